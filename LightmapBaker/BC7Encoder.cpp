@@ -0,0 +1,321 @@
+#include "BC7Encoder.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+	// interpolation weights of 4-bit indices, out of 64
+	const int Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	// an endpoint as mode 6 stores it: 7 bits per channel and one shared low bit
+	struct Endpoint {
+		int value[4];
+		int pbit;
+
+		int Channel(int channel) const { return value[channel] << 1 | pbit; }
+	};
+
+	struct EncodedBlock {
+		Endpoint endpoints[2];
+		int indices[16];
+		long long error;
+	};
+
+	Endpoint quantize(const float* color)
+	{
+		Endpoint best = {};
+		long long bestError = -1;
+		for (int pbit = 0; pbit < 2; pbit++)
+		{
+			Endpoint endpoint = {};
+			endpoint.pbit = pbit;
+			long long error = 0;
+			for (int channel = 0; channel < 4; channel++)
+			{
+				int value = static_cast<int>(std::lround((color[channel] - pbit) * 0.5f));
+				endpoint.value[channel] = std::clamp(value, 0, 127);
+				float difference = endpoint.Channel(channel) - color[channel];
+				error += static_cast<long long>(difference * difference);
+			}
+			if (bestError < 0 || error < bestError)
+			{
+				best = endpoint;
+				bestError = error;
+			}
+		}
+		return best;
+	}
+
+	// picks the closest of the 16 colours for every pixel
+	long long assignIndices(const uint8_t* pixels, const Endpoint* endpoints, int* indices)
+	{
+		int palette[16][4];
+		for (int i = 0; i < 16; i++)
+		{
+			for (int channel = 0; channel < 4; channel++)
+				palette[i][channel] = ((64 - Weights[i]) * endpoints[0].Channel(channel) + Weights[i] * endpoints[1].Channel(channel) + 32) >> 6;
+		}
+
+		long long total = 0;
+		for (int pixel = 0; pixel < 16; pixel++)
+		{
+			long long best = -1;
+			for (int i = 0; i < 16; i++)
+			{
+				long long error = 0;
+				for (int channel = 0; channel < 4; channel++)
+				{
+					int difference = palette[i][channel] - pixels[pixel * 4 + channel];
+					error += difference * difference;
+				}
+				if (best < 0 || error < best)
+				{
+					best = error;
+					indices[pixel] = i;
+				}
+			}
+			total += best;
+		}
+		return total;
+	}
+
+	// the endpoints that best reproduce the pixels with the given indices, by least squares
+	bool refit(const uint8_t* pixels, const int* indices, float* first, float* second)
+	{
+		float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+		float ax[4] = {}, bx[4] = {};
+		for (int pixel = 0; pixel < 16; pixel++)
+		{
+			float b = Weights[indices[pixel]] / 64.0f;
+			float a = 1.0f - b;
+			aa += a * a;
+			ab += a * b;
+			bb += b * b;
+			for (int channel = 0; channel < 4; channel++)
+			{
+				ax[channel] += a * pixels[pixel * 4 + channel];
+				bx[channel] += b * pixels[pixel * 4 + channel];
+			}
+		}
+		float determinant = aa * bb - ab * ab;
+		if (std::abs(determinant) < 1e-6f)
+			return false;
+		for (int channel = 0; channel < 4; channel++)
+		{
+			first[channel] = std::clamp((ax[channel] * bb - bx[channel] * ab) / determinant, 0.0f, 255.0f);
+			second[channel] = std::clamp((bx[channel] * aa - ax[channel] * ab) / determinant, 0.0f, 255.0f);
+		}
+		return true;
+	}
+
+	EncodedBlock encodeBlock(const uint8_t* pixels)
+	{
+		float mean[4] = {};
+		for (int pixel = 0; pixel < 16; pixel++)
+		{
+			for (int channel = 0; channel < 4; channel++)
+				mean[channel] += pixels[pixel * 4 + channel] / 16.0f;
+		}
+
+		float covariance[4][4] = {};
+		for (int pixel = 0; pixel < 16; pixel++)
+		{
+			float offset[4];
+			for (int channel = 0; channel < 4; channel++)
+				offset[channel] = pixels[pixel * 4 + channel] - mean[channel];
+			for (int row = 0; row < 4; row++)
+			{
+				for (int column = 0; column < 4; column++)
+					covariance[row][column] += offset[row] * offset[column];
+			}
+		}
+
+		// principal axis by power iteration
+		float axis[4] = { 1.0f, 1.0f, 1.0f, 0.0f };
+		for (int iteration = 0; iteration < 8; iteration++)
+		{
+			float next[4] = {};
+			for (int row = 0; row < 4; row++)
+			{
+				for (int column = 0; column < 4; column++)
+					next[row] += covariance[row][column] * axis[column];
+			}
+			float length = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2] + next[3] * next[3]);
+			if (length < 1e-6f)
+				break;
+			for (int channel = 0; channel < 4; channel++)
+				axis[channel] = next[channel] / length;
+		}
+
+		float minProjection = 0.0f, maxProjection = 0.0f;
+		for (int pixel = 0; pixel < 16; pixel++)
+		{
+			float projection = 0.0f;
+			for (int channel = 0; channel < 4; channel++)
+				projection += (pixels[pixel * 4 + channel] - mean[channel]) * axis[channel];
+			minProjection = std::min(minProjection, projection);
+			maxProjection = std::max(maxProjection, projection);
+		}
+
+		float first[4], second[4];
+		for (int channel = 0; channel < 4; channel++)
+		{
+			first[channel] = std::clamp(mean[channel] + axis[channel] * minProjection, 0.0f, 255.0f);
+			second[channel] = std::clamp(mean[channel] + axis[channel] * maxProjection, 0.0f, 255.0f);
+		}
+
+		EncodedBlock best;
+		best.endpoints[0] = quantize(first);
+		best.endpoints[1] = quantize(second);
+		best.error = assignIndices(pixels, best.endpoints, best.indices);
+		for (int iteration = 0; iteration < 2 && best.error > 0; iteration++)
+		{
+			EncodedBlock candidate;
+			if (!refit(pixels, best.indices, first, second))
+				break;
+			candidate.endpoints[0] = quantize(first);
+			candidate.endpoints[1] = quantize(second);
+			candidate.error = assignIndices(pixels, candidate.endpoints, candidate.indices);
+			if (candidate.error >= best.error)
+				break;
+			best = candidate;
+		}
+
+		// the first index is stored without its top bit, which therefore has to be zero
+		if (best.indices[0] >= 8)
+		{
+			std::swap(best.endpoints[0], best.endpoints[1]);
+			for (int& index : best.indices)
+				index = 15 - index;
+		}
+		return best;
+	}
+
+	class BitWriter
+	{
+	public:
+		explicit BitWriter(uint8_t* block) : block(block) { std::memset(block, 0, 16); }
+
+		void Write(uint32_t value, int bits)
+		{
+			for (int bit = 0; bit < bits; bit++, position++)
+			{
+				if (value >> bit & 1)
+					block[position >> 3] |= static_cast<uint8_t>(1 << (position & 7));
+			}
+		}
+
+	private:
+		uint8_t* block;
+		int position = 0;
+	};
+
+	class BitReader
+	{
+	public:
+		explicit BitReader(const uint8_t* block) : block(block) {}
+
+		uint32_t Read(int bits)
+		{
+			uint32_t value = 0;
+			for (int bit = 0; bit < bits; bit++, position++)
+				value |= static_cast<uint32_t>(block[position >> 3] >> (position & 7) & 1) << bit;
+			return value;
+		}
+
+	private:
+		const uint8_t* block;
+		int position = 0;
+	};
+
+	void writeBlock(const EncodedBlock& encoded, uint8_t* block)
+	{
+		BitWriter writer(block);
+		// mode 6 is six zero bits and a one
+		writer.Write(1u << 6, 7);
+		for (int channel = 0; channel < 4; channel++)
+		{
+			writer.Write(encoded.endpoints[0].value[channel], 7);
+			writer.Write(encoded.endpoints[1].value[channel], 7);
+		}
+		writer.Write(encoded.endpoints[0].pbit, 1);
+		writer.Write(encoded.endpoints[1].pbit, 1);
+		writer.Write(encoded.indices[0], 3);
+		for (int pixel = 1; pixel < 16; pixel++)
+			writer.Write(encoded.indices[pixel], 4);
+	}
+}
+
+void EncodeBC7(const uint8_t* rgba, uint32_t width, uint32_t height, std::vector<uint8_t>& blocks)
+{
+	uint32_t blocksX = width / 4, blocksY = height / 4;
+	blocks.resize(static_cast<size_t>(blocksX) * blocksY * 16);
+	JobSystem::ParallelFor(blocksY, 1, [&](size_t begin, size_t end) {
+		uint8_t pixels[16 * 4];
+		for (size_t blockY = begin; blockY < end; blockY++)
+		{
+			for (uint32_t blockX = 0; blockX < blocksX; blockX++)
+			{
+				for (uint32_t row = 0; row < 4; row++)
+					std::memcpy(pixels + row * 16, rgba + ((blockY * 4 + row) * width + blockX * 4) * 4, 16);
+				writeBlock(encodeBlock(pixels), &blocks[(blockY * blocksX + blockX) * 16]);
+			}
+		}
+	});
+}
+
+void DecodeBC7(const uint8_t* blocks, uint32_t width, uint32_t height, std::vector<uint8_t>& rgba)
+{
+	uint32_t blocksX = width / 4, blocksY = height / 4;
+	rgba.assign(static_cast<size_t>(width) * height * 4, 0);
+	for (uint32_t blockY = 0; blockY < blocksY; blockY++)
+	{
+		for (uint32_t blockX = 0; blockX < blocksX; blockX++)
+		{
+			BitReader reader(blocks + (blockY * blocksX + blockX) * 16);
+			if (reader.Read(7) != 1u << 6)
+				continue;
+
+			int endpoints[2][4];
+			for (int channel = 0; channel < 4; channel++)
+			{
+				endpoints[0][channel] = reader.Read(7) << 1;
+				endpoints[1][channel] = reader.Read(7) << 1;
+			}
+			int pbits[2] = { static_cast<int>(reader.Read(1)), static_cast<int>(reader.Read(1)) };
+			for (int channel = 0; channel < 4; channel++)
+			{
+				endpoints[0][channel] |= pbits[0];
+				endpoints[1][channel] |= pbits[1];
+			}
+
+			for (int pixel = 0; pixel < 16; pixel++)
+			{
+				int weight = Weights[reader.Read(pixel == 0 ? 3 : 4)];
+				uint8_t* out = &rgba[((blockY * 4 + pixel / 4) * width + blockX * 4 + pixel % 4) * 4];
+				for (int channel = 0; channel < 4; channel++)
+					out[channel] = static_cast<uint8_t>(((64 - weight) * endpoints[0][channel] + weight * endpoints[1][channel] + 32) >> 6);
+			}
+		}
+	}
+}
+
+BC7Error MeasureBC7Error(const uint8_t* original, const uint8_t* decoded, uint32_t width, uint32_t height)
+{
+	BC7Error result;
+	double sum = 0.0;
+	size_t pixels = static_cast<size_t>(width) * height;
+	for (size_t i = 0; i < pixels; i++)
+	{
+		for (int channel = 0; channel < 3; channel++)
+		{
+			int difference = std::abs(original[i * 4 + channel] - decoded[i * 4 + channel]);
+			sum += difference * difference;
+			result.max = std::max(result.max, difference);
+		}
+	}
+	result.rms = pixels ? std::sqrt(sum / (pixels * 3)) : 0.0;
+	return result;
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+struct BC7Error {
+	// per channel, in 8-bit steps, over RGB
+	double rms = 0.0;
+	int max = 0;
+};
+
+// BC7 in mode 6 only: one pair of RGBA endpoints per 4x4 block and a 4-bit index per
+// pixel. That is the mode with the most colour precision for a single gradient, which
+// is what a block of smooth baked light is. Endpoints come from the block's principal
+// axis and are refitted to the chosen indices by least squares. Blocks are encoded as
+// jobs; width and height must be multiples of four.
+void EncodeBC7(const uint8_t* rgba, uint32_t width, uint32_t height, std::vector<uint8_t>& blocks);
+
+// the inverse, for blocks EncodeBC7 wrote; other modes decode as black
+void DecodeBC7(const uint8_t* blocks, uint32_t width, uint32_t height, std::vector<uint8_t>& rgba);
+
+BC7Error MeasureBC7Error(const uint8_t* original, const uint8_t* decoded, uint32_t width, uint32_t height);
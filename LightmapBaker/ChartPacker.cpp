@@ -0,0 +1,347 @@
+#include "ChartPacker.h"
+#include "ModelLoader.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <unordered_map>
+
+namespace {
+	// a chart before packing: its plane, and its extent there in world units
+	struct ChartShape {
+		// the two axes the chart is flattened onto
+		int axisU = 0;
+		int axisV = 1;
+		glm::vec2 min = glm::vec2(INFINITY);
+		glm::vec2 max = glm::vec2(-INFINITY);
+		// u and v trade places so the chart is never taller than wide
+		bool swapped = false;
+	};
+
+	struct PositionKey {
+		uint32_t bits[3];
+
+		bool operator==(const PositionKey& other) const { return std::memcmp(bits, other.bits, sizeof(bits)) == 0; }
+	};
+
+	struct PositionKeyHash {
+		size_t operator()(const PositionKey& key) const
+		{
+			return (static_cast<size_t>(key.bits[0]) * 73856093u) ^ (static_cast<size_t>(key.bits[1]) * 19349663u) ^ (static_cast<size_t>(key.bits[2]) * 83492791u);
+		}
+	};
+
+	PositionKey makeKey(const glm::vec3& position)
+	{
+		PositionKey key;
+		// +0 and -0 are the same point
+		glm::vec3 canonical = position + glm::vec3(0.0f);
+		std::memcpy(key.bits, &canonical, sizeof(key.bits));
+		return key;
+	}
+
+	uint64_t edgeKey(uint32_t a, uint32_t b)
+	{
+		return a < b ? (static_cast<uint64_t>(a) << 32 | b) : (static_cast<uint64_t>(b) << 32 | a);
+	}
+
+	// +x, -x, +y, -y, +z, -z, whichever the normal is closest to
+	int dominantDirection(const glm::vec3& normal)
+	{
+		glm::vec3 magnitude = glm::abs(normal);
+		int axis = magnitude.x >= magnitude.y ? (magnitude.x >= magnitude.z ? 0 : 2) : (magnitude.y >= magnitude.z ? 1 : 2);
+		return axis * 2 + (normal[axis] < 0.0f ? 1 : 0);
+	}
+
+	// true if the insides of two triangles overlap by more than tolerance; triangles that
+	// only share an edge or a corner do not
+	bool overlaps(const glm::vec2* a, const glm::vec2* b, float tolerance)
+	{
+		for (int triangle = 0; triangle < 2; triangle++)
+		{
+			const glm::vec2* corners = triangle == 0 ? a : b;
+			for (int edge = 0; edge < 3; edge++)
+			{
+				glm::vec2 direction = corners[(edge + 1) % 3] - corners[edge];
+				glm::vec2 axis(-direction.y, direction.x);
+				float length = glm::length(axis);
+				if (length <= 0.0f)
+					continue;
+				axis /= length;
+
+				float minA = INFINITY, maxA = -INFINITY, minB = INFINITY, maxB = -INFINITY;
+				for (int corner = 0; corner < 3; corner++)
+				{
+					float projectedA = glm::dot(a[corner], axis);
+					float projectedB = glm::dot(b[corner], axis);
+					minA = std::min(minA, projectedA);
+					maxA = std::max(maxA, projectedA);
+					minB = std::min(minB, projectedB);
+					maxB = std::max(maxB, projectedB);
+				}
+				if (maxA <= minB + tolerance || maxB <= minA + tolerance)
+					return false;
+			}
+		}
+		return true;
+	}
+
+	// the triangles already in a chart, bucketed by a grid over its plane
+	class ChartGrid
+	{
+	public:
+		explicit ChartGrid(float cellSize) : inverseCell(1.0f / cellSize) {}
+
+		void Clear() { cells.clear(); }
+
+		template<typename Function>
+		bool Any(const glm::vec2& min, const glm::vec2& max, Function&& function) const
+		{
+			glm::ivec2 first = cell(min), last = cell(max);
+			for (int y = first.y; y <= last.y; y++)
+			{
+				for (int x = first.x; x <= last.x; x++)
+				{
+					auto found = cells.find(key(x, y));
+					if (found == cells.end())
+						continue;
+					for (uint32_t triangle : found->second)
+					{
+						if (function(triangle))
+							return true;
+					}
+				}
+			}
+			return false;
+		}
+
+		void Add(const glm::vec2& min, const glm::vec2& max, uint32_t triangle)
+		{
+			glm::ivec2 first = cell(min), last = cell(max);
+			for (int y = first.y; y <= last.y; y++)
+			{
+				for (int x = first.x; x <= last.x; x++)
+					cells[key(x, y)].push_back(triangle);
+			}
+		}
+
+	private:
+		float inverseCell;
+		std::unordered_map<uint64_t, std::vector<uint32_t>> cells;
+
+		glm::ivec2 cell(const glm::vec2& point) const { return glm::ivec2(glm::floor(point * inverseCell)); }
+		static uint64_t key(int x, int y) { return static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32 | static_cast<uint32_t>(y); }
+	};
+
+	uint32_t roundUp4(uint32_t value)
+	{
+		return (value + 3) & ~3u;
+	}
+
+	// the rectangle a chart needs at scale texels per unit, padding included
+	glm::uvec2 chartSize(const ChartShape& shape, float scale, uint32_t padding)
+	{
+		glm::vec2 extent = (shape.max - shape.min) * scale;
+		if (shape.swapped)
+			extent = glm::vec2(extent.y, extent.x);
+		return glm::uvec2(glm::max(glm::ceil(extent), glm::vec2(1.0f))) + glm::uvec2(padding * 2);
+	}
+
+	// shelf packing, tallest charts first; returns the atlas size
+	glm::uvec2 packShelves(std::vector<Chart>& charts, const std::vector<ChartShape>& shapes, float scale, uint32_t padding)
+	{
+		std::vector<uint32_t> order(charts.size());
+		double area = 0.0;
+		uint32_t widest = 4;
+		for (uint32_t i = 0; i < charts.size(); i++)
+		{
+			glm::uvec2 size = chartSize(shapes[i], scale, padding);
+			charts[i].width = size.x;
+			charts[i].height = size.y;
+			area += static_cast<double>(size.x) * size.y;
+			widest = std::max(widest, size.x);
+			order[i] = i;
+		}
+		std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+			return charts[a].height != charts[b].height ? charts[a].height > charts[b].height : charts[a].width > charts[b].width;
+		});
+
+		// rows leave some of each shelf empty, aim a little wider than a square of the area
+		uint32_t width = roundUp4(std::max(widest, static_cast<uint32_t>(std::ceil(std::sqrt(area * 1.1)))));
+		uint32_t x = 0, y = 0, shelfHeight = 0;
+		for (uint32_t i : order)
+		{
+			Chart& chart = charts[i];
+			if (x + chart.width > width)
+			{
+				x = 0;
+				y += shelfHeight;
+				shelfHeight = 0;
+			}
+			chart.x = x;
+			chart.y = y;
+			x += chart.width;
+			shelfHeight = std::max(shelfHeight, chart.height);
+		}
+		return glm::uvec2(width, roundUp4(std::max(y + shelfHeight, 4u)));
+	}
+}
+
+ChartAtlas PackCharts(const ModelData& model, const ChartOptions& options)
+{
+	ChartAtlas atlas;
+	std::vector<ChartShape> shapes;
+	atlas.triangleCharts.resize(model.meshes.size());
+
+	// grid cells of a few texels, at the requested density
+	ChartGrid grid(8.0f / options.texelsPerUnit);
+	for (uint32_t meshIndex = 0; meshIndex < model.meshes.size(); meshIndex++)
+	{
+		const MeshData& mesh = model.meshes[meshIndex];
+		uint32_t triangleCount = static_cast<uint32_t>(mesh.indices.size() / 3);
+
+		// corners at the same position are one, whatever else differs between them
+		std::unordered_map<PositionKey, uint32_t, PositionKeyHash> welded;
+		std::vector<uint32_t> weld(mesh.vertices.size());
+		for (size_t i = 0; i < mesh.vertices.size(); i++)
+			weld[i] = welded.emplace(makeKey(mesh.vertices[i].Position), static_cast<uint32_t>(welded.size())).first->second;
+
+		std::vector<int> directions(triangleCount);
+		std::unordered_map<uint64_t, std::vector<uint32_t>> edges;
+		for (uint32_t triangle = 0; triangle < triangleCount; triangle++)
+		{
+			const unsigned int* corner = &mesh.indices[triangle * 3];
+			glm::vec3 a = mesh.vertices[corner[0]].Position, b = mesh.vertices[corner[1]].Position, c = mesh.vertices[corner[2]].Position;
+			directions[triangle] = dominantDirection(glm::cross(b - a, c - a));
+			for (int edge = 0; edge < 3; edge++)
+			{
+				uint32_t from = weld[corner[edge]], to = weld[corner[(edge + 1) % 3]];
+				if (from != to)
+					edges[edgeKey(from, to)].push_back(triangle);
+			}
+		}
+
+		std::vector<uint32_t>& triangleCharts = atlas.triangleCharts[meshIndex];
+		triangleCharts.assign(triangleCount, UINT32_MAX);
+		std::vector<glm::vec2> projected(3);
+		std::vector<glm::vec2> chartCorners;
+		std::vector<uint32_t> queue;
+		for (uint32_t seed = 0; seed < triangleCount; seed++)
+		{
+			if (triangleCharts[seed] != UINT32_MAX)
+				continue;
+
+			uint32_t chartIndex = static_cast<uint32_t>(atlas.charts.size());
+			Chart chart;
+			chart.mesh = meshIndex;
+			ChartShape shape;
+			int direction = directions[seed];
+			int axis = direction / 2;
+			shape.axisU = (axis + 1) % 3;
+			shape.axisV = (axis + 2) % 3;
+
+			grid.Clear();
+			chartCorners.clear();
+			queue.assign(1, seed);
+			triangleCharts[seed] = chartIndex;
+			for (size_t next = 0; next < queue.size(); next++)
+			{
+				uint32_t triangle = queue[next];
+				const unsigned int* corner = &mesh.indices[triangle * 3];
+				glm::vec2 corners[3], min(INFINITY), max(-INFINITY);
+				for (int i = 0; i < 3; i++)
+				{
+					const glm::vec3& position = mesh.vertices[corner[i]].Position;
+					corners[i] = glm::vec2(position[shape.axisU], position[shape.axisV]);
+					min = glm::min(min, corners[i]);
+					max = glm::max(max, corners[i]);
+				}
+
+				// the seed always fits; anything else must not fold back over the chart
+				float tolerance = 1e-4f * std::max(1.0f, glm::length(max - min));
+				if (next > 0 && grid.Any(min, max, [&](uint32_t other) { return overlaps(corners, &chartCorners[other * 3], tolerance); }))
+				{
+					triangleCharts[triangle] = UINT32_MAX;
+					continue;
+				}
+
+				uint32_t local = static_cast<uint32_t>(chart.triangles.size());
+				chart.triangles.push_back(triangle);
+				chartCorners.insert(chartCorners.end(), corners, corners + 3);
+				grid.Add(min, max, local);
+				shape.min = glm::min(shape.min, min);
+				shape.max = glm::max(shape.max, max);
+
+				for (int edge = 0; edge < 3; edge++)
+				{
+					uint32_t from = weld[corner[edge]], to = weld[corner[(edge + 1) % 3]];
+					if (from == to)
+						continue;
+					for (uint32_t neighbour : edges[edgeKey(from, to)])
+					{
+						if (triangleCharts[neighbour] == UINT32_MAX && directions[neighbour] == direction)
+						{
+							triangleCharts[neighbour] = chartIndex;
+							queue.push_back(neighbour);
+						}
+					}
+				}
+			}
+
+			glm::vec2 extent = shape.max - shape.min;
+			shape.swapped = extent.y > extent.x;
+			atlas.charts.push_back(std::move(chart));
+			shapes.push_back(shape);
+		}
+	}
+
+	// lower the density until the atlas fits
+	float scale = options.texelsPerUnit;
+	glm::uvec2 size = packShelves(atlas.charts, shapes, scale, options.padding);
+	while ((size.x > options.maxSize || size.y > options.maxSize) && scale > 1e-6f)
+	{
+		scale *= 0.9f;
+		size = packShelves(atlas.charts, shapes, scale, options.padding);
+	}
+	if (scale != options.texelsPerUnit)
+		std::cout << "Lightmap density lowered to " << scale << " texels per unit to fit " << options.maxSize << " texels" << std::endl;
+	atlas.width = size.x;
+	atlas.height = size.y;
+	atlas.texelsPerUnit = scale;
+
+	// a vertex of every source vertex in every chart it is part of
+	atlas.meshes.resize(model.meshes.size());
+	for (uint32_t meshIndex = 0; meshIndex < model.meshes.size(); meshIndex++)
+	{
+		const MeshData& source = model.meshes[meshIndex];
+		LightmapMesh& mesh = atlas.meshes[meshIndex];
+		mesh.sourceVertexCount = static_cast<uint32_t>(source.vertices.size());
+		mesh.sourceIndexCount = static_cast<uint32_t>(source.indices.size());
+		mesh.sourceHash = LightmapData::HashMesh(source);
+		mesh.indices.resize(source.indices.size());
+
+		std::unordered_map<uint64_t, uint32_t> vertices;
+		const std::vector<uint32_t>& triangleCharts = atlas.triangleCharts[meshIndex];
+		for (size_t corner = 0; corner < source.indices.size(); corner++)
+		{
+			uint32_t chartIndex = triangleCharts[corner / 3];
+			uint32_t vertex = source.indices[corner];
+			auto inserted = vertices.emplace(static_cast<uint64_t>(chartIndex) << 32 | vertex, static_cast<uint32_t>(mesh.vertexRemap.size()));
+			if (inserted.second)
+			{
+				const Chart& chart = atlas.charts[chartIndex];
+				const ChartShape& shape = shapes[chartIndex];
+				const glm::vec3& position = source.vertices[vertex].Position;
+				glm::vec2 local = (glm::vec2(position[shape.axisU], position[shape.axisV]) - shape.min) * scale;
+				if (shape.swapped)
+					local = glm::vec2(local.y, local.x);
+				glm::vec2 texel = glm::vec2(chart.x + options.padding, chart.y + options.padding) + local;
+				mesh.vertexRemap.push_back(vertex);
+				mesh.coords.push_back(texel / glm::vec2(atlas.width, atlas.height));
+			}
+			mesh.indices[corner] = inserted.first->second;
+		}
+	}
+	return atlas;
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include "Lightmap.h"
+
+struct ModelData;
+
+struct ChartOptions {
+	// lightmap resolution on the surfaces; lowered if the atlas would not fit otherwise
+	float texelsPerUnit = 0.125f;
+	// texels around every chart, so filtering never reaches into a neighbour
+	uint32_t padding = 2;
+	uint32_t maxSize = 4096;
+};
+
+// A connected piece of one mesh that faces one way, flattened onto the plane it faces.
+struct Chart {
+	uint32_t mesh = 0;
+	// triangles of the mesh, index list position / 3
+	std::vector<uint32_t> triangles;
+	// atlas rectangle in texels, padding included
+	uint32_t x = 0, y = 0;
+	uint32_t width = 0, height = 0;
+};
+
+struct ChartAtlas {
+	uint32_t width = 0;
+	uint32_t height = 0;
+	float texelsPerUnit = 0.0f;
+	std::vector<Chart> charts;
+	// every mesh rebuilt for the lightmap, with coordinates in [0, 1] across the atlas
+	std::vector<LightmapMesh> meshes;
+	// chart of each triangle of each rebuilt mesh, triangles in their original order
+	std::vector<std::vector<uint32_t>> triangleCharts;
+};
+
+// Gives every mesh of model a second UV set without overlaps. Triangles are grouped by
+// the axis their normal is closest to, grown into charts across shared edges and projected
+// along that axis, so a chart keeps the surface's proportions and a texel covers the same
+// area everywhere. A triangle that would land on top of one already in its chart starts
+// a chart of its own. The charts are packed in rows by height into one atlas whose sides
+// are multiples of four, as block compression needs.
+ChartAtlas PackCharts(const ModelData& model, const ChartOptions& options);
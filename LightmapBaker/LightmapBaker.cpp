@@ -0,0 +1,708 @@
+// Offline lightmap baker. Gives every mesh of a static model a second UV set, path traces
+// the light that reaches each texel of it from a sun and a sky, bounces included, and
+// writes the result as BC7 next to the model, where Object picks it up on load.
+//
+//   LightmapBaker [options] model.obj
+//
+//   --samples N            paths per texel (64)
+//   --bounces N            reflections light may take before it reaches a texel (3)
+//   --texels-per-unit F    lightmap density on the surfaces (0.5)
+//   --max-size N           largest atlas side; the density is lowered to fit (4096)
+//   --sun x y z            direction towards the sun in model space (0.35 0.85 0.4)
+//   --sun-color r g b      light on a surface facing the sun, 0 for no sun (1.6 1.5 1.3)
+//   --sky r g b            light on a surface open to the whole sky (0.35 0.4 0.5)
+//   --threads N            workers besides the main thread (one per hardware thread but one)
+//   --flip                 flip textures on load, as the viewer does for the stalkyard maps
+//   --output file          defaults to the model path + ".lightmap"
+//   --png file             also writes the compressed atlas, decoded, for inspection
+//
+// Texels are traced as jobs across every core against a BVH with four-wide SSE triangle
+// tests. The noise left is filtered by an edge-aware a-trous wavelet that never crosses
+// from one chart into another, and the filtered light is stored as sqrt(light / Range)
+// so the 8 bits of BC7 go where dark values need them.
+
+#include "ModelLoader.h"
+#include "Lightmap.h"
+#include "JobSystem.h"
+#include "ImageWriter.h"
+#include "ChartPacker.h"
+#include "RayTracer.h"
+#include "BC7Encoder.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+	const float Pi = 3.14159265358979f;
+
+	struct BakeOptions {
+		int samples = 64;
+		int bounces = 3;
+		ChartOptions charts = { 0.5f, 2, 4096 };
+		glm::vec3 sunDirection = glm::vec3(0.35f, 0.85f, 0.4f);
+		glm::vec3 sunColor = glm::vec3(1.6f, 1.5f, 1.3f);
+		glm::vec3 skyColor = glm::vec3(0.35f, 0.4f, 0.5f);
+		int threads = -1;
+		bool flipTextures = false;
+		std::string output;
+		std::string png;
+	};
+
+	// a point on a triangle, both normals facing the side it is seen from
+	struct SurfacePoint {
+		glm::vec3 position;
+		glm::vec3 normal;
+		glm::vec3 faceNormal;
+	};
+
+	// pcg hash, one stream per texel so the bake does not depend on how jobs are split
+	class Random
+	{
+	public:
+		explicit Random(uint32_t seed) : state(seed * 747796405u + 2891336453u) {}
+
+		float Next()
+		{
+			state = state * 747796405u + 2891336453u;
+			uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+			word = (word >> 22u) ^ word;
+			return (word >> 8) * (1.0f / 16777216.0f);
+		}
+
+	private:
+		uint32_t state;
+	};
+
+	// two tangents completing an orthonormal basis around a unit normal
+	void makeBasis(const glm::vec3& normal, glm::vec3& tangent, glm::vec3& bitangent)
+	{
+		float sign = std::copysign(1.0f, normal.z);
+		float a = -1.0f / (sign + normal.z);
+		float b = normal.x * normal.y * a;
+		tangent = glm::vec3(1.0f + sign * normal.x * normal.x * a, sign * b, -sign * normal.x);
+		bitangent = glm::vec3(b, sign + normal.y * normal.y * a, -normal.y);
+	}
+
+	// cosine weighted, so a mean of incoming light over these directions is irradiance / pi
+	glm::vec3 sampleHemisphere(const glm::vec3& normal, Random& random)
+	{
+		glm::vec3 tangent, bitangent;
+		makeBasis(normal, tangent, bitangent);
+		float radius = std::sqrt(random.Next());
+		float angle = 2.0f * Pi * random.Next();
+		float height = std::sqrt(std::max(0.0f, 1.0f - radius * radius));
+		return tangent * (radius * std::cos(angle)) + bitangent * (radius * std::sin(angle)) + normal * height;
+	}
+
+	// barycentric weights of the point of a 2D triangle closest to point, and its distance
+	float closestBarycentric(const glm::vec2* corners, const glm::vec2& point, glm::vec3& weights)
+	{
+		glm::vec2 edge1 = corners[1] - corners[0], edge2 = corners[2] - corners[0];
+		float area = edge1.x * edge2.y - edge1.y * edge2.x;
+		if (std::abs(area) > 1e-12f)
+		{
+			glm::vec2 offset = point - corners[0];
+			float u = (offset.x * edge2.y - offset.y * edge2.x) / area;
+			float v = (edge1.x * offset.y - edge1.y * offset.x) / area;
+			if (u >= 0.0f && v >= 0.0f && u + v <= 1.0f)
+			{
+				weights = glm::vec3(1.0f - u - v, u, v);
+				return 0.0f;
+			}
+		}
+
+		// outside, or too thin to have an inside: the nearest point of the nearest edge
+		float best = INFINITY;
+		for (int edge = 0; edge < 3; edge++)
+		{
+			int from = edge, to = (edge + 1) % 3;
+			glm::vec2 direction = corners[to] - corners[from];
+			float lengthSquared = glm::dot(direction, direction);
+			float t = lengthSquared > 0.0f ? std::clamp(glm::dot(point - corners[from], direction) / lengthSquared, 0.0f, 1.0f) : 0.0f;
+			float distance = glm::length(corners[from] + direction * t - point);
+			if (distance < best)
+			{
+				best = distance;
+				weights = glm::vec3(0.0f);
+				weights[from] = 1.0f - t;
+				weights[to] = t;
+			}
+		}
+		return best;
+	}
+
+	float luminance(const glm::vec3& color)
+	{
+		return glm::dot(color, glm::vec3(0.2126f, 0.7152f, 0.0722f));
+	}
+
+	// every triangle of the model in one BVH, and what shading a hit needs
+	class BakeScene
+	{
+	public:
+		BakeScene(const ModelData& model, const BakeOptions& options) : model(model), options(options)
+		{
+			for (uint32_t mesh = 0; mesh < model.meshes.size(); mesh++)
+			{
+				meshTriangles.push_back(static_cast<uint32_t>(triangles.size()));
+				const MeshData& data = model.meshes[mesh];
+				for (uint32_t corner = 0; corner + 2 < data.indices.size(); corner += 3)
+				{
+					triangles.push_back({ mesh, corner });
+					for (int i = 0; i < 3; i++)
+						corners.push_back(data.vertices[data.indices[corner + i]].Position);
+				}
+			}
+
+			glm::vec3 min(INFINITY), max(-INFINITY);
+			for (const glm::vec3& corner : corners)
+			{
+				min = glm::min(min, corner);
+				max = glm::max(max, corner);
+			}
+			// far enough off the surface to clear rounding, close enough not to skip thin walls
+			rayOffset = corners.empty() ? 0.0f : std::max(glm::length(max - min) * 2e-5f, 1e-4f);
+
+			for (const MaterialData& material : model.materials)
+			{
+				int image = -1;
+				for (const MaterialTexture& texture : material.textures)
+				{
+					if (texture.type == "texture_diffuse" && model.images[texture.image].pixels)
+					{
+						image = static_cast<int>(texture.image);
+						break;
+					}
+				}
+				// texture.shader falls back to the ambient colour without a diffuse map
+				materialImages.push_back(image);
+				materialColors.push_back(glm::vec3(material.parameters.Ambient));
+			}
+		}
+
+		void Build() { tracer.Build(corners); }
+		const RayTracer& GetTracer() const { return tracer; }
+		float GetRayOffset() const { return rayOffset; }
+		uint32_t GetTriangleIndex(uint32_t mesh, uint32_t triangle) const { return meshTriangles[mesh] + triangle; }
+
+		SurfacePoint Evaluate(uint32_t triangle, const glm::vec3& weights) const
+		{
+			const MeshData& mesh = model.meshes[triangles[triangle].mesh];
+			const unsigned int* index = &mesh.indices[triangles[triangle].corner];
+			SurfacePoint point;
+			point.position = corners[triangle * 3] * weights.x + corners[triangle * 3 + 1] * weights.y + corners[triangle * 3 + 2] * weights.z;
+			point.faceNormal = glm::cross(corners[triangle * 3 + 1] - corners[triangle * 3], corners[triangle * 3 + 2] - corners[triangle * 3]);
+			float faceLength = glm::length(point.faceNormal);
+			point.faceNormal = faceLength > 0.0f ? point.faceNormal / faceLength : glm::vec3(0.0f, 1.0f, 0.0f);
+
+			glm::vec3 normal = mesh.vertices[index[0]].Normal * weights.x + mesh.vertices[index[1]].Normal * weights.y + mesh.vertices[index[2]].Normal * weights.z;
+			float length = glm::length(normal);
+			point.normal = length > 0.0f ? normal / length : point.faceNormal;
+			// the side the vertex normals point to is the side that is lit
+			if (glm::dot(point.faceNormal, point.normal) < 0.0f)
+				point.faceNormal = -point.faceNormal;
+			return point;
+		}
+
+		glm::vec3 Albedo(uint32_t triangle, const glm::vec3& weights) const
+		{
+			const MeshData& mesh = model.meshes[triangles[triangle].mesh];
+			int image = materialImages[mesh.material];
+			glm::vec3 color = materialColors[mesh.material];
+			if (image >= 0)
+			{
+				const unsigned int* index = &mesh.indices[triangles[triangle].corner];
+				glm::vec2 uv = mesh.vertices[index[0]].TexCoords * weights.x + mesh.vertices[index[1]].TexCoords * weights.y + mesh.vertices[index[2]].TexCoords * weights.z;
+				const ImageData& data = model.images[image];
+				// the first row of the image is uploaded as t = 0 and the textures repeat
+				int x = static_cast<int>((uv.x - std::floor(uv.x)) * data.width) % data.width;
+				int y = static_cast<int>((uv.y - std::floor(uv.y)) * data.height) % data.height;
+				const unsigned char* texel = data.pixels.get() + (static_cast<size_t>(y) * data.width + x) * data.components;
+				color = data.components < 3 ? glm::vec3(texel[0] / 255.0f) : glm::vec3(texel[0], texel[1], texel[2]) / 255.0f;
+			}
+			// nothing real reflects everything, and a bounce that did would never converge
+			return glm::min(color, glm::vec3(0.9f));
+		}
+
+		// light from the sun on a point, if nothing is in between
+		glm::vec3 SunLight(const SurfacePoint& point, uint64_t& rays) const
+		{
+			float cosine = glm::dot(point.normal, options.sunDirection);
+			if (cosine <= 0.0f || glm::dot(point.faceNormal, options.sunDirection) <= 0.0f || options.sunColor == glm::vec3(0.0f))
+				return glm::vec3(0.0f);
+			rays++;
+			if (tracer.Occluded(point.position + point.faceNormal * rayOffset, options.sunDirection, INFINITY))
+				return glm::vec3(0.0f);
+			return options.sunColor * cosine;
+		}
+
+		// light arriving at point from a random direction, weighted for irradiance / pi;
+		// backFace is set if the first thing the path hits is the back of a triangle
+		glm::vec3 IndirectLight(SurfacePoint point, Random& random, uint64_t& rays, bool& backFace) const
+		{
+			glm::vec3 result(0.0f), throughput(1.0f);
+			backFace = false;
+			for (int bounce = 0; bounce < options.bounces; bounce++)
+			{
+				glm::vec3 direction = sampleHemisphere(point.normal, random);
+				if (glm::dot(direction, point.faceNormal) <= 0.0f)
+					break;
+
+				RayHit hit;
+				rays++;
+				if (!tracer.Intersect(point.position + point.faceNormal * rayOffset, direction, INFINITY, hit))
+				{
+					result += throughput * options.skyColor;
+					break;
+				}
+
+				glm::vec3 weights(1.0f - hit.u - hit.v, hit.u, hit.v);
+				SurfacePoint next = Evaluate(hit.triangle, weights);
+				if (glm::dot(next.faceNormal, direction) > 0.0f)
+				{
+					// inside a wall, or under one; no light comes from there
+					backFace = bounce == 0;
+					break;
+				}
+
+				throughput *= Albedo(hit.triangle, weights);
+				result += throughput * SunLight(next, rays);
+				point = next;
+			}
+			return result;
+		}
+
+	private:
+		struct SceneTriangle {
+			uint32_t mesh;
+			// first of its three entries in the mesh's index list
+			uint32_t corner;
+		};
+
+		const ModelData& model;
+		const BakeOptions& options;
+		std::vector<SceneTriangle> triangles;
+		std::vector<glm::vec3> corners;
+		std::vector<uint32_t> meshTriangles;
+		std::vector<int> materialImages;
+		std::vector<glm::vec3> materialColors;
+		float rayOffset = 0.0f;
+		RayTracer tracer;
+	};
+
+	// everything known about the atlas, one entry per texel
+	struct Lightmap {
+		uint32_t width = 0;
+		uint32_t height = 0;
+		// scene triangle whose surface the texel shows, UINT32_MAX for none
+		std::vector<uint32_t> triangles;
+		// chart whose rectangle the texel lies in, padding included, UINT32_MAX for none
+		std::vector<uint32_t> charts;
+		std::vector<glm::vec3> positions;
+		std::vector<glm::vec3> normals;
+		std::vector<glm::vec3> light;
+		// of the mean, in luminance
+		std::vector<float> variance;
+		std::vector<uint8_t> valid;
+		// the triangle corners in texels, three per scene triangle
+		std::vector<glm::vec2> corners;
+		size_t coveredTexels = 0;
+
+		size_t Index(uint32_t x, uint32_t y) const { return static_cast<size_t>(y) * width + x; }
+	};
+
+	// assigns every texel a triangle: the one its center lies in, or failing that one that
+	// passes within half a texel diagonal, so texels on chart borders are baked too
+	void rasterize(const ChartAtlas& atlas, const BakeScene& scene, Lightmap& lightmap)
+	{
+		size_t texels = static_cast<size_t>(atlas.width) * atlas.height;
+		lightmap.width = atlas.width;
+		lightmap.height = atlas.height;
+		lightmap.triangles.assign(texels, UINT32_MAX);
+		lightmap.charts.assign(texels, UINT32_MAX);
+		lightmap.positions.assign(texels, glm::vec3(0.0f));
+		lightmap.normals.assign(texels, glm::vec3(0.0f));
+		lightmap.light.assign(texels, glm::vec3(0.0f));
+		lightmap.variance.assign(texels, 0.0f);
+		lightmap.valid.assign(texels, 0);
+		std::vector<float> distances(texels, INFINITY);
+
+		glm::vec2 size(atlas.width, atlas.height);
+		for (uint32_t chartIndex = 0; chartIndex < atlas.charts.size(); chartIndex++)
+		{
+			const Chart& chart = atlas.charts[chartIndex];
+			for (uint32_t y = chart.y; y < chart.y + chart.height; y++)
+			{
+				for (uint32_t x = chart.x; x < chart.x + chart.width; x++)
+					lightmap.charts[lightmap.Index(x, y)] = chartIndex;
+			}
+
+			const LightmapMesh& mesh = atlas.meshes[chart.mesh];
+			for (uint32_t triangle : chart.triangles)
+			{
+				glm::vec2 corners[3];
+				for (int i = 0; i < 3; i++)
+					corners[i] = mesh.coords[mesh.indices[triangle * 3 + i]] * size;
+				uint32_t sceneTriangle = scene.GetTriangleIndex(chart.mesh, triangle);
+				std::copy(corners, corners + 3, lightmap.corners.begin() + sceneTriangle * 3);
+
+				glm::vec2 min = glm::min(glm::min(corners[0], corners[1]), corners[2]) - 1.0f;
+				glm::vec2 max = glm::max(glm::max(corners[0], corners[1]), corners[2]) + 1.0f;
+				uint32_t firstX = static_cast<uint32_t>(std::max(static_cast<float>(chart.x), std::floor(min.x)));
+				uint32_t firstY = static_cast<uint32_t>(std::max(static_cast<float>(chart.y), std::floor(min.y)));
+				uint32_t lastX = static_cast<uint32_t>(std::min(static_cast<float>(chart.x + chart.width - 1), max.x));
+				uint32_t lastY = static_cast<uint32_t>(std::min(static_cast<float>(chart.y + chart.height - 1), max.y));
+				for (uint32_t y = firstY; y <= lastY; y++)
+				{
+					for (uint32_t x = firstX; x <= lastX; x++)
+					{
+						glm::vec3 weights;
+						float distance = closestBarycentric(corners, glm::vec2(x + 0.5f, y + 0.5f), weights);
+						size_t texel = lightmap.Index(x, y);
+						if (distance > 0.7072f || distance >= distances[texel])
+							continue;
+						distances[texel] = distance;
+						lightmap.triangles[texel] = sceneTriangle;
+						SurfacePoint point = scene.Evaluate(sceneTriangle, weights);
+						lightmap.positions[texel] = point.position;
+						lightmap.normals[texel] = point.normal;
+					}
+				}
+			}
+		}
+
+		for (uint32_t triangle : lightmap.triangles)
+			lightmap.coveredTexels += triangle != UINT32_MAX;
+	}
+
+	uint64_t trace(const BakeScene& scene, const BakeOptions& options, Lightmap& lightmap)
+	{
+		std::vector<uint32_t> texels;
+		texels.reserve(lightmap.coveredTexels);
+		for (uint32_t texel = 0; texel < lightmap.triangles.size(); texel++)
+		{
+			if (lightmap.triangles[texel] != UINT32_MAX)
+				texels.push_back(texel);
+		}
+
+		std::atomic<uint64_t> totalRays = 0;
+		std::atomic<size_t> done = 0;
+		JobSystem::ParallelFor(texels.size(), 64, [&](size_t begin, size_t end) {
+			uint64_t rays = 0;
+			for (size_t i = begin; i < end; i++)
+			{
+				uint32_t texel = texels[i];
+				uint32_t triangle = lightmap.triangles[texel];
+				const glm::vec2* corners = &lightmap.corners[triangle * 3];
+				glm::vec2 center(texel % lightmap.width + 0.5f, texel / lightmap.width + 0.5f);
+
+				Random random(texel);
+				glm::vec3 sum(0.0f);
+				double luminanceSum = 0.0, luminanceSquares = 0.0;
+				int backFaces = 0;
+				for (int sample = 0; sample < options.samples; sample++)
+				{
+					// anywhere in the texel's footprint, so shadow edges come out antialiased
+					glm::vec2 jitter(random.Next() - 0.5f, random.Next() - 0.5f);
+					glm::vec3 weights;
+					closestBarycentric(corners, center + jitter, weights);
+					SurfacePoint point = scene.Evaluate(triangle, weights);
+
+					bool backFace;
+					glm::vec3 value = scene.SunLight(point, rays) + scene.IndirectLight(point, random, rays, backFace);
+					backFaces += backFace;
+					sum += value;
+					double sampleLuminance = luminance(value);
+					luminanceSum += sampleLuminance;
+					luminanceSquares += sampleLuminance * sampleLuminance;
+				}
+
+				double mean = luminanceSum / options.samples;
+				lightmap.light[texel] = sum / static_cast<float>(options.samples);
+				lightmap.variance[texel] = static_cast<float>(std::max(0.0, luminanceSquares / options.samples - mean * mean) / options.samples);
+				// a texel that mostly sees the backs of walls is buried in one; it takes its
+				// light from its neighbours instead
+				lightmap.valid[texel] = backFaces * 2 <= options.samples;
+			}
+			totalRays += rays;
+
+			size_t finished = done += end - begin;
+			if ((finished - (end - begin)) * 10 / texels.size() != finished * 10 / texels.size())
+				std::cout << "Traced " << finished * 100 / texels.size() << "%" << std::endl;
+		});
+		return totalRays;
+	}
+
+	// edge-aware a-trous wavelet filter: five passes of a 5x5 B3 spline kernel with holes
+	// doubling each pass, weighted by normals, planes and luminance against its expected noise
+	void denoise(Lightmap& lightmap, float texelSize)
+	{
+		const float kernel[5] = { 1.0f / 16.0f, 1.0f / 4.0f, 3.0f / 8.0f, 1.0f / 4.0f, 1.0f / 16.0f };
+		const float luminanceSigma = 4.0f;
+		const float normalPower = 32.0f;
+
+		std::vector<glm::vec3> light(lightmap.light.size());
+		std::vector<float> variance(lightmap.variance.size());
+		for (int pass = 0; pass < 5; pass++)
+		{
+			int step = 1 << pass;
+			JobSystem::ParallelFor(lightmap.height, 4, [&](size_t begin, size_t end) {
+				for (size_t y = begin; y < end; y++)
+				{
+					for (uint32_t x = 0; x < lightmap.width; x++)
+					{
+						size_t center = lightmap.Index(x, static_cast<uint32_t>(y));
+						light[center] = lightmap.light[center];
+						variance[center] = lightmap.variance[center];
+						if (!lightmap.valid[center])
+							continue;
+
+						const glm::vec3& position = lightmap.positions[center];
+						const glm::vec3& normal = lightmap.normals[center];
+						float centerLuminance = luminance(lightmap.light[center]);
+						float luminanceScale = luminanceSigma * std::sqrt(lightmap.variance[center]) + 1e-4f;
+						float planeScale = texelSize * step * 0.5f;
+
+						glm::vec3 sum(0.0f);
+						float weightSum = 0.0f, varianceSum = 0.0f;
+						for (int dy = -2; dy <= 2; dy++)
+						{
+							int sampleY = static_cast<int>(y) + dy * step;
+							if (sampleY < 0 || sampleY >= static_cast<int>(lightmap.height))
+								continue;
+							for (int dx = -2; dx <= 2; dx++)
+							{
+								int sampleX = static_cast<int>(x) + dx * step;
+								if (sampleX < 0 || sampleX >= static_cast<int>(lightmap.width))
+									continue;
+								size_t sample = lightmap.Index(sampleX, sampleY);
+								if (!lightmap.valid[sample] || lightmap.charts[sample] != lightmap.charts[center])
+									continue;
+
+								float weight = kernel[dx + 2] * kernel[dy + 2];
+								weight *= std::pow(std::max(0.0f, glm::dot(normal, lightmap.normals[sample])), normalPower);
+								weight *= std::exp(-std::abs(glm::dot(normal, lightmap.positions[sample] - position)) / planeScale);
+								weight *= std::exp(-std::abs(luminance(lightmap.light[sample]) - centerLuminance) / luminanceScale);
+								sum += lightmap.light[sample] * weight;
+								weightSum += weight;
+								varianceSum += weight * weight * lightmap.variance[sample];
+							}
+						}
+						if (weightSum > 0.0f)
+						{
+							light[center] = sum / weightSum;
+							variance[center] = varianceSum / (weightSum * weightSum);
+						}
+					}
+				}
+			});
+			lightmap.light.swap(light);
+			lightmap.variance.swap(variance);
+		}
+	}
+
+	// spreads the light of valid texels into the empty ones of the same chart rectangle,
+	// one ring a pass, so bilinear filtering at chart borders reads no black
+	void dilate(Lightmap& lightmap)
+	{
+		std::vector<glm::vec3> light;
+		std::vector<uint8_t> valid;
+		for (bool changed = true; changed;)
+		{
+			changed = false;
+			light = lightmap.light;
+			valid = lightmap.valid;
+			for (uint32_t y = 0; y < lightmap.height; y++)
+			{
+				for (uint32_t x = 0; x < lightmap.width; x++)
+				{
+					size_t center = lightmap.Index(x, y);
+					if (lightmap.valid[center] || lightmap.charts[center] == UINT32_MAX)
+						continue;
+
+					glm::vec3 sum(0.0f);
+					int count = 0;
+					for (int dy = -1; dy <= 1; dy++)
+					{
+						for (int dx = -1; dx <= 1; dx++)
+						{
+							int sampleX = static_cast<int>(x) + dx, sampleY = static_cast<int>(y) + dy;
+							if (sampleX < 0 || sampleY < 0 || sampleX >= static_cast<int>(lightmap.width) || sampleY >= static_cast<int>(lightmap.height))
+								continue;
+							size_t sample = lightmap.Index(sampleX, sampleY);
+							if (lightmap.valid[sample] && lightmap.charts[sample] == lightmap.charts[center])
+							{
+								sum += lightmap.light[sample];
+								count++;
+							}
+						}
+					}
+					if (count > 0)
+					{
+						light[center] = sum / static_cast<float>(count);
+						valid[center] = 1;
+						changed = true;
+					}
+				}
+			}
+			lightmap.light.swap(light);
+			lightmap.valid.swap(valid);
+		}
+	}
+
+	double millisecondsSince(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	bool parseVector(int argc, char* argv[], int& i, glm::vec3& value)
+	{
+		if (i + 3 >= argc)
+			return false;
+		for (int component = 0; component < 3; component++)
+			value[component] = static_cast<float>(std::atof(argv[++i]));
+		return true;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	BakeOptions options;
+	std::string path;
+	bool flipSet = false;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string argument = argv[i];
+		bool valid = true;
+		if (argument == "--samples" && i + 1 < argc)
+			options.samples = std::max(1, std::atoi(argv[++i]));
+		else if (argument == "--bounces" && i + 1 < argc)
+			options.bounces = std::max(0, std::atoi(argv[++i]));
+		else if (argument == "--texels-per-unit" && i + 1 < argc)
+			options.charts.texelsPerUnit = std::max(1e-6f, static_cast<float>(std::atof(argv[++i])));
+		else if (argument == "--max-size" && i + 1 < argc)
+			options.charts.maxSize = std::max(16, std::atoi(argv[++i]));
+		else if (argument == "--sun")
+			valid = parseVector(argc, argv, i, options.sunDirection);
+		else if (argument == "--sun-color")
+			valid = parseVector(argc, argv, i, options.sunColor);
+		else if (argument == "--sky")
+			valid = parseVector(argc, argv, i, options.skyColor);
+		else if (argument == "--threads" && i + 1 < argc)
+			options.threads = std::max(0, std::atoi(argv[++i]));
+		else if (argument == "--flip")
+			options.flipTextures = flipSet = true;
+		else if (argument == "--output" && i + 1 < argc)
+			options.output = argv[++i];
+		else if (argument == "--png" && i + 1 < argc)
+			options.png = argv[++i];
+		else if (argument.rfind("--", 0) != 0 && path.empty())
+			path = argument;
+		else
+			valid = false;
+
+		if (!valid)
+		{
+			path.clear();
+			break;
+		}
+	}
+	if (path.empty() || glm::length(options.sunDirection) <= 0.0f)
+	{
+		std::cout << "Usage: LightmapBaker [--samples N] [--bounces N] [--texels-per-unit F] [--max-size N] [--sun x y z] [--sun-color r g b] [--sky r g b] [--threads N] [--flip] [--output file] [--png file] model.obj" << std::endl;
+		return 1;
+	}
+	options.sunDirection = glm::normalize(options.sunDirection);
+	// the same flip the viewer uses for the stalkyard maps, unless asked for
+	if (!flipSet)
+		options.flipTextures = path.find("stalkyard") != std::string::npos;
+	if (options.output.empty())
+		options.output = LightmapData::GetPath(path);
+
+	JobSystem::Initialize(options.threads);
+	auto start = std::chrono::steady_clock::now();
+
+	ModelLoader loader(options.flipTextures);
+	ModelData model;
+	if (!loader.Load(path, model))
+	{
+		std::cout << "ERROR::ASSIMP:: " << loader.GetError() << std::endl;
+		JobSystem::Shutdown();
+		return 1;
+	}
+	size_t triangleCount = 0;
+	for (const MeshData& mesh : model.meshes)
+		triangleCount += mesh.indices.size() / 3;
+	std::cout << "Loaded " << path << ": " << model.meshes.size() << " meshes, " << triangleCount << " triangles in " << millisecondsSince(start) << " ms" << std::endl;
+
+	auto stageStart = std::chrono::steady_clock::now();
+	ChartAtlas atlas = PackCharts(model, options.charts);
+	std::cout << "Charts: " << atlas.charts.size() << " in a " << atlas.width << "x" << atlas.height << " atlas at " << atlas.texelsPerUnit << " texels per unit, " << millisecondsSince(stageStart) << " ms" << std::endl;
+
+	stageStart = std::chrono::steady_clock::now();
+	BakeScene scene(model, options);
+	scene.Build();
+	const RayTracerStats& treeStats = scene.GetTracer().GetStats();
+	std::cout << "BVH: " << treeStats.nodes << " nodes, " << treeStats.leaves << " leaves, depth " << treeStats.depth << ", " << millisecondsSince(stageStart) << " ms" << std::endl;
+
+	Lightmap lightmap;
+	lightmap.corners.resize(triangleCount * 3);
+	rasterize(atlas, scene, lightmap);
+	std::cout << "Texels: " << lightmap.coveredTexels << " of " << lightmap.triangles.size() << std::endl;
+
+	stageStart = std::chrono::steady_clock::now();
+	uint64_t rays = trace(scene, options, lightmap);
+	double traceMilliseconds = millisecondsSince(stageStart);
+	std::cout << "Traced " << rays << " rays in " << traceMilliseconds << " ms on " << JobSystem::GetWorkerCount() + 1 << " threads, "
+		<< (traceMilliseconds > 0.0 ? rays / traceMilliseconds / 1000.0 : 0.0) << " Mrays/s" << std::endl;
+
+	stageStart = std::chrono::steady_clock::now();
+	denoise(lightmap, 1.0f / atlas.texelsPerUnit);
+	dilate(lightmap);
+	std::cout << "Denoised in " << millisecondsSince(stageStart) << " ms" << std::endl;
+
+	stageStart = std::chrono::steady_clock::now();
+	std::vector<uint8_t> pixels(lightmap.light.size() * 4);
+	for (size_t texel = 0; texel < lightmap.light.size(); texel++)
+	{
+		glm::vec3 encoded = glm::sqrt(glm::clamp(lightmap.light[texel] / LightmapData::Range, 0.0f, 1.0f));
+		for (int channel = 0; channel < 3; channel++)
+			pixels[texel * 4 + channel] = static_cast<uint8_t>(std::lround(encoded[channel] * 255.0f));
+		pixels[texel * 4 + 3] = 255;
+	}
+
+	LightmapData data;
+	data.width = atlas.width;
+	data.height = atlas.height;
+	data.meshes = std::move(atlas.meshes);
+	EncodeBC7(pixels.data(), data.width, data.height, data.blocks);
+	std::vector<uint8_t> decoded;
+	DecodeBC7(data.blocks.data(), data.width, data.height, decoded);
+	BC7Error error = MeasureBC7Error(pixels.data(), decoded.data(), data.width, data.height);
+	std::cout << "BC7: " << data.blocks.size() << " bytes in " << millisecondsSince(stageStart) << " ms, error rms " << error.rms << " max " << error.max << std::endl;
+
+	int result = 0;
+	if (data.Write(options.output))
+	{
+		std::cout << "Wrote " << options.output << " in " << millisecondsSince(start) / 1000.0 << " s total" << std::endl;
+	}
+	else
+	{
+		std::cout << "Failed to write " << options.output << std::endl;
+		result = 1;
+	}
+	if (!options.png.empty() && !WritePNG(options.png, data.width, data.height, 4, decoded.data(), false))
+	{
+		std::cout << "Failed to write " << options.png << std::endl;
+		result = 1;
+	}
+
+	JobSystem::Shutdown();
+	return result;
+}
@@ -0,0 +1,434 @@
+#include "RayTracer.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RAY_TRACER_SSE 1
+#include <emmintrin.h>
+#else
+#define RAY_TRACER_SSE 0
+#endif
+
+namespace {
+	const int SplitBins = 12;
+	const size_t MaxLeafTriangles = 16;
+	const float TraversalCost = 1.0f;
+	// below this the ray is parallel to the triangle's plane
+	const float MinDeterminant = 1e-12f;
+
+	struct Bounds {
+		glm::vec3 min = glm::vec3(INFINITY);
+		glm::vec3 max = glm::vec3(-INFINITY);
+
+		void Grow(const glm::vec3& point) { min = glm::min(min, point); max = glm::max(max, point); }
+		void Grow(const Bounds& other) { min = glm::min(min, other.min); max = glm::max(max, other.max); }
+		float Area() const
+		{
+			glm::vec3 size = glm::max(max - min, glm::vec3(0.0f));
+			return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+		}
+	};
+
+	// leaves are tested four triangles at a time, so that is the unit of their cost
+	float packetCount(size_t triangles)
+	{
+		return static_cast<float>((triangles + 3) / 4);
+	}
+
+#if !RAY_TRACER_SSE
+	// entry distance of the ray into the box, or INFINITY if it misses it within maxDistance
+	float intersectBox(const glm::vec3& min, const glm::vec3& max, const glm::vec3& origin, const glm::vec3& inverseDirection, float maxDistance)
+	{
+		glm::vec3 t0 = (min - origin) * inverseDirection;
+		glm::vec3 t1 = (max - origin) * inverseDirection;
+		glm::vec3 nearT = glm::min(t0, t1);
+		glm::vec3 farT = glm::max(t0, t1);
+		float entry = std::max(std::max(nearT.x, nearT.y), std::max(nearT.z, 0.0f));
+		float exit = std::min(std::min(farT.x, farT.y), std::min(farT.z, maxDistance));
+		return entry <= exit ? entry : INFINITY;
+	}
+#endif
+}
+
+void RayTracer::Build(const std::vector<glm::vec3>& corners)
+{
+	nodes.clear();
+	packets.clear();
+	stats = RayTracerStats();
+
+	std::vector<BuildTriangle> triangles(corners.size() / 3);
+	for (size_t i = 0; i < triangles.size(); i++)
+	{
+		BuildTriangle& triangle = triangles[i];
+		triangle.min = glm::min(glm::min(corners[i * 3], corners[i * 3 + 1]), corners[i * 3 + 2]);
+		triangle.max = glm::max(glm::max(corners[i * 3], corners[i * 3 + 1]), corners[i * 3 + 2]);
+		triangle.center = (triangle.min + triangle.max) * 0.5f;
+		triangle.index = static_cast<uint32_t>(i);
+	}
+
+	stats.triangles = triangles.size();
+	buildNodes.reserve(triangles.size() / 2 + 1);
+	buildNodes.emplace_back();
+	build(0, triangles, 0, triangles.size(), corners, 1);
+
+	nodes.reserve(buildNodes.size() / 3 + 1);
+	collapse(0);
+	buildNodes.clear();
+	buildNodes.shrink_to_fit();
+	stats.nodes = nodes.size();
+}
+
+bool RayTracer::Intersect(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, RayHit& hit) const
+{
+	return traverse<false>(origin, direction, maxDistance, hit);
+}
+
+bool RayTracer::Occluded(const glm::vec3& origin, const glm::vec3& direction, float maxDistance) const
+{
+	RayHit hit;
+	return traverse<true>(origin, direction, maxDistance, hit);
+}
+
+void RayTracer::build(uint32_t node, std::vector<BuildTriangle>& triangles, size_t begin, size_t end, const std::vector<glm::vec3>& corners, uint32_t depth)
+{
+	stats.depth = std::max(stats.depth, depth);
+	size_t count = end - begin;
+
+	Bounds bounds, centers;
+	for (size_t i = begin; i < end; i++)
+	{
+		bounds.Grow(Bounds{ triangles[i].min, triangles[i].max });
+		centers.Grow(triangles[i].center);
+	}
+	buildNodes[node].min = bounds.min;
+	buildNodes[node].max = bounds.max;
+
+	if (count <= 4)
+	{
+		makeLeaf(node, triangles, begin, end, corners);
+		return;
+	}
+
+	// binned SAH over all three axes
+	float bestCost = INFINITY;
+	int bestAxis = -1;
+	int bestSplit = 0;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		float extent = centers.max[axis] - centers.min[axis];
+		if (extent <= 0.0f)
+			continue;
+
+		Bounds bins[SplitBins];
+		size_t binCounts[SplitBins] = {};
+		float scale = SplitBins / extent;
+		for (size_t i = begin; i < end; i++)
+		{
+			int bin = std::min(SplitBins - 1, static_cast<int>((triangles[i].center[axis] - centers.min[axis]) * scale));
+			bins[bin].Grow(Bounds{ triangles[i].min, triangles[i].max });
+			binCounts[bin]++;
+		}
+
+		// area and count of everything right of each split, swept from the right
+		float rightArea[SplitBins];
+		size_t rightCount[SplitBins];
+		Bounds right;
+		size_t rightTotal = 0;
+		for (int bin = SplitBins - 1; bin > 0; bin--)
+		{
+			right.Grow(bins[bin]);
+			rightTotal += binCounts[bin];
+			rightArea[bin] = right.Area();
+			rightCount[bin] = rightTotal;
+		}
+
+		Bounds left;
+		size_t leftTotal = 0;
+		for (int split = 1; split < SplitBins; split++)
+		{
+			left.Grow(bins[split - 1]);
+			leftTotal += binCounts[split - 1];
+			if (leftTotal == 0 || rightCount[split] == 0)
+				continue;
+			float cost = left.Area() * packetCount(leftTotal) + rightArea[split] * packetCount(rightCount[split]);
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestAxis = axis;
+				bestSplit = split;
+			}
+		}
+	}
+
+	float leafCost = packetCount(count);
+	float splitCost = TraversalCost + bestCost / std::max(bounds.Area(), 1e-20f);
+	if (bestAxis < 0 || (count <= MaxLeafTriangles && leafCost <= splitCost))
+	{
+		if (count <= MaxLeafTriangles)
+		{
+			makeLeaf(node, triangles, begin, end, corners);
+			return;
+		}
+		// every center in one spot and too many for a leaf: halve by index
+		bestAxis = -1;
+	}
+
+	size_t middle = begin + count / 2;
+	if (bestAxis >= 0)
+	{
+		float scale = SplitBins / (centers.max[bestAxis] - centers.min[bestAxis]);
+		float minCenter = centers.min[bestAxis];
+		auto split = std::partition(triangles.begin() + begin, triangles.begin() + end, [&](const BuildTriangle& triangle) {
+			return std::min(SplitBins - 1, static_cast<int>((triangle.center[bestAxis] - minCenter) * scale)) < bestSplit;
+		});
+		middle = split - triangles.begin();
+	}
+
+	uint32_t first = static_cast<uint32_t>(buildNodes.size());
+	buildNodes[node].first = first;
+	buildNodes[node].packets = 0;
+	buildNodes.emplace_back();
+	buildNodes.emplace_back();
+	build(first, triangles, begin, middle, corners, depth + 1);
+	build(first + 1, triangles, middle, end, corners, depth + 1);
+}
+
+void RayTracer::makeLeaf(uint32_t node, const std::vector<BuildTriangle>& triangles, size_t begin, size_t end, const std::vector<glm::vec3>& corners)
+{
+	buildNodes[node].first = static_cast<uint32_t>(packets.size());
+	buildNodes[node].packets = static_cast<uint32_t>((end - begin + 3) / 4);
+	stats.leaves++;
+
+	for (size_t i = begin; i < end; i += 4)
+	{
+		Packet packet = {};
+		for (size_t lane = 0; lane < 4 && i + lane < end; lane++)
+		{
+			uint32_t index = triangles[i + lane].index;
+			const glm::vec3& corner = corners[index * 3];
+			glm::vec3 edge1 = corners[index * 3 + 1] - corner;
+			glm::vec3 edge2 = corners[index * 3 + 2] - corner;
+			packet.x[lane] = corner.x;
+			packet.y[lane] = corner.y;
+			packet.z[lane] = corner.z;
+			packet.edge1X[lane] = edge1.x;
+			packet.edge1Y[lane] = edge1.y;
+			packet.edge1Z[lane] = edge1.z;
+			packet.edge2X[lane] = edge2.x;
+			packet.edge2Y[lane] = edge2.y;
+			packet.edge2Z[lane] = edge2.z;
+			packet.triangle[lane] = index;
+		}
+		packets.push_back(packet);
+	}
+}
+
+uint32_t RayTracer::collapse(uint32_t buildNode)
+{
+	uint32_t index = static_cast<uint32_t>(nodes.size());
+	nodes.emplace_back();
+
+	// a leaf at the root becomes the only child of one node
+	std::vector<uint32_t> children;
+	if (buildNodes[buildNode].packets != 0)
+		children = { buildNode };
+	else
+		children = { buildNodes[buildNode].first, buildNodes[buildNode].first + 1 };
+
+	// open up the largest inner child until there are four
+	while (children.size() < 4)
+	{
+		int largest = -1;
+		float largestArea = -1.0f;
+		for (size_t i = 0; i < children.size(); i++)
+		{
+			const BuildNode& child = buildNodes[children[i]];
+			glm::vec3 size = child.max - child.min;
+			float area = size.x * size.y + size.y * size.z + size.z * size.x;
+			if (child.packets == 0 && area > largestArea)
+			{
+				largest = static_cast<int>(i);
+				largestArea = area;
+			}
+		}
+		if (largest < 0)
+			break;
+		uint32_t first = buildNodes[children[largest]].first;
+		children[largest] = first;
+		children.push_back(first + 1);
+	}
+
+	Node node = {};
+	node.childCount = static_cast<uint32_t>(children.size());
+	for (size_t i = 0; i < children.size(); i++)
+	{
+		const BuildNode& child = buildNodes[children[i]];
+		node.minX[i] = child.min.x;
+		node.minY[i] = child.min.y;
+		node.minZ[i] = child.min.z;
+		node.maxX[i] = child.max.x;
+		node.maxY[i] = child.max.y;
+		node.maxZ[i] = child.max.z;
+		node.packets[i] = child.packets;
+		node.child[i] = child.packets != 0 ? child.first : collapse(children[i]);
+	}
+	nodes[index] = node;
+	return index;
+}
+
+template<bool AnyHit>
+bool RayTracer::traverse(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, RayHit& hit) const
+{
+	if (nodes.empty() || stats.triangles == 0)
+		return false;
+
+	// a zero component would multiply infinity by zero in the slab test
+	glm::vec3 slabDirection;
+	for (int axis = 0; axis < 3; axis++)
+		slabDirection[axis] = std::abs(direction[axis]) > 1e-20f ? direction[axis] : std::copysign(1e-20f, direction[axis]);
+	glm::vec3 inverseDirection = 1.0f / slabDirection;
+	float closest = maxDistance;
+	bool found = false;
+
+#if RAY_TRACER_SSE
+	const __m128 originX = _mm_set1_ps(origin.x), originY = _mm_set1_ps(origin.y), originZ = _mm_set1_ps(origin.z);
+	const __m128 directionX = _mm_set1_ps(direction.x), directionY = _mm_set1_ps(direction.y), directionZ = _mm_set1_ps(direction.z);
+	const __m128 inverseX = _mm_set1_ps(inverseDirection.x), inverseY = _mm_set1_ps(inverseDirection.y), inverseZ = _mm_set1_ps(inverseDirection.z);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 minDeterminant = _mm_set1_ps(MinDeterminant);
+	const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+#endif
+
+	// a node or a leaf, and where the ray enters its box
+	struct Entry {
+		uint32_t node;
+		uint32_t packets;
+		float distance;
+	};
+	Entry stack[256];
+	int stackSize = 0;
+	stack[stackSize++] = { 0, 0, 0.0f };
+	while (stackSize > 0)
+	{
+		Entry entry = stack[--stackSize];
+		// something closer has been hit since it was pushed
+		if (entry.distance > closest)
+			continue;
+
+		if (entry.packets == 0)
+		{
+			const Node& node = nodes[entry.node];
+			alignas(16) float distances[4];
+			int hits = 0;
+#if RAY_TRACER_SSE
+			__m128 nearX = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.minX), originX), inverseX);
+			__m128 farX = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.maxX), originX), inverseX);
+			__m128 nearY = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.minY), originY), inverseY);
+			__m128 farY = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.maxY), originY), inverseY);
+			__m128 nearZ = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.minZ), originZ), inverseZ);
+			__m128 farZ = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.maxZ), originZ), inverseZ);
+			__m128 entryT = _mm_max_ps(_mm_max_ps(_mm_min_ps(nearX, farX), _mm_min_ps(nearY, farY)), _mm_max_ps(_mm_min_ps(nearZ, farZ), zero));
+			__m128 exitT = _mm_min_ps(_mm_min_ps(_mm_max_ps(nearX, farX), _mm_max_ps(nearY, farY)), _mm_min_ps(_mm_max_ps(nearZ, farZ), _mm_set1_ps(closest)));
+			hits = _mm_movemask_ps(_mm_cmple_ps(entryT, exitT)) & ((1 << node.childCount) - 1);
+			_mm_store_ps(distances, entryT);
+#else
+			for (uint32_t lane = 0; lane < node.childCount; lane++)
+			{
+				distances[lane] = intersectBox(glm::vec3(node.minX[lane], node.minY[lane], node.minZ[lane]), glm::vec3(node.maxX[lane], node.maxY[lane], node.maxZ[lane]), origin, inverseDirection, closest);
+				if (distances[lane] != INFINITY)
+					hits |= 1 << lane;
+			}
+#endif
+			// farthest first, so the nearest child is the next one popped
+			while (hits != 0)
+			{
+				int farthest = -1;
+				for (int lane = 0; lane < 4; lane++)
+				{
+					if ((hits & (1 << lane)) && (farthest < 0 || distances[lane] > distances[farthest]))
+						farthest = lane;
+				}
+				stack[stackSize++] = { node.child[farthest], node.packets[farthest], distances[farthest] };
+				hits &= ~(1 << farthest);
+			}
+			continue;
+		}
+
+		for (uint32_t p = entry.node; p < entry.node + entry.packets; p++)
+		{
+			const Packet& packet = packets[p];
+#if RAY_TRACER_SSE
+			// Moller-Trumbore on four triangles at once
+			__m128 edge1X = _mm_loadu_ps(packet.edge1X), edge1Y = _mm_loadu_ps(packet.edge1Y), edge1Z = _mm_loadu_ps(packet.edge1Z);
+			__m128 edge2X = _mm_loadu_ps(packet.edge2X), edge2Y = _mm_loadu_ps(packet.edge2Y), edge2Z = _mm_loadu_ps(packet.edge2Z);
+
+			__m128 pX = _mm_sub_ps(_mm_mul_ps(directionY, edge2Z), _mm_mul_ps(directionZ, edge2Y));
+			__m128 pY = _mm_sub_ps(_mm_mul_ps(directionZ, edge2X), _mm_mul_ps(directionX, edge2Z));
+			__m128 pZ = _mm_sub_ps(_mm_mul_ps(directionX, edge2Y), _mm_mul_ps(directionY, edge2X));
+			__m128 determinant = _mm_add_ps(_mm_add_ps(_mm_mul_ps(edge1X, pX), _mm_mul_ps(edge1Y, pY)), _mm_mul_ps(edge1Z, pZ));
+			__m128 inverse = _mm_div_ps(one, determinant);
+
+			__m128 toOriginX = _mm_sub_ps(originX, _mm_loadu_ps(packet.x));
+			__m128 toOriginY = _mm_sub_ps(originY, _mm_loadu_ps(packet.y));
+			__m128 toOriginZ = _mm_sub_ps(originZ, _mm_loadu_ps(packet.z));
+			__m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(toOriginX, pX), _mm_mul_ps(toOriginY, pY)), _mm_mul_ps(toOriginZ, pZ)), inverse);
+
+			__m128 qX = _mm_sub_ps(_mm_mul_ps(toOriginY, edge1Z), _mm_mul_ps(toOriginZ, edge1Y));
+			__m128 qY = _mm_sub_ps(_mm_mul_ps(toOriginZ, edge1X), _mm_mul_ps(toOriginX, edge1Z));
+			__m128 qZ = _mm_sub_ps(_mm_mul_ps(toOriginX, edge1Y), _mm_mul_ps(toOriginY, edge1X));
+			__m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(directionX, qX), _mm_mul_ps(directionY, qY)), _mm_mul_ps(directionZ, qZ)), inverse);
+			__m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(edge2X, qX), _mm_mul_ps(edge2Y, qY)), _mm_mul_ps(edge2Z, qZ)), inverse);
+
+			__m128 mask = _mm_cmpgt_ps(_mm_and_ps(determinant, absMask), minDeterminant);
+			mask = _mm_and_ps(mask, _mm_and_ps(_mm_cmpge_ps(u, zero), _mm_cmpge_ps(v, zero)));
+			mask = _mm_and_ps(mask, _mm_cmple_ps(_mm_add_ps(u, v), one));
+			mask = _mm_and_ps(mask, _mm_and_ps(_mm_cmpgt_ps(t, zero), _mm_cmplt_ps(t, _mm_set1_ps(closest))));
+			int hits = _mm_movemask_ps(mask);
+			if (hits == 0)
+				continue;
+			if (AnyHit)
+				return true;
+
+			alignas(16) float distances[4], us[4], vs[4];
+			_mm_store_ps(distances, t);
+			_mm_store_ps(us, u);
+			_mm_store_ps(vs, v);
+			for (int lane = 0; lane < 4; lane++)
+			{
+				if ((hits & (1 << lane)) && distances[lane] < closest)
+				{
+					closest = distances[lane];
+					hit = { distances[lane], packet.triangle[lane], us[lane], vs[lane] };
+					found = true;
+				}
+			}
+#else
+			for (int lane = 0; lane < 4; lane++)
+			{
+				glm::vec3 edge1(packet.edge1X[lane], packet.edge1Y[lane], packet.edge1Z[lane]);
+				glm::vec3 edge2(packet.edge2X[lane], packet.edge2Y[lane], packet.edge2Z[lane]);
+				glm::vec3 pvec = glm::cross(direction, edge2);
+				float determinant = glm::dot(edge1, pvec);
+				if (std::abs(determinant) <= MinDeterminant)
+					continue;
+				float inverse = 1.0f / determinant;
+				glm::vec3 toOrigin = origin - glm::vec3(packet.x[lane], packet.y[lane], packet.z[lane]);
+				float u = glm::dot(toOrigin, pvec) * inverse;
+				glm::vec3 qvec = glm::cross(toOrigin, edge1);
+				float v = glm::dot(direction, qvec) * inverse;
+				float t = glm::dot(edge2, qvec) * inverse;
+				if (u < 0.0f || v < 0.0f || u + v > 1.0f || t <= 0.0f || t >= closest)
+					continue;
+				if (AnyHit)
+					return true;
+				closest = t;
+				hit = { t, packet.triangle[lane], u, v };
+				found = true;
+			}
+#endif
+		}
+	}
+	return found;
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+struct RayHit {
+	float distance = 0.0f;
+	uint32_t triangle = 0;
+	// barycentric weights of the triangle's second and third corner
+	float u = 0.0f;
+	float v = 0.0f;
+};
+
+struct RayTracerStats {
+	size_t triangles = 0;
+	size_t nodes = 0;
+	size_t leaves = 0;
+	uint32_t depth = 0;
+};
+
+// Bounding volume hierarchy over a static triangle soup, built once with the surface area
+// heuristic and then collapsed so every node has up to four children. Where the target
+// has SSE2 a ray tests all four child boxes of a node in one go, and since leaves keep
+// their triangles in packets of four, one packet is one four-wide ray-triangle test.
+// Queries only read the tree and can run on any number of threads at once.
+class RayTracer
+{
+public:
+	// three corners per triangle; a hit reports the triangle's index in this array / 3
+	void Build(const std::vector<glm::vec3>& corners);
+
+	// closest hit in (0, maxDistance), both faces count
+	bool Intersect(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, RayHit& hit) const;
+	// true if anything lies in (0, maxDistance); stops at the first hit
+	bool Occluded(const glm::vec3& origin, const glm::vec3& direction, float maxDistance) const;
+
+	const RayTracerStats& GetStats() const { return stats; }
+
+private:
+	// the binary tree the SAH build produces
+	struct BuildNode {
+		glm::vec3 min;
+		// index of the first child, the second follows it; the first packet for a leaf
+		uint32_t first;
+		glm::vec3 max;
+		// packets in a leaf, 0 for an inner node
+		uint32_t packets;
+	};
+
+	// four child boxes side by side, lanes past childCount unused
+	struct Node {
+		float minX[4], minY[4], minZ[4];
+		float maxX[4], maxY[4], maxZ[4];
+		// another Node, or the first packet of a leaf
+		uint32_t child[4];
+		// packets of a leaf child, 0 for a Node
+		uint32_t packets[4];
+		uint32_t childCount;
+	};
+
+	// four triangles as first corner and two edges, one lane each; unused lanes have zero
+	// edges and never hit
+	struct Packet {
+		float x[4], y[4], z[4];
+		float edge1X[4], edge1Y[4], edge1Z[4];
+		float edge2X[4], edge2Y[4], edge2Z[4];
+		uint32_t triangle[4];
+	};
+
+	struct BuildTriangle {
+		glm::vec3 min;
+		glm::vec3 max;
+		glm::vec3 center;
+		uint32_t index;
+	};
+
+	std::vector<BuildNode> buildNodes;
+	std::vector<Node> nodes;
+	std::vector<Packet> packets;
+	RayTracerStats stats;
+
+	void build(uint32_t node, std::vector<BuildTriangle>& triangles, size_t begin, size_t end, const std::vector<glm::vec3>& corners, uint32_t depth);
+	void makeLeaf(uint32_t node, const std::vector<BuildTriangle>& triangles, size_t begin, size_t end, const std::vector<glm::vec3>& corners);
+	// the wide node holding the children and grandchildren of a binary one
+	uint32_t collapse(uint32_t buildNode);
+	template<bool AnyHit>
+	bool traverse(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, RayHit& hit) const;
+};
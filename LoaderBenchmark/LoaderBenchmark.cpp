@@ -0,0 +1,557 @@
+// Headless benchmark for the model loader. Loads each bundled model repeatedly without
+// SDL or a GL context and writes per-stage timings and allocation counts as JSON.
+//
+//   LoaderBenchmark [--iterations N] [--root dir] [--output file] [--scaling] [--conversion]
+//
+// The GL upload is replaced by a null sink that reads every byte the viewer would upload.
+// --scaling reruns the job-system work (mesh conversion, texture decoding, frustum
+// culling, transform updates) with 1 to N threads and reports the throughput of each.
+// --conversion times the aiMesh to Vertex conversion on its own, the old per-vertex loop
+// against the conversion kernels, and checks that both produce the same arrays. It also
+// times packing the same meshes into the CompactVertex layout.
+
+#include "ModelLoader.h"
+#include "VertexConversion.h"
+#include "JobSystem.h"
+#include "AllocationTracker.h"
+#include "Frustum.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <Windows.h>
+#include <Psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+namespace {
+	// everything that goes through operator new, counted by AllocationTracker; stb_image
+	// allocates with malloc, so decoded pixels are reported separately as image bytes
+	struct AllocationCounter {
+		uint64_t bytes;
+		uint64_t count;
+
+		static AllocationCounter Now()
+		{
+			AllocationCounts total = AllocationTracker::GetTotal();
+			return { total.bytes, total.allocations };
+		}
+		AllocationCounter operator-(const AllocationCounter& other) const { return { bytes - other.bytes, count - other.count }; }
+	};
+
+	enum Stage { Import, ConvertMeshes, DecodeTextures, Upload, StageCount };
+	const char* stageNames[StageCount] = { "import", "convert_meshes", "decode_textures", "null_upload" };
+
+	struct StageSample {
+		double milliseconds;
+		AllocationCounter allocations;
+	};
+
+	struct Iteration {
+		StageSample stages[StageCount];
+		size_t meshes = 0;
+		size_t vertices = 0;
+		size_t indices = 0;
+		size_t materials = 0;
+		size_t images = 0;
+		size_t imageBytes = 0;
+		size_t failedImages = 0;
+	};
+
+	struct ModelResult {
+		std::string path;
+		bool loaded = true;
+		std::string error;
+		std::vector<Iteration> iterations;
+	};
+
+	const char* defaultModels[] = {
+		"Models/Med/med.obj",
+		"Models/hl/source/stalkyard/hl.obj",
+		"Models/hl/source/stalkyard/hl_mp_stalkyard.obj",
+	};
+
+	// reads every byte the viewer would hand to GL so none of the stages can be optimised away
+	uint64_t nullUpload(const ModelData& model)
+	{
+		uint64_t checksum = 0;
+		for (const MeshData& mesh : model.meshes)
+		{
+			const unsigned char* bytes = reinterpret_cast<const unsigned char*>(mesh.vertices.data());
+			size_t size = mesh.vertices.size() * sizeof(Vertex);
+			for (size_t i = 0; i < size; i += 64)
+				checksum += bytes[i];
+			checksum = std::accumulate(mesh.indices.begin(), mesh.indices.end(), checksum);
+		}
+		for (const ImageData& image : model.images)
+		{
+			size_t size = image.GetByteSize();
+			for (size_t i = 0; i < size; i += 64)
+				checksum += image.pixels.get()[i];
+		}
+		for (const MaterialData& material : model.materials)
+			checksum += material.textures.size();
+		return checksum;
+	}
+
+	template<typename Function>
+	StageSample timeStage(Function&& function)
+	{
+		AllocationCounter before = AllocationCounter::Now();
+		auto start = std::chrono::steady_clock::now();
+		function();
+		auto end = std::chrono::steady_clock::now();
+		return { std::chrono::duration<double, std::milli>(end - start).count(), AllocationCounter::Now() - before };
+	}
+
+	size_t peakResidentBytes()
+	{
+#ifdef _WIN32
+		PROCESS_MEMORY_COUNTERS counters = {};
+		if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+			return counters.PeakWorkingSetSize;
+		return 0;
+#else
+		rusage usage = {};
+		getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+		return static_cast<size_t>(usage.ru_maxrss);
+#else
+		return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+	}
+
+	void writeEscaped(std::ostream& stream, const std::string& text)
+	{
+		for (char c : text)
+		{
+			if (c == '"' || c == '\\')
+				stream << '\\';
+			stream << c;
+		}
+	}
+
+	// min / median / mean over the iterations
+	void writeSummary(std::ostream& stream, std::vector<double> values)
+	{
+		std::sort(values.begin(), values.end());
+		double mean = std::accumulate(values.begin(), values.end(), 0.0) / values.size();
+		double median = values.size() % 2 ? values[values.size() / 2] : (values[values.size() / 2 - 1] + values[values.size() / 2]) / 2.0;
+		stream << "{\"min\":" << values.front() << ",\"median\":" << median << ",\"mean\":" << mean << ",\"max\":" << values.back() << "}";
+	}
+
+	void writeModel(std::ostream& stream, const ModelResult& result)
+	{
+		stream << "    {\"path\":\"";
+		writeEscaped(stream, result.path);
+		stream << "\",\"loaded\":" << (result.loaded ? "true" : "false");
+		if (!result.loaded)
+		{
+			stream << ",\"error\":\"";
+			writeEscaped(stream, result.error);
+			stream << "\"}";
+			return;
+		}
+
+		// the content is identical on every iteration
+		const Iteration& first = result.iterations.front();
+		stream << ",\n     \"meshes\":" << first.meshes << ",\"vertices\":" << first.vertices << ",\"indices\":" << first.indices
+			<< ",\"materials\":" << first.materials << ",\"images\":" << first.images << ",\"failed_images\":" << first.failedImages
+			<< ",\"image_bytes\":" << first.imageBytes << ",\n     \"stages\":{";
+
+		for (int stage = 0; stage < StageCount; stage++)
+		{
+			std::vector<double> milliseconds, bytes, allocations;
+			for (const Iteration& iteration : result.iterations)
+			{
+				milliseconds.push_back(iteration.stages[stage].milliseconds);
+				bytes.push_back(static_cast<double>(iteration.stages[stage].allocations.bytes));
+				allocations.push_back(static_cast<double>(iteration.stages[stage].allocations.count));
+			}
+
+			stream << (stage ? ",\n       " : "\n       ") << "\"" << stageNames[stage] << "\":{\"ms\":";
+			writeSummary(stream, milliseconds);
+			stream << ",\"bytes_allocated\":";
+			writeSummary(stream, bytes);
+			stream << ",\"allocations\":";
+			writeSummary(stream, allocations);
+			stream << "}";
+		}
+		stream << "}}";
+	}
+}
+
+namespace {
+	// objects culled and transformed per pass of the synthetic scene
+	const size_t ScalingObjects = 1 << 18;
+
+	struct ScalingSample {
+		int threads;
+		// convert + decode of every model, summed; negative if no model loaded
+		double loadMilliseconds;
+		double cullMilliseconds;
+		double transformMilliseconds;
+	};
+
+	template<typename Function>
+	double bestOf(int iterations, Function&& function)
+	{
+		double best = 0.0;
+		for (int i = 0; i < iterations; i++)
+		{
+			auto start = std::chrono::steady_clock::now();
+			function();
+			double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			best = i ? std::min(best, milliseconds) : milliseconds;
+		}
+		return best;
+	}
+
+	// the same work at every thread count; import stays outside the timing because Assimp is serial
+	std::vector<ScalingSample> runScaling(const std::string& root, const std::vector<std::string>& models, int iterations, uint64_t& checksum)
+	{
+		// a grid of unit boxes around a camera at the origin, about a fifth of them in view
+		std::vector<glm::mat4> transforms(ScalingObjects);
+		std::vector<glm::mat4> world(ScalingObjects);
+		std::vector<unsigned char> visible(ScalingObjects);
+		for (size_t i = 0; i < ScalingObjects; i++)
+			transforms[i] = glm::translate(glm::mat4(1.0f), glm::vec3(float(i % 64) - 32.0f, float(i / 64 % 64) - 32.0f, float(i / 4096) - 32.0f));
+		glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+		Frustum frustum(projection * glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f)));
+		glm::mat4 parent = glm::rotate(glm::mat4(1.0f), 0.3f, glm::vec3(0.0f, 1.0f, 0.0f));
+
+		std::vector<ScalingSample> samples;
+		int maxThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+		for (int threads = 1; threads <= maxThreads; threads++)
+		{
+			JobSystem::Initialize(threads - 1);
+			ScalingSample sample = { threads, -1.0, 0.0, 0.0 };
+
+			for (const std::string& path : models)
+			{
+				bool flipTextures = path.find("stalkyard") != std::string::npos;
+				double best = 0.0;
+				for (int i = 0; i < iterations; i++)
+				{
+					ModelLoader loader(flipTextures);
+					ModelData model;
+					if (!loader.Import(root + "/" + path))
+						break;
+					auto start = std::chrono::steady_clock::now();
+					loader.ConvertMeshes(model);
+					loader.ReleaseScene();
+					loader.DecodeTextures(model);
+					double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+					best = i ? std::min(best, milliseconds) : milliseconds;
+					checksum += nullUpload(model);
+				}
+				if (best > 0.0)
+					sample.loadMilliseconds = std::max(0.0, sample.loadMilliseconds) + best;
+			}
+
+			sample.cullMilliseconds = bestOf(iterations, [&]() {
+				JobSystem::ParallelFor(ScalingObjects, 1024, [&](size_t begin, size_t end) {
+					for (size_t i = begin; i < end; i++)
+						visible[i] = frustum.IntersectsBox(glm::vec3(0.0f), glm::vec3(0.5f), transforms[i]);
+				});
+			});
+			sample.transformMilliseconds = bestOf(iterations, [&]() {
+				JobSystem::ParallelFor(ScalingObjects, 1024, [&](size_t begin, size_t end) {
+					for (size_t i = begin; i < end; i++)
+						world[i] = parent * transforms[i];
+				});
+			});
+			checksum += std::accumulate(visible.begin(), visible.end(), uint64_t(0)) + static_cast<uint64_t>(world.back()[3][0]);
+
+			JobSystem::Shutdown();
+			samples.push_back(sample);
+			std::cout << "scaling: " << threads << " threads" << std::endl;
+		}
+		return samples;
+	}
+
+	void writeScaling(std::ostream& stream, const std::vector<ScalingSample>& samples)
+	{
+		const ScalingSample& single = samples.front();
+		// per-second throughput, and speedup over one thread
+		auto rate = [](double count, double milliseconds) { return milliseconds > 0.0 ? count * 1000.0 / milliseconds : 0.0; };
+		auto speedup = [](double one, double many) { return many > 0.0 ? one / many : 0.0; };
+
+		stream << ",\n  \"scaling\":{\"objects\":" << ScalingObjects << ",\"samples\":[\n";
+		for (size_t i = 0; i < samples.size(); i++)
+		{
+			const ScalingSample& sample = samples[i];
+			stream << "    {\"threads\":" << sample.threads;
+			if (sample.loadMilliseconds >= 0.0)
+				stream << ",\"load_ms\":" << sample.loadMilliseconds << ",\"load_speedup\":" << speedup(single.loadMilliseconds, sample.loadMilliseconds);
+			stream << ",\"cull_ms\":" << sample.cullMilliseconds << ",\"culled_per_second\":" << rate(ScalingObjects, sample.cullMilliseconds)
+				<< ",\"cull_speedup\":" << speedup(single.cullMilliseconds, sample.cullMilliseconds)
+				<< ",\"transform_ms\":" << sample.transformMilliseconds << ",\"transforms_per_second\":" << rate(ScalingObjects, sample.transformMilliseconds)
+				<< ",\"transform_speedup\":" << speedup(single.transformMilliseconds, sample.transformMilliseconds) << "}";
+			stream << (i + 1 < samples.size() ? ",\n" : "\n");
+		}
+		stream << "  ]}";
+	}
+}
+
+namespace {
+	struct ConversionSample {
+		std::string path;
+		size_t meshes;
+		size_t vertices;
+		double loopMilliseconds;
+		double kernelMilliseconds;
+		// the same through PackVertices into CompactVertex
+		double compactMilliseconds;
+	};
+
+	// the per-vertex loop ModelLoader used before the conversion kernels, kept as the baseline
+	void convertLoop(const aiMesh* aimesh, MeshData& mesh)
+	{
+		for (unsigned int i = 0; i < aimesh->mNumVertices; i++)
+		{
+			Vertex vertex;
+			vertex.Position = glm::vec3(aimesh->mVertices[i].x, aimesh->mVertices[i].y, aimesh->mVertices[i].z);
+			if (aimesh->HasNormals())
+				vertex.Normal = glm::vec3(aimesh->mNormals[i].x, aimesh->mNormals[i].y, aimesh->mNormals[i].z);
+			else
+				vertex.Normal = glm::vec3(0.0f, 0.0f, 0.0f);
+			if (aimesh->mTextureCoords[0])
+				vertex.TexCoords = glm::vec2(aimesh->mTextureCoords[0][i].x, aimesh->mTextureCoords[0][i].y);
+			else
+				vertex.TexCoords = glm::vec2(0.0f, 0.0f);
+			mesh.vertices.push_back(vertex);
+		}
+		for (unsigned int i = 0; i < aimesh->mNumFaces; i++)
+		{
+			const aiFace& face = aimesh->mFaces[i];
+			for (unsigned int j = 0; j < face.mNumIndices; j++)
+				mesh.indices.push_back(face.mIndices[j]);
+		}
+	}
+
+	void convertKernel(const aiMesh* aimesh, MeshData& mesh)
+	{
+		mesh.vertices.resize(aimesh->mNumVertices);
+		ConvertVertices(*aimesh, mesh.vertices.data());
+		mesh.indices.resize(CountIndices(*aimesh));
+		ConvertIndices(*aimesh, mesh.indices.data());
+	}
+
+	// every mesh of each imported model through both conversions on one thread, output
+	// arrays included; the two results are compared byte for byte
+	std::vector<ConversionSample> runConversion(const std::string& root, const std::vector<std::string>& models, int iterations, uint64_t& checksum)
+	{
+		std::vector<ConversionSample> samples;
+		for (const std::string& path : models)
+		{
+			ModelLoader loader(false);
+			if (!loader.Import(root + "/" + path))
+				continue;
+			const aiScene* scene = loader.GetScene();
+			ConversionSample sample = { path, scene->mNumMeshes, 0, 0.0, 0.0, 0.0 };
+			for (unsigned int i = 0; i < scene->mNumMeshes; i++)
+				sample.vertices += scene->mMeshes[i]->mNumVertices;
+
+			auto convertAll = [&](auto convert) {
+				std::vector<MeshData> meshes(scene->mNumMeshes);
+				for (unsigned int i = 0; i < scene->mNumMeshes; i++)
+					convert(scene->mMeshes[i], meshes[i]);
+				return meshes;
+			};
+			sample.loopMilliseconds = bestOf(iterations, [&]() { checksum += convertAll(convertLoop).size(); });
+			sample.kernelMilliseconds = bestOf(iterations, [&]() { checksum += convertAll(convertKernel).size(); });
+			sample.compactMilliseconds = bestOf(iterations, [&]() {
+				std::vector<std::vector<CompactVertex>> vertices(scene->mNumMeshes);
+				std::vector<std::vector<unsigned int>> indices(scene->mNumMeshes);
+				for (unsigned int i = 0; i < scene->mNumMeshes; i++)
+				{
+					vertices[i].resize(scene->mMeshes[i]->mNumVertices);
+					PackVertices(*scene->mMeshes[i], vertices[i].data());
+					indices[i].resize(CountIndices(*scene->mMeshes[i]));
+					ConvertIndices(*scene->mMeshes[i], indices[i].data());
+				}
+				checksum += vertices.size() + indices.size();
+			});
+
+			std::vector<MeshData> loop = convertAll(convertLoop);
+			std::vector<MeshData> kernel = convertAll(convertKernel);
+			for (size_t i = 0; i < loop.size(); i++)
+			{
+				if (loop[i].indices != kernel[i].indices || loop[i].vertices.size() != kernel[i].vertices.size()
+					|| std::memcmp(loop[i].vertices.data(), kernel[i].vertices.data(), loop[i].vertices.size() * sizeof(Vertex)) != 0)
+				{
+					std::cout << path << ": mesh " << i << " converts differently" << std::endl;
+					break;
+				}
+			}
+
+			samples.push_back(sample);
+			std::cout << "conversion: " << path << std::endl;
+		}
+		return samples;
+	}
+
+	void writeConversion(std::ostream& stream, const std::vector<ConversionSample>& samples)
+	{
+		stream << ",\n  \"conversion\":[\n";
+		for (size_t i = 0; i < samples.size(); i++)
+		{
+			const ConversionSample& sample = samples[i];
+			stream << "    {\"path\":\"";
+			writeEscaped(stream, sample.path);
+			stream << "\",\"meshes\":" << sample.meshes << ",\"vertices\":" << sample.vertices
+				<< ",\"loop_ms\":" << sample.loopMilliseconds << ",\"kernel_ms\":" << sample.kernelMilliseconds
+				<< ",\"speedup\":" << (sample.kernelMilliseconds > 0.0 ? sample.loopMilliseconds / sample.kernelMilliseconds : 0.0)
+				<< ",\"compact_ms\":" << sample.compactMilliseconds << ",\"vertex_bytes\":" << sample.vertices * sizeof(Vertex)
+				<< ",\"compact_vertex_bytes\":" << sample.vertices * sizeof(CompactVertex) << "}";
+			stream << (i + 1 < samples.size() ? ",\n" : "\n");
+		}
+		stream << "  ]";
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	int iterations = 5;
+	std::string root = ".";
+	std::string output;
+	bool scaling = false;
+	bool conversion = false;
+	std::vector<std::string> models;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string argument = argv[i];
+		if (argument == "--iterations" && i + 1 < argc)
+			iterations = std::max(1, std::atoi(argv[++i]));
+		else if (argument == "--root" && i + 1 < argc)
+			root = argv[++i];
+		else if (argument == "--output" && i + 1 < argc)
+			output = argv[++i];
+		else if (argument == "--scaling")
+			scaling = true;
+		else if (argument == "--conversion")
+			conversion = true;
+		else if (argument.rfind("--", 0) != 0)
+			models.push_back(argument);
+		else
+		{
+			std::cout << "Usage: LoaderBenchmark [--iterations N] [--root dir] [--output file] [--scaling] [--conversion] [model.obj ...]" << std::endl;
+			return 1;
+		}
+	}
+	if (models.empty())
+		models.assign(std::begin(defaultModels), std::end(defaultModels));
+
+	std::vector<ModelResult> results;
+	uint64_t checksum = 0;
+
+	// the per-stage numbers use the full pool, as the viewer does
+	JobSystem::Initialize();
+	for (const std::string& path : models)
+	{
+		ModelResult result;
+		result.path = path;
+		// the same flip the viewer uses for the stalkyard maps; it does not change the cost
+		bool flipTextures = path.find("stalkyard") != std::string::npos;
+
+		for (int i = 0; i < iterations && result.loaded; i++)
+		{
+			// a fresh loader per iteration, so nothing is cached between runs
+			ModelLoader loader(flipTextures);
+			ModelData model;
+			Iteration iteration;
+
+			iteration.stages[Import] = timeStage([&]() { result.loaded = loader.Import(root + "/" + path); });
+			if (!result.loaded)
+			{
+				result.error = loader.GetError();
+				break;
+			}
+			iteration.stages[ConvertMeshes] = timeStage([&]() { loader.ConvertMeshes(model); loader.ReleaseScene(); });
+			iteration.stages[DecodeTextures] = timeStage([&]() { loader.DecodeTextures(model); });
+			iteration.stages[Upload] = timeStage([&]() { checksum += nullUpload(model); });
+
+			iteration.meshes = model.meshes.size();
+			iteration.materials = model.materials.size();
+			iteration.images = model.images.size();
+			for (const MeshData& mesh : model.meshes)
+			{
+				iteration.vertices += mesh.vertices.size();
+				iteration.indices += mesh.indices.size();
+			}
+			for (const ImageData& image : model.images)
+			{
+				iteration.imageBytes += image.GetByteSize();
+				if (!image.pixels)
+					iteration.failedImages++;
+			}
+
+			result.iterations.push_back(std::move(iteration));
+		}
+
+		std::cout << path << ": " << (result.loaded ? "ok" : "failed, " + result.error) << std::endl;
+		results.push_back(std::move(result));
+	}
+
+	JobSystem::Shutdown();
+
+	std::vector<ScalingSample> scalingSamples;
+	if (scaling)
+		scalingSamples = runScaling(root, models, iterations, checksum);
+	std::vector<ConversionSample> conversionSamples;
+	if (conversion)
+		conversionSamples = runConversion(root, models, iterations, checksum);
+
+	std::ostringstream json;
+	json << std::fixed << std::setprecision(3);
+	json << "{\"iterations\":" << iterations << ",\"peak_rss_bytes\":" << peakResidentBytes() << ",\"checksum\":" << checksum << ",\n  \"models\":[\n";
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		writeModel(json, results[i]);
+		json << (i + 1 < results.size() ? ",\n" : "\n");
+	}
+	json << "  ]";
+	if (!scalingSamples.empty())
+		writeScaling(json, scalingSamples);
+	if (!conversionSamples.empty())
+		writeConversion(json, conversionSamples);
+	json << "}\n";
+
+	if (output.empty())
+	{
+		std::cout << json.str();
+	}
+	else
+	{
+		std::ofstream stream(output, std::ios::trunc);
+		stream << json.str();
+		if (!stream)
+		{
+			std::cout << "Failed to write '" << output << "'" << std::endl;
+			return 1;
+		}
+		std::cout << "Results written to '" << output << "'" << std::endl;
+	}
+
+	bool failed = std::any_of(results.begin(), results.end(), [](const ModelResult& result) { return !result.loaded; });
+	return failed ? 1 : 0;
+}
@@ -1,5 +1,33 @@
 ﻿#include "Shader.h"
+#include "GLState.h"
+#include "Profiler.h"
+#include "ShaderManager.h"
 #include "Object.h"
+#include "RenderQueue.h"
+#include "InstancedObject.h"
+#include "GeometryPool.h"
+#include "IndirectRenderer.h"
+#include "CameraBuffer.h"
+#include "StreamBuffer.h"
+#include "TransformBuffer.h"
+#include "HeadlessContext.h"
+#include "Framebuffer.h"
+#include "FrameTimer.h"
+#include "CameraPath.h"
+#include "ImageWriter.h"
+#include "RenderBackend.h"
+#include "TripleBuffer.h"
+#include "LatencyTracker.h"
+#include "JobSystem.h"
+#include "Frustum.h"
+#include "PacketBenchmark.h"
+#include "AllocationTracker.h"
+#include "FrameArena.h"
+#include "LightCulling.h"
+#include "LightBuffer.h"
+#include "LightBenchmark.h"
+#include "SkinnedObject.h"
+#include "AnimationBenchmark.h"
 
 #include <glad/glad.h>
 #include <SDL.h>
@@ -7,7 +35,15 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <format>
 #include <iostream>
+#include <memory>
+#include <random>
+#include <thread>
 #include <vector>
 #include <fstream>
 #include <sstream>
@@ -22,6 +58,31 @@ float pitch = 0.f;
 float yaw = -90.f;
 float fov = 45.f;
 
+// headless runs advance by a fixed step so the camera path and animation repeat exactly
+const float HeadlessFrameStep = 1.0f / 60.0f;
+
+// Everything the render side needs from one simulation step. The simulation thread fills
+// one and publishes it; from then on it is only read, by the render thread.
+struct FrameSnapshot {
+	uint64_t frame = 0;
+	glm::mat4 projection = glm::mat4(1.0f);
+	glm::mat4 view = glm::mat4(1.0f);
+	glm::vec3 cameraPosition = glm::vec3(0.0f);
+	// one model matrix per scene object, in the order of objects
+	std::vector<glm::mat4> objectTransforms;
+	// world space, where they are this frame
+	std::vector<Light> lights;
+	// what every animated character is playing, in the order of their transforms
+	std::vector<AnimationPlayback> characters;
+	bool useIndirect = false;
+	bool useDepthPrepass = false;
+	// bumped for every profile capture asked for, so a request in a skipped snapshot is not lost
+	uint32_t profileRequests = 0;
+	// Profiler::Now() when the input this frame shows was sampled
+	double inputTime = 0.0;
+	bool quit = false;
+};
+
 static void processKeyboard(float deltaTime) {
 	float cameraSpeed = 5.f * deltaTime;
 	const Uint8* keyState = SDL_GetKeyboardState(NULL);
@@ -79,100 +140,652 @@ static void processMouse(SDL_Event ev, float deltaTime) {
 
 int main(int argc, char** argv) {
 
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 2);
-	SDL_GL_SetAttribute(SDL_GL_STENCIL_SIZE, 8);
-
-	SDL_Init(SDL_INIT_VIDEO);
-
 	float screenWidth = 1920;
 	float screenHeight = 1080;
 
-	SDL_Window* window = SDL_CreateWindow("3D Scene Viewer", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, static_cast<int>(screenWidth), static_cast<int>(screenHeight), SDL_WINDOW_OPENGL | SDL_WINDOW_RESIZABLE);
-	SDL_GLContext context = SDL_GL_CreateContext(window);
-	SDL_GL_MakeCurrent(window, context);
+	// --headless renders --frames frames along the camera path into an offscreen target,
+	// optionally saving each one to --capture and the frame times to --frame-times
+	bool headless = false;
+	int headlessFrames = 600;
+	std::string captureDirectory;
+	std::string frameTimesPath;
+	std::string cameraPathFile;
+	// --backend null|recording replace GL altogether and need no context; --record writes
+	// the last frame's command stream of a recording run
+	RenderBackendType backend = RenderBackendType::GL;
+	std::string commandsPath;
+	// --workers sets the job system's pool size, 0 runs every job on the thread that asks for it
+	int workerCount = -1;
+	// --packet-benchmark times packet generation on a procedural scene and exits; null backend unless --backend says otherwise
+	bool packetBenchmark = false;
+	// --strict-allocations aborts on the first frame after warm-up that touches the heap
+	bool strictAllocations = false;
+	// --depth-prepass lays down the depth of the opaque geometry before it is shaded
+	bool useDepthPrepass = false;
+	// --lights N scatters N moving point and spot lights over the props, shaded through clustered culling
+	int lightCount = 0;
+	// --light-benchmark times clustered light culling and checks it against the one-by-one test, then exits
+	bool lightBenchmark = false;
+	// --characters N lays out N animated copies of the rigged --character-model on a grid
+	int characterCount = 0;
+	std::string characterModel;
+	// --cpu-skinning skins the characters on the job system even where the GPU could
+	bool cpuSkinning = false;
+	// --animation-benchmark times pose evaluation and CPU skinning and checks them against a reference, then exits
+	bool animationBenchmark = false;
+
+	for (int i = 1; i < argc; i++) {
+		std::string argument = argv[i];
+		// --profile records from startup so loading shows up in the capture as well
+		if (argument == "--profile")
+			Profiler::SetEnabled(true);
+		else if (argument == "--headless")
+			headless = true;
+		else if (argument == "--frames" && i + 1 < argc)
+			headlessFrames = std::max(1, std::atoi(argv[++i]));
+		else if (argument == "--size" && i + 1 < argc) {
+			int width = 0, height = 0;
+			if (std::sscanf(argv[++i], "%dx%d", &width, &height) == 2 && width > 0 && height > 0) {
+				screenWidth = static_cast<float>(width);
+				screenHeight = static_cast<float>(height);
+			}
+		}
+		else if (argument == "--capture" && i + 1 < argc)
+			captureDirectory = argv[++i];
+		else if (argument == "--frame-times" && i + 1 < argc)
+			frameTimesPath = argv[++i];
+		else if (argument == "--camera-path" && i + 1 < argc)
+			cameraPathFile = argv[++i];
+		else if (argument == "--backend" && i + 1 < argc) {
+			std::string name = argv[++i];
+			if (name == "null")
+				backend = RenderBackendType::Null;
+			else if (name == "recording")
+				backend = RenderBackendType::Recording;
+		}
+		else if (argument == "--record" && i + 1 < argc)
+			commandsPath = argv[++i];
+		else if (argument == "--workers" && i + 1 < argc)
+			workerCount = std::max(0, std::atoi(argv[++i]));
+		else if (argument == "--packet-benchmark")
+			packetBenchmark = true;
+		else if (argument == "--strict-allocations")
+			strictAllocations = true;
+		else if (argument == "--depth-prepass")
+			useDepthPrepass = true;
+		else if (argument == "--lights" && i + 1 < argc)
+			lightCount = std::max(0, std::atoi(argv[++i]));
+		else if (argument == "--light-benchmark")
+			lightBenchmark = true;
+		else if (argument == "--characters" && i + 1 < argc)
+			characterCount = std::max(0, std::atoi(argv[++i]));
+		else if (argument == "--character-model" && i + 1 < argc)
+			characterModel = argv[++i];
+		else if (argument == "--cpu-skinning")
+			cpuSkinning = true;
+		else if (argument == "--animation-benchmark")
+			animationBenchmark = true;
+	}
+	if (packetBenchmark && backend == RenderBackendType::GL)
+		backend = RenderBackendType::Null;
+	if (backend != RenderBackendType::GL)
+		headless = true;
+	Profiler::SetThreadName("Main");
+	AllocationTracker::SetThreadTag(AllocationTag::Loading);
+	AllocationTracker::SetStrict(strictAllocations);
+	JobSystem::Initialize(workerCount);
+	if (lightBenchmark)
+		return RunLightBenchmark(30);
+	if (animationBenchmark)
+		return RunAnimationBenchmark(30);
+
+	SDL_Window* window = nullptr;
+	SDL_GLContext context = nullptr;
+	HeadlessContext headlessContext;
+
+	if (backend != RenderBackendType::GL) {
+		RenderBackend::Install(backend);
+		RenderBackend::SetCaptureCommands(!commandsPath.empty());
+	}
+	else if (headless) {
+		if (!headlessContext.Create()) {
+			std::cerr << "Failed to create a headless GL context: " << headlessContext.GetError() << std::endl;
+			return -1;
+		}
+	}
+	else {
+		SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+		SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 4);
+		SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 6);
+		SDL_GL_SetAttribute(SDL_GL_STENCIL_SIZE, 8);
+
+		SDL_Init(SDL_INIT_VIDEO);
+
+		window = SDL_CreateWindow("3D Scene Viewer", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, static_cast<int>(screenWidth), static_cast<int>(screenHeight), SDL_WINDOW_OPENGL | SDL_WINDOW_RESIZABLE);
+		context = SDL_GL_CreateContext(window);
+		if (!context) {
+			// the newer paths are optional, anything from 3.3 up can run the viewer
+			SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
+			SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
+			context = SDL_GL_CreateContext(window);
+		}
+		SDL_GL_MakeCurrent(window, context);
+	}
 
-	if (!gladLoadGLLoader((GLADloadproc)SDL_GL_GetProcAddress)) {
+	GLADloadproc loadProc = headless ? (GLADloadproc)HeadlessContext::GetProcAddress : (GLADloadproc)SDL_GL_GetProcAddress;
+	if (backend == RenderBackendType::GL && !gladLoadGLLoader(loadProc)) {
 		std::cerr << "Failed to initialize GLAD" << std::endl;
 		return -1;
 	}
+	std::cout << "GL " << glGetString(GL_VERSION) << ", " << glGetString(GL_RENDERER) << std::endl;
 
-	glEnable(GL_DEPTH_TEST);
-	SDL_ShowCursor(SDL_DISABLE);
-	SDL_SetRelativeMouseMode(SDL_TRUE);
+	GLState::SetDepthTest(true);
+	if (!headless) {
+		SDL_ShowCursor(SDL_DISABLE);
+		SDL_SetRelativeMouseMode(SDL_TRUE);
+	}
 
 	std::vector<Object> objects;
 
-	Shader shader("texture.shader");
+	// everything up to the main loop, recorded by hand because it does not form one block
+	double loadStart = Profiler::Now();
+
+	ShaderManager shaders;
+	shaders.AddUniformBlockBinding("Camera", CameraBuffer::BlockBinding);
+	Material::RegisterBindings(shaders);
+
+	// the lights are read from storage buffers; without them the scene stays unlit
+	bool clusteredLighting = lightCount > 0 && LightBuffer::IsSupported();
+	if (lightCount > 0 && !clusteredLighting)
+		std::cout << "--lights needs GL 4.3, the scene is drawn unlit" << std::endl;
+	const uint32_t lighting = clusteredLighting ? ShaderFeature::ClusteredLighting : ShaderFeature::None;
+
+	// the objects read their world matrices from the TransformBuffer where there is one,
+	// everything else keeps the model uniform
+	const uint32_t objectTransforms = TransformBuffer::IsSupported() ? ShaderFeature::Transforms : ShaderFeature::None;
+
+	// the full-featured variants double as fallbacks while cheaper per-material variants compile
+	const uint32_t allMaps = ShaderFeature::DiffuseMap | ShaderFeature::SpecularMap;
+	ShaderHandle sceneShader = shaders.LoadVariant("texture.shader", allMaps | lighting);
+	ShaderHandle objectShader = shaders.LoadVariant("texture.shader", allMaps | lighting | objectTransforms);
+	ShaderHandle instancedShader = shaders.LoadVariant("texture.shader", allMaps | ShaderFeature::Instanced | lighting);
+	ShaderHandle depthOnlyShader = shaders.LoadVariant("texture.shader", ShaderFeature::DepthOnly | objectTransforms);
+	if (sceneShader == ShaderManager::InvalidHandle || objectShader == ShaderManager::InvalidHandle || instancedShader == ShaderManager::InvalidHandle || depthOnlyShader == ShaderManager::InvalidHandle) {
+		std::cerr << "Failed to build texture.shader, see the log above" << std::endl;
+		return -1;
+	}
+	Shader& depthShader = shaders.Get(depthOnlyShader);
+	Shader& shader = shaders.Get(sceneShader);
+	UniformHandle modelUniform = shader.GetModelUniform();
 
-	Object med = Object("Models/Med/med.obj", false, shader);
+	if (packetBenchmark)
+		return RunPacketBenchmark(shaders, sceneShader, 30);
+
+	Object med = Object("Models/Med/med.obj", false, shaders, objectShader, lighting | objectTransforms);
 	med.Translate(glm::vec3(28.5f, 1.0f, 3.0f));
 	med.SetScale(glm::vec3(0.03f, 0.03f, 0.03f));
 	med.SetRotation(glm::vec3(0.0f,1.0f,0.0f), 1.5708);
 
-	Object hf = Object("Models/hl/source/stalkyard/hl.obj", true, shader);
+	Object hf = Object("Models/hl/source/stalkyard/hl.obj", true, shaders, objectShader, lighting | objectTransforms);
 	hf.SetScale(glm::vec3(0.1f, 0.1f, 0.1f));
 	hf.SetRotation(glm::vec3(1.0f, 0.0f, 0.0f), 0.0f);
 	hf.Translate(glm::vec3(0.0f, 40.0f, 200.f));
 	
-	//Object backpack = Object("Models/Backpack/backpack.obj", true, shader);
+	InstancedObject medProps("Models/Med/med.obj", false, shaders, instancedShader, lighting);
+	medProps.Reserve(64);
+	for (int x = 0; x < 8; x++) {
+		for (int z = 0; z < 8; z++) {
+			glm::mat4 transform = glm::translate(glm::mat4(1.0f), glm::vec3(20.0f + x * 2.0f, 0.5f, -8.0f + z * 2.0f));
+			transform = glm::scale(transform, glm::vec3(0.03f, 0.03f, 0.03f));
+			medProps.AddInstance(transform);
+		}
+	}
+
+	//Object backpack = Object("Models/Backpack/backpack.obj", true, shaders, sceneShader);
 
 	objects.push_back(med);
 	//objects.push_back(backpack);
 	objects.push_back(hf);
 
-	glm::mat4 projection = glm::perspective(glm::radians(fov), screenWidth / screenHeight, 0.1f, 100.0f);
+	// scattered over the props, each circling its own spot; every fourth is a spot light looking down
+	std::vector<Light> lights(lightCount);
+	std::mt19937 random(7);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	for (size_t i = 0; i < lights.size(); i++) {
+		Light& light = lights[i];
+		light.Position = glm::vec3(10.0f + 30.0f * unit(random), 0.5f + 5.0f * unit(random), -15.0f + 30.0f * unit(random));
+		light.Color = glm::vec3(0.2f) + 0.8f * glm::vec3(unit(random), unit(random), unit(random));
+		light.Intensity = 1.5f;
+		light.Range = 3.0f + 5.0f * unit(random);
+		if (i % 4 == 3) {
+			light.Type = LightType::Spot;
+			light.Direction = glm::vec3(0.0f, -1.0f, 0.0f);
+		}
+	}
+	float lightTime = 0.0f;
+
+	// the characters stand in rows past the props, each starting somewhere else in some clip
+	std::unique_ptr<SkinnedObject> crowd;
+	std::vector<glm::mat4> characterTransforms;
+	std::vector<AnimationPlayback> characterPlayback;
+	if (characterCount > 0 && characterModel.empty())
+		std::cout << "--characters needs a rigged model, pass one with --character-model" << std::endl;
+	else if (characterCount > 0) {
+		// the CPU path skins into the streams the plain scene variant reads
+		bool gpuSkinning = !cpuSkinning && SkinnedObject::IsGPUSkinningSupported();
+		ShaderHandle characterShader = gpuSkinning ? shaders.LoadVariant("texture.shader", allMaps | ShaderFeature::Skinned | lighting) : sceneShader;
+		if (characterShader == ShaderManager::InvalidHandle) {
+			std::cout << "The skinned variant of texture.shader failed to build, the characters are skinned on the CPU" << std::endl;
+			gpuSkinning = false;
+			characterShader = sceneShader;
+		}
+		crowd = std::make_unique<SkinnedObject>(characterModel, false, shaders, characterShader, lighting, gpuSkinning);
+		if (!crowd->IsAnimated()) {
+			std::cout << "No skeleton in " << characterModel << ", no characters drawn" << std::endl;
+			crowd.reset();
+		}
+	}
+	if (crowd) {
+		const AnimationSet& animations = *crowd->GetAnimations();
+		uint32_t clipCount = static_cast<uint32_t>(animations.clips.size());
+		int columns = static_cast<int>(std::ceil(std::sqrt(static_cast<float>(characterCount))));
+		characterTransforms.resize(characterCount);
+		characterPlayback.resize(characterCount);
+		for (int i = 0; i < characterCount; i++) {
+			characterTransforms[i] = glm::translate(glm::mat4(1.0f), glm::vec3(40.0f + (i % columns) * 2.0f, 0.0f, -8.0f + (i / columns) * 2.0f));
+			AnimationPlayback& playback = characterPlayback[i];
+			playback.clip = clipCount > 0 ? i % clipCount : 0;
+			playback.speed = 0.8f + 0.4f * unit(random);
+			if (clipCount > 0)
+				playback.time = animations.clips[playback.clip].duration * unit(random);
+		}
+		std::cout << "Characters: " << characterCount << " of " << characterModel << ", " << animations.skeleton.GetJointCount() << " joints, "
+			<< clipCount << " clips, skinned on the " << (crowd->UsesGPUSkinning() ? "GPU" : "CPU") << std::endl;
+	}
 
-	bool running = true;
-	SDL_Event event;
-	Uint32 lastTime = SDL_GetTicks(), currentTime;
+	const float nearPlane = 0.1f;
+	const float farPlane = 100.0f;
 
-	while (running) {
-		currentTime = SDL_GetTicks();
-		float deltaTime = (currentTime - lastTime) / 1000.0f;
-		lastTime = currentTime;
+	RenderQueue renderQueue(nearPlane, farPlane);
 
-		while (SDL_PollEvent(&event)) {
-			if (event.type == SDL_QUIT)
-				running = false;
-			processMouse(event, deltaTime);
-		}
-		processKeyboard(deltaTime);
+	// every per-frame upload (camera, transforms, indirect commands) is carved out of this ring
+	StreamBuffer stream(1024 * 1024);
+	CameraBuffer camera(stream);
 
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	LightCuller lightCuller;
+	std::unique_ptr<LightBuffer> lightBuffer;
+	if (clusteredLighting)
+		lightBuffer = std::make_unique<LightBuffer>(stream);
 
-		shader.Bind();
+	std::unique_ptr<TransformBuffer> transforms;
+	if (TransformBuffer::IsSupported()) {
+		transforms = std::make_unique<TransformBuffer>(stream, 4096);
+		for (Object& object : objects) {
+			object.SetTransformIndex(transforms->Allocate());
+			object.SetTransformIndexBuffer(transforms->GetIndexBuffer());
+		}
+	}
 
+	GeometryPool geometryPool;
+	std::unique_ptr<IndirectRenderer> indirectRenderer;
+	ShaderHandle indirectShader = ShaderManager::InvalidHandle, indirectDepthShader = ShaderManager::InvalidHandle;
+	if (IndirectRenderer::IsSupported() && transforms) {
+		indirectShader = shaders.LoadVariant("indirect.shader", lighting);
+		indirectDepthShader = shaders.LoadVariant("indirect.shader", ShaderFeature::DepthOnly);
+		if (indirectShader == ShaderManager::InvalidHandle || indirectDepthShader == ShaderManager::InvalidHandle)
+			std::cout << "indirect.shader failed to build, multi-draw indirect is off" << std::endl;
+	}
+	if (indirectShader != ShaderManager::InvalidHandle && indirectDepthShader != ShaderManager::InvalidHandle) {
+		for (Object& object : objects)
+			object.AddToPool(geometryPool);
+		geometryPool.Upload();
+
+		indirectRenderer = std::make_unique<IndirectRenderer>(shaders.Get(indirectShader), geometryPool, stream);
+		indirectRenderer->SetDepthShader(&shaders.Get(indirectDepthShader));
+		renderQueue.SetIndirectRenderer(indirectRenderer.get());
+	}
+	bool useIndirect = indirectRenderer != nullptr;
+	if (Profiler::IsEnabled())
+		Profiler::RecordCpuZone("Scene load", loadStart, Profiler::Now(), 0);
+
+	const ShaderCacheStats& shaderStats = shaders.GetStats();
+	std::cout << "Shaders: " << shaders.GetCount() << " programs, " << shaderStats.binaryHits << " from binary cache, "
+		<< shaderStats.compiled << " compiled, " << shaderStats.binaryRejected << " cached binaries rejected, "
+		<< shaderStats.pending << " queued" << std::endl;
+
+	// a headless context has no default framebuffer, everything goes to the offscreen target
+	std::unique_ptr<Framebuffer> offscreen;
+	std::unique_ptr<FrameTimer> frameTimer;
+	CameraPath cameraPath;
+	std::vector<unsigned char> capturePixels;
+	if (headless) {
+		offscreen = std::make_unique<Framebuffer>(static_cast<int>(screenWidth), static_cast<int>(screenHeight));
+		if (!offscreen->IsComplete())
+			return -1;
+		offscreen->Bind();
+		frameTimer = std::make_unique<FrameTimer>(backend == RenderBackendType::GL);
+		frameTimer->Reserve(headlessFrames);
+		if (!cameraPathFile.empty() && !cameraPath.Load(cameraPathFile))
+			return -1;
+		if (!captureDirectory.empty() && backend != RenderBackendType::GL) {
+			std::cout << "--capture needs the GL backend, frames are not saved" << std::endl;
+			captureDirectory.clear();
+		}
+		if (!captureDirectory.empty())
+			std::filesystem::create_directories(captureDirectory);
+	}
+
+	// simulation side: advances the scene and fills a snapshot; reads only input and scene state
+	uint64_t frameNumber = 0;
+	uint32_t profileRequests = 0;
+	auto simulate = [&](FrameSnapshot& snapshot, float deltaTime) {
+		PROFILE_SCOPE("Simulate");
+		AllocationScope allocationScope(AllocationTag::Simulation);
 		hf.SetRotation(glm::vec3(0.0f, 1.0f, 0.0f), deltaTime);
 
-		glm::mat4 projection = glm::perspective(glm::radians(fov), screenWidth / screenHeight, 0.1f, 100.0f);
-		glm::mat4 view = glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
-		shader.SetUniformMat4f("projection", projection);
-		shader.SetUniformMat4f("view", view);
+		snapshot.frame = ++frameNumber;
+		snapshot.projection = glm::perspective(glm::radians(fov), screenWidth / screenHeight, nearPlane, farPlane);
+		snapshot.view = glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
+		snapshot.cameraPosition = cameraPos;
+		snapshot.objectTransforms.clear();
+		for (const Object& object : objects)
+			snapshot.objectTransforms.push_back(object.GetModelMatrix());
+		lightTime += deltaTime;
+		snapshot.lights = lights;
+		for (size_t i = 0; i < lights.size(); i++) {
+			float angle = lightTime * (0.5f + 0.1f * (i % 7)) + static_cast<float>(i);
+			snapshot.lights[i].Position += glm::vec3(std::cos(angle), 0.0f, std::sin(angle)) * 2.0f;
+		}
+		if (crowd) {
+			// every character moves on to the next clip whenever the one it plays comes round again
+			const AnimationSet& animations = *crowd->GetAnimations();
+			for (AnimationPlayback& playback : characterPlayback) {
+				float before = playback.time;
+				playback.Advance(deltaTime, animations);
+				if (playback.time < before && animations.clips.size() > 1)
+					playback.Play((playback.clip + 1) % static_cast<uint32_t>(animations.clips.size()), 0.3f);
+			}
+			snapshot.characters = characterPlayback;
+		}
+		snapshot.useIndirect = useIndirect;
+		snapshot.useDepthPrepass = useDepthPrepass;
+		snapshot.profileRequests = profileRequests;
+		snapshot.inputTime = Profiler::Now();
+	};
+
+	// render side: owns the GL context and every GL object; reads only the snapshot
+	bool indirectActive = useIndirect;
+	bool depthPrepassActive = false;
+	uint32_t profileRequestsSeen = 0;
+	// transient per-frame data of whichever thread renders; emptied once the frame is submitted
+	FrameArena renderArena(256 * 1024);
+	auto render = [&](const FrameSnapshot& snapshot) {
+		AllocationScope allocationScope(AllocationTag::Render);
+		{
+			PROFILE_SCOPE("Shader compiles");
+			shaders.Update();
+		}
+		{
+			PROFILE_SCOPE("Stream wait");
+			stream.BeginFrame();
+		}
+		if (snapshot.useIndirect != indirectActive) {
+			indirectActive = snapshot.useIndirect;
+			renderQueue.SetIndirectRenderer(indirectActive ? indirectRenderer.get() : nullptr);
+		}
+		if (snapshot.useDepthPrepass != depthPrepassActive) {
+			depthPrepassActive = snapshot.useDepthPrepass;
+			renderQueue.SetDepthPrepass(depthPrepassActive ? &depthShader : nullptr);
+		}
 
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-		glm::mat4 model = glm::mat4(1.0f);
-		model = glm::translate(model, glm::vec3(0.0f, 0.0f, 0.0f));
-		model = glm::scale(model, glm::vec3(1.0f, 1.0f, 1.0f));
-		shader.SetUniformMat4f("model", model);
+		shader.Bind();
+		{
+			PROFILE_SCOPE("Uniform setup");
+			camera.Update(snapshot.projection, snapshot.view, snapshot.cameraPosition);
+
+			if (transforms) {
+				transforms->BeginFrame();
+				JobSystem::ParallelFor(objects.size(), 256, [&](size_t begin, size_t end) {
+					for (size_t i = begin; i < end; i++)
+						transforms->Write(objects[i].GetTransformIndex(), snapshot.objectTransforms[i]);
+				});
+				transforms->Publish();
+			}
+			if (lightBuffer) {
+				PROFILE_SCOPE("Light culling");
+				lightCuller.Cull(snapshot.lights, snapshot.view, snapshot.projection, nearPlane, farPlane);
+				lightBuffer->Update(snapshot.lights, lightCuller, screenWidth, screenHeight);
+			}
+
+			glm::mat4 model = glm::mat4(1.0f);
+			model = glm::translate(model, glm::vec3(0.0f, 0.0f, 0.0f));
+			model = glm::scale(model, glm::vec3(1.0f, 1.0f, 1.0f));
+			shader.SetUniform(modelUniform, model);
+		}
+		{
+			PROFILE_SCOPE("Submit");
+			Frustum frustum(snapshot.projection * snapshot.view);
+			Object::SubmitAll(renderQueue, objects, snapshot.objectTransforms, snapshot.view, &frustum);
+		}
+		{
+			PROFILE_GPU_SCOPE("RenderQueue::Flush");
+			renderQueue.Flush();
+		}
+		{
+			PROFILE_GPU_SCOPE("Instanced props");
+			medProps.Draw();
+		}
+		if (crowd) {
+			PROFILE_GPU_SCOPE("Characters");
+			crowd->Draw(characterTransforms, snapshot.characters);
+		}
 
+		stream.EndFrame();
+		GLState::EndFrame();
+		RenderBackend::EndFrame();
+		Profiler::EndFrame();
 
+		// written here so no GPU zone is being read back while the rings are walked
+		if (snapshot.profileRequests != profileRequestsSeen) {
+			AllocationScope diagnostics(AllocationTag::Diagnostics);
+			profileRequestsSeen = snapshot.profileRequests;
+			Profiler::WriteChromeTrace("profile_" + std::to_string(SDL_GetTicks()) + ".json");
+		}
 
-		for (Object object : objects)
-		{
-			object.Draw(shader);
+		AllocationTracker::EndFrame();
+		renderArena.Reset();
+	};
+
+	Uint32 lastStatsTime = SDL_GetTicks();
+	auto printStats = [&](LatencyTracker* latency) {
+		Uint32 currentTime = SDL_GetTicks();
+		if (currentTime - lastStatsTime < 1000)
+			return;
+		AllocationScope diagnostics(AllocationTag::Diagnostics);
+
+		const RenderQueueStats& stats = renderQueue.GetStats();
+		std::cout << "Render queue: " << stats.packets << " packets, state changes "
+			<< stats.stateChangesUnsorted << " unsorted -> " << stats.stateChangesSorted << " sorted" << std::endl;
+		if (renderQueue.HasDepthPrepass())
+			std::cout << "Depth prepass: " << stats.prepassPackets << " opaque packets" << std::endl;
+		if (lightBuffer) {
+			const LightCullingStats& lightStats = lightCuller.GetStats();
+			std::cout << "Lights: " << lightStats.visibleLights << " of " << lightStats.lights << " in range of the view, "
+				<< lightStats.references << " cluster references, at most " << lightStats.maxPerCluster << " in one cluster" << std::endl;
+		}
+		const UniformStats& uniformStats = Shader::GetUniformStats();
+		std::cout << "Uniforms: " << uniformStats.uploads << " sent, " << uniformStats.elided << " unchanged and skipped" << std::endl;
+		Shader::ResetUniformStats();
+		const GLStateStats& glStats = GLState::GetFrameStats();
+		std::cout << "GL state: " << glStats.issued << " calls issued, " << glStats.elided << " redundant calls dropped last frame" << std::endl;
+		if (stream.GetStallCount() > 0 || stream.GetOverflowCount() > 0)
+			std::cout << "Stream buffer: " << stream.GetStallCount() << " frames waited on the GPU, "
+				<< stream.GetOverflowCount() << " allocations did not fit" << std::endl;
+		if (backend == RenderBackendType::Recording) {
+			const RenderCounters& counters = RenderBackend::GetFrameCounters();
+			std::cout << "Backend: " << counters.drawCalls << " draw calls (" << counters.draws << " draws), " << counters.binds << " binds, "
+				<< counters.bufferUploads << " buffer uploads (" << counters.bufferBytes << " bytes), " << counters.uniformUploads << " uniforms" << std::endl;
+		}
+		if (latency && latency->GetStats().frames > 0) {
+			const LatencyStats& latencyStats = latency->GetStats();
+			std::cout << std::format("Input to photon: {:.1f} ms mean, {:.1f} ms max over {} frames",
+				latencyStats.meanMilliseconds, latencyStats.maxMilliseconds, latencyStats.frames) << std::endl;
+			latency->Reset();
+		}
+		const AllocationCounts& frameAllocations = AllocationTracker::GetFrameTotal();
+		std::cout << "Allocations: " << frameAllocations.allocations << " (" << frameAllocations.bytes << " bytes) last frame, frame arena peak "
+			<< renderArena.GetPeak() << " of " << renderArena.GetCapacity() << " bytes" << std::endl;
+		lastStatsTime = currentTime;
+	};
+
+	// loading is done; from here this thread runs the frame loop, and whatever it allocates
+	// outside the simulate, render and diagnostics scopes counts against the steady state
+	AllocationTracker::SetThreadTag(AllocationTag::Simulation);
+
+	if (headless) {
+		// one thread, fixed steps: the snapshot is drawn as soon as it is built so every run is identical
+		FrameSnapshot snapshot;
+		renderArena.MakeCurrent();
+		for (int frameIndex = 0; frameIndex < headlessFrames; frameIndex++) {
+			PROFILE_SCOPE("Frame");
+			cameraPath.Evaluate(frameIndex * HeadlessFrameStep, cameraPos, cameraFront);
+			frameTimer->BeginFrame();
+			simulate(snapshot, HeadlessFrameStep);
+			render(snapshot);
+			frameTimer->EndFrame();
+			printStats(nullptr);
+
+			// nothing is presented; the flush stands in for the swap
+			glFlush();
+			if (!captureDirectory.empty()) {
+				PROFILE_SCOPE("Capture");
+				AllocationScope diagnostics(AllocationTag::Diagnostics);
+				offscreen->ReadPixels(capturePixels);
+				WritePNG(std::format("{}/frame_{:04}.png", captureDirectory, frameIndex), offscreen->GetWidth(), offscreen->GetHeight(), 4, capturePixels.data(), true);
+			}
 		}
 
-		shader.Bind();
+		frameTimer->Finish();
+		frameTimer->PrintSummary();
+		if (!frameTimesPath.empty())
+			frameTimer->WriteCSV(frameTimesPath);
+	}
+	else {
+		// The render thread takes the context over and draws whatever snapshot is newest
+		// while this thread handles input and builds the next one, so simulating frame N+1
+		// overlaps submitting frame N.
+		TripleBuffer<FrameSnapshot> snapshots;
+		SDL_GL_MakeCurrent(window, nullptr);
+
+		std::thread renderThread([&] {
+			Profiler::SetThreadName("Render");
+			AllocationTracker::SetThreadTag(AllocationTag::Render);
+			renderArena.MakeCurrent();
+			SDL_GL_MakeCurrent(window, context);
+			LatencyTracker latency;
+			uint64_t published = 0;
+			while (true) {
+				snapshots.WaitForPublish(published);
+				published = snapshots.GetPublishCount();
+				snapshots.Update();
+				const FrameSnapshot& snapshot = snapshots.GetReadBuffer();
+				if (snapshot.quit)
+					break;
+
+				{
+					PROFILE_SCOPE("Frame");
+					latency.Poll();
+					render(snapshot);
+					printStats(&latency);
+				}
+				{
+					PROFILE_SCOPE("SwapWindow");
+					SDL_GL_SwapWindow(window);
+				}
+				latency.FramePresented(snapshot.inputTime);
+			}
+			SDL_GL_MakeCurrent(window, nullptr);
+		});
+
+		bool running = true;
+		Uint32 lastTime = SDL_GetTicks(), currentTime;
+		auto handleEvent = [&](const SDL_Event& event) {
+			if (event.type == SDL_QUIT)
+				running = false;
+			if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_F8) {
+				Profiler::SetEnabled(!Profiler::IsEnabled());
+				std::cout << "Profiler " << (Profiler::IsEnabled() ? "on" : "off") << std::endl;
+			}
+			if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_F9)
+				profileRequests++;
+			if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_i && indirectRenderer) {
+				useIndirect = !useIndirect;
+				std::cout << "Multi-draw indirect " << (useIndirect ? "on" : "off") << std::endl;
+			}
+			if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_p) {
+				useDepthPrepass = !useDepthPrepass;
+				std::cout << "Depth prepass " << (useDepthPrepass ? "on" : "off") << std::endl;
+			}
+			processMouse(event, 0.0f);
+		};
+
+		SDL_Event event;
+
+		while (running) {
+			{
+				// building further ahead than the render thread only makes the input staler;
+				// events are still handled while it catches up
+				PROFILE_SCOPE("Wait for render");
+				while (running && snapshots.HasUnread()) {
+					if (SDL_WaitEventTimeout(&event, 1))
+						handleEvent(event);
+				}
+			}
+			{
+				PROFILE_SCOPE("Events");
+				while (SDL_PollEvent(&event))
+					handleEvent(event);
+			}
+			currentTime = SDL_GetTicks();
+			float deltaTime = (currentTime - lastTime) / 1000.0f;
+			lastTime = currentTime;
+			{
+				PROFILE_SCOPE("processKeyboard");
+				processKeyboard(deltaTime);
+			}
+
+			simulate(snapshots.GetWriteBuffer(), deltaTime);
+			snapshots.Publish();
+		}
 
+		snapshots.GetWriteBuffer().quit = true;
+		snapshots.Publish();
+		renderThread.join();
+		SDL_GL_MakeCurrent(window, context);
+	}
 
-		SDL_GL_SwapWindow(window);
+	if (backend == RenderBackendType::Recording) {
+		const RenderCounters& counters = RenderBackend::GetFrameCounters();
+		std::cout << "Last frame: " << counters.calls << " GL calls, " << counters.drawCalls << " draw calls (" << counters.draws << " draws), "
+			<< counters.binds << " binds, " << counters.stateChanges << " state changes, "
+			<< counters.bufferUploads << " buffer uploads (" << counters.bufferBytes << " bytes), "
+			<< counters.textureUploads << " texture uploads (" << counters.textureBytes << " bytes), "
+			<< counters.uniformUploads << " uniform uploads (" << counters.uniformBytes << " bytes)" << std::endl;
+		if (!commandsPath.empty())
+			RenderBackend::WriteCommands(commandsPath);
 	}
 
-	SDL_GL_DeleteContext(context);
-	SDL_DestroyWindow(window);
-	SDL_Quit();
+	JobSystem::Shutdown();
+	if (Profiler::IsEnabled())
+		Profiler::WriteChromeTrace("profile_exit.json");
+
+	if (!headless) {
+		SDL_GL_DeleteContext(context);
+		SDL_DestroyWindow(window);
+		SDL_Quit();
+	}
 
 	return 0;
 }
@@ -0,0 +1,181 @@
+#include "AllocationTracker.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+bool AllocationTracker::strict = false;
+int AllocationTracker::warmupFrames = 0;
+uint64_t AllocationTracker::frame = 0;
+
+namespace {
+	constexpr size_t TagCount = static_cast<size_t>(AllocationTag::Count);
+
+	struct AtomicCounts {
+		std::atomic<uint64_t> allocations{ 0 };
+		std::atomic<uint64_t> bytes{ 0 };
+	};
+
+	// constant-initialised, so allocations made before main are counted too
+	AtomicCounts current[TagCount];
+	AtomicCounts total[TagCount];
+	AllocationCounts lastFrame[TagCount];
+
+	thread_local AllocationTag threadTag = AllocationTag::Untagged;
+
+	const char* tagNames[TagCount] = { "untagged", "loading", "simulation", "render", "jobs", "diagnostics" };
+}
+
+const char* AllocationTracker::GetTagName(AllocationTag tag)
+{
+	return tagNames[static_cast<size_t>(tag)];
+}
+
+AllocationTag AllocationTracker::GetThreadTag()
+{
+	return threadTag;
+}
+
+void AllocationTracker::SetThreadTag(AllocationTag tag)
+{
+	threadTag = tag;
+}
+
+void AllocationTracker::Record(size_t bytes)
+{
+	size_t tag = static_cast<size_t>(threadTag);
+	current[tag].allocations.fetch_add(1, std::memory_order_relaxed);
+	current[tag].bytes.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void AllocationTracker::EndFrame()
+{
+	for (size_t tag = 0; tag < TagCount; tag++)
+	{
+		lastFrame[tag].allocations = current[tag].allocations.exchange(0, std::memory_order_relaxed);
+		lastFrame[tag].bytes = current[tag].bytes.exchange(0, std::memory_order_relaxed);
+		total[tag].allocations.fetch_add(lastFrame[tag].allocations, std::memory_order_relaxed);
+		total[tag].bytes.fetch_add(lastFrame[tag].bytes, std::memory_order_relaxed);
+	}
+
+	frame++;
+	if (strict && frame > static_cast<uint64_t>(warmupFrames) && GetFrameTotal().allocations > 0)
+	{
+		// printf rather than iostream, which could allocate on the way out
+		std::printf("Steady-state frame %llu allocated: ", static_cast<unsigned long long>(frame));
+		PrintFrame();
+		std::fflush(stdout);
+		std::abort();
+	}
+}
+
+const AllocationCounts& AllocationTracker::GetFrameCounts(AllocationTag tag)
+{
+	return lastFrame[static_cast<size_t>(tag)];
+}
+
+AllocationCounts AllocationTracker::GetFrameTotal()
+{
+	AllocationCounts sum;
+	for (size_t tag = 0; tag < TagCount; tag++)
+	{
+		if (tag == static_cast<size_t>(AllocationTag::Diagnostics))
+			continue;
+		sum.allocations += lastFrame[tag].allocations;
+		sum.bytes += lastFrame[tag].bytes;
+	}
+	return sum;
+}
+
+AllocationCounts AllocationTracker::GetTotalCounts(AllocationTag tag)
+{
+	size_t index = static_cast<size_t>(tag);
+	return { total[index].allocations.load(std::memory_order_relaxed) + current[index].allocations.load(std::memory_order_relaxed),
+		total[index].bytes.load(std::memory_order_relaxed) + current[index].bytes.load(std::memory_order_relaxed) };
+}
+
+AllocationCounts AllocationTracker::GetTotal()
+{
+	AllocationCounts sum;
+	for (size_t tag = 0; tag < TagCount; tag++)
+	{
+		AllocationCounts counts = GetTotalCounts(static_cast<AllocationTag>(tag));
+		sum.allocations += counts.allocations;
+		sum.bytes += counts.bytes;
+	}
+	return sum;
+}
+
+void AllocationTracker::SetStrict(bool enable, int warmup)
+{
+	strict = enable;
+	warmupFrames = warmup;
+}
+
+void AllocationTracker::PrintFrame()
+{
+	for (size_t tag = 0; tag < TagCount; tag++)
+	{
+		if (lastFrame[tag].allocations == 0)
+			continue;
+		std::printf("%s %llu (%llu bytes) ", tagNames[tag], static_cast<unsigned long long>(lastFrame[tag].allocations),
+			static_cast<unsigned long long>(lastFrame[tag].bytes));
+	}
+	std::printf("\n");
+}
+
+#if TRACK_ALLOCATIONS
+
+namespace {
+	void* trackedAllocate(size_t size)
+	{
+		AllocationTracker::Record(size);
+		if (void* memory = std::malloc(size ? size : 1))
+			return memory;
+		throw std::bad_alloc();
+	}
+
+	void* trackedAllocateAligned(size_t size, std::align_val_t alignment)
+	{
+		AllocationTracker::Record(size);
+		size_t align = static_cast<size_t>(alignment);
+#ifdef _WIN32
+		void* memory = _aligned_malloc(size ? size : 1, align);
+#else
+		void* memory = std::aligned_alloc(align, (size + align - 1) / align * align);
+#endif
+		if (memory)
+			return memory;
+		throw std::bad_alloc();
+	}
+
+	void freeAligned(void* memory)
+	{
+#ifdef _WIN32
+		_aligned_free(memory);
+#else
+		std::free(memory);
+#endif
+	}
+}
+
+void* operator new(size_t size) { return trackedAllocate(size); }
+void* operator new[](size_t size) { return trackedAllocate(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { AllocationTracker::Record(size); return std::malloc(size ? size : 1); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { AllocationTracker::Record(size); return std::malloc(size ? size : 1); }
+void* operator new(size_t size, std::align_val_t alignment) { return trackedAllocateAligned(size, alignment); }
+void* operator new[](size_t size, std::align_val_t alignment) { return trackedAllocateAligned(size, alignment); }
+
+void operator delete(void* memory) noexcept { std::free(memory); }
+void operator delete[](void* memory) noexcept { std::free(memory); }
+void operator delete(void* memory, size_t) noexcept { std::free(memory); }
+void operator delete[](void* memory, size_t) noexcept { std::free(memory); }
+void operator delete(void* memory, const std::nothrow_t&) noexcept { std::free(memory); }
+void operator delete[](void* memory, const std::nothrow_t&) noexcept { std::free(memory); }
+void operator delete(void* memory, std::align_val_t) noexcept { freeAligned(memory); }
+void operator delete[](void* memory, std::align_val_t) noexcept { freeAligned(memory); }
+void operator delete(void* memory, size_t, std::align_val_t) noexcept { freeAligned(memory); }
+void operator delete[](void* memory, size_t, std::align_val_t) noexcept { freeAligned(memory); }
+
+#endif
@@ -0,0 +1,87 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Define TRACK_ALLOCATIONS to 0 to leave the global operator new alone.
+#ifndef TRACK_ALLOCATIONS
+#define TRACK_ALLOCATIONS 1
+#endif
+
+// The subsystem an allocation is charged to, taken from the allocating thread.
+enum class AllocationTag : uint8_t {
+	Untagged,
+	Loading,
+	Simulation,
+	Render,
+	// jobs are charged to the tag of the thread that queued them; this is for the pool itself
+	Jobs,
+	// stats, captures and traces produced on request; exempt from the steady-state check
+	Diagnostics,
+	Count,
+};
+
+struct AllocationCounts {
+	uint64_t allocations = 0;
+	uint64_t bytes = 0;
+};
+
+// Counts every allocation that goes through the global operator new, per tag, for the
+// current frame and in total. Counting is two relaxed atomic adds, so it stays on in
+// release builds. Memory from malloc (stb_image, SDL, the driver) is not seen.
+//
+// In strict mode a frame that allocates outside Diagnostics once the warm-up frames are
+// over is a failure: EndFrame prints where the allocations were charged and aborts, so a
+// regression shows up the first time the loop runs rather than as a slow leak in a profile.
+class AllocationTracker
+{
+public:
+	static const char* GetTagName(AllocationTag tag);
+
+	static AllocationTag GetThreadTag();
+	static void SetThreadTag(AllocationTag tag);
+
+	// called by operator new
+	static void Record(size_t bytes);
+
+	// closes the frame; call once per frame from one thread
+	static void EndFrame();
+	static const AllocationCounts& GetFrameCounts(AllocationTag tag);
+	// the last closed frame, every tag but Diagnostics
+	static AllocationCounts GetFrameTotal();
+	static AllocationCounts GetTotalCounts(AllocationTag tag);
+	// since startup, every tag
+	static AllocationCounts GetTotal();
+
+	static void SetStrict(bool strict, int warmupFrames = 120);
+	static bool IsStrict() { return strict; }
+
+	// one line of per-tag counts for the last closed frame
+	static void PrintFrame();
+
+private:
+	static bool strict;
+	static int warmupFrames;
+	static uint64_t frame;
+};
+
+// Charges the calling thread's allocations to tag until the end of the scope.
+class AllocationScope
+{
+public:
+	explicit AllocationScope(AllocationTag tag)
+		: previous(AllocationTracker::GetThreadTag())
+	{
+		AllocationTracker::SetThreadTag(tag);
+	}
+
+	~AllocationScope()
+	{
+		AllocationTracker::SetThreadTag(previous);
+	}
+
+	AllocationScope(const AllocationScope&) = delete;
+	AllocationScope& operator=(const AllocationScope&) = delete;
+
+private:
+	AllocationTag previous;
+};
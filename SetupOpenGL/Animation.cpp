@@ -0,0 +1,343 @@
+#include "Animation.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ANIMATION_SSE 1
+#include <emmintrin.h>
+#else
+#define ANIMATION_SSE 0
+#endif
+
+namespace {
+	float wrapTime(float time, float duration)
+	{
+		if (duration <= 0.0f)
+			return 0.0f;
+		time = std::fmod(time, duration);
+		return time < 0.0f ? time + duration : time;
+	}
+
+#if ANIMATION_SSE
+	// from + (to - from) * factor for each of count arrays of four lanes
+	inline void lerpLanes(const float (*from)[4], const float (*to)[4], __m128 factor, float (*result)[4], int count)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			__m128 a = _mm_load_ps(from[i]);
+			__m128 b = _mm_load_ps(to[i]);
+			_mm_store_ps(result[i], _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), factor)));
+		}
+	}
+
+	// translation and scale linearly; rotation by nlerp, with to negated in the lanes
+	// where it lies on the far side of from
+	void mixQuad(const JointQuad& from, const JointQuad& to, __m128 translationFactor, __m128 rotationFactor, __m128 scaleFactor, JointQuad& result)
+	{
+		lerpLanes(from.translation, to.translation, translationFactor, result.translation, 3);
+		lerpLanes(from.scale, to.scale, scaleFactor, result.scale, 3);
+
+		__m128 a[4], b[4];
+		__m128 dot = _mm_setzero_ps();
+		for (int axis = 0; axis < 4; axis++)
+		{
+			a[axis] = _mm_load_ps(from.rotation[axis]);
+			b[axis] = _mm_load_ps(to.rotation[axis]);
+			dot = _mm_add_ps(dot, _mm_mul_ps(a[axis], b[axis]));
+		}
+		__m128 flip = _mm_and_ps(_mm_cmplt_ps(dot, _mm_setzero_ps()), _mm_set1_ps(-0.0f));
+
+		__m128 q[4];
+		__m128 lengthSquared = _mm_setzero_ps();
+		for (int axis = 0; axis < 4; axis++)
+		{
+			q[axis] = _mm_add_ps(a[axis], _mm_mul_ps(_mm_sub_ps(_mm_xor_ps(b[axis], flip), a[axis]), rotationFactor));
+			lengthSquared = _mm_add_ps(lengthSquared, _mm_mul_ps(q[axis], q[axis]));
+		}
+		__m128 inverseLength = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(lengthSquared));
+		for (int axis = 0; axis < 4; axis++)
+			_mm_store_ps(result.rotation[axis], _mm_mul_ps(q[axis], inverseLength));
+	}
+
+	// the matrices of a quad's four joints, translation * rotation * scale
+	void quadToMatrices(const JointQuad& quad, AffineMatrix* matrices)
+	{
+		__m128 x = _mm_load_ps(quad.rotation[0]), y = _mm_load_ps(quad.rotation[1]);
+		__m128 z = _mm_load_ps(quad.rotation[2]), w = _mm_load_ps(quad.rotation[3]);
+		__m128 sx = _mm_load_ps(quad.scale[0]), sy = _mm_load_ps(quad.scale[1]), sz = _mm_load_ps(quad.scale[2]);
+		__m128 one = _mm_set1_ps(1.0f), two = _mm_set1_ps(2.0f);
+
+		__m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+		__m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+		__m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+
+		__m128 rows[3][4] = {
+			{
+				_mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), sx),
+				_mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), sy),
+				_mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), sz),
+				_mm_load_ps(quad.translation[0]),
+			},
+			{
+				_mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), sx),
+				_mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), sy),
+				_mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), sz),
+				_mm_load_ps(quad.translation[1]),
+			},
+			{
+				_mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), sx),
+				_mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), sy),
+				_mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), sz),
+				_mm_load_ps(quad.translation[2]),
+			},
+		};
+
+		// each row holds one element for four joints; transposed it is one joint's row
+		for (int row = 0; row < 3; row++)
+		{
+			__m128 c0 = rows[row][0], c1 = rows[row][1], c2 = rows[row][2], c3 = rows[row][3];
+			_MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+			_mm_storeu_ps(&matrices[0].rows[row].x, c0);
+			_mm_storeu_ps(&matrices[1].rows[row].x, c1);
+			_mm_storeu_ps(&matrices[2].rows[row].x, c2);
+			_mm_storeu_ps(&matrices[3].rows[row].x, c3);
+		}
+	}
+
+	// result may be b, never a
+	inline void multiply(const AffineMatrix& a, const AffineMatrix& b, AffineMatrix& result)
+	{
+		__m128 b0 = _mm_loadu_ps(&b.rows[0].x);
+		__m128 b1 = _mm_loadu_ps(&b.rows[1].x);
+		__m128 b2 = _mm_loadu_ps(&b.rows[2].x);
+		__m128 b3 = _mm_set_ps(1.0f, 0.0f, 0.0f, 0.0f);
+		for (int row = 0; row < 3; row++)
+		{
+			__m128 r = _mm_loadu_ps(&a.rows[row].x);
+			__m128 sum = _mm_mul_ps(_mm_shuffle_ps(r, r, _MM_SHUFFLE(0, 0, 0, 0)), b0);
+			sum = _mm_add_ps(sum, _mm_mul_ps(_mm_shuffle_ps(r, r, _MM_SHUFFLE(1, 1, 1, 1)), b1));
+			sum = _mm_add_ps(sum, _mm_mul_ps(_mm_shuffle_ps(r, r, _MM_SHUFFLE(2, 2, 2, 2)), b2));
+			sum = _mm_add_ps(sum, _mm_mul_ps(_mm_shuffle_ps(r, r, _MM_SHUFFLE(3, 3, 3, 3)), b3));
+			_mm_storeu_ps(&result.rows[row].x, sum);
+		}
+	}
+#else
+	void mixQuad(const JointQuad& from, const JointQuad& to, const float* translationFactor, const float* rotationFactor, const float* scaleFactor, JointQuad& result)
+	{
+		for (int lane = 0; lane < 4; lane++)
+		{
+			for (int axis = 0; axis < 3; axis++)
+			{
+				result.translation[axis][lane] = from.translation[axis][lane] + (to.translation[axis][lane] - from.translation[axis][lane]) * translationFactor[lane];
+				result.scale[axis][lane] = from.scale[axis][lane] + (to.scale[axis][lane] - from.scale[axis][lane]) * scaleFactor[lane];
+			}
+
+			float dot = 0.0f;
+			for (int axis = 0; axis < 4; axis++)
+				dot += from.rotation[axis][lane] * to.rotation[axis][lane];
+			float sign = dot < 0.0f ? -1.0f : 1.0f;
+
+			float q[4];
+			float lengthSquared = 0.0f;
+			for (int axis = 0; axis < 4; axis++)
+			{
+				q[axis] = from.rotation[axis][lane] + (to.rotation[axis][lane] * sign - from.rotation[axis][lane]) * rotationFactor[lane];
+				lengthSquared += q[axis] * q[axis];
+			}
+			float inverseLength = 1.0f / std::sqrt(lengthSquared);
+			for (int axis = 0; axis < 4; axis++)
+				result.rotation[axis][lane] = q[axis] * inverseLength;
+		}
+	}
+
+	void quadToMatrices(const JointQuad& quad, AffineMatrix* matrices)
+	{
+		for (int lane = 0; lane < 4; lane++)
+		{
+			float x = quad.rotation[0][lane], y = quad.rotation[1][lane], z = quad.rotation[2][lane], w = quad.rotation[3][lane];
+			float sx = quad.scale[0][lane], sy = quad.scale[1][lane], sz = quad.scale[2][lane];
+			AffineMatrix& matrix = matrices[lane];
+			matrix.rows[0] = glm::vec4((1.0f - 2.0f * (y * y + z * z)) * sx, 2.0f * (x * y - w * z) * sy, 2.0f * (x * z + w * y) * sz, quad.translation[0][lane]);
+			matrix.rows[1] = glm::vec4(2.0f * (x * y + w * z) * sx, (1.0f - 2.0f * (x * x + z * z)) * sy, 2.0f * (y * z - w * x) * sz, quad.translation[1][lane]);
+			matrix.rows[2] = glm::vec4(2.0f * (x * z - w * y) * sx, 2.0f * (y * z + w * x) * sy, (1.0f - 2.0f * (x * x + y * y)) * sz, quad.translation[2][lane]);
+		}
+	}
+
+	inline void multiply(const AffineMatrix& a, const AffineMatrix& b, AffineMatrix& result)
+	{
+		glm::vec4 b0 = b.rows[0], b1 = b.rows[1], b2 = b.rows[2];
+		for (int row = 0; row < 3; row++)
+		{
+			const glm::vec4& r = a.rows[row];
+			result.rows[row] = r.x * b0 + r.y * b1 + r.z * b2 + glm::vec4(0.0f, 0.0f, 0.0f, r.w);
+		}
+	}
+#endif
+}
+
+void AnimationPlayback::Play(uint32_t nextClip, float fadeSeconds)
+{
+	if (nextClip == clip)
+		return;
+
+	previousClip = clip;
+	previousTime = time;
+	previousWeight = fadeSeconds > 0.0f ? 1.0f : 0.0f;
+	fadeDuration = fadeSeconds;
+	clip = nextClip;
+	time = 0.0f;
+}
+
+void AnimationPlayback::Advance(float deltaTime, const AnimationSet& animations)
+{
+	const std::vector<AnimationClip>& clips = animations.clips;
+	if (clip < clips.size())
+		time = wrapTime(time + deltaTime * speed, clips[clip].duration);
+	if (previousWeight > 0.0f && previousClip < clips.size())
+	{
+		previousTime = wrapTime(previousTime + deltaTime * speed, clips[previousClip].duration);
+		previousWeight = fadeDuration > 0.0f ? std::max(previousWeight - deltaTime / fadeDuration, 0.0f) : 0.0f;
+	}
+}
+
+PoseEvaluator::PoseEvaluator(const AnimationSet& animations)
+	: animations(&animations)
+{
+	const Skeleton& skeleton = animations.skeleton;
+	size_t quads = skeleton.restPose.size();
+	for (Cursor& cursor : cursors)
+		cursor.keys.resize(skeleton.GetJointCount() * AnimationClip::ChannelCount);
+	for (Pose& pose : poses)
+		pose.resize(quads);
+	nextKeys.resize(quads);
+	factors.resize(quads);
+	jointMatrices.resize(quads * 4);
+}
+
+void PoseEvaluator::Evaluate(const AnimationPlayback& playback, const glm::mat4& root, AffineMatrix* palette)
+{
+	const Skeleton& skeleton = animations->skeleton;
+	const std::vector<AnimationClip>& clips = animations->clips;
+	size_t quads = skeleton.restPose.size();
+
+	Pose& pose = poses[0];
+	if (playback.clip < clips.size())
+	{
+		bool fading = playback.previousWeight > 0.0f && playback.previousClip < clips.size();
+		sample(playback.clip, playback.time, getCursor(playback.clip, fading ? playback.previousClip : InvalidClip), pose);
+		if (fading)
+		{
+			sample(playback.previousClip, playback.previousTime, getCursor(playback.previousClip, playback.clip), poses[1]);
+#if ANIMATION_SSE
+			__m128 weight = _mm_set1_ps(playback.previousWeight);
+			for (size_t quad = 0; quad < quads; quad++)
+				mixQuad(pose[quad], poses[1][quad], weight, weight, weight, pose[quad]);
+#else
+			const float weight[4] = { playback.previousWeight, playback.previousWeight, playback.previousWeight, playback.previousWeight };
+			for (size_t quad = 0; quad < quads; quad++)
+				mixQuad(pose[quad], poses[1][quad], weight, weight, weight, pose[quad]);
+#endif
+		}
+	}
+	else
+	{
+		pose = skeleton.restPose;
+	}
+
+	for (size_t quad = 0; quad < quads; quad++)
+		quadToMatrices(pose[quad], &jointMatrices[quad * 4]);
+
+	// parents come first, so every parent is already in model space when its children need it
+	AffineMatrix rootMatrix = AffineMatrix::FromMat4(root);
+	for (size_t joint = 0; joint < skeleton.GetJointCount(); joint++)
+	{
+		int32_t parent = skeleton.parents[joint];
+		multiply(parent < 0 ? rootMatrix : jointMatrices[parent], jointMatrices[joint], jointMatrices[joint]);
+	}
+
+	for (size_t entry = 0; entry < skeleton.GetPaletteSize(); entry++)
+		multiply(jointMatrices[skeleton.paletteJoints[entry]], skeleton.inverseBindMatrices[entry], palette[entry]);
+}
+
+PoseEvaluator::Cursor& PoseEvaluator::getCursor(uint32_t clip, uint32_t otherClip)
+{
+	for (Cursor& cursor : cursors)
+	{
+		if (cursor.clip == clip)
+			return cursor;
+	}
+	// never the one the other clip of a fade is using
+	return cursors[0].clip == otherClip ? cursors[1] : cursors[0];
+}
+
+void PoseEvaluator::sample(uint32_t clipIndex, float time, Cursor& cursor, Pose& pose)
+{
+	const Skeleton& skeleton = animations->skeleton;
+	const AnimationClip& clip = animations->clips[clipIndex];
+
+	// the cursors only ever move forward; anything else is searched from scratch
+	bool search = cursor.clip != clipIndex || time < cursor.time;
+	cursor.clip = clipIndex;
+	cursor.time = time;
+
+	// every lane starts at rest with nothing to interpolate, animated lanes are overwritten
+	pose = skeleton.restPose;
+	nextKeys = skeleton.restPose;
+	std::fill(factors.begin(), factors.end(), FactorQuad{});
+
+	for (size_t joint = 0; joint < skeleton.GetJointCount(); joint++)
+	{
+		JointQuad& from = pose[joint / 4];
+		JointQuad& to = nextKeys[joint / 4];
+		FactorQuad& factor = factors[joint / 4];
+		size_t lane = joint % 4;
+
+		for (int channel = 0; channel < AnimationClip::ChannelCount; channel++)
+		{
+			size_t trackIndex = joint * AnimationClip::ChannelCount + channel;
+			const AnimationClip::Track& track = clip.tracks[trackIndex];
+			if (track.keyCount == 0)
+				continue;
+
+			const float* times = &clip.times[track.firstKey];
+			uint32_t& key = cursor.keys[trackIndex];
+			if (search)
+			{
+				uint32_t after = static_cast<uint32_t>(std::upper_bound(times, times + track.keyCount, time) - times);
+				key = after > 0 ? after - 1 : 0;
+			}
+			else
+			{
+				while (key + 1 < track.keyCount && times[key + 1] <= time)
+					key++;
+			}
+			uint32_t next = std::min(key + 1, track.keyCount - 1);
+
+			float span = times[next] - times[key];
+			factor.channel[channel][lane] = span > 0.0f ? std::clamp((time - times[key]) / span, 0.0f, 1.0f) : 0.0f;
+
+			const glm::vec4& a = clip.values[track.firstKey + key];
+			const glm::vec4& b = clip.values[track.firstKey + next];
+			float (*fromLanes)[4] = channel == AnimationClip::Translation ? from.translation : channel == AnimationClip::Rotation ? from.rotation : from.scale;
+			float (*toLanes)[4] = channel == AnimationClip::Translation ? to.translation : channel == AnimationClip::Rotation ? to.rotation : to.scale;
+			int components = channel == AnimationClip::Rotation ? 4 : 3;
+			for (int axis = 0; axis < components; axis++)
+			{
+				fromLanes[axis][lane] = a[axis];
+				toLanes[axis][lane] = b[axis];
+			}
+		}
+	}
+
+	for (size_t quad = 0; quad < pose.size(); quad++)
+	{
+		const FactorQuad& factor = factors[quad];
+#if ANIMATION_SSE
+		mixQuad(pose[quad], nextKeys[quad], _mm_load_ps(factor.channel[AnimationClip::Translation]), _mm_load_ps(factor.channel[AnimationClip::Rotation]),
+			_mm_load_ps(factor.channel[AnimationClip::Scale]), pose[quad]);
+#else
+		mixQuad(pose[quad], nextKeys[quad], factor.channel[AnimationClip::Translation], factor.channel[AnimationClip::Rotation], factor.channel[AnimationClip::Scale], pose[quad]);
+#endif
+	}
+}
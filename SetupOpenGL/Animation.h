@@ -0,0 +1,179 @@
+#pragma once
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// An affine transform as the top three rows of its 4x4 matrix, 48 bytes instead of 64.
+// Skin palettes are stored and uploaded in this form; the shaders read three vec4s.
+struct AffineMatrix {
+	glm::vec4 rows[3];
+
+	static AffineMatrix FromMat4(const glm::mat4& matrix)
+	{
+		AffineMatrix affine;
+		for (int row = 0; row < 3; row++)
+			affine.rows[row] = glm::vec4(matrix[0][row], matrix[1][row], matrix[2][row], matrix[3][row]);
+		return affine;
+	}
+
+	glm::mat4 ToMat4() const
+	{
+		glm::mat4 matrix(1.0f);
+		for (int row = 0; row < 3; row++)
+		{
+			for (int column = 0; column < 4; column++)
+				matrix[column][row] = rows[row][column];
+		}
+		return matrix;
+	}
+};
+
+// The local transforms of four joints, one array per component, so blending them and
+// turning them into matrices handles four joints per SSE instruction. Rotations are
+// quaternions in x, y, z, w order.
+struct alignas(16) JointQuad {
+	float translation[3][4];
+	float rotation[4][4];
+	float scale[3][4];
+};
+
+// a whole skeleton's local transforms, (joints + 3) / 4 quads; lanes past the last joint
+// hold the identity so the kernels never see garbage
+using Pose = std::vector<JointQuad>;
+
+inline Pose MakeIdentityPose(size_t jointCount)
+{
+	JointQuad identity = {};
+	for (int lane = 0; lane < 4; lane++)
+	{
+		identity.rotation[3][lane] = 1.0f;
+		for (int axis = 0; axis < 3; axis++)
+			identity.scale[axis][lane] = 1.0f;
+	}
+	return Pose((jointCount + 3) / 4, identity);
+}
+
+inline void SetJointTransform(Pose& pose, size_t joint, const glm::vec3& translation, const glm::vec4& rotation, const glm::vec3& scale)
+{
+	JointQuad& quad = pose[joint / 4];
+	size_t lane = joint % 4;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		quad.translation[axis][lane] = translation[axis];
+		quad.scale[axis][lane] = scale[axis];
+	}
+	for (int axis = 0; axis < 4; axis++)
+		quad.rotation[axis][lane] = rotation[axis];
+}
+
+// The joints of a rig, parents before their children, and the skin palette that
+// SkinVertex::Joints index into. Palette entry i follows joint paletteJoints[i];
+// inverseBindMatrices[i] takes the mesh from its bind pose into that joint's space.
+struct Skeleton {
+	std::vector<std::string> names;
+	// -1 for a root
+	std::vector<int32_t> parents;
+	// the local transforms of the joints no clip animates
+	Pose restPose;
+	std::vector<uint32_t> paletteJoints;
+	std::vector<AffineMatrix> inverseBindMatrices;
+
+	size_t GetJointCount() const { return parents.size(); }
+	size_t GetPaletteSize() const { return paletteJoints.size(); }
+};
+
+// Keyframes of one clip. Every joint has a translation, a rotation and a scale track;
+// a track without keys leaves that part of the joint at its rest pose. The keys of all
+// tracks are stored back to back, times in seconds.
+struct AnimationClip {
+	enum Channel { Translation, Rotation, Scale, ChannelCount };
+
+	struct Track {
+		uint32_t firstKey = 0;
+		uint32_t keyCount = 0;
+	};
+
+	std::string name;
+	float duration = 0.0f;
+	// joint * ChannelCount + channel
+	std::vector<Track> tracks;
+	std::vector<float> times;
+	// xyz for translation and scale, xyzw for rotation
+	std::vector<glm::vec4> values;
+};
+
+// the skeleton of a rigged model and the clips that animate it
+struct AnimationSet {
+	Skeleton skeleton;
+	std::vector<AnimationClip> clips;
+};
+
+// What one character is playing and how far in, advanced by the simulation and copied
+// into the frame snapshot. Play cross-fades: the clip that was playing keeps running
+// while its weight falls from one to zero.
+struct AnimationPlayback {
+	uint32_t clip = 0;
+	float time = 0.0f;
+	float speed = 1.0f;
+	uint32_t previousClip = 0;
+	float previousTime = 0.0f;
+	// how much of the pose still comes from previousClip
+	float previousWeight = 0.0f;
+	float fadeDuration = 0.0f;
+
+	// a fade still running when the next one starts is cut short
+	void Play(uint32_t nextClip, float fadeSeconds);
+	// clips loop
+	void Advance(float deltaTime, const AnimationSet& animations);
+};
+
+// Turns an AnimationPlayback into a skin palette. Sampling keeps a cursor per track at
+// the key it stopped at, so playing forward steps a key or two instead of searching; a
+// clip that starts over or jumps back is searched once. Keys are interpolated and poses
+// blended four joints at a time with SSE where the target has SSE2: translation and
+// scale linearly, rotation by normalized lerp along the shorter arc, which is close
+// enough to slerp between keys this dense. The local matrices are built four at a time
+// as well and then multiplied down the hierarchy.
+//
+// One evaluator per character: it holds that character's cursors and scratch poses,
+// sized once for the set, so Evaluate never allocates and characters can be evaluated
+// as parallel jobs.
+class PoseEvaluator
+{
+public:
+	explicit PoseEvaluator(const AnimationSet& animations);
+
+	// writes GetPaletteSize entries, with root applied to every joint
+	void Evaluate(const AnimationPlayback& playback, const glm::mat4& root, AffineMatrix* palette);
+
+private:
+	static constexpr uint32_t InvalidClip = 0xFFFFFFFFu;
+
+	struct Cursor {
+		uint32_t clip = InvalidClip;
+		float time = 0.0f;
+		// per track, the last key at or before time
+		std::vector<uint32_t> keys;
+	};
+
+	// per-lane interpolation factors of the translation, rotation and scale channels
+	struct alignas(16) FactorQuad {
+		float channel[AnimationClip::ChannelCount][4];
+	};
+
+	const AnimationSet* animations;
+	Cursor cursors[2];
+	Pose poses[2];
+	// the key after each lane's current one while sampling
+	Pose nextKeys;
+	std::vector<FactorQuad> factors;
+	// local matrices, replaced by model-space ones down the hierarchy; padded to whole quads
+	std::vector<AffineMatrix> jointMatrices;
+
+	// the cursor last used for clip, or a free one
+	Cursor& getCursor(uint32_t clip, uint32_t otherClip);
+	void sample(uint32_t clip, float time, Cursor& cursor, Pose& pose);
+};
@@ -0,0 +1,360 @@
+#include "AnimationBenchmark.h"
+#include "Animation.h"
+#include "JobSystem.h"
+#include "Skinning.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <format>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace {
+	const size_t CharacterCounts[] = { 100, 500, 2000 };
+	const size_t JointCount = 64;
+	const size_t VertexCount = 4096;
+	const float FrameStep = 1.0f / 60.0f;
+	// every character whose vertices are compared with the reference
+	const size_t VertexCheckStride = 50;
+
+	glm::vec4 toVec4(const glm::quat& rotation)
+	{
+		return glm::vec4(rotation.x, rotation.y, rotation.z, rotation.w);
+	}
+
+	glm::mat4 localMatrix(const glm::vec4& translation, const glm::vec4& rotation, const glm::vec4& scale)
+	{
+		glm::quat quaternion(rotation.w, rotation.x, rotation.y, rotation.z);
+		return glm::translate(glm::mat4(1.0f), glm::vec3(translation)) * glm::mat4_cast(quaternion) * glm::scale(glm::mat4(1.0f), glm::vec3(scale));
+	}
+
+	// rest transforms of the procedural rig as translation, rotation, scale per joint
+	struct RestJoint {
+		glm::vec4 translation;
+		glm::vec4 rotation;
+		glm::vec4 scale;
+	};
+
+	// a binary tree of joints, each child a little up and to its side of its parent; two
+	// clips swing every joint at its own phase, some joints move and scale as well, some
+	// are left at rest, and every third rotation key is stored negated
+	AnimationSet makeAnimations(std::vector<RestJoint>& rest)
+	{
+		AnimationSet animations;
+		Skeleton& skeleton = animations.skeleton;
+		skeleton.restPose = MakeIdentityPose(JointCount);
+		rest.resize(JointCount);
+
+		std::vector<glm::mat4> bind(JointCount);
+		for (size_t joint = 0; joint < JointCount; joint++)
+		{
+			int32_t parent = joint == 0 ? -1 : static_cast<int32_t>((joint - 1) / 2);
+			float side = joint % 2 == 1 ? -1.0f : 1.0f;
+			RestJoint& restJoint = rest[joint];
+			restJoint.translation = joint == 0 ? glm::vec4(0.0f) : glm::vec4(side * 0.15f, 0.3f, 0.0f, 0.0f);
+			restJoint.rotation = joint == 0 ? glm::vec4(0.0f, 0.0f, 0.0f, 1.0f) : toVec4(glm::angleAxis(side * 0.2f, glm::vec3(0.0f, 0.0f, 1.0f)));
+			restJoint.scale = glm::vec4(1.0f, 1.0f, 1.0f, 0.0f);
+
+			skeleton.names.push_back(std::format("joint{}", joint));
+			skeleton.parents.push_back(parent);
+			SetJointTransform(skeleton.restPose, joint, glm::vec3(restJoint.translation), restJoint.rotation, glm::vec3(restJoint.scale));
+
+			glm::mat4 local = localMatrix(restJoint.translation, restJoint.rotation, restJoint.scale);
+			bind[joint] = parent < 0 ? local : bind[parent] * local;
+			skeleton.paletteJoints.push_back(static_cast<uint32_t>(joint));
+			skeleton.inverseBindMatrices.push_back(AffineMatrix::FromMat4(glm::inverse(bind[joint])));
+		}
+
+		for (int c = 0; c < 2; c++)
+		{
+			AnimationClip clip;
+			clip.name = std::format("clip{}", c);
+			clip.duration = 1.0f + 0.6f * c;
+			clip.tracks.resize(JointCount * AnimationClip::ChannelCount);
+
+			auto addTrack = [&](size_t joint, AnimationClip::Channel channel, int keyCount, auto value) {
+				clip.tracks[joint * AnimationClip::ChannelCount + channel] = { static_cast<uint32_t>(clip.times.size()), static_cast<uint32_t>(keyCount) };
+				for (int key = 0; key < keyCount; key++)
+				{
+					clip.times.push_back(clip.duration * key / (keyCount - 1));
+					clip.values.push_back(value(key, keyCount));
+				}
+			};
+
+			for (size_t joint = 0; joint < JointCount; joint++)
+			{
+				if (joint % 7 == 6)
+					continue;
+
+				float phase = joint * 0.3f + c;
+				glm::vec3 axis = glm::normalize(glm::vec3(std::sin(float(joint)), std::cos(joint * 1.3f), 0.5f));
+				glm::quat restRotation(rest[joint].rotation.w, rest[joint].rotation.x, rest[joint].rotation.y, rest[joint].rotation.z);
+				addTrack(joint, AnimationClip::Rotation, 9 + 4 * c, [&](int key, int keyCount) {
+					float angle = 0.5f * std::sin(6.2831853f * key / (keyCount - 1) + phase);
+					glm::vec4 rotation = toVec4(restRotation * glm::angleAxis(angle, axis));
+					return key % 3 == 2 ? -rotation : rotation;
+				});
+				if (joint % 3 == 0)
+				{
+					addTrack(joint, AnimationClip::Translation, 5, [&](int key, int) {
+						return rest[joint].translation + glm::vec4(0.0f, 0.05f * std::sin(key + phase), 0.0f, 0.0f);
+					});
+				}
+				if (joint % 8 == 0)
+				{
+					// uniform, so normals only need renormalizing
+					addTrack(joint, AnimationClip::Scale, 3, [&](int key, int) {
+						return glm::vec4(glm::vec3(1.0f + 0.1f * key), 0.0f);
+					});
+				}
+			}
+			animations.clips.push_back(std::move(clip));
+		}
+		return animations;
+	}
+
+	struct BenchmarkMesh {
+		std::vector<Vertex> vertices;
+		std::vector<SkinVertex> skin;
+	};
+
+	// vertices scattered over the rig's height, each weighted to four random joints
+	BenchmarkMesh makeMesh()
+	{
+		std::mt19937 random(1234);
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+		std::uniform_real_distribution<float> positive(0.05f, 1.0f);
+		std::uniform_int_distribution<int> joint(0, static_cast<int>(JointCount) - 1);
+
+		BenchmarkMesh mesh;
+		mesh.vertices.resize(VertexCount);
+		mesh.skin.resize(VertexCount);
+		for (size_t i = 0; i < VertexCount; i++)
+		{
+			Vertex& vertex = mesh.vertices[i];
+			vertex.Position = glm::vec3(unit(random), 1.0f + unit(random), unit(random) * 0.3f);
+			vertex.Normal = glm::normalize(glm::vec3(unit(random), unit(random), unit(random)) + glm::vec3(0.0f, 0.0f, 0.01f));
+			vertex.TexCoords = glm::vec2(unit(random), unit(random));
+
+			float weights[4];
+			float total = 0.0f;
+			for (int j = 0; j < 4; j++)
+				total += weights[j] = positive(random);
+			int sum = 0;
+			SkinVertex& skin = mesh.skin[i];
+			for (int j = 0; j < 4; j++)
+			{
+				skin.Joints[j] = static_cast<uint16_t>(joint(random));
+				skin.Weights[j] = static_cast<uint8_t>(weights[j] / total * 255.0f);
+				sum += skin.Weights[j];
+			}
+			skin.Weights[0] = static_cast<uint8_t>(skin.Weights[0] + 255 - sum);
+		}
+		return mesh;
+	}
+
+	// every character somewhere else in either clip, every third one halfway through a fade
+	std::vector<AnimationPlayback> makePlayback(size_t count, const AnimationSet& animations)
+	{
+		std::vector<AnimationPlayback> playback(count);
+		for (size_t i = 0; i < count; i++)
+		{
+			AnimationPlayback& character = playback[i];
+			character.speed = 0.8f + 0.1f * (i % 5);
+			character.clip = static_cast<uint32_t>(i % 2);
+			character.time = std::fmod(i * 0.37f, animations.clips[character.clip].duration);
+			if (i % 3 == 0)
+			{
+				character.previousClip = 1 - character.clip;
+				character.previousTime = std::fmod(i * 0.11f, animations.clips[character.previousClip].duration);
+				character.previousWeight = 0.5f;
+				character.fadeDuration = 1.0f;
+			}
+		}
+		return playback;
+	}
+
+	std::vector<glm::mat4> makeTransforms(size_t count)
+	{
+		std::vector<glm::mat4> transforms(count);
+		for (size_t i = 0; i < count; i++)
+		{
+			glm::mat4 transform = glm::translate(glm::mat4(1.0f), glm::vec3(float(i % 50) * 2.0f, 0.0f, float(i / 50) * 2.0f));
+			transforms[i] = glm::rotate(transform, i * 0.1f, glm::vec3(0.0f, 1.0f, 0.0f));
+		}
+		return transforms;
+	}
+
+	// the reference blend: lerp, or nlerp along the shorter arc for rotations
+	glm::vec4 mixValue(const glm::vec4& a, glm::vec4 b, float factor, bool rotation)
+	{
+		if (!rotation)
+			return a + (b - a) * factor;
+		if (glm::dot(a, b) < 0.0f)
+			b = -b;
+		return glm::normalize(a + (b - a) * factor);
+	}
+
+	glm::vec4 sampleReference(const AnimationClip& clip, size_t joint, AnimationClip::Channel channel, float time, const glm::vec4& rest)
+	{
+		const AnimationClip::Track& track = clip.tracks[joint * AnimationClip::ChannelCount + channel];
+		if (track.keyCount == 0)
+			return rest;
+		const float* times = &clip.times[track.firstKey];
+		size_t after = std::upper_bound(times, times + track.keyCount, time) - times;
+		size_t key = after > 0 ? after - 1 : 0;
+		size_t next = std::min<size_t>(key + 1, track.keyCount - 1);
+		float span = times[next] - times[key];
+		float factor = span > 0.0f ? std::clamp((time - times[key]) / span, 0.0f, 1.0f) : 0.0f;
+		return mixValue(clip.values[track.firstKey + key], clip.values[track.firstKey + next], factor, channel == AnimationClip::Rotation);
+	}
+
+	std::vector<glm::mat4> evaluateReference(const AnimationSet& animations, const std::vector<RestJoint>& rest, const AnimationPlayback& playback, const glm::mat4& root)
+	{
+		const Skeleton& skeleton = animations.skeleton;
+		bool fading = playback.previousWeight > 0.0f;
+		std::vector<glm::mat4> model(JointCount);
+		for (size_t joint = 0; joint < JointCount; joint++)
+		{
+			glm::vec4 channels[AnimationClip::ChannelCount];
+			const glm::vec4 restChannels[AnimationClip::ChannelCount] = { rest[joint].translation, rest[joint].rotation, rest[joint].scale };
+			for (int channel = 0; channel < AnimationClip::ChannelCount; channel++)
+			{
+				AnimationClip::Channel name = static_cast<AnimationClip::Channel>(channel);
+				channels[channel] = sampleReference(animations.clips[playback.clip], joint, name, playback.time, restChannels[channel]);
+				if (fading)
+				{
+					glm::vec4 previous = sampleReference(animations.clips[playback.previousClip], joint, name, playback.previousTime, restChannels[channel]);
+					channels[channel] = mixValue(channels[channel], previous, playback.previousWeight, channel == AnimationClip::Rotation);
+				}
+			}
+			glm::mat4 local = localMatrix(channels[AnimationClip::Translation], channels[AnimationClip::Rotation], channels[AnimationClip::Scale]);
+			int32_t parent = skeleton.parents[joint];
+			model[joint] = (parent < 0 ? root : model[parent]) * local;
+		}
+
+		std::vector<glm::mat4> palette(skeleton.GetPaletteSize());
+		for (size_t entry = 0; entry < palette.size(); entry++)
+			palette[entry] = model[skeleton.paletteJoints[entry]] * skeleton.inverseBindMatrices[entry].ToMat4();
+		return palette;
+	}
+
+	// largest difference relative to the magnitude of what is compared, at least one
+	float relativeError(const glm::vec4& value, const glm::vec4& reference)
+	{
+		glm::vec4 difference = glm::abs(value - reference);
+		float magnitude = std::max(1.0f, std::max(std::max(std::abs(reference.x), std::abs(reference.y)), std::max(std::abs(reference.z), std::abs(reference.w))));
+		return std::max(std::max(difference.x, difference.y), std::max(difference.z, difference.w)) / magnitude;
+	}
+
+	float checkVertices(const BenchmarkMesh& mesh, const std::vector<glm::mat4>& palette, const std::vector<PositionVertex>& positions, const std::vector<SurfaceVertex>& surfaces)
+	{
+		float error = 0.0f;
+		for (size_t i = 0; i < VertexCount; i++)
+		{
+			glm::mat4 blend(0.0f);
+			for (int j = 0; j < 4; j++)
+				blend += palette[mesh.skin[i].Joints[j]] * (mesh.skin[i].Weights[j] / 255.0f);
+			glm::vec3 position = glm::vec3(blend * glm::vec4(mesh.vertices[i].Position, 1.0f));
+			glm::vec3 normal = glm::normalize(glm::mat3(blend) * mesh.vertices[i].Normal);
+			error = std::max(error, relativeError(glm::vec4(positions[i].Position, 0.0f), glm::vec4(position, 0.0f)));
+			error = std::max(error, relativeError(glm::vec4(surfaces[i].Normal, 0.0f), glm::vec4(normal, 0.0f)));
+		}
+		return error;
+	}
+
+	double median(std::vector<double> values)
+	{
+		std::sort(values.begin(), values.end());
+		return values[values.size() / 2];
+	}
+}
+
+int RunAnimationBenchmark(int iterations)
+{
+	std::vector<RestJoint> rest;
+	const AnimationSet animations = makeAnimations(rest);
+	const BenchmarkMesh mesh = makeMesh();
+	const size_t paletteSize = animations.skeleton.GetPaletteSize();
+	// nlerp against nlerp, so only float rounding separates the two
+	const float tolerance = 1e-3f;
+
+	int poolSize = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+	size_t failures = 0;
+	std::cout << "Skeletal animation, " << JointCount << " joints, " << VertexCount << " vertices per character, median of " << iterations << " frames" << std::endl;
+	for (size_t count : CharacterCounts)
+	{
+		std::vector<glm::mat4> transforms = makeTransforms(count);
+		for (int threads : { 1, poolSize })
+		{
+			JobSystem::Shutdown();
+			JobSystem::Initialize(threads - 1);
+
+			std::vector<AnimationPlayback> playback = makePlayback(count, animations);
+			std::vector<PoseEvaluator> evaluators(count, PoseEvaluator(animations));
+			std::vector<AffineMatrix> palettes(count * paletteSize);
+			std::vector<double> poseTimes, skinTimes;
+			for (int i = 0; i < iterations; i++)
+			{
+				for (AnimationPlayback& character : playback)
+					character.Advance(FrameStep, animations);
+
+				auto start = std::chrono::steady_clock::now();
+				JobSystem::ParallelFor(count, 16, [&](size_t begin, size_t end) {
+					for (size_t c = begin; c < end; c++)
+						evaluators[c].Evaluate(playback[c], transforms[c], &palettes[c * paletteSize]);
+				});
+				auto posed = std::chrono::steady_clock::now();
+				JobSystem::ParallelFor(count, 2, [&](size_t begin, size_t end) {
+					// one character's vertices at a time, each thread into its own, as the
+					// renderer's stream would take them
+					thread_local std::vector<PositionVertex> positions(VertexCount);
+					thread_local std::vector<SurfaceVertex> surfaces(VertexCount);
+					for (size_t c = begin; c < end; c++)
+						SkinVertices(mesh.vertices.data(), mesh.skin.data(), VertexCount, &palettes[c * paletteSize], positions.data(), surfaces.data());
+				});
+				auto skinned = std::chrono::steady_clock::now();
+				poseTimes.push_back(std::chrono::duration<double, std::milli>(posed - start).count());
+				skinTimes.push_back(std::chrono::duration<double, std::milli>(skinned - posed).count());
+			}
+
+			float paletteError = 0.0f, vertexError = 0.0f;
+			std::vector<PositionVertex> positions(VertexCount);
+			std::vector<SurfaceVertex> surfaces(VertexCount);
+			for (size_t c = 0; c < count; c++)
+			{
+				std::vector<glm::mat4> reference = evaluateReference(animations, rest, playback[c], transforms[c]);
+				const AffineMatrix* palette = &palettes[c * paletteSize];
+				for (size_t entry = 0; entry < paletteSize; entry++)
+				{
+					AffineMatrix expected = AffineMatrix::FromMat4(reference[entry]);
+					for (int row = 0; row < 3; row++)
+						paletteError = std::max(paletteError, relativeError(palette[entry].rows[row], expected.rows[row]));
+				}
+				if (c % VertexCheckStride == 0)
+				{
+					SkinVertices(mesh.vertices.data(), mesh.skin.data(), VertexCount, palette, positions.data(), surfaces.data());
+					vertexError = std::max(vertexError, checkVertices(mesh, reference, positions, surfaces));
+				}
+			}
+			bool passed = paletteError <= tolerance && vertexError <= tolerance;
+			if (!passed)
+				failures++;
+
+			std::cout << std::format("{:>5} characters, {:>2} threads: poses {:>8.3f} ms, skinning {:>8.3f} ms, palette error {:.1e}, vertex error {:.1e}{}",
+				count, threads, median(poseTimes), median(skinTimes), paletteError, vertexError, passed ? "" : ", too far from the reference") << std::endl;
+			if (threads == poolSize)
+				break;
+		}
+	}
+
+	JobSystem::Shutdown();
+	JobSystem::Initialize();
+	return failures == 0 ? 0 : 1;
+}
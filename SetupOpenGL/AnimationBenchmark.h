@@ -0,0 +1,9 @@
+#pragma once
+
+// --animation-benchmark: evaluates the poses of a crowd of procedural 64-joint characters
+// and skins a 4096-vertex mesh for each on the CPU, from a hundred characters to two
+// thousand, once with every job on the calling thread and once on the full job system.
+// Palettes and skinned vertices are checked against a plain glm implementation that
+// searches every key and multiplies 4x4 matrices. Needs no GL context. Returns main's
+// exit code.
+int RunAnimationBenchmark(int iterations);
@@ -0,0 +1,27 @@
+#include "CameraBuffer.h"
+#include "GLState.h"
+
+#include <cstring>
+
+CameraBuffer::CameraBuffer(StreamBuffer& stream)
+	: stream(stream)
+{
+	block.Projection = block.View = block.ViewProjection = glm::mat4(1.0f);
+	block.Position = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+}
+
+void CameraBuffer::Update(const glm::mat4& projection, const glm::mat4& view, const glm::vec3& position)
+{
+	block.Projection = projection;
+	block.View = view;
+	block.ViewProjection = projection * view;
+	block.Position = glm::vec4(position, 1.0f);
+
+	StreamAllocation range = stream.Allocate(sizeof(CameraBlock), stream.GetUniformAlignment());
+	if (!range.IsValid())
+		return;
+
+	std::memcpy(range.data, &block, sizeof(CameraBlock));
+	stream.Commit(range);
+	GLState::BindBufferRange(GL_UNIFORM_BUFFER, BlockBinding, stream.GetBuffer(), range.offset, range.size);
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "StreamBuffer.h"
+
+// std140 layout of the "Camera" uniform block shared by every shader
+struct CameraBlock {
+	glm::mat4 Projection;
+	glm::mat4 View;
+	glm::mat4 ViewProjection;
+	glm::vec4 Position;
+};
+
+// Per-frame camera matrices in one uniform block, written once per frame instead of
+// being set on every program by name. Each frame's copy is streamed into a new range,
+// so updating it never waits for the previous frame's draws.
+class CameraBuffer
+{
+public:
+	static constexpr GLuint BlockBinding = 0;
+
+	explicit CameraBuffer(StreamBuffer& stream);
+
+	CameraBuffer(const CameraBuffer&) = delete;
+	CameraBuffer& operator=(const CameraBuffer&) = delete;
+
+	// call after StreamBuffer::BeginFrame; binds the new range at BlockBinding
+	void Update(const glm::mat4& projection, const glm::mat4& view, const glm::vec3& position);
+	const CameraBlock& GetBlock() const { return block; }
+
+private:
+	StreamBuffer& stream;
+	CameraBlock block;
+};
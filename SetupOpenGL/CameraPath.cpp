@@ -0,0 +1,83 @@
+#include "CameraPath.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+CameraPath::CameraPath()
+{
+	// from the spawn point past the instanced props to the medkit, then back out
+	keys = {
+		{ 0.0f, glm::vec3(0.0f, 1.0f, 3.0f), -90.0f, 0.0f },
+		{ 3.0f, glm::vec3(12.0f, 1.0f, 2.0f), -20.0f, -10.0f },
+		{ 6.0f, glm::vec3(24.0f, 2.0f, 8.0f), -60.0f, -25.0f },
+		{ 8.0f, glm::vec3(26.0f, 1.5f, 3.0f), 0.0f, -15.0f },
+		{ 12.0f, glm::vec3(4.0f, 3.0f, 10.0f), -135.0f, 5.0f },
+	};
+}
+
+bool CameraPath::Load(const std::string& path)
+{
+	std::ifstream stream(path);
+	if (!stream)
+	{
+		std::cout << "Failed to open camera path '" << path << "'" << std::endl;
+		return false;
+	}
+
+	std::vector<CameraKey> loaded;
+	std::string line;
+	while (std::getline(stream, line))
+	{
+		line = line.substr(0, line.find('#'));
+		if (line.find_first_not_of(" \t\r") == std::string::npos)
+			continue;
+
+		CameraKey key;
+		std::istringstream fields(line);
+		if (!(fields >> key.time >> key.position.x >> key.position.y >> key.position.z >> key.yaw >> key.pitch))
+		{
+			std::cout << "Camera path '" << path << "': cannot read '" << line << "'" << std::endl;
+			return false;
+		}
+		loaded.push_back(key);
+	}
+	if (loaded.empty())
+	{
+		std::cout << "Camera path '" << path << "' has no keys" << std::endl;
+		return false;
+	}
+
+	std::stable_sort(loaded.begin(), loaded.end(), [](const CameraKey& a, const CameraKey& b) { return a.time < b.time; });
+	keys = std::move(loaded);
+	return true;
+}
+
+void CameraPath::Evaluate(float time, glm::vec3& position, glm::vec3& front) const
+{
+	auto next = std::upper_bound(keys.begin(), keys.end(), time, [](float t, const CameraKey& key) { return t < key.time; });
+
+	float yaw, pitch;
+	if (next == keys.begin() || next == keys.end())
+	{
+		const CameraKey& key = next == keys.begin() ? keys.front() : keys.back();
+		position = key.position;
+		yaw = key.yaw;
+		pitch = key.pitch;
+	}
+	else
+	{
+		const CameraKey& a = *(next - 1);
+		const CameraKey& b = *next;
+		float t = (time - a.time) / (b.time - a.time);
+		position = glm::mix(a.position, b.position, t);
+		yaw = glm::mix(a.yaw, b.yaw, t);
+		pitch = glm::mix(a.pitch, b.pitch, t);
+	}
+
+	front.x = cos(glm::radians(pitch)) * cos(glm::radians(yaw));
+	front.y = sin(glm::radians(pitch));
+	front.z = cos(glm::radians(pitch)) * sin(glm::radians(yaw));
+	front = glm::normalize(front);
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+struct CameraKey {
+	float time;       // seconds
+	glm::vec3 position;
+	float yaw;        // degrees, as the mouse look uses them
+	float pitch;
+};
+
+// A scripted camera for repeatable runs: keyframes interpolated linearly, held at the
+// last key once the path has ended.
+class CameraPath
+{
+public:
+	// a walk through the default scene
+	CameraPath();
+
+	// one key per line, "time x y z yaw pitch"; '#' starts a comment
+	bool Load(const std::string& path);
+
+	void Evaluate(float time, glm::vec3& position, glm::vec3& front) const;
+	float GetDuration() const { return keys.empty() ? 0.0f : keys.back().time; }
+
+private:
+	std::vector<CameraKey> keys;
+};
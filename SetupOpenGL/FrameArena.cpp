@@ -0,0 +1,74 @@
+#include "FrameArena.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <new>
+
+namespace {
+	thread_local FrameArena* threadArena = nullptr;
+
+	constexpr size_t BufferAlignment = alignof(std::max_align_t);
+}
+
+FrameArena::FrameArena(size_t capacity)
+	: buffer(static_cast<std::byte*>(::operator new(capacity, std::align_val_t(BufferAlignment)))), capacity(capacity)
+{
+	// so the first overflow of a frame does not allocate its own bookkeeping
+	overflow.reserve(16);
+}
+
+FrameArena::~FrameArena()
+{
+	Reset();
+	if (threadArena == this)
+		threadArena = nullptr;
+	::operator delete(buffer, std::align_val_t(BufferAlignment));
+}
+
+void FrameArena::Reset()
+{
+	for (const auto& [memory, alignment] : overflow)
+		::operator delete(memory, std::align_val_t(alignment));
+	overflow.clear();
+
+	if (overflowBytes > 0)
+	{
+		// the grown buffer is allocated here, between frames, once
+		size_t grown = capacity + overflowBytes + overflowBytes / 2;
+		::operator delete(buffer, std::align_val_t(BufferAlignment));
+		buffer = static_cast<std::byte*>(::operator new(grown, std::align_val_t(BufferAlignment)));
+		capacity = grown;
+		overflowBytes = 0;
+	}
+	used = 0;
+}
+
+void FrameArena::MakeCurrent()
+{
+	threadArena = this;
+}
+
+std::pmr::memory_resource* FrameArena::GetThreadResource()
+{
+	return threadArena ? static_cast<std::pmr::memory_resource*>(threadArena) : std::pmr::new_delete_resource();
+}
+
+void* FrameArena::do_allocate(size_t bytes, size_t alignment)
+{
+	uintptr_t base = reinterpret_cast<uintptr_t>(buffer);
+	uintptr_t start = (base + used + alignment - 1) & ~(static_cast<uintptr_t>(alignment) - 1);
+	size_t end = static_cast<size_t>(start - base) + bytes;
+	if (end <= capacity)
+	{
+		used = end;
+		peak = std::max(peak, used + overflowBytes);
+		return reinterpret_cast<void*>(start);
+	}
+
+	void* memory = ::operator new(bytes, std::align_val_t(alignment));
+	overflow.emplace_back(memory, alignment);
+	overflowBytes += bytes;
+	overflowCount++;
+	peak = std::max(peak, used + overflowBytes);
+	return memory;
+}
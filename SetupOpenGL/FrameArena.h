@@ -0,0 +1,51 @@
+#pragma once
+#include <cstddef>
+#include <memory_resource>
+#include <vector>
+
+// Bump allocator for data that only lives until the end of the frame. Allocating is an
+// aligned pointer bump, deallocating does nothing, and Reset at the end of the frame
+// frees everything at once. It is a std::pmr::memory_resource, so std::pmr containers
+// can be pointed at it for transient per-frame data.
+//
+// An arena belongs to one thread. MakeCurrent installs it as that thread's resource, and
+// code that does not know which thread it runs on asks GetThreadResource, which falls
+// back to the heap on threads without an arena (the job workers, for one).
+//
+// A frame that outgrows the arena takes the rest from the heap and is counted as an
+// overflow; the next Reset grows the arena to fit, so only the first such frame allocates.
+class FrameArena : public std::pmr::memory_resource
+{
+public:
+	explicit FrameArena(size_t capacity);
+	~FrameArena() override;
+
+	FrameArena(const FrameArena&) = delete;
+	FrameArena& operator=(const FrameArena&) = delete;
+
+	// everything allocated since the last Reset is gone
+	void Reset();
+
+	void MakeCurrent();
+	static std::pmr::memory_resource* GetThreadResource();
+
+	size_t GetCapacity() const { return capacity; }
+	size_t GetUsed() const { return used; }
+	// the most any frame has used, overflow included
+	size_t GetPeak() const { return peak; }
+	unsigned int GetOverflowCount() const { return overflowCount; }
+
+private:
+	std::byte* buffer;
+	size_t capacity;
+	size_t used = 0;
+	size_t peak = 0;
+	// heap blocks taken this frame after the buffer ran out
+	std::vector<std::pair<void*, size_t>> overflow;
+	size_t overflowBytes = 0;
+	unsigned int overflowCount = 0;
+
+	void* do_allocate(size_t bytes, size_t alignment) override;
+	void do_deallocate(void*, size_t, size_t) override {}
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+};
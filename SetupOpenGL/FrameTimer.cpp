@@ -0,0 +1,111 @@
+#include "FrameTimer.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+
+FrameTimer::FrameTimer(bool gpuTimes)
+	: timerQueries(gpuTimes && GLAD_GL_VERSION_3_3 != 0)
+{
+	std::fill(std::begin(pending), std::end(pending), -1);
+	if (timerQueries)
+		glGenQueries(Latency, queries);
+}
+
+FrameTimer::~FrameTimer()
+{
+	if (timerQueries)
+		glDeleteQueries(Latency, queries);
+}
+
+void FrameTimer::BeginFrame()
+{
+	int frame = static_cast<int>(frames.size());
+	int slot = frame % Latency;
+	if (timerQueries)
+	{
+		// the slot's previous frame was issued Latency frames ago
+		collect(slot);
+		glBeginQuery(GL_TIME_ELAPSED, queries[slot]);
+		pending[slot] = frame;
+	}
+	frames.push_back({ 0.0, -1.0 });
+	start = std::chrono::steady_clock::now();
+}
+
+void FrameTimer::EndFrame()
+{
+	if (timerQueries)
+		glEndQuery(GL_TIME_ELAPSED);
+	frames.back().cpuMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void FrameTimer::Finish()
+{
+	for (int slot = 0; slot < Latency; slot++)
+		collect(slot);
+}
+
+void FrameTimer::collect(int slot)
+{
+	if (pending[slot] < 0)
+		return;
+
+	GLuint64 elapsed = 0;
+	glGetQueryObjectui64v(queries[slot], GL_QUERY_RESULT, &elapsed);
+	frames[pending[slot]].gpuMilliseconds = elapsed / 1.0e6;
+	pending[slot] = -1;
+}
+
+void FrameTimer::PrintSummary() const
+{
+	if (frames.empty())
+		return;
+
+	auto summary = [](const char* label, std::vector<double> values) {
+		if (values.empty())
+		{
+			std::cout << label << ": not measured" << std::endl;
+			return;
+		}
+		std::sort(values.begin(), values.end());
+		double mean = std::accumulate(values.begin(), values.end(), 0.0) / values.size();
+		size_t p95 = std::min(values.size() - 1, static_cast<size_t>(values.size() * 0.95));
+		std::cout << std::fixed << std::setprecision(3) << label << " ms: min " << values.front() << ", median " << values[values.size() / 2]
+			<< ", mean " << mean << ", p95 " << values[p95] << ", max " << values.back() << std::endl;
+		std::cout.unsetf(std::ios::floatfield);
+	};
+
+	std::vector<double> cpu, gpu;
+	for (const FrameTime& frame : frames)
+	{
+		cpu.push_back(frame.cpuMilliseconds);
+		if (frame.gpuMilliseconds >= 0.0)
+			gpu.push_back(frame.gpuMilliseconds);
+	}
+	std::cout << frames.size() << " frames" << std::endl;
+	summary("CPU", cpu);
+	summary("GPU", gpu);
+}
+
+bool FrameTimer::WriteCSV(const std::string& path) const
+{
+	std::ofstream stream(path, std::ios::trunc);
+	if (!stream)
+	{
+		std::cout << "Failed to write frame times '" << path << "'" << std::endl;
+		return false;
+	}
+
+	stream << std::fixed << std::setprecision(4) << "frame,cpu_ms,gpu_ms\n";
+	for (size_t i = 0; i < frames.size(); i++)
+	{
+		stream << i << "," << frames[i].cpuMilliseconds << ",";
+		if (frames[i].gpuMilliseconds >= 0.0)
+			stream << frames[i].gpuMilliseconds;
+		stream << "\n";
+	}
+	return static_cast<bool>(stream);
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <glad/glad.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+struct FrameTime {
+	double cpuMilliseconds;
+	// negative when the GPU time is unknown
+	double gpuMilliseconds;
+};
+
+// Per-frame CPU and GPU times for benchmark runs. The CPU time covers BeginFrame to
+// EndFrame; the GPU time is a GL_TIME_ELAPSED query over the same commands, read back
+// Latency frames later so measuring does not serialise CPU and GPU.
+class FrameTimer
+{
+public:
+	static constexpr int Latency = 4;
+
+	// gpuTimes is false where timer queries have nothing to measure, e.g. the null backend
+	explicit FrameTimer(bool gpuTimes = true);
+	~FrameTimer();
+
+	FrameTimer(const FrameTimer&) = delete;
+	FrameTimer& operator=(const FrameTimer&) = delete;
+
+	// makes room for count more frames, so recording them does not allocate
+	void Reserve(size_t count) { frames.reserve(frames.size() + count); }
+
+	void BeginFrame();
+	void EndFrame();
+	// waits for the results still in flight; call before reading the times
+	void Finish();
+
+	const std::vector<FrameTime>& GetFrames() const { return frames; }
+
+	// min, median, mean, 95th percentile and max of both columns
+	void PrintSummary() const;
+	// "frame,cpu_ms,gpu_ms", one row per frame
+	bool WriteCSV(const std::string& path) const;
+
+private:
+	GLuint queries[Latency] = {};
+	// frame index each query slot is measuring, -1 if idle
+	int pending[Latency];
+	bool timerQueries;
+	std::chrono::steady_clock::time_point start;
+	std::vector<FrameTime> frames;
+
+	void collect(int slot);
+};
@@ -0,0 +1,63 @@
+#include "Framebuffer.h"
+#include "GLState.h"
+
+#include <iostream>
+
+Framebuffer::Framebuffer(int width, int height)
+	: width(width), height(height)
+{
+	if (GLAD_GL_VERSION_4_5)
+	{
+		glCreateRenderbuffers(1, &colorBuffer);
+		glNamedRenderbufferStorage(colorBuffer, GL_RGBA8, width, height);
+		glCreateRenderbuffers(1, &depthBuffer);
+		glNamedRenderbufferStorage(depthBuffer, GL_DEPTH24_STENCIL8, width, height);
+
+		glCreateFramebuffers(1, &framebuffer);
+		glNamedFramebufferRenderbuffer(framebuffer, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+		glNamedFramebufferRenderbuffer(framebuffer, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+		complete = glCheckNamedFramebufferStatus(framebuffer, GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+	}
+	else
+	{
+		glGenRenderbuffers(1, &colorBuffer);
+		glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+		glGenRenderbuffers(1, &depthBuffer);
+		glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+		glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+		glGenFramebuffers(1, &framebuffer);
+		GLState::BindFramebuffer(framebuffer);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+		complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+	}
+
+	if (!complete)
+		std::cout << "Framebuffer " << width << "x" << height << " is incomplete" << std::endl;
+}
+
+Framebuffer::~Framebuffer()
+{
+	GLState::DeleteFramebuffer(framebuffer);
+	glDeleteRenderbuffers(1, &colorBuffer);
+	glDeleteRenderbuffers(1, &depthBuffer);
+}
+
+void Framebuffer::Bind() const
+{
+	GLState::BindFramebuffer(framebuffer);
+	glViewport(0, 0, width, height);
+}
+
+void Framebuffer::ReadPixels(std::vector<unsigned char>& pixels) const
+{
+	pixels.resize(static_cast<size_t>(width) * height * 4);
+
+	GLState::BindFramebuffer(framebuffer);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadBuffer(GL_COLOR_ATTACHMENT0);
+	glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+}
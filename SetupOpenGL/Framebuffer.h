@@ -0,0 +1,34 @@
+#pragma once
+#include <glad/glad.h>
+
+#include <vector>
+
+// An offscreen render target: an RGBA8 colour and a depth/stencil renderbuffer.
+// Headless runs render into one instead of a window's default framebuffer.
+class Framebuffer
+{
+public:
+	Framebuffer(int width, int height);
+	~Framebuffer();
+
+	Framebuffer(const Framebuffer&) = delete;
+	Framebuffer& operator=(const Framebuffer&) = delete;
+
+	bool IsComplete() const { return complete; }
+
+	// binds for drawing and reading and sets the viewport to cover it
+	void Bind() const;
+	// waits for the frame and copies the colour attachment, bottom row first, 4 bytes per pixel
+	void ReadPixels(std::vector<unsigned char>& pixels) const;
+
+	int GetWidth() const { return width; }
+	int GetHeight() const { return height; }
+
+private:
+	int width;
+	int height;
+	GLuint framebuffer = 0;
+	GLuint colorBuffer = 0;
+	GLuint depthBuffer = 0;
+	bool complete = false;
+};
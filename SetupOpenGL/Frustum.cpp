@@ -0,0 +1,38 @@
+#include "Frustum.h"
+
+Frustum::Frustum(const glm::mat4& viewProjection)
+{
+	// Gribb/Hartmann: each plane is the fourth row plus or minus one of the others
+	glm::mat4 m = glm::transpose(viewProjection);
+	planes[0] = m[3] + m[0];
+	planes[1] = m[3] - m[0];
+	planes[2] = m[3] + m[1];
+	planes[3] = m[3] - m[1];
+	planes[4] = m[3] + m[2];
+	planes[5] = m[3] - m[2];
+
+	for (glm::vec4& plane : planes)
+		plane /= glm::length(glm::vec3(plane));
+}
+
+bool Frustum::IntersectsBox(const glm::vec3& center, const glm::vec3& extents) const
+{
+	for (const glm::vec4& plane : planes)
+	{
+		glm::vec3 normal(plane);
+		// how far the box reaches towards the plane's normal
+		float radius = glm::dot(extents, glm::abs(normal));
+		if (glm::dot(normal, center) + plane.w < -radius)
+			return false;
+	}
+	return true;
+}
+
+bool Frustum::IntersectsBox(const glm::vec3& center, const glm::vec3& extents, const glm::mat4& model) const
+{
+	glm::vec3 worldCenter = glm::vec3(model * glm::vec4(center, 1.0f));
+	// the world-space box around the transformed one
+	glm::mat3 axes(model);
+	glm::vec3 worldExtents = glm::abs(axes[0]) * extents.x + glm::abs(axes[1]) * extents.y + glm::abs(axes[2]) * extents.z;
+	return IntersectsBox(worldCenter, worldExtents);
+}
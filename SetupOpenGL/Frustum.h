@@ -0,0 +1,21 @@
+#pragma once
+#include <glm/glm.hpp>
+
+// The six planes of a view volume, normals pointing inwards.
+class Frustum
+{
+public:
+	Frustum() = default;
+	// planes of projection * view, in world space
+	explicit Frustum(const glm::mat4& viewProjection);
+
+	// false only if the box lies entirely outside one of the planes; boxes near a corner
+	// may pass without being visible
+	bool IntersectsBox(const glm::vec3& center, const glm::vec3& extents) const;
+	// the same test for an object-space box placed by model
+	bool IntersectsBox(const glm::vec3& center, const glm::vec3& extents, const glm::mat4& model) const;
+
+private:
+	// xyz normal, w distance
+	glm::vec4 planes[6] = {};
+};
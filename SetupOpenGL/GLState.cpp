@@ -0,0 +1,360 @@
+#include "GLState.h"
+
+namespace {
+	constexpr GLuint Unknown = 0xFFFFFFFFu;
+	constexpr int BufferTargetCount = 6;
+	constexpr int IndexedTargetCount = 2;
+
+	struct IndexedBinding {
+		GLuint buffer;
+		GLintptr offset;
+		GLsizeiptr size;
+
+		bool operator!=(const IndexedBinding& other) const
+		{
+			return buffer != other.buffer || offset != other.offset || size != other.size;
+		}
+	};
+
+	struct TextureBinding {
+		GLenum target;
+		GLuint texture;
+
+		bool operator!=(const TextureBinding& other) const
+		{
+			return target != other.target || texture != other.texture;
+		}
+	};
+
+	// everything starts unknown; -1 marks an unknown capability
+	struct Cache {
+		GLuint program;
+		GLuint vao;
+		GLuint buffers[BufferTargetCount];
+		IndexedBinding indexed[IndexedTargetCount][GLState::MaxBufferBindings];
+		GLuint activeUnit;
+		TextureBinding textures[GLState::MaxTextureUnits];
+		GLuint samplers[GLState::MaxTextureUnits];
+		GLuint framebuffer;
+
+		int depthTest;
+		int depthWrite;
+		int colorWrite;
+		int blend;
+		int cullFace;
+		GLenum depthFunc;
+		GLenum blendSource;
+		GLenum blendDestination;
+	};
+
+	Cache cache;
+	bool cacheReady = false;
+
+	Cache& state()
+	{
+		if (!cacheReady)
+			GLState::Invalidate();
+		return cache;
+	}
+}
+
+GLStateStats GLState::current;
+GLStateStats GLState::lastFrame;
+
+template<typename T>
+bool GLState::change(T& cached, T value)
+{
+	if (!(cached != value))
+	{
+		current.elided++;
+		return false;
+	}
+	cached = value;
+	current.issued++;
+	return true;
+}
+
+int GLState::bufferTarget(GLenum target)
+{
+	switch (target)
+	{
+	case GL_ARRAY_BUFFER: return 0;
+	case GL_ELEMENT_ARRAY_BUFFER: return 1;
+	case GL_UNIFORM_BUFFER: return 2;
+	case GL_SHADER_STORAGE_BUFFER: return 3;
+	case GL_DRAW_INDIRECT_BUFFER: return 4;
+	case GL_COPY_WRITE_BUFFER: return 5;
+	default: return -1;
+	}
+}
+
+int GLState::indexedTarget(GLenum target)
+{
+	switch (target)
+	{
+	case GL_UNIFORM_BUFFER: return 0;
+	case GL_SHADER_STORAGE_BUFFER: return 1;
+	default: return -1;
+	}
+}
+
+void GLState::UseProgram(GLuint program)
+{
+	if (change(state().program, program))
+		glUseProgram(program);
+}
+
+void GLState::BindVertexArray(GLuint vao)
+{
+	if (change(state().vao, vao))
+	{
+		glBindVertexArray(vao);
+		// the element buffer binding belongs to the vertex array
+		cache.buffers[bufferTarget(GL_ELEMENT_ARRAY_BUFFER)] = Unknown;
+	}
+}
+
+void GLState::BindBuffer(GLenum target, GLuint buffer)
+{
+	int slot = bufferTarget(target);
+	if (slot < 0)
+	{
+		current.issued++;
+		glBindBuffer(target, buffer);
+		return;
+	}
+	if (change(state().buffers[slot], buffer))
+		glBindBuffer(target, buffer);
+}
+
+void GLState::BindBufferBase(GLenum target, GLuint index, GLuint buffer)
+{
+	int slot = indexedTarget(target);
+	if (slot < 0 || index >= MaxBufferBindings)
+	{
+		current.issued++;
+		glBindBufferBase(target, index, buffer);
+		return;
+	}
+
+	// a size of 0 stands for the whole buffer
+	if (change(state().indexed[slot][index], IndexedBinding{ buffer, 0, 0 }))
+	{
+		glBindBufferBase(target, index, buffer);
+		// also replaces the generic binding of the target
+		cache.buffers[bufferTarget(target)] = buffer;
+	}
+}
+
+void GLState::BindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+{
+	int slot = indexedTarget(target);
+	if (slot < 0 || index >= MaxBufferBindings)
+	{
+		current.issued++;
+		glBindBufferRange(target, index, buffer, offset, size);
+		return;
+	}
+
+	if (change(state().indexed[slot][index], IndexedBinding{ buffer, offset, size }))
+	{
+		glBindBufferRange(target, index, buffer, offset, size);
+		cache.buffers[bufferTarget(target)] = buffer;
+	}
+}
+
+void GLState::BindTexture(GLuint unit, GLenum target, GLuint texture)
+{
+	if (unit >= MaxTextureUnits)
+	{
+		current.issued += 2;
+		glActiveTexture(GL_TEXTURE0 + unit);
+		glBindTexture(target, texture);
+		state().activeUnit = unit;
+		return;
+	}
+
+	// one cached target per unit; binding another target there forgets the old one
+	if (!change(state().textures[unit], TextureBinding{ target, texture }))
+		return;
+
+	if (cache.activeUnit != unit)
+	{
+		current.issued++;
+		glActiveTexture(GL_TEXTURE0 + unit);
+		cache.activeUnit = unit;
+	}
+	glBindTexture(target, texture);
+}
+
+void GLState::BindSampler(GLuint unit, GLuint sampler)
+{
+	if (unit >= MaxTextureUnits)
+	{
+		current.issued++;
+		glBindSampler(unit, sampler);
+		return;
+	}
+	if (change(state().samplers[unit], sampler))
+		glBindSampler(unit, sampler);
+}
+
+void GLState::BindFramebuffer(GLuint framebuffer)
+{
+	if (change(state().framebuffer, framebuffer))
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+}
+
+void GLState::setCapability(GLenum capability, int& cached, bool enabled)
+{
+	if (!change(cached, enabled ? 1 : 0))
+		return;
+	if (enabled)
+		glEnable(capability);
+	else
+		glDisable(capability);
+}
+
+void GLState::SetDepthTest(bool enabled)
+{
+	setCapability(GL_DEPTH_TEST, state().depthTest, enabled);
+}
+
+void GLState::SetDepthWrite(bool enabled)
+{
+	if (change(state().depthWrite, enabled ? 1 : 0))
+		glDepthMask(enabled ? GL_TRUE : GL_FALSE);
+}
+
+void GLState::SetDepthFunc(GLenum func)
+{
+	if (change(state().depthFunc, func))
+		glDepthFunc(func);
+}
+
+void GLState::SetColorWrite(bool enabled)
+{
+	GLboolean mask = enabled ? GL_TRUE : GL_FALSE;
+	if (change(state().colorWrite, enabled ? 1 : 0))
+		glColorMask(mask, mask, mask, mask);
+}
+
+void GLState::SetBlend(bool enabled)
+{
+	setCapability(GL_BLEND, state().blend, enabled);
+}
+
+void GLState::SetBlendFunc(GLenum source, GLenum destination)
+{
+	Cache& c = state();
+	if (c.blendSource == source && c.blendDestination == destination)
+	{
+		current.elided++;
+		return;
+	}
+	c.blendSource = source;
+	c.blendDestination = destination;
+	current.issued++;
+	glBlendFunc(source, destination);
+}
+
+void GLState::SetCullFace(bool enabled)
+{
+	setCapability(GL_CULL_FACE, state().cullFace, enabled);
+}
+
+void GLState::DeleteProgram(GLuint program)
+{
+	if (program == 0)
+		return;
+	// a program in use stays alive until it is unbound; only the cached name has to go
+	if (state().program == program)
+		cache.program = Unknown;
+	glDeleteProgram(program);
+}
+
+void GLState::DeleteVertexArray(GLuint vao)
+{
+	if (vao == 0)
+		return;
+	if (state().vao == vao)
+	{
+		cache.vao = 0;
+		cache.buffers[bufferTarget(GL_ELEMENT_ARRAY_BUFFER)] = Unknown;
+	}
+	glDeleteVertexArrays(1, &vao);
+}
+
+void GLState::DeleteBuffer(GLuint buffer)
+{
+	if (buffer == 0)
+		return;
+
+	// deleting a bound buffer reverts its bindings to 0
+	Cache& c = state();
+	for (GLuint& bound : c.buffers)
+	{
+		if (bound == buffer)
+			bound = 0;
+	}
+	for (auto& target : c.indexed)
+	{
+		for (IndexedBinding& binding : target)
+		{
+			if (binding.buffer == buffer)
+				binding = IndexedBinding{ Unknown, 0, 0 };
+		}
+	}
+	glDeleteBuffers(1, &buffer);
+}
+
+void GLState::DeleteTexture(GLuint texture)
+{
+	if (texture == 0)
+		return;
+
+	for (TextureBinding& binding : state().textures)
+	{
+		if (binding.texture == texture)
+			binding.texture = 0;
+	}
+	glDeleteTextures(1, &texture);
+}
+
+void GLState::DeleteFramebuffer(GLuint framebuffer)
+{
+	if (framebuffer == 0)
+		return;
+	if (state().framebuffer == framebuffer)
+		cache.framebuffer = 0;
+	glDeleteFramebuffers(1, &framebuffer);
+}
+
+void GLState::Invalidate()
+{
+	cache.program = Unknown;
+	cache.vao = Unknown;
+	for (GLuint& buffer : cache.buffers)
+		buffer = Unknown;
+	for (auto& target : cache.indexed)
+	{
+		for (IndexedBinding& binding : target)
+			binding = IndexedBinding{ Unknown, 0, 0 };
+	}
+	cache.activeUnit = Unknown;
+	for (TextureBinding& binding : cache.textures)
+		binding = TextureBinding{ GL_NONE, Unknown };
+	for (GLuint& sampler : cache.samplers)
+		sampler = Unknown;
+	cache.framebuffer = Unknown;
+
+	cache.depthTest = cache.depthWrite = cache.colorWrite = cache.blend = cache.cullFace = -1;
+	cache.depthFunc = cache.blendSource = cache.blendDestination = GL_NONE;
+	cacheReady = true;
+}
+
+void GLState::EndFrame()
+{
+	lastFrame = current;
+	current = GLStateStats();
+}
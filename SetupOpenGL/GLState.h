@@ -0,0 +1,66 @@
+#pragma once
+#include <glad/glad.h>
+
+struct GLStateStats {
+	// calls forwarded to the driver and calls dropped because the state was already set
+	unsigned int issued = 0;
+	unsigned int elided = 0;
+};
+
+// Shadow of the bindings and fixed-function state the renderer touches. Every bind goes
+// through here; a call that would not change anything never reaches the driver.
+// Cached values start out unknown, so the first call of each kind is always issued.
+// Objects have to be deleted through the Delete functions so a recycled name is never
+// mistaken for one that is still bound.
+class GLState
+{
+public:
+	static constexpr int MaxTextureUnits = 32;
+	static constexpr int MaxBufferBindings = 16;
+
+	static void UseProgram(GLuint program);
+	static void BindVertexArray(GLuint vao);
+	// GL_ARRAY_BUFFER, GL_ELEMENT_ARRAY_BUFFER, GL_UNIFORM_BUFFER, GL_SHADER_STORAGE_BUFFER,
+	// GL_DRAW_INDIRECT_BUFFER and GL_COPY_WRITE_BUFFER are tracked, other targets pass through
+	static void BindBuffer(GLenum target, GLuint buffer);
+	static void BindBufferBase(GLenum target, GLuint index, GLuint buffer);
+	static void BindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+	// switches the active unit only when the binding actually changes
+	static void BindTexture(GLuint unit, GLenum target, GLuint texture);
+	static void BindSampler(GLuint unit, GLuint sampler);
+	// GL_FRAMEBUFFER only, draw and read together
+	static void BindFramebuffer(GLuint framebuffer);
+
+	static void SetDepthTest(bool enabled);
+	static void SetDepthWrite(bool enabled);
+	static void SetDepthFunc(GLenum func);
+	// all four channels together
+	static void SetColorWrite(bool enabled);
+	static void SetBlend(bool enabled);
+	static void SetBlendFunc(GLenum source, GLenum destination);
+	static void SetCullFace(bool enabled);
+
+	static void DeleteProgram(GLuint program);
+	static void DeleteVertexArray(GLuint vao);
+	static void DeleteBuffer(GLuint buffer);
+	static void DeleteTexture(GLuint texture);
+	static void DeleteFramebuffer(GLuint framebuffer);
+
+	// forget everything, e.g. after code outside the renderer changed GL state
+	static void Invalidate();
+
+	// closes the frame's counters; GetFrameStats returns the last closed frame
+	static void EndFrame();
+	static const GLStateStats& GetFrameStats() { return lastFrame; }
+
+private:
+	static GLStateStats current;
+	static GLStateStats lastFrame;
+
+	// true and counted as issued if value differs from cached, which then takes it
+	template<typename T>
+	static bool change(T& cached, T value);
+	static int bufferTarget(GLenum target);
+	static int indexedTarget(GLenum target);
+	static void setCapability(GLenum capability, int& cached, bool enabled);
+};
@@ -0,0 +1,120 @@
+#include "GeometryPool.h"
+#include "GLState.h"
+#include "VertexLayout.h"
+#include "Profiler.h"
+
+GeometryPool::GeometryPool()
+{
+	if (GLAD_GL_VERSION_4_5)
+	{
+		glCreateVertexArrays(1, &VAO);
+		glCreateVertexArrays(1, &depthVAO);
+		glCreateBuffers(1, &VBO);
+		glCreateBuffers(1, &EBO);
+		return;
+	}
+
+	glGenVertexArrays(1, &VAO);
+	glGenVertexArrays(1, &depthVAO);
+	glGenBuffers(1, &VBO);
+	glGenBuffers(1, &EBO);
+}
+
+GeometryPool::~GeometryPool()
+{
+	GLState::DeleteVertexArray(VAO);
+	GLState::DeleteVertexArray(depthVAO);
+	GLState::DeleteBuffer(VBO);
+	GLState::DeleteBuffer(EBO);
+}
+
+void GeometryPool::Add(Mesh& mesh)
+{
+	MeshRange range;
+	range.firstIndex = static_cast<unsigned int>(indices.size());
+	range.indexCount = static_cast<unsigned int>(mesh.indices.size());
+	range.baseVertex = static_cast<int>(vertices.size());
+
+	vertices.insert(vertices.end(), mesh.vertices.begin(), mesh.vertices.end());
+	indices.insert(indices.end(), mesh.indices.begin(), mesh.indices.end());
+
+	mesh.SetPoolRange(range);
+}
+
+void GeometryPool::Upload()
+{
+	PROFILE_SCOPE("GeometryPool::Upload");
+	if (GLAD_GL_VERSION_4_5)
+		uploadImmutable();
+	else
+		uploadMutable();
+
+	// the GPU copy is all the pool needs from here on
+	vertices = std::vector<Vertex>();
+	indices = std::vector<unsigned int>();
+}
+
+void GeometryPool::uploadImmutable()
+{
+	std::vector<unsigned char> streams;
+	size_t surfaceOffset = WriteVertexStreams(vertices, streams);
+	glNamedBufferStorage(VBO, streams.size(), streams.data(), 0);
+	glNamedBufferStorage(EBO, indices.size() * sizeof(unsigned int), indices.data(), 0);
+
+	glVertexArrayVertexBuffer(VAO, VertexBinding, VBO, 0, sizeof(PositionVertex));
+	glVertexArrayVertexBuffer(VAO, SurfaceBinding, VBO, surfaceOffset, sizeof(SurfaceVertex));
+	glVertexArrayElementBuffer(VAO, EBO);
+	SetVertexArrayFormat<PositionVertex>(VAO, VertexBinding);
+	SetVertexArrayFormat<SurfaceVertex>(VAO, SurfaceBinding);
+
+	glVertexArrayVertexBuffer(depthVAO, VertexBinding, VBO, 0, sizeof(PositionVertex));
+	glVertexArrayElementBuffer(depthVAO, EBO);
+	SetVertexArrayFormat<PositionVertex>(depthVAO, VertexBinding);
+}
+
+void GeometryPool::uploadMutable()
+{
+	std::vector<unsigned char> streams;
+	size_t surfaceOffset = WriteVertexStreams(vertices, streams);
+
+	GLState::BindVertexArray(VAO);
+
+	GLState::BindBuffer(GL_ARRAY_BUFFER, VBO);
+	glBufferData(GL_ARRAY_BUFFER, streams.size(), streams.data(), GL_STATIC_DRAW);
+
+	GLState::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+
+	SetVertexAttribPointers<PositionVertex>();
+	SetVertexAttribPointers<SurfaceVertex>(surfaceOffset);
+
+	GLState::BindVertexArray(depthVAO);
+	GLState::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+	SetVertexAttribPointers<PositionVertex>();
+
+	GLState::BindVertexArray(0);
+}
+
+void GeometryPool::SetDrawIDBuffer(GLuint buffer)
+{
+	// the depth pass needs the draw id as well, to find each draw's transform
+	for (GLuint vao : { VAO, depthVAO })
+	{
+		if (GLAD_GL_VERSION_4_5)
+		{
+			glVertexArrayVertexBuffer(vao, DrawIDBinding, buffer, 0, sizeof(GLuint));
+			glVertexArrayBindingDivisor(vao, DrawIDBinding, 1);
+			glEnableVertexArrayAttrib(vao, DrawIDLocation);
+			glVertexArrayAttribIFormat(vao, DrawIDLocation, 1, GL_UNSIGNED_INT, 0);
+			glVertexArrayAttribBinding(vao, DrawIDLocation, DrawIDBinding);
+			continue;
+		}
+
+		GLState::BindVertexArray(vao);
+		GLState::BindBuffer(GL_ARRAY_BUFFER, buffer);
+		glEnableVertexAttribArray(DrawIDLocation);
+		glVertexAttribIPointer(DrawIDLocation, 1, GL_UNSIGNED_INT, sizeof(GLuint), (void*)0);
+		glVertexAttribDivisor(DrawIDLocation, 1);
+		GLState::BindVertexArray(0);
+	}
+}
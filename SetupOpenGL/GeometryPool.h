@@ -0,0 +1,48 @@
+#pragma once
+#include <glad/glad.h>
+
+#include <vector>
+
+#include "Mesh.h"
+
+// Packs the geometry of many meshes into one vertex/index buffer pair behind a single
+// VAO, so they can be drawn by multi-draw indirect without rebinding.
+class GeometryPool
+{
+public:
+	// location of the draw id input of shaders that read from the pool
+	static constexpr GLuint DrawIDLocation = VertexAttribute::DrawID;
+
+	GeometryPool();
+	~GeometryPool();
+
+	GeometryPool(const GeometryPool&) = delete;
+	GeometryPool& operator=(const GeometryPool&) = delete;
+
+	// appends the mesh to the pool and records its range in the mesh
+	void Add(Mesh& mesh);
+	// uploads everything added so far; call once after the last Add
+	void Upload();
+
+	GLuint GetVAO() const { return VAO; }
+	// positions and draw ids only, for depth-only passes
+	GLuint GetDepthVAO() const { return depthVAO; }
+
+	// binds a buffer of sequential draw ids as an instanced attribute, so that
+	// baseInstance of each indirect command selects the per-draw data
+	void SetDrawIDBuffer(GLuint buffer);
+
+private:
+	// vertex buffer binding points of the VAOs, the same as Mesh uses
+	static constexpr GLuint VertexBinding = 0;
+	static constexpr GLuint DrawIDBinding = 1;
+	static constexpr GLuint SurfaceBinding = 2;
+
+	GLuint VAO = 0, depthVAO = 0, VBO = 0, EBO = 0;
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+
+	// immutable storage and attribute formats set without binding, GL 4.5
+	void uploadImmutable();
+	void uploadMutable();
+};
@@ -0,0 +1,173 @@
+#include "HeadlessContext.h"
+
+#if defined(__linux__)
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#else
+#include <SDL.h>
+#endif
+
+HeadlessContext::~HeadlessContext()
+{
+	Destroy();
+}
+
+#if defined(__linux__)
+
+bool HeadlessContext::Create()
+{
+	// the surfaceless platform works without X, Wayland or a render node
+	auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+	EGLDisplay eglDisplay = EGL_NO_DISPLAY;
+	if (getPlatformDisplay)
+		eglDisplay = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+	if (eglDisplay == EGL_NO_DISPLAY)
+		eglDisplay = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+	EGLint major = 0, minor = 0;
+	if (eglDisplay == EGL_NO_DISPLAY || !eglInitialize(eglDisplay, &major, &minor))
+	{
+		error = "no EGL display";
+		return false;
+	}
+	display = eglDisplay;
+	initialized = true;
+
+	if (!eglBindAPI(EGL_OPENGL_API))
+	{
+		error = "EGL cannot create desktop GL contexts";
+		Destroy();
+		return false;
+	}
+
+	if (!createContext(4, 6) && !createContext(3, 3))
+	{
+		Destroy();
+		return false;
+	}
+	return true;
+}
+
+bool HeadlessContext::createContext(int major, int minor)
+{
+	EGLDisplay eglDisplay = static_cast<EGLDisplay>(display);
+
+	const EGLint configAttributes[] = {
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_ALPHA_SIZE, 8,
+		EGL_NONE
+	};
+	// a surfaceless context does not need a config if the driver allows that
+	EGLConfig config = nullptr;
+	EGLint configCount = 0;
+	if (!eglChooseConfig(eglDisplay, configAttributes, &config, 1, &configCount) || configCount == 0)
+		config = nullptr;
+
+	const EGLint contextAttributes[] = {
+		EGL_CONTEXT_MAJOR_VERSION, major,
+		EGL_CONTEXT_MINOR_VERSION, minor,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+	EGLContext eglContext = eglCreateContext(eglDisplay, config, EGL_NO_CONTEXT, contextAttributes);
+	if (eglContext == EGL_NO_CONTEXT)
+	{
+		error = "no GL " + std::to_string(major) + "." + std::to_string(minor) + " core context";
+		return false;
+	}
+	context = eglContext;
+
+	if (!eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, eglContext))
+	{
+		error = "surfaceless contexts are not supported";
+		eglDestroyContext(eglDisplay, eglContext);
+		context = nullptr;
+		return false;
+	}
+	return true;
+}
+
+void HeadlessContext::Destroy()
+{
+	if (!initialized)
+		return;
+
+	EGLDisplay eglDisplay = static_cast<EGLDisplay>(display);
+	eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	if (context)
+		eglDestroyContext(eglDisplay, static_cast<EGLContext>(context));
+	eglTerminate(eglDisplay);
+	context = nullptr;
+	display = nullptr;
+	initialized = false;
+}
+
+void* HeadlessContext::GetProcAddress(const char* name)
+{
+	// EGL 1.5 resolves core GL entry points as well as extensions
+	return reinterpret_cast<void*>(eglGetProcAddress(name));
+}
+
+#else
+
+bool HeadlessContext::Create()
+{
+	if (SDL_InitSubSystem(SDL_INIT_VIDEO) != 0)
+	{
+		error = SDL_GetError();
+		return false;
+	}
+	initialized = true;
+
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+	window = SDL_CreateWindow("3D Scene Viewer", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, 16, 16, SDL_WINDOW_OPENGL | SDL_WINDOW_HIDDEN);
+	if (!window)
+	{
+		error = SDL_GetError();
+		Destroy();
+		return false;
+	}
+
+	if (!createContext(4, 6) && !createContext(3, 3))
+	{
+		Destroy();
+		return false;
+	}
+	return true;
+}
+
+bool HeadlessContext::createContext(int major, int minor)
+{
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, major);
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, minor);
+	context = SDL_GL_CreateContext(static_cast<SDL_Window*>(window));
+	if (!context)
+	{
+		error = SDL_GetError();
+		return false;
+	}
+	SDL_GL_MakeCurrent(static_cast<SDL_Window*>(window), static_cast<SDL_GLContext>(context));
+	return true;
+}
+
+void HeadlessContext::Destroy()
+{
+	if (!initialized)
+		return;
+
+	if (context)
+		SDL_GL_DeleteContext(static_cast<SDL_GLContext>(context));
+	if (window)
+		SDL_DestroyWindow(static_cast<SDL_Window*>(window));
+	SDL_QuitSubSystem(SDL_INIT_VIDEO);
+	context = nullptr;
+	window = nullptr;
+	initialized = false;
+}
+
+void* HeadlessContext::GetProcAddress(const char* name)
+{
+	return SDL_GL_GetProcAddress(name);
+}
+
+#endif
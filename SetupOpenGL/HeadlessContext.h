@@ -0,0 +1,34 @@
+#pragma once
+#include <string>
+
+// A GL context with no window. On Linux it is an EGL context on Mesa's surfaceless
+// platform, which needs neither a display server nor a GPU (llvmpipe renders it); other
+// platforms fall back to a hidden SDL window. Nothing is drawn to a default framebuffer,
+// so rendering has to target a Framebuffer.
+class HeadlessContext
+{
+public:
+	HeadlessContext() = default;
+	~HeadlessContext();
+
+	HeadlessContext(const HeadlessContext&) = delete;
+	HeadlessContext& operator=(const HeadlessContext&) = delete;
+
+	// asks for a 4.6 core context and settles for 3.3; makes it current
+	bool Create();
+	void Destroy();
+
+	const std::string& GetError() const { return error; }
+	// for gladLoadGLLoader
+	static void* GetProcAddress(const char* name);
+
+private:
+	// EGLDisplay/EGLContext, or SDL_Window/SDL_GLContext; kept opaque so callers need neither header
+	void* display = nullptr;
+	void* context = nullptr;
+	void* window = nullptr;
+	bool initialized = false;
+	std::string error;
+
+	bool createContext(int major, int minor);
+};
@@ -0,0 +1,121 @@
+#include "ImageWriter.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+namespace {
+	uint32_t crc32(const unsigned char* data, size_t size, uint32_t crc = 0)
+	{
+		static uint32_t table[256];
+		static bool tableReady = false;
+		if (!tableReady)
+		{
+			for (uint32_t i = 0; i < 256; i++)
+			{
+				uint32_t value = i;
+				for (int bit = 0; bit < 8; bit++)
+					value = value & 1 ? 0xEDB88320u ^ (value >> 1) : value >> 1;
+				table[i] = value;
+			}
+			tableReady = true;
+		}
+
+		crc = ~crc;
+		for (size_t i = 0; i < size; i++)
+			crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+		return ~crc;
+	}
+
+	void putBigEndian(std::vector<unsigned char>& out, uint32_t value)
+	{
+		out.push_back(static_cast<unsigned char>(value >> 24));
+		out.push_back(static_cast<unsigned char>(value >> 16));
+		out.push_back(static_cast<unsigned char>(value >> 8));
+		out.push_back(static_cast<unsigned char>(value));
+	}
+
+	void writeChunk(std::ofstream& stream, const char* type, const std::vector<unsigned char>& data)
+	{
+		std::vector<unsigned char> chunk;
+		chunk.reserve(data.size() + 12);
+		putBigEndian(chunk, static_cast<uint32_t>(data.size()));
+		chunk.insert(chunk.end(), type, type + 4);
+		chunk.insert(chunk.end(), data.begin(), data.end());
+		// the CRC covers the type and the data, not the length
+		putBigEndian(chunk, crc32(chunk.data() + 4, chunk.size() - 4));
+		stream.write(reinterpret_cast<const char*>(chunk.data()), chunk.size());
+	}
+}
+
+bool WritePNG(const std::string& path, int width, int height, int components, const unsigned char* pixels, bool flipVertically)
+{
+	if (width <= 0 || height <= 0 || (components != 3 && components != 4))
+		return false;
+
+	std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+	if (!stream)
+	{
+		std::cout << "Failed to write image '" << path << "'" << std::endl;
+		return false;
+	}
+
+	const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	stream.write(reinterpret_cast<const char*>(signature), sizeof(signature));
+
+	std::vector<unsigned char> header;
+	putBigEndian(header, width);
+	putBigEndian(header, height);
+	header.push_back(8);                          // bit depth
+	header.push_back(components == 4 ? 6 : 2);    // colour type, RGBA or RGB
+	header.push_back(0);                          // deflate
+	header.push_back(0);                          // adaptive filtering
+	header.push_back(0);                          // no interlace
+	writeChunk(stream, "IHDR", header);
+
+	// every scanline starts with its filter type, 0 for none
+	size_t rowSize = static_cast<size_t>(width) * components;
+	std::vector<unsigned char> raw;
+	raw.reserve((rowSize + 1) * height);
+	for (int y = 0; y < height; y++)
+	{
+		int row = flipVertically ? height - 1 - y : y;
+		const unsigned char* source = pixels + row * rowSize;
+		raw.push_back(0);
+		raw.insert(raw.end(), source, source + rowSize);
+	}
+
+	// a zlib stream of stored deflate blocks, at most 65535 bytes each
+	std::vector<unsigned char> data;
+	const size_t maxBlock = 65535;
+	data.reserve(raw.size() + raw.size() / maxBlock * 5 + 16);
+	data.push_back(0x78);
+	data.push_back(0x01);
+	uint32_t adlerA = 1, adlerB = 0;
+	size_t offset = 0;
+	do
+	{
+		size_t size = std::min(maxBlock, raw.size() - offset);
+		bool last = offset + size == raw.size();
+		data.push_back(last ? 1 : 0);
+		data.push_back(static_cast<unsigned char>(size));
+		data.push_back(static_cast<unsigned char>(size >> 8));
+		data.push_back(static_cast<unsigned char>(~size));
+		data.push_back(static_cast<unsigned char>(~size >> 8));
+		data.insert(data.end(), raw.begin() + offset, raw.begin() + offset + size);
+
+		for (size_t i = offset; i < offset + size; i++)
+		{
+			adlerA = (adlerA + raw[i]) % 65521;
+			adlerB = (adlerB + adlerA) % 65521;
+		}
+		offset += size;
+	} while (offset < raw.size());
+	putBigEndian(data, (adlerB << 16) | adlerA);
+	writeChunk(stream, "IDAT", data);
+
+	writeChunk(stream, "IEND", {});
+	return static_cast<bool>(stream);
+}
@@ -0,0 +1,7 @@
+#pragma once
+#include <string>
+
+// Writes 8-bit RGBA or RGB pixels as a PNG. The image data is stored without compression,
+// which keeps the writer tiny and fast; the files are for inspection and diffing, not
+// distribution. flipVertically takes rows bottom first, as glReadPixels returns them.
+bool WritePNG(const std::string& path, int width, int height, int components, const unsigned char* pixels, bool flipVertically);
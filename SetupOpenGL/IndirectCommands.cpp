@@ -0,0 +1,38 @@
+#include "IndirectCommands.h"
+
+void IndirectCommandList::Clear()
+{
+	commands.clear();
+	drawData.clear();
+	batches.clear();
+}
+
+void BuildIndirectCommands(const std::vector<IndirectDraw>& draws, IndirectCommandList& list)
+{
+	list.Clear();
+	list.commands.reserve(draws.size());
+	list.drawData.reserve(draws.size());
+
+	for (const IndirectDraw& draw : draws)
+	{
+		GLuint commandIndex = static_cast<GLuint>(list.commands.size());
+
+		DrawElementsIndirectCommand command;
+		command.count = draw.range.indexCount;
+		command.instanceCount = 1;
+		command.firstIndex = draw.range.firstIndex;
+		command.baseVertex = draw.range.baseVertex;
+		command.baseInstance = commandIndex;
+		list.commands.push_back(command);
+
+		list.drawData.push_back({ draw.transformIndex, draw.materialIndex });
+
+		if (list.batches.empty()
+			|| list.batches.back().program != draw.program
+			|| list.batches.back().material != draw.material)
+		{
+			list.batches.push_back({ draw.program, draw.material, commandIndex, 0 });
+		}
+		list.batches.back().commandCount++;
+	}
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <glad/glad.h>
+
+#include <vector>
+
+#include "Mesh.h"
+
+class Material;
+
+// layout mandated by glMultiDrawElementsIndirect
+struct DrawElementsIndirectCommand {
+	GLuint count;
+	GLuint instanceCount;
+	GLuint firstIndex;
+	GLint baseVertex;
+	GLuint baseInstance;
+};
+
+// std430 per-draw record, indexed in the shader by the command's baseInstance
+struct DrawData {
+	GLuint transformIndex;
+	GLuint materialIndex;
+};
+
+struct IndirectDraw {
+	MeshRange range;
+	GLuint transformIndex;
+	GLuint materialIndex;
+	GLuint program;
+	const Material* material;
+};
+
+// consecutive commands that share program and textures, submitted as one multi-draw
+struct IndirectBatch {
+	GLuint program;
+	const Material* material;
+	GLuint firstCommand;
+	GLuint commandCount;
+};
+
+struct IndirectCommandList {
+	std::vector<DrawElementsIndirectCommand> commands;
+	std::vector<DrawData> drawData;
+	std::vector<IndirectBatch> batches;
+
+	void Clear();
+};
+
+// Turns an already sorted list of draws into indirect commands, per-draw data and
+// batches. Only touches CPU memory, so it can run without a GL context.
+void BuildIndirectCommands(const std::vector<IndirectDraw>& draws, IndirectCommandList& list);
@@ -0,0 +1,195 @@
+#include "IndirectRenderer.h"
+#include "GLState.h"
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+
+IndirectRenderer::IndirectRenderer(Shader& shader, GeometryPool& pool, StreamBuffer& stream)
+	: shader(shader), pool(pool), stream(stream)
+{
+	// always 4.5 here in practice, but the pool only needs the names to be real objects
+	if (GLAD_GL_VERSION_4_5)
+	{
+		glCreateBuffers(1, &commandBuffer);
+		glCreateBuffers(1, &drawDataBuffer);
+		glCreateBuffers(1, &materialBuffer);
+		glCreateBuffers(1, &drawIDBuffer);
+	}
+	else
+	{
+		glGenBuffers(1, &commandBuffer);
+		glGenBuffers(1, &drawDataBuffer);
+		glGenBuffers(1, &materialBuffer);
+		glGenBuffers(1, &drawIDBuffer);
+	}
+
+	pool.SetDrawIDBuffer(drawIDBuffer);
+}
+
+IndirectRenderer::~IndirectRenderer()
+{
+	GLState::DeleteBuffer(commandBuffer);
+	GLState::DeleteBuffer(drawDataBuffer);
+	GLState::DeleteBuffer(materialBuffer);
+	GLState::DeleteBuffer(drawIDBuffer);
+}
+
+bool IndirectRenderer::CanSubmit(const std::vector<RenderPacket>& packets) const
+{
+	for (const RenderPacket& packet : packets)
+	{
+		if (!packet.mesh->IsPooled() || packet.transformIndex == TransformBuffer::InvalidIndex)
+			return false;
+	}
+	return true;
+}
+
+void IndirectRenderer::Submit(const std::vector<RenderPacket>& packets, bool depthPrepass)
+{
+	draws.clear();
+
+	GLuint program = shader.GetRendererID();
+	for (const RenderPacket& packet : packets)
+	{
+		IndirectDraw draw;
+		draw.range = packet.mesh->GetPoolRange();
+		draw.transformIndex = packet.transformIndex;
+		draw.material = packet.mesh->material.get();
+		draw.materialIndex = addMaterial(draw.material);
+		draw.program = program;
+		draws.push_back(draw);
+	}
+
+	BuildIndirectCommands(draws, commandList);
+	if (commandList.commands.empty())
+		return;
+
+	GLintptr commandOffset = uploadBuffers();
+
+	// one command per packet, so the opaque packets are the leading commands; without
+	// materials they all go out as a single multi-draw
+	GLuint commandCount = static_cast<GLuint>(commandList.commands.size());
+	GLuint opaqueCount = static_cast<GLuint>(RenderQueue::CountOpaque(packets));
+	bool prepassed = depthPrepass && depthShader && opaqueCount > 0;
+	if (prepassed)
+	{
+		RenderQueue::BeginDepthPrepass();
+		GLState::BindVertexArray(pool.GetDepthVAO());
+		GLState::UseProgram(depthShader->GetRendererID());
+		drawCommands(commandOffset, 0, opaqueCount);
+		RenderQueue::BeginPrepassedShading();
+	}
+
+	GLState::BindVertexArray(pool.GetVAO());
+	GLState::BindBufferBase(GL_SHADER_STORAGE_BUFFER, MaterialBinding, materialBuffer);
+
+	GLuint boundProgram = 0;
+	for (const IndirectBatch& batch : commandList.batches)
+	{
+		if (batch.program != boundProgram)
+		{
+			GLState::UseProgram(batch.program);
+			boundProgram = batch.program;
+		}
+		if (batch.material)
+			batch.material->Bind();
+
+		// a batch can run from the last opaque packets into the first transparent ones
+		GLuint end = batch.firstCommand + batch.commandCount;
+		GLuint split = std::clamp(opaqueCount, batch.firstCommand, end);
+		drawCommands(commandOffset, batch.firstCommand, split - batch.firstCommand);
+		if (split == opaqueCount && split < end)
+		{
+			RenderQueue::BeginTransparent();
+			prepassed = false;
+		}
+		drawCommands(commandOffset, split, end - split);
+	}
+	if (prepassed)
+		RenderQueue::EndPrepassedShading();
+	if (opaqueCount < commandCount)
+		RenderQueue::EndTransparent();
+}
+
+void IndirectRenderer::drawCommands(GLintptr commandOffset, GLuint first, GLuint count) const
+{
+	if (count == 0)
+		return;
+
+	const void* offset = (const void*)(commandOffset + first * sizeof(DrawElementsIndirectCommand));
+	glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, offset, count, 0);
+}
+
+GLuint IndirectRenderer::addMaterial(const Material* material)
+{
+	if (!material)
+		return 0;
+
+	// material ids are small and stable, so they index the parameter buffer directly
+	GLuint index = material->GetID();
+	if (index >= materialParameters.size())
+	{
+		materialParameters.resize(index + 1, MaterialParameters{});
+		materialWritten.resize(index + 1, false);
+	}
+	if (!materialWritten[index])
+	{
+		materialParameters[index] = material->GetParameters();
+		materialWritten[index] = true;
+		materialsDirty = true;
+	}
+	return index;
+}
+
+GLintptr IndirectRenderer::uploadBuffers()
+{
+	const IndirectCommandList& list = commandList;
+	const GLsizeiptr commandBytes = list.commands.size() * sizeof(DrawElementsIndirectCommand);
+	const GLsizeiptr drawDataBytes = list.drawData.size() * sizeof(DrawData);
+
+	GLintptr commandOffset = 0;
+	StreamAllocation commandRange = stream.Allocate(commandBytes, sizeof(GLuint));
+	StreamAllocation drawDataRange = stream.Allocate(drawDataBytes, stream.GetStorageAlignment());
+	if (commandRange.IsValid() && drawDataRange.IsValid())
+	{
+		std::memcpy(commandRange.data, list.commands.data(), commandBytes);
+		std::memcpy(drawDataRange.data, list.drawData.data(), drawDataBytes);
+		stream.Commit(commandRange);
+		stream.Commit(drawDataRange);
+
+		GLState::BindBuffer(GL_DRAW_INDIRECT_BUFFER, stream.GetBuffer());
+		GLState::BindBufferRange(GL_SHADER_STORAGE_BUFFER, DrawDataBinding, stream.GetBuffer(), drawDataRange.offset, drawDataBytes);
+		commandOffset = commandRange.offset;
+	}
+	else
+	{
+		// the stream is full this frame, orphan the fallback buffers instead
+		GLState::BindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, commandBytes, list.commands.data(), GL_STREAM_DRAW);
+
+		GLState::BindBuffer(GL_SHADER_STORAGE_BUFFER, drawDataBuffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, drawDataBytes, list.drawData.data(), GL_STREAM_DRAW);
+		GLState::BindBufferBase(GL_SHADER_STORAGE_BUFFER, DrawDataBinding, drawDataBuffer);
+	}
+
+	if (materialsDirty)
+	{
+		GLState::BindBuffer(GL_SHADER_STORAGE_BUFFER, materialBuffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, materialParameters.size() * sizeof(MaterialParameters), materialParameters.data(), GL_STATIC_DRAW);
+		materialsDirty = false;
+	}
+	GLState::BindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	if (list.commands.size() > drawIDCapacity)
+	{
+		std::vector<GLuint> drawIDs(list.commands.size());
+		std::iota(drawIDs.begin(), drawIDs.end(), 0);
+
+		GLState::BindBuffer(GL_ARRAY_BUFFER, drawIDBuffer);
+		glBufferData(GL_ARRAY_BUFFER, drawIDs.size() * sizeof(GLuint), drawIDs.data(), GL_STATIC_DRAW);
+		GLState::BindBuffer(GL_ARRAY_BUFFER, 0);
+		drawIDCapacity = drawIDs.size();
+	}
+	return commandOffset;
+}
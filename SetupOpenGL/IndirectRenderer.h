@@ -0,0 +1,70 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "GeometryPool.h"
+#include "IndirectCommands.h"
+#include "Material.h"
+#include "RenderQueue.h"
+#include "Shader.h"
+#include "StreamBuffer.h"
+#include "TransformBuffer.h"
+
+// Submits sorted render packets whose meshes live in a GeometryPool through
+// glMultiDrawElementsIndirect, one call per material batch. Transform and material
+// indices are fetched in the shader through the command's baseInstance; the
+// transforms themselves come from the TransformBuffer. Commands and per-draw data are
+// streamed through the StreamBuffer each frame.
+class IndirectRenderer
+{
+public:
+	// shader storage bindings used by indirect.shader
+	static constexpr GLuint TransformBinding = TransformBuffer::Binding;
+	static constexpr GLuint DrawDataBinding = 1;
+	static constexpr GLuint MaterialBinding = 2;
+
+	IndirectRenderer(Shader& shader, GeometryPool& pool, StreamBuffer& stream);
+	~IndirectRenderer();
+
+	IndirectRenderer(const IndirectRenderer&) = delete;
+	IndirectRenderer& operator=(const IndirectRenderer&) = delete;
+
+	// needs shader storage buffers and multi-draw indirect
+	static bool IsSupported() { return GLAD_GL_VERSION_4_3 != 0; }
+
+	// the DEPTH_ONLY variant of the shader, used when Submit is asked for a depth prepass
+	void SetDepthShader(Shader* shader) { depthShader = shader; }
+	bool CanSubmit(const std::vector<RenderPacket>& packets) const;
+	// with depthPrepass (and a depth shader) the opaque commands are first drawn from the
+	// pool's position-only VAO, the same commands the shaded pass then draws
+	void Submit(const std::vector<RenderPacket>& packets, bool depthPrepass = false);
+
+	const IndirectCommandList& GetCommands() const { return commandList; }
+
+private:
+	Shader& shader;
+	Shader* depthShader = nullptr;
+	GeometryPool& pool;
+	StreamBuffer& stream;
+
+	// only used when a frame's commands do not fit in the stream
+	GLuint commandBuffer = 0;
+	GLuint drawDataBuffer = 0;
+	GLuint materialBuffer = 0;
+	GLuint drawIDBuffer = 0;
+	size_t drawIDCapacity = 0;
+
+	std::vector<IndirectDraw> draws;
+	std::vector<MaterialParameters> materialParameters;
+	std::vector<bool> materialWritten;
+	bool materialsDirty = false;
+	IndirectCommandList commandList;
+
+	GLuint addMaterial(const Material* material);
+	// binds the frame's draw data and returns the offset of the first command in the bound indirect buffer
+	GLintptr uploadBuffers();
+	// count commands from first in the bound indirect buffer, which starts at commandOffset
+	void drawCommands(GLintptr commandOffset, GLuint first, GLuint count) const;
+};
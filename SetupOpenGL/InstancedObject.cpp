@@ -0,0 +1,91 @@
+#include "InstancedObject.h"
+#include "GLState.h"
+
+#include <algorithm>
+
+InstancedObject::InstancedObject(std::string const& path, bool flipTextures, ShaderManager& shaders, ShaderHandle shader, uint32_t shaderFeatures)
+	: shaders(shaders), model(path, flipTextures, shaders, shader, shaderFeatures | ShaderFeature::Instanced)
+{
+	// the buffer is resized as props are added, so it keeps mutable storage; created rather
+	// than generated so the vertex array can reference it before it was ever bound
+	if (GLAD_GL_VERSION_4_5)
+		glCreateBuffers(1, &instanceBuffer);
+	else
+		glGenBuffers(1, &instanceBuffer);
+
+	for (Mesh& mesh : model.GetMeshes())
+		mesh.SetInstanceBuffer(instanceBuffer);
+}
+
+InstancedObject::~InstancedObject()
+{
+	GLState::DeleteBuffer(instanceBuffer);
+}
+
+void InstancedObject::Reserve(unsigned int instanceCount)
+{
+	transforms.reserve(instanceCount);
+}
+
+unsigned int InstancedObject::AddInstance(const glm::mat4& transform)
+{
+	unsigned int instance = static_cast<unsigned int>(transforms.size());
+	transforms.push_back(transform);
+	markDirty(instance);
+	return instance;
+}
+
+void InstancedObject::SetInstanceTransform(unsigned int instance, const glm::mat4& transform)
+{
+	transforms[instance] = transform;
+	markDirty(instance);
+}
+
+void InstancedObject::Draw()
+{
+	if (transforms.empty())
+		return;
+
+	uploadInstances();
+
+	GLsizei instanceCount = static_cast<GLsizei>(transforms.size());
+	for (const Mesh& mesh : model.GetMeshes())
+	{
+		shaders.Get(shaders.Resolve(mesh.material->GetShader())).Bind();
+		mesh.DrawInstanced(instanceCount);
+	}
+}
+
+void InstancedObject::markDirty(unsigned int instance)
+{
+	if (dirtyBegin == dirtyEnd)
+	{
+		dirtyBegin = instance;
+		dirtyEnd = instance + 1;
+		return;
+	}
+	dirtyBegin = std::min(dirtyBegin, instance);
+	dirtyEnd = std::max(dirtyEnd, instance + 1);
+}
+
+void InstancedObject::uploadInstances()
+{
+	unsigned int instanceCount = static_cast<unsigned int>(transforms.size());
+
+	GLState::BindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+	if (instanceCount > bufferCapacity)
+	{
+		// grow geometrically so adding props one at a time does not reallocate every frame
+		bufferCapacity = std::max(instanceCount, bufferCapacity * 2);
+		glBufferData(GL_ARRAY_BUFFER, bufferCapacity * sizeof(glm::mat4), nullptr, GL_DYNAMIC_DRAW);
+		dirtyBegin = 0;
+		dirtyEnd = instanceCount;
+	}
+
+	if (dirtyBegin != dirtyEnd)
+	{
+		glBufferSubData(GL_ARRAY_BUFFER, dirtyBegin * sizeof(glm::mat4), (dirtyEnd - dirtyBegin) * sizeof(glm::mat4), &transforms[dirtyBegin]);
+		dirtyBegin = dirtyEnd = 0;
+	}
+	GLState::BindBuffer(GL_ARRAY_BUFFER, 0);
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include "Object.h"
+#include "Shader.h"
+#include "ShaderManager.h"
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+// A model imported once and drawn many times, one glDrawElementsInstanced per mesh
+// with the world matrices read from a per-instance attribute buffer.
+class InstancedObject
+{
+public:
+	// shader should be a variant built with ShaderFeature::Instanced and shaderFeatures
+	InstancedObject(std::string const& path, bool flipTextures, ShaderManager& shaders, ShaderHandle shader, uint32_t shaderFeatures = ShaderFeature::None);
+	~InstancedObject();
+
+	InstancedObject(const InstancedObject&) = delete;
+	InstancedObject& operator=(const InstancedObject&) = delete;
+
+	void Reserve(unsigned int instanceCount);
+	unsigned int AddInstance(const glm::mat4& transform);
+	void SetInstanceTransform(unsigned int instance, const glm::mat4& transform);
+	const glm::mat4& GetInstanceTransform(unsigned int instance) const { return transforms[instance]; }
+	unsigned int GetInstanceCount() const { return static_cast<unsigned int>(transforms.size()); }
+
+	void Draw();
+
+private:
+	ShaderManager& shaders;
+	Object model;
+	std::vector<glm::mat4> transforms;
+
+	GLuint instanceBuffer = 0;
+	unsigned int bufferCapacity = 0;
+
+	// half-open range of instances changed since the last upload
+	unsigned int dirtyBegin = 0;
+	unsigned int dirtyEnd = 0;
+
+	void markDirty(unsigned int instance);
+	void uploadInstances();
+};
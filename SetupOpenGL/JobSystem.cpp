@@ -0,0 +1,317 @@
+#include "JobSystem.h"
+#include "FrameArena.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdlib>
+#include <memory_resource>
+#include <string>
+#include <thread>
+
+namespace {
+	// Ring of jobs that grows when full and never shrinks, so a queue that has seen a
+	// frame's worth of jobs stops allocating.
+	struct WorkQueue {
+		std::mutex lock;
+		std::vector<Job> jobs = std::vector<Job>(256);
+		size_t head = 0;
+		size_t count = 0;
+
+		void PushBack(const Job& job)
+		{
+			if (count == jobs.size())
+			{
+				std::vector<Job> grown(jobs.size() * 2);
+				for (size_t i = 0; i < count; i++)
+					grown[i] = jobs[(head + i) % jobs.size()];
+				jobs.swap(grown);
+				head = 0;
+			}
+			jobs[(head + count) % jobs.size()] = job;
+			count++;
+		}
+
+		bool PopBack(Job& job)
+		{
+			if (count == 0)
+				return false;
+			count--;
+			job = jobs[(head + count) % jobs.size()];
+			return true;
+		}
+
+		bool PopFront(Job& job)
+		{
+			if (count == 0)
+				return false;
+			job = jobs[head];
+			head = (head + 1) % jobs.size();
+			count--;
+			return true;
+		}
+	};
+
+	// one per worker, then the one shared by every thread outside the pool
+	std::vector<std::unique_ptr<WorkQueue>> queues;
+	std::vector<std::thread> workers;
+	std::atomic<bool> stopping = false;
+
+	// jobs sitting in any queue; idle workers sleep while it is zero
+	std::atomic<int> queuedJobs = 0;
+	std::mutex sleepLock;
+	std::condition_variable wake;
+
+	// the queue the calling thread pushes to and pops from first
+	thread_local int ownQueue = -1;
+
+	int queueOf()
+	{
+		return ownQueue >= 0 ? ownQueue : static_cast<int>(queues.size()) - 1;
+	}
+
+	bool popOwn(int index, Job& job)
+	{
+		WorkQueue& queue = *queues[index];
+		std::lock_guard<std::mutex> lock(queue.lock);
+		return queue.PopBack(job);
+	}
+
+	bool steal(int index, Job& job)
+	{
+		WorkQueue& queue = *queues[index];
+		// a thief never waits for a busy queue, it moves on to the next one
+		std::unique_lock<std::mutex> lock(queue.lock, std::try_to_lock);
+		return lock.owns_lock() && queue.PopFront(job);
+	}
+
+	bool findJob(Job& job)
+	{
+		if (queuedJobs.load(std::memory_order_acquire) == 0)
+			return false;
+
+		int own = queueOf();
+		bool found = popOwn(own, job);
+		// start at the next queue so thieves spread out instead of all hitting queue 0
+		int count = static_cast<int>(queues.size());
+		for (int i = 1; i < count && !found; i++)
+			found = steal((own + i) % count, job);
+		if (found)
+			queuedJobs.fetch_sub(1, std::memory_order_acq_rel);
+		return found;
+	}
+
+	// a job owning a copy of function, freed once it has run
+	Job makeJob(std::function<void()> function, JobCounter* counter)
+	{
+		Job job;
+		job.function = [](void* context, size_t, size_t) {
+			std::unique_ptr<std::function<void()>> function(static_cast<std::function<void()>*>(context));
+			(*function)();
+		};
+		job.context = new std::function<void()>(std::move(function));
+		job.counter = counter;
+		job.tag = AllocationTracker::GetThreadTag();
+		return job;
+	}
+
+	void workerLoop(int index)
+	{
+		ownQueue = index;
+		AllocationTracker::SetThreadTag(AllocationTag::Jobs);
+		std::string name = "Worker " + std::to_string(index);
+		Profiler::SetThreadName(name.c_str());
+
+		while (true)
+		{
+			Job job;
+			if (findJob(job))
+			{
+				JobSystem::execute(job);
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lock(sleepLock);
+			wake.wait(lock, [] { return stopping.load() || queuedJobs.load() > 0; });
+			if (stopping.load() && queuedJobs.load() == 0)
+				return;
+		}
+	}
+}
+
+void JobSystem::Initialize(int workerCount)
+{
+	if (!queues.empty())
+		return;
+
+	if (workerCount < 0)
+		workerCount = std::max(0, static_cast<int>(std::thread::hardware_concurrency()) - 1);
+
+	// an early return from main must not leave joinable threads to the static destructors
+	static bool registered = false;
+	if (!registered)
+		std::atexit(Shutdown);
+	registered = true;
+
+	stopping = false;
+	for (int i = 0; i < workerCount + 1; i++)
+		queues.push_back(std::make_unique<WorkQueue>());
+	for (int i = 0; i < workerCount; i++)
+		workers.emplace_back(workerLoop, i);
+}
+
+void JobSystem::Shutdown()
+{
+	if (queues.empty())
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(sleepLock);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (std::thread& worker : workers)
+		worker.join();
+	workers.clear();
+
+	// nothing may be left behind with a counter someone could still wait on
+	Job job;
+	while (findJob(job))
+		execute(job);
+	queues.clear();
+}
+
+int JobSystem::GetWorkerCount()
+{
+	return static_cast<int>(workers.size());
+}
+
+void JobSystem::Run(std::function<void()> function, JobCounter* counter)
+{
+	Job job = makeJob(std::move(function), counter);
+	if (counter)
+		counter->pending.fetch_add(1, std::memory_order_relaxed);
+	submit(&job, 1);
+}
+
+void JobSystem::RunAfter(JobCounter& dependency, std::function<void()> function, JobCounter* counter)
+{
+	Job job = makeJob(std::move(function), counter);
+	if (counter)
+		counter->pending.fetch_add(1, std::memory_order_relaxed);
+
+	{
+		// the last job of dependency drops the count to zero under the same lock, so this
+		// either sees the zero or is picked up by that job
+		std::lock_guard<std::mutex> lock(dependency.continuationLock);
+		if (!dependency.IsDone())
+		{
+			dependency.continuations.push_back(job);
+			return;
+		}
+	}
+	submit(&job, 1);
+}
+
+void JobSystem::Wait(JobCounter& counter)
+{
+	while (!counter.IsDone())
+	{
+		Job job;
+		if (findJob(job))
+			execute(job);
+		else
+			std::this_thread::yield();
+	}
+	// the job that reached zero may still hold the lock; once it is released the counter can go
+	std::lock_guard<std::mutex> lock(counter.continuationLock);
+}
+
+void JobSystem::execute(const Job& job)
+{
+	AllocationScope scope(job.tag);
+	job.function(job.context, job.begin, job.end);
+	if (job.counter)
+		complete(*job.counter);
+}
+
+void JobSystem::complete(JobCounter& counter)
+{
+	// only what may be the last decrement takes the lock; counter must not be touched after it
+	int pending = counter.pending.load(std::memory_order_relaxed);
+	while (pending > 1)
+	{
+		if (counter.pending.compare_exchange_weak(pending, pending - 1, std::memory_order_acq_rel))
+			return;
+	}
+
+	std::vector<Job> continuations;
+	{
+		std::lock_guard<std::mutex> lock(counter.continuationLock);
+		if (counter.pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			continuations.swap(counter.continuations);
+	}
+	if (!continuations.empty())
+		submit(continuations.data(), continuations.size());
+}
+
+void JobSystem::submit(const Job* jobs, size_t count)
+{
+	if (queues.empty())
+	{
+		for (size_t i = 0; i < count; i++)
+			execute(jobs[i]);
+		return;
+	}
+
+	{
+		WorkQueue& queue = *queues[queueOf()];
+		std::lock_guard<std::mutex> lock(queue.lock);
+		for (size_t i = 0; i < count; i++)
+			queue.PushBack(jobs[i]);
+	}
+	queuedJobs.fetch_add(static_cast<int>(count), std::memory_order_acq_rel);
+
+	// taking the lock orders this against a worker that has just found nothing and is about to sleep
+	{
+		std::lock_guard<std::mutex> lock(sleepLock);
+	}
+	if (count == 1)
+		wake.notify_one();
+	else
+		wake.notify_all();
+}
+
+void JobSystem::parallelFor(size_t count, size_t grain, void (*function)(void*, size_t, size_t), void* context)
+{
+	if (count == 0)
+		return;
+
+	grain = std::max<size_t>(grain, 1);
+	size_t chunks = (count + grain - 1) / grain;
+	if (chunks == 1 || workers.empty())
+	{
+		function(context, 0, count);
+		return;
+	}
+
+	JobCounter counter;
+	counter.pending.store(static_cast<int>(chunks), std::memory_order_relaxed);
+
+	// the usual handful of chunks fits on the stack; more come from the thread's frame arena
+	std::byte storage[64 * sizeof(Job)];
+	std::pmr::monotonic_buffer_resource local(storage, sizeof(storage), FrameArena::GetThreadResource());
+	std::pmr::vector<Job> jobs(chunks, &local);
+	AllocationTag tag = AllocationTracker::GetThreadTag();
+	for (size_t i = 0; i < chunks; i++)
+	{
+		jobs[i].function = function;
+		jobs[i].context = context;
+		jobs[i].begin = i * grain;
+		jobs[i].end = std::min(count, (i + 1) * grain);
+		jobs[i].counter = &counter;
+		jobs[i].tag = tag;
+	}
+	submit(jobs.data(), jobs.size());
+	Wait(counter);
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <vector>
+
+#include "AllocationTracker.h"
+
+class JobCounter;
+
+struct Job {
+	void (*function)(void* context, size_t begin, size_t end) = nullptr;
+	void* context = nullptr;
+	// the range a parallel-for chunk covers; unused by plain jobs
+	size_t begin = 0;
+	size_t end = 0;
+	// decremented once the job has run, may be nullptr
+	JobCounter* counter = nullptr;
+	// the queuing thread's, so the job's allocations are charged to the right subsystem
+	AllocationTag tag = AllocationTag::Untagged;
+};
+
+// Number of jobs still outstanding for one piece of work. Wait on it, or make other
+// work depend on it with RunAfter. A counter can be reused once it has reached zero, and
+// destroyed once Wait on it has returned.
+class JobCounter
+{
+public:
+	JobCounter() = default;
+
+	JobCounter(const JobCounter&) = delete;
+	JobCounter& operator=(const JobCounter&) = delete;
+
+	bool IsDone() const { return pending.load(std::memory_order_acquire) == 0; }
+
+private:
+	friend class JobSystem;
+
+	std::atomic<int> pending = 0;
+	// jobs queued by RunAfter, submitted when pending reaches zero
+	std::mutex continuationLock;
+	std::vector<Job> continuations;
+};
+
+// Engine-wide worker pool. Every worker owns a deque of jobs: it pushes and pops at the
+// back, so it keeps working on what it just split off while that is still in cache, and
+// an idle worker steals from the front of someone else's, taking the oldest and usually
+// largest piece of work. Threads outside the pool share one more deque. Each deque has
+// its own lock, held only for the push or pop itself.
+//
+// Waiting never blocks a thread that could run jobs: Wait keeps executing queued jobs
+// until its counter reaches zero, so it is safe to wait from inside a job. Without
+// Initialize, or with no workers, everything runs inline on the calling thread.
+class JobSystem
+{
+public:
+	// workers in addition to the calling thread; -1 starts one per hardware thread but one
+	static void Initialize(int workerCount = -1);
+	// finishes whatever is still queued, then joins the workers
+	static void Shutdown();
+	static int GetWorkerCount();
+
+	static void Run(std::function<void()> function, JobCounter* counter = nullptr);
+	// queues function once dependency reaches zero, or right away if it already has
+	static void RunAfter(JobCounter& dependency, std::function<void()> function, JobCounter* counter = nullptr);
+	static void Wait(JobCounter& counter);
+
+	// calls function(begin, end) over [0, count) in chunks of at most grain indices and
+	// returns once every chunk has run; the calling thread takes part
+	template <typename Function>
+	static void ParallelFor(size_t count, size_t grain, Function&& function)
+	{
+		using Callable = std::remove_reference_t<Function>;
+		auto invoke = [](void* context, size_t begin, size_t end) { (*static_cast<Callable*>(context))(begin, end); };
+		parallelFor(count, grain, invoke, const_cast<void*>(static_cast<const void*>(std::addressof(function))));
+	}
+
+	// runs one job on the calling thread; used by the workers
+	static void execute(const Job& job);
+
+private:
+	static void complete(JobCounter& counter);
+	static void submit(const Job* jobs, size_t count);
+	static void parallelFor(size_t count, size_t grain, void (*function)(void*, size_t, size_t), void* context);
+};
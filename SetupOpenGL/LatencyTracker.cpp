@@ -0,0 +1,44 @@
+#include "LatencyTracker.h"
+#include "Profiler.h"
+
+#include <algorithm>
+
+LatencyTracker::~LatencyTracker()
+{
+	for (size_t i = 0; i < count; i++)
+		glDeleteSync(pending[(first + i) % MaxPending].fence);
+}
+
+void LatencyTracker::FramePresented(double inputTime)
+{
+	if (count == MaxPending)
+	{
+		glDeleteSync(pending[first].fence);
+		first = (first + 1) % MaxPending;
+		count--;
+	}
+	pending[(first + count) % MaxPending] = { glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), inputTime };
+	count++;
+	// the fence has to reach the driver or polling it would never see it signal
+	glFlush();
+}
+
+void LatencyTracker::Poll()
+{
+	double now = Profiler::Now();
+	while (count > 0)
+	{
+		const PendingFrame& frame = pending[first];
+		GLenum result = glClientWaitSync(frame.fence, 0, 0);
+		if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED)
+			break;
+
+		double milliseconds = (now - frame.inputTime) / 1000.0;
+		stats.meanMilliseconds += (milliseconds - stats.meanMilliseconds) / ++stats.frames;
+		stats.maxMilliseconds = std::max(stats.maxMilliseconds, milliseconds);
+
+		glDeleteSync(frame.fence);
+		first = (first + 1) % MaxPending;
+		count--;
+	}
+}
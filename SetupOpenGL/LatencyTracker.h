@@ -0,0 +1,48 @@
+#pragma once
+#include <glad/glad.h>
+
+#include <cstddef>
+
+struct LatencyStats {
+	int frames = 0;
+	double meanMilliseconds = 0.0;
+	double maxMilliseconds = 0.0;
+};
+
+// Input-to-photon latency of presented frames: the time from the input sample a frame
+// was built from until the GPU has finished it, taken from a fence placed after the swap.
+// Fences are only polled, never waited on, so a completion is seen at the next Poll and
+// the figure is an upper bound by up to one poll interval. Scan-out is not included.
+class LatencyTracker
+{
+public:
+	// frames kept in flight before the oldest is dropped unmeasured
+	static constexpr size_t MaxPending = 8;
+
+	LatencyTracker() = default;
+	~LatencyTracker();
+
+	LatencyTracker(const LatencyTracker&) = delete;
+	LatencyTracker& operator=(const LatencyTracker&) = delete;
+
+	// call right after the swap of a frame whose input was sampled at inputTime (Profiler::Now)
+	void FramePresented(double inputTime);
+	// records every pending frame the GPU has finished since the last call
+	void Poll();
+
+	// frames completed since the last Reset
+	const LatencyStats& GetStats() const { return stats; }
+	void Reset() { stats = LatencyStats(); }
+
+private:
+	struct PendingFrame {
+		GLsync fence;
+		double inputTime;
+	};
+
+	// ring of frames in flight, oldest at first
+	PendingFrame pending[MaxPending] = {};
+	size_t first = 0;
+	size_t count = 0;
+	LatencyStats stats;
+};
@@ -0,0 +1,22 @@
+#pragma once
+#include <glm/glm.hpp>
+
+enum class LightType {
+	Point,
+	Spot
+};
+
+// A dynamic light in world space. Its influence ends at Range, which is what the
+// clustered culling tests against, so the falloff reaches zero there.
+struct Light {
+	LightType Type = LightType::Point;
+	glm::vec3 Position = glm::vec3(0.0f);
+	glm::vec3 Color = glm::vec3(1.0f);
+	float Intensity = 1.0f;
+	float Range = 10.0f;
+	// spot lights only: the direction the cone points in, and the cosines of the angles
+	// where it starts to fade and where it is dark
+	glm::vec3 Direction = glm::vec3(0.0f, -1.0f, 0.0f);
+	float InnerCone = 0.9f;
+	float OuterCone = 0.8f;
+};
@@ -0,0 +1,114 @@
+#include "LightBenchmark.h"
+#include "JobSystem.h"
+#include "LightCulling.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <format>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace {
+	const size_t LightCounts[] = { 100, 1000, 10000 };
+
+	// lights scattered through a box around the view, every fourth a spot pointing down
+	std::vector<Light> makeLights(size_t count)
+	{
+		std::mt19937 random(1234);
+		std::uniform_real_distribution<float> across(-60.0f, 60.0f);
+		std::uniform_real_distribution<float> depth(-110.0f, 10.0f);
+		std::uniform_real_distribution<float> range(1.0f, 8.0f);
+		std::vector<Light> lights(count);
+		for (size_t i = 0; i < count; i++)
+		{
+			Light& light = lights[i];
+			light.Position = glm::vec3(across(random), across(random) * 0.25f, depth(random));
+			light.Range = range(random);
+			if (i % 4 == 3)
+			{
+				light.Type = LightType::Spot;
+				light.Direction = glm::vec3(0.0f, -1.0f, 0.2f);
+				light.InnerCone = 0.95f;
+				light.OuterCone = i % 8 == 3 ? 0.85f : 0.5f;
+			}
+		}
+		return lights;
+	}
+
+	// clusters whose list differs from testing every light against the cluster on its own
+	size_t countMismatches(const LightCuller& culler, const std::vector<Light>& lights, const glm::mat4& view)
+	{
+		std::vector<glm::vec4> spheres;
+		for (const Light& light : lights)
+			spheres.push_back(LightCuller::GetBoundingSphere(light, view));
+
+		size_t mismatches = 0;
+		std::vector<uint32_t> expected;
+		for (uint32_t cluster = 0; cluster < culler.GetClusterCount(); cluster++)
+		{
+			expected.clear();
+			for (uint32_t i = 0; i < spheres.size(); i++)
+			{
+				if (LightCuller::IntersectsCluster(spheres[i], culler.GetClusterBounds()[cluster]))
+					expected.push_back(i);
+			}
+			const LightCluster& range = culler.GetClusters()[cluster];
+			const uint32_t* indices = culler.GetLightIndices().data() + range.offset;
+			if (range.count != expected.size() || !std::equal(expected.begin(), expected.end(), indices))
+				mismatches++;
+		}
+		return mismatches;
+	}
+
+	double median(std::vector<double> values)
+	{
+		std::sort(values.begin(), values.end());
+		return values[values.size() / 2];
+	}
+}
+
+int RunLightBenchmark(int iterations)
+{
+	const float nearPlane = 0.1f;
+	const float farPlane = 100.0f;
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, nearPlane, farPlane);
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 2.0f, 0.0f), glm::vec3(0.0f, 1.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+	int poolSize = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+	size_t failures = 0;
+	std::cout << "Light culling, 16x9x24 clusters, median of " << iterations << " frames" << std::endl;
+	for (size_t count : LightCounts)
+	{
+		std::vector<Light> lights = makeLights(count);
+		for (int threads : { 1, poolSize })
+		{
+			JobSystem::Shutdown();
+			JobSystem::Initialize(threads - 1);
+
+			LightCuller culler;
+			std::vector<double> times;
+			for (int i = 0; i < iterations; i++)
+			{
+				auto start = std::chrono::steady_clock::now();
+				culler.Cull(lights, view, projection, nearPlane, farPlane);
+				times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+			}
+
+			const LightCullingStats& stats = culler.GetStats();
+			size_t mismatches = countMismatches(culler, lights, view);
+			failures += mismatches;
+			std::cout << std::format("{:>6} lights, {:>2} threads: {:>8.3f} ms, {} visible, {} references, at most {} in a cluster, {} clusters differ from the reference",
+				count, threads, median(times), stats.visibleLights, stats.references, stats.maxPerCluster, mismatches) << std::endl;
+			if (threads == poolSize)
+				break;
+		}
+	}
+
+	JobSystem::Shutdown();
+	JobSystem::Initialize();
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+// --light-benchmark: times LightCuller::Cull on a scene of random point and spot lights,
+// from a hundred to ten thousand, once with every job on the calling thread and once on
+// the full job system. Every run is checked against IntersectsCluster applied to each
+// light and cluster one by one. Needs no GL context. Returns main's exit code.
+int RunLightBenchmark(int iterations);
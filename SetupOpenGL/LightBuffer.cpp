@@ -0,0 +1,59 @@
+#include "LightBuffer.h"
+#include "GLState.h"
+
+#include <algorithm>
+#include <cstring>
+
+// the clusters are read as uvec2 and copied over as they are
+static_assert(sizeof(LightCluster) == 2 * sizeof(uint32_t), "LightCluster has to match uvec2");
+
+LightBuffer::LightBuffer(StreamBuffer& stream)
+	: stream(stream)
+{
+}
+
+void LightBuffer::Update(const std::vector<Light>& lights, const LightCuller& culler, float viewportWidth, float viewportHeight)
+{
+	const std::vector<LightCluster>& clusters = culler.GetClusters();
+	const std::vector<uint32_t>& indices = culler.GetLightIndices();
+	GLsizeiptr alignment = stream.GetStorageAlignment();
+
+	StreamAllocation lightRange = stream.Allocate(sizeof(LightGridHeader) + lights.size() * sizeof(LightData), alignment);
+	StreamAllocation clusterRange = stream.Allocate(clusters.size() * sizeof(LightCluster), alignment);
+	// never empty, a zero-sized range cannot be bound
+	StreamAllocation indexRange = stream.Allocate(std::max<size_t>(indices.size(), 1) * sizeof(uint32_t), alignment);
+	if (!lightRange.IsValid() || !clusterRange.IsValid() || !indexRange.IsValid())
+		return;
+
+	LightGridHeader header;
+	header.ClusterCount = glm::uvec4(culler.GetTilesX(), culler.GetTilesY(), culler.GetSlices(), static_cast<GLuint>(lights.size()));
+	header.ClusterScale = glm::vec4(culler.GetTilesX() / viewportWidth, culler.GetTilesY() / viewportHeight, culler.GetSliceScale(), culler.GetSliceBias());
+	header.Ambient = glm::vec4(ambient, 1.0f);
+	std::memcpy(lightRange.data, &header, sizeof(LightGridHeader));
+
+	LightData* data = reinterpret_cast<LightData*>(static_cast<char*>(lightRange.data) + sizeof(LightGridHeader));
+	for (const Light& light : lights)
+	{
+		float spotScale = 0.0f;
+		float spotOffset = 1.0f;
+		glm::vec3 direction(0.0f);
+		if (light.Type == LightType::Spot)
+		{
+			direction = glm::normalize(light.Direction);
+			spotScale = 1.0f / std::max(light.InnerCone - light.OuterCone, 1e-4f);
+			spotOffset = -light.OuterCone * spotScale;
+		}
+		*data++ = { glm::vec4(light.Position, light.Range), glm::vec4(light.Color * light.Intensity, spotScale), glm::vec4(direction, spotOffset) };
+	}
+
+	std::memcpy(clusterRange.data, clusters.data(), clusters.size() * sizeof(LightCluster));
+	if (!indices.empty())
+		std::memcpy(indexRange.data, indices.data(), indices.size() * sizeof(uint32_t));
+
+	stream.Commit(lightRange);
+	stream.Commit(clusterRange);
+	stream.Commit(indexRange);
+	GLState::BindBufferRange(GL_SHADER_STORAGE_BUFFER, LightBinding, stream.GetBuffer(), lightRange.offset, lightRange.size);
+	GLState::BindBufferRange(GL_SHADER_STORAGE_BUFFER, ClusterBinding, stream.GetBuffer(), clusterRange.offset, clusterRange.size);
+	GLState::BindBufferRange(GL_SHADER_STORAGE_BUFFER, IndexBinding, stream.GetBuffer(), indexRange.offset, indexRange.size);
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "Light.h"
+#include "LightCulling.h"
+#include "StreamBuffer.h"
+
+// std430 layout of one light in the "Lights" storage buffer of lights.glsl. The spot
+// cone is folded into a scale and offset on the cosine, so a point light is scale 0
+// and offset 1 and the shader never branches on the type.
+struct LightData {
+	glm::vec4 PositionRange;
+	glm::vec4 ColorSpotScale;
+	glm::vec4 DirectionSpotOffset;
+};
+
+// std430 header in front of the lights
+struct LightGridHeader {
+	// tiles x, tiles y, slices, light count
+	glm::uvec4 ClusterCount;
+	// tiles per pixel in x and y, slice scale and bias
+	glm::vec4 ClusterScale;
+	glm::vec4 Ambient;
+};
+
+// Uploads a frame's lights and a LightCuller's clusters to three shader storage ranges
+// carved out of the StreamBuffer: the lights behind a header describing the grid, one
+// (offset, count) pair per cluster, and the light index list.
+class LightBuffer
+{
+public:
+	static constexpr GLuint LightBinding = 3;
+	static constexpr GLuint ClusterBinding = 4;
+	static constexpr GLuint IndexBinding = 5;
+
+	explicit LightBuffer(StreamBuffer& stream);
+
+	LightBuffer(const LightBuffer&) = delete;
+	LightBuffer& operator=(const LightBuffer&) = delete;
+
+	static bool IsSupported() { return GLAD_GL_VERSION_4_3 != 0; }
+
+	void SetAmbient(const glm::vec3& color) { ambient = color; }
+
+	// call after StreamBuffer::BeginFrame with the lights culler was just run on; binds
+	// the three ranges, or nothing if the stream has no room left this frame
+	void Update(const std::vector<Light>& lights, const LightCuller& culler, float viewportWidth, float viewportHeight);
+
+private:
+	StreamBuffer& stream;
+	glm::vec3 ambient = glm::vec3(0.15f);
+};
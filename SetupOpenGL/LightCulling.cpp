@@ -0,0 +1,260 @@
+#include "LightCulling.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LIGHT_CULLING_SSE 1
+#include <emmintrin.h>
+#else
+#define LIGHT_CULLING_SSE 0
+#endif
+
+namespace {
+	// calls hit(i) for every candidate i whose sphere reaches into box, in order
+	template<typename Candidates, typename Function>
+	void forEachIntersecting(const Candidates& candidates, const ClusterBounds& box, Function&& hit)
+	{
+		size_t count = candidates.x.size();
+#if LIGHT_CULLING_SSE
+		__m128 minX = _mm_set1_ps(box.min.x), minY = _mm_set1_ps(box.min.y), minZ = _mm_set1_ps(box.min.z);
+		__m128 maxX = _mm_set1_ps(box.max.x), maxY = _mm_set1_ps(box.max.y), maxZ = _mm_set1_ps(box.max.z);
+		__m128 zero = _mm_setzero_ps();
+		for (size_t i = 0; i < count; i += 4)
+		{
+			__m128 x = _mm_loadu_ps(&candidates.x[i]);
+			__m128 y = _mm_loadu_ps(&candidates.y[i]);
+			__m128 z = _mm_loadu_ps(&candidates.z[i]);
+			// the same arithmetic as IntersectsCluster, so both agree to the last bit
+			__m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minX, x), _mm_sub_ps(x, maxX)), zero);
+			__m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minY, y), _mm_sub_ps(y, maxY)), zero);
+			__m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minZ, z), _mm_sub_ps(z, maxZ)), zero);
+			__m128 distanceSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+			unsigned int hits = static_cast<unsigned int>(_mm_movemask_ps(_mm_cmple_ps(distanceSquared, _mm_loadu_ps(&candidates.radiusSquared[i]))));
+			while (hits != 0)
+			{
+				hit(i + std::countr_zero(hits));
+				hits &= hits - 1;
+			}
+		}
+#else
+		for (size_t i = 0; i < count; i++)
+		{
+			glm::vec3 center(candidates.x[i], candidates.y[i], candidates.z[i]);
+			glm::vec3 outside = glm::max(glm::max(box.min - center, center - box.max), glm::vec3(0.0f));
+			if (glm::dot(outside, outside) <= candidates.radiusSquared[i])
+				hit(i);
+		}
+#endif
+	}
+}
+
+LightCuller::LightCuller(uint32_t tilesX, uint32_t tilesY, uint32_t slices)
+	: tilesX(tilesX), tilesY(tilesY), slices(slices), bounds(GetClusterCount()), rowBounds(tilesY * slices), sliceLights(slices), clusters(GetClusterCount())
+{
+}
+
+void LightCuller::Cull(const std::vector<Light>& lights, const glm::mat4& view, const glm::mat4& projection, float nearPlane, float farPlane)
+{
+	stats = LightCullingStats();
+	stats.lights = static_cast<unsigned int>(lights.size());
+	if (projection != boundsProjection || nearPlane != boundsNear || farPlane != boundsFar)
+		buildBounds(projection, nearPlane, farPlane);
+
+	spheres.resize(lights.size());
+	sliceRanges.resize(lights.size());
+	for (size_t i = 0; i < lights.size(); i++)
+	{
+		glm::vec4 sphere = GetBoundingSphere(lights[i], view);
+		spheres[i] = sphere;
+		float depth = -sphere.z;
+		if (depth + sphere.w < nearPlane || depth - sphere.w > farPlane)
+		{
+			sliceRanges[i] = glm::uvec2(1, 0);
+			continue;
+		}
+		// a slice of slack either way against rounding in the log; the box test decides
+		uint32_t first = getSlice(depth - sphere.w);
+		uint32_t last = getSlice(depth + sphere.w);
+		sliceRanges[i] = glm::uvec2(first > 0 ? first - 1 : 0, std::min(last + 1, slices - 1));
+		stats.visibleLights++;
+	}
+
+	JobSystem::ParallelFor(slices, 1, [this](size_t begin, size_t end) {
+		for (size_t slice = begin; slice < end; slice++)
+			cullSlice(static_cast<uint32_t>(slice));
+	});
+
+	// the slices' lists back to back, in cluster order
+	size_t total = 0;
+	for (const SliceLights& slice : sliceLights)
+		total += slice.indices.size();
+	lightIndices.resize(total);
+
+	uint32_t base = 0;
+	uint32_t tilesPerSlice = tilesX * tilesY;
+	for (uint32_t slice = 0; slice < slices; slice++)
+	{
+		const std::vector<uint32_t>& indices = sliceLights[slice].indices;
+		std::copy(indices.begin(), indices.end(), lightIndices.begin() + base);
+		for (uint32_t cluster = slice * tilesPerSlice; cluster < (slice + 1) * tilesPerSlice; cluster++)
+		{
+			clusters[cluster].offset += base;
+			stats.maxPerCluster = std::max(stats.maxPerCluster, clusters[cluster].count);
+		}
+		base += static_cast<uint32_t>(indices.size());
+	}
+	stats.references = static_cast<unsigned int>(total);
+}
+
+glm::vec4 LightCuller::GetBoundingSphere(const Light& light, const glm::mat4& view)
+{
+	glm::vec3 center = light.Position;
+	float radius = light.Range;
+	if (light.Type == LightType::Spot && light.OuterCone > 0.0f)
+	{
+		glm::vec3 direction = glm::normalize(light.Direction);
+		float cosine = std::min(light.OuterCone, 1.0f);
+		if (cosine < 0.70710678f)
+		{
+			// wider than 90 degrees: the circle where the cone meets its range
+			center += direction * (light.Range * cosine);
+			radius = light.Range * std::sqrt(1.0f - cosine * cosine);
+		}
+		else
+		{
+			// narrower: the sphere through the apex and that circle
+			radius = light.Range / (2.0f * cosine);
+			center += direction * radius;
+		}
+	}
+	return glm::vec4(glm::vec3(view * glm::vec4(center, 1.0f)), radius);
+}
+
+bool LightCuller::IntersectsCluster(const glm::vec4& sphere, const ClusterBounds& cluster)
+{
+	glm::vec3 center(sphere);
+	// how far the center lies outside the box along each axis, zero inside it
+	glm::vec3 outside = glm::max(glm::max(cluster.min - center, center - cluster.max), glm::vec3(0.0f));
+	return glm::dot(outside, outside) <= sphere.w * sphere.w;
+}
+
+void LightCuller::buildBounds(const glm::mat4& projection, float nearPlane, float farPlane)
+{
+	boundsProjection = projection;
+	boundsNear = nearPlane;
+	boundsFar = farPlane;
+
+	float logRatio = std::log(farPlane / nearPlane);
+	sliceScale = static_cast<float>(slices) / logRatio;
+	sliceBias = -static_cast<float>(slices) * std::log(nearPlane) / logRatio;
+
+	// view-space ray through every tile corner, scaled to one unit of depth
+	glm::mat4 inverse = glm::inverse(projection);
+	std::vector<glm::vec3> corners((tilesX + 1) * (tilesY + 1));
+	for (uint32_t y = 0; y <= tilesY; y++)
+	{
+		for (uint32_t x = 0; x <= tilesX; x++)
+		{
+			glm::vec4 ndc(-1.0f + 2.0f * x / tilesX, -1.0f + 2.0f * y / tilesY, -1.0f, 1.0f);
+			glm::vec4 point = inverse * ndc;
+			corners[x + (tilesX + 1) * y] = glm::vec3(point) / -point.z;
+		}
+	}
+
+	for (uint32_t slice = 0; slice < slices; slice++)
+	{
+		float nearDepth = nearPlane * std::pow(farPlane / nearPlane, static_cast<float>(slice) / slices);
+		float farDepth = nearPlane * std::pow(farPlane / nearPlane, static_cast<float>(slice + 1) / slices);
+		for (uint32_t y = 0; y < tilesY; y++)
+		{
+			for (uint32_t x = 0; x < tilesX; x++)
+			{
+				ClusterBounds& box = bounds[GetClusterIndex(x, y, slice)];
+				box.min = glm::vec3(INFINITY);
+				box.max = glm::vec3(-INFINITY);
+				for (uint32_t corner = 0; corner < 4; corner++)
+				{
+					const glm::vec3& ray = corners[(x + (corner & 1)) + (tilesX + 1) * (y + (corner >> 1))];
+					for (float depth : { nearDepth, farDepth })
+					{
+						box.min = glm::min(box.min, ray * depth);
+						box.max = glm::max(box.max, ray * depth);
+					}
+				}
+
+				ClusterBounds& row = rowBounds[y + tilesY * slice];
+				row.min = x == 0 ? box.min : glm::min(row.min, box.min);
+				row.max = x == 0 ? box.max : glm::max(row.max, box.max);
+			}
+		}
+	}
+}
+
+uint32_t LightCuller::getSlice(float depth) const
+{
+	if (depth <= boundsNear)
+		return 0;
+	float slice = std::floor(std::log(depth) * sliceScale + sliceBias);
+	return static_cast<uint32_t>(std::clamp(slice, 0.0f, static_cast<float>(slices - 1)));
+}
+
+void LightCuller::cullSlice(uint32_t slice)
+{
+	SliceLights& lights = sliceLights[slice];
+	lights.slice.Clear();
+	for (uint32_t i = 0; i < spheres.size(); i++)
+	{
+		if (sliceRanges[i].x <= slice && slice <= sliceRanges[i].y)
+			lights.slice.Add(spheres[i], i);
+	}
+	lights.slice.Pad();
+
+	lights.indices.clear();
+	for (uint32_t y = 0; y < tilesY; y++)
+	{
+		Candidates& row = lights.row;
+		row.Clear();
+		forEachIntersecting(lights.slice, rowBounds[y + tilesY * slice], [&](size_t i) {
+			row.Add(lights.slice.x[i], lights.slice.y[i], lights.slice.z[i], lights.slice.radiusSquared[i], lights.slice.lightIndex[i]);
+		});
+		row.Pad();
+
+		for (uint32_t x = 0; x < tilesX; x++)
+		{
+			uint32_t cluster = GetClusterIndex(x, y, slice);
+			uint32_t start = static_cast<uint32_t>(lights.indices.size());
+			forEachIntersecting(row, bounds[cluster], [&](size_t i) {
+				lights.indices.push_back(row.lightIndex[i]);
+			});
+			clusters[cluster] = { start, static_cast<uint32_t>(lights.indices.size()) - start };
+		}
+	}
+}
+
+void LightCuller::Candidates::Clear()
+{
+	x.clear();
+	y.clear();
+	z.clear();
+	radiusSquared.clear();
+	lightIndex.clear();
+}
+
+void LightCuller::Candidates::Add(float centerX, float centerY, float centerZ, float squaredRadius, uint32_t light)
+{
+	x.push_back(centerX);
+	y.push_back(centerY);
+	z.push_back(centerZ);
+	radiusSquared.push_back(squaredRadius);
+	lightIndex.push_back(light);
+}
+
+void LightCuller::Candidates::Pad()
+{
+	// padding never passes: no distance is below a negative squared radius
+	while (x.size() % 4 != 0)
+		Add(0.0f, 0.0f, 0.0f, -1.0f, 0);
+}
@@ -0,0 +1,112 @@
+#pragma once
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include "Light.h"
+
+// The lights of one cluster: count entries of the index list, starting at offset.
+struct LightCluster {
+	uint32_t offset = 0;
+	uint32_t count = 0;
+};
+
+// view-space box around one cluster
+struct ClusterBounds {
+	glm::vec3 min = glm::vec3(0.0f);
+	glm::vec3 max = glm::vec3(0.0f);
+};
+
+struct LightCullingStats {
+	unsigned int lights = 0;
+	// lights whose range reaches into the clustered depth range
+	unsigned int visibleLights = 0;
+	// entries in the index list, one for every light in every cluster it touches
+	unsigned int references = 0;
+	unsigned int maxPerCluster = 0;
+};
+
+// Clustered light assignment. The view volume is cut into tilesX x tilesY screen tiles
+// and slices spaced exponentially in depth, so clusters stay roughly as deep as they are
+// wide at any distance. Cull tests the bounding sphere of every light against the
+// view-space box of each cluster and builds one compact list of light indices per
+// cluster, which is all the fragment shader loops over.
+//
+// Slices are culled as jobs. Each gathers the lights whose depth range reaches it, keeps
+// those that touch a row of its tiles, and tests only those against the row's tiles. The
+// box tests run four lights at a time with SSE where the target has SSE2. Nothing here
+// touches GL; LightBuffer uploads the result.
+class LightCuller
+{
+public:
+	LightCuller(uint32_t tilesX = 16, uint32_t tilesY = 9, uint32_t slices = 24);
+
+	// lights are in world space; the cluster boxes are rebuilt when the projection or the
+	// depth range differ from the last call
+	void Cull(const std::vector<Light>& lights, const glm::mat4& view, const glm::mat4& projection, float nearPlane, float farPlane);
+
+	uint32_t GetTilesX() const { return tilesX; }
+	uint32_t GetTilesY() const { return tilesY; }
+	uint32_t GetSlices() const { return slices; }
+	uint32_t GetClusterCount() const { return tilesX * tilesY * slices; }
+	// tiles count from the bottom left of the screen, slices from the near plane
+	uint32_t GetClusterIndex(uint32_t x, uint32_t y, uint32_t slice) const { return x + tilesX * (y + tilesY * slice); }
+	// the slice of a positive view depth is floor(log(depth) * scale + bias)
+	float GetSliceScale() const { return sliceScale; }
+	float GetSliceBias() const { return sliceBias; }
+
+	const std::vector<LightCluster>& GetClusters() const { return clusters; }
+	const std::vector<uint32_t>& GetLightIndices() const { return lightIndices; }
+	const std::vector<ClusterBounds>& GetClusterBounds() const { return bounds; }
+	const LightCullingStats& GetStats() const { return stats; }
+
+	// view-space sphere around everything the light can reach, radius in w; a spot light
+	// gets the smallest sphere around its cone rather than one around its full range
+	static glm::vec4 GetBoundingSphere(const Light& light, const glm::mat4& view);
+	// the test Cull makes, one light and one cluster at a time
+	static bool IntersectsCluster(const glm::vec4& sphere, const ClusterBounds& cluster);
+
+private:
+	// lights to test, as arrays padded to a multiple of four
+	struct Candidates {
+		std::vector<float> x, y, z, radiusSquared;
+		std::vector<uint32_t> lightIndex;
+
+		void Clear();
+		void Add(const glm::vec4& sphere, uint32_t light) { Add(sphere.x, sphere.y, sphere.z, sphere.w * sphere.w, light); }
+		void Add(float centerX, float centerY, float centerZ, float squaredRadius, uint32_t light);
+		void Pad();
+	};
+
+	struct SliceLights {
+		Candidates slice;
+		Candidates row;
+		// this slice's part of the index list, offsets relative to its start
+		std::vector<uint32_t> indices;
+	};
+
+	uint32_t tilesX, tilesY, slices;
+
+	glm::mat4 boundsProjection = glm::mat4(0.0f);
+	float boundsNear = 0.0f;
+	float boundsFar = 0.0f;
+	float sliceScale = 0.0f;
+	float sliceBias = 0.0f;
+	std::vector<ClusterBounds> bounds;
+	// one box around each row of tiles in a slice
+	std::vector<ClusterBounds> rowBounds;
+
+	std::vector<glm::vec4> spheres;
+	// first and last slice each light can reach, first > last when it reaches none
+	std::vector<glm::uvec2> sliceRanges;
+	std::vector<SliceLights> sliceLights;
+
+	std::vector<LightCluster> clusters;
+	std::vector<uint32_t> lightIndices;
+	LightCullingStats stats;
+
+	void buildBounds(const glm::mat4& projection, float nearPlane, float farPlane);
+	uint32_t getSlice(float depth) const;
+	void cullSlice(uint32_t slice);
+};
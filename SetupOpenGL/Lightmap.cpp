@@ -0,0 +1,209 @@
+#include "Lightmap.h"
+#include "GLState.h"
+#include "Material.h"
+#include "ModelLoader.h"
+
+#include <filesystem>
+#include <fstream>
+
+namespace {
+	constexpr uint32_t FileMagic = 0x50414D4C; // "LMAP"
+	constexpr uint32_t FileVersion = 1;
+
+	struct FileHeader {
+		uint32_t magic;
+		uint32_t version;
+		uint32_t width;
+		uint32_t height;
+		uint32_t meshCount;
+	};
+
+	struct MeshHeader {
+		uint32_t sourceVertexCount;
+		uint32_t sourceIndexCount;
+		uint64_t sourceHash;
+		uint32_t vertexCount;
+		uint32_t indexCount;
+	};
+
+	template<typename T>
+	bool readArray(std::ifstream& stream, std::vector<T>& values, size_t count)
+	{
+		values.resize(count);
+		return static_cast<bool>(stream.read(reinterpret_cast<char*>(values.data()), count * sizeof(T)));
+	}
+
+	template<typename T>
+	void writeArray(std::ofstream& stream, const std::vector<T>& values)
+	{
+		stream.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+	}
+
+	uint64_t hashBytes(uint64_t hash, const void* data, size_t size)
+	{
+		// FNV-1a
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+		for (size_t i = 0; i < size; i++)
+			hash = (hash ^ bytes[i]) * 0x100000001B3ull;
+		return hash;
+	}
+}
+
+uint64_t LightmapData::HashMesh(const MeshData& mesh)
+{
+	uint64_t hash = 0xCBF29CE484222325ull;
+	for (const Vertex& vertex : mesh.vertices)
+		hash = hashBytes(hash, &vertex.Position, sizeof(vertex.Position));
+	return hashBytes(hash, mesh.indices.data(), mesh.indices.size() * sizeof(unsigned int));
+}
+
+bool LightmapData::Read(const std::string& path)
+{
+	std::ifstream stream(path, std::ios::binary);
+	if (!stream)
+		return false;
+
+	FileHeader header;
+	if (!stream.read(reinterpret_cast<char*>(&header), sizeof(header)) || header.magic != FileMagic || header.version != FileVersion)
+		return false;
+	if (header.width % 4 != 0 || header.height % 4 != 0)
+		return false;
+
+	width = header.width;
+	height = header.height;
+	meshes.resize(header.meshCount);
+	for (LightmapMesh& mesh : meshes)
+	{
+		MeshHeader meshHeader;
+		if (!stream.read(reinterpret_cast<char*>(&meshHeader), sizeof(meshHeader)))
+			return false;
+		mesh.sourceVertexCount = meshHeader.sourceVertexCount;
+		mesh.sourceIndexCount = meshHeader.sourceIndexCount;
+		mesh.sourceHash = meshHeader.sourceHash;
+		if (!readArray(stream, mesh.vertexRemap, meshHeader.vertexCount) || !readArray(stream, mesh.coords, meshHeader.vertexCount) || !readArray(stream, mesh.indices, meshHeader.indexCount))
+			return false;
+	}
+	return readArray(stream, blocks, static_cast<size_t>(width / 4) * (height / 4) * 16);
+}
+
+bool LightmapData::Write(const std::string& path) const
+{
+	FileHeader header = { FileMagic, FileVersion, width, height, static_cast<uint32_t>(meshes.size()) };
+
+	// write to a temporary file first so a crash never leaves a truncated bake behind
+	std::string temporaryPath = path + ".tmp";
+	{
+		std::ofstream stream(temporaryPath, std::ios::binary | std::ios::trunc);
+		if (!stream)
+			return false;
+		stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		for (const LightmapMesh& mesh : meshes)
+		{
+			MeshHeader meshHeader = { mesh.sourceVertexCount, mesh.sourceIndexCount, mesh.sourceHash, static_cast<uint32_t>(mesh.vertexRemap.size()), static_cast<uint32_t>(mesh.indices.size()) };
+			stream.write(reinterpret_cast<const char*>(&meshHeader), sizeof(meshHeader));
+			writeArray(stream, mesh.vertexRemap);
+			writeArray(stream, mesh.coords);
+			writeArray(stream, mesh.indices);
+		}
+		writeArray(stream, blocks);
+		if (!stream)
+			return false;
+	}
+
+	std::error_code error;
+	std::filesystem::rename(temporaryPath, path, error);
+	if (error)
+	{
+		std::filesystem::remove(temporaryPath, error);
+		return false;
+	}
+	return true;
+}
+
+bool LightmapData::Matches(const ModelData& model) const
+{
+	if (meshes.size() != model.meshes.size())
+		return false;
+	for (size_t i = 0; i < meshes.size(); i++)
+	{
+		const LightmapMesh& baked = meshes[i];
+		const MeshData& source = model.meshes[i];
+		if (baked.sourceVertexCount != source.vertices.size() || baked.sourceIndexCount != source.indices.size() || baked.sourceHash != HashMesh(source))
+			return false;
+		if (baked.coords.size() != baked.vertexRemap.size())
+			return false;
+		for (uint32_t vertex : baked.vertexRemap)
+		{
+			if (vertex >= baked.sourceVertexCount)
+				return false;
+		}
+		for (uint32_t index : baked.indices)
+		{
+			if (index >= baked.vertexRemap.size())
+				return false;
+		}
+	}
+	return true;
+}
+
+void LightmapData::Apply(ModelData& model) const
+{
+	for (size_t i = 0; i < meshes.size(); i++)
+	{
+		const LightmapMesh& baked = meshes[i];
+		MeshData& mesh = model.meshes[i];
+
+		std::vector<Vertex> vertices(baked.vertexRemap.size());
+		for (size_t vertex = 0; vertex < vertices.size(); vertex++)
+			vertices[vertex] = mesh.vertices[baked.vertexRemap[vertex]];
+		mesh.vertices = std::move(vertices);
+		// the skin follows its vertices through the remap
+		if (!mesh.skin.empty())
+		{
+			std::vector<SkinVertex> skin(baked.vertexRemap.size());
+			for (size_t vertex = 0; vertex < skin.size(); vertex++)
+				skin[vertex] = mesh.skin[baked.vertexRemap[vertex]];
+			mesh.skin = std::move(skin);
+		}
+		mesh.indices.assign(baked.indices.begin(), baked.indices.end());
+		mesh.lightmapCoords = baked.coords;
+	}
+}
+
+LightmapTexture::LightmapTexture(const LightmapData& data)
+{
+	GLsizei size = static_cast<GLsizei>(data.blocks.size());
+	if (GLAD_GL_VERSION_4_5)
+	{
+		glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+		glTextureStorage2D(texture, 1, GL_COMPRESSED_RGBA_BPTC_UNORM, data.width, data.height);
+		glCompressedTextureSubImage2D(texture, 0, 0, 0, data.width, data.height, GL_COMPRESSED_RGBA_BPTC_UNORM, size, data.blocks.data());
+
+		// baked light changes slowly across a surface, a single level filtered linearly is enough
+		glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		return;
+	}
+
+	glGenTextures(1, &texture);
+	GLState::BindTexture(Material::LightmapUnit, GL_TEXTURE_2D, texture);
+	glCompressedTexImage2D(GL_TEXTURE_2D, 0, GL_COMPRESSED_RGBA_BPTC_UNORM, data.width, data.height, 0, size, data.blocks.data());
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
+
+LightmapTexture::~LightmapTexture()
+{
+	GLState::DeleteTexture(texture);
+}
+
+void LightmapTexture::Bind() const
+{
+	GLState::BindTexture(Material::LightmapUnit, GL_TEXTURE_2D, texture);
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct MeshData;
+struct ModelData;
+
+// The lightmap UV set of one mesh. Charts are cut along seams, so the baked mesh has its
+// own vertices: vertexRemap names the source vertex each one copies, and indices and
+// coords replace the source mesh's.
+struct LightmapMesh {
+	// the source mesh the bake was made from, checked before the rest is applied
+	uint32_t sourceVertexCount = 0;
+	uint32_t sourceIndexCount = 0;
+	uint64_t sourceHash = 0;
+
+	std::vector<uint32_t> vertexRemap;
+	std::vector<glm::vec2> coords;
+	std::vector<uint32_t> indices;
+};
+
+// What LightmapBaker writes next to a model: one atlas of baked light for all its meshes,
+// as BC7 blocks, and the UV set that maps every mesh into it. Texels hold
+// sqrt(light / Range), which spends the 8 bits where the eye can tell dark values apart
+// and still leaves room for light brighter than white.
+struct LightmapData {
+	static constexpr float Range = 4.0f;
+
+	uint32_t width = 0;
+	uint32_t height = 0;
+	// (width / 4) * (height / 4) blocks of 16 bytes, rows from v = 0
+	std::vector<uint8_t> blocks;
+	std::vector<LightmapMesh> meshes;
+
+	static std::string GetPath(const std::string& modelPath) { return modelPath + ".lightmap"; }
+	// identifies a mesh by its positions and indices
+	static uint64_t HashMesh(const MeshData& mesh);
+
+	// false if the file is missing, from another version or truncated
+	bool Read(const std::string& path);
+	bool Write(const std::string& path) const;
+
+	// true if the bake was made from exactly these meshes
+	bool Matches(const ModelData& model) const;
+	// rebuilds every mesh of model with its lightmap vertices, indices and coordinates
+	void Apply(ModelData& model) const;
+};
+
+// The atlas of a LightmapData on the GPU, bound next to the material by every mesh that
+// was baked into it.
+class LightmapTexture
+{
+public:
+	explicit LightmapTexture(const LightmapData& data);
+	~LightmapTexture();
+
+	LightmapTexture(const LightmapTexture&) = delete;
+	LightmapTexture& operator=(const LightmapTexture&) = delete;
+
+	void Bind() const;
+	GLuint GetID() const { return texture; }
+
+	// BC7 (BPTC) textures are core from GL 4.2
+	static bool IsSupported() { return GLAD_GL_VERSION_4_2 != 0; }
+
+private:
+	GLuint texture = 0;
+};
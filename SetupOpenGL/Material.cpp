@@ -0,0 +1,111 @@
+#include "Material.h"
+#include "GLState.h"
+
+unsigned int Material::nextID = 1;
+
+Material::Material(const MaterialParameters& parameters, const std::vector<Texture>& textures, ShaderManager& shaders, ShaderHandle baseShader, uint32_t extraFeatures)
+	: id(nextID++), textures(textures), parameters(parameters)
+{
+	if (GLAD_GL_VERSION_4_5)
+	{
+		glCreateBuffers(1, &uniformBuffer);
+		glNamedBufferStorage(uniformBuffer, sizeof(MaterialParameters), &parameters, 0);
+	}
+	else
+	{
+		glGenBuffers(1, &uniformBuffer);
+		GLState::BindBuffer(GL_UNIFORM_BUFFER, uniformBuffer);
+		glBufferData(GL_UNIFORM_BUFFER, sizeof(MaterialParameters), &parameters, GL_STATIC_DRAW);
+		GLState::BindBuffer(GL_UNIFORM_BUFFER, 0);
+	}
+
+	uint32_t features = buildSamplers() | extraFeatures;
+	shader = shaders.LoadVariant(shaders.GetFilePath(baseShader), features, baseShader);
+}
+
+Material::~Material()
+{
+	GLState::DeleteBuffer(uniformBuffer);
+}
+
+void Material::Bind() const
+{
+	for (const SamplerBinding& sampler : samplers)
+	{
+		GLState::BindTexture(sampler.unit, GL_TEXTURE_2D, sampler.texture);
+	}
+	GLState::BindBufferBase(GL_UNIFORM_BUFFER, BlockBinding, uniformBuffer);
+}
+
+void Material::RegisterBindings(ShaderManager& shaders)
+{
+	shaders.AddUniformBlockBinding("Material", BlockBinding);
+
+	// every material maps a sampler name to the same unit, so the sampler uniforms are
+	// written once per program and never at draw time
+	const unsigned int diffuseSamplers = 3;
+	const unsigned int specularSamplers = 2;
+	for (unsigned int number = 1; number <= diffuseSamplers; number++)
+		shaders.AddSamplerUnit("texture_diffuse" + std::to_string(number), samplerUnit("texture_diffuse", number));
+	for (unsigned int number = 1; number <= specularSamplers; number++)
+		shaders.AddSamplerUnit("texture_specular" + std::to_string(number), samplerUnit("texture_specular", number));
+	shaders.AddSamplerUnit("lightmap", LightmapUnit);
+}
+
+uint32_t Material::buildSamplers()
+{
+	uint32_t features = ShaderFeature::None;
+	unsigned int diffuseNr = 1;
+	unsigned int specularNr = 1;
+	for (const Texture& texture : textures)
+	{
+		if (texture.type == "texture_diffuse" && diffuseNr <= 3)
+		{
+			samplers.push_back({ samplerUnit(texture.type, diffuseNr++), texture.id });
+			features |= ShaderFeature::DiffuseMap;
+		}
+		else if (texture.type == "texture_specular" && specularNr <= 2)
+		{
+			samplers.push_back({ samplerUnit(texture.type, specularNr++), texture.id });
+			features |= ShaderFeature::SpecularMap;
+		}
+	}
+	// variants without HAS_DIFFUSE_MAP never read it, but indirect.shader always samples
+	// texture_diffuse1 and would otherwise see the previous batch's texture
+	if (diffuseNr == 1)
+		samplers.push_back({ samplerUnit("texture_diffuse", 1), defaultDiffuse() });
+	return features;
+}
+
+GLuint Material::defaultDiffuse()
+{
+	static GLuint texture = 0;
+	if (texture)
+		return texture;
+
+	const unsigned char white[4] = { 255, 255, 255, 255 };
+	if (GLAD_GL_VERSION_4_5)
+	{
+		glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+		glTextureStorage2D(texture, 1, GL_RGBA8, 1, 1);
+		glTextureSubImage2D(texture, 0, 0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, white);
+	}
+	else
+	{
+		glGenTextures(1, &texture);
+		GLState::BindTexture(0, GL_TEXTURE_2D, texture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, white);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	}
+	return texture;
+}
+
+GLuint Material::samplerUnit(const std::string& type, unsigned int number)
+{
+	// texture_diffuse1..3 use units 0..2, texture_specular1..2 use units 3..4
+	const GLuint specularBase = 3;
+	if (type == "texture_specular")
+		return specularBase + number - 1;
+	return number - 1;
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+#include "ShaderManager.h"
+
+struct Texture {
+	unsigned int id;
+	std::string path;
+	std::string type;
+};
+
+// std140 layout of the "Material" uniform block in texture.shader
+struct MaterialParameters {
+	glm::vec4 Ambient;   // Ka
+	glm::vec4 Specular;  // Ks
+	float Shininess;     // Ns
+	float Opacity;       // d
+	float padding[2];
+};
+
+struct SamplerBinding {
+	GLuint unit;
+	GLuint texture;
+};
+
+class Material
+{
+public:
+	// uniform buffer binding point shared by every material
+	static constexpr GLuint BlockBinding = 1;
+	// texture unit of a baked mesh's lightmap, after the five material samplers
+	static constexpr GLuint LightmapUnit = 5;
+
+	// requests the cheapest variant of baseShader's file that covers the material's textures,
+	// plus any extra features; baseShader is used until the variant has compiled
+	Material(const MaterialParameters& parameters, const std::vector<Texture>& textures, ShaderManager& shaders, ShaderHandle baseShader, uint32_t extraFeatures = ShaderFeature::None);
+	~Material();
+
+	Material(const Material&) = delete;
+	Material& operator=(const Material&) = delete;
+
+	// binds the prebuilt sampler table and the parameter block, no lookups involved
+	void Bind() const;
+
+	// registers the material block and sampler units with every program the manager builds
+	static void RegisterBindings(ShaderManager& shaders);
+
+	unsigned int GetID() const { return id; }
+	ShaderHandle GetShader() const { return shader; }
+	const MaterialParameters& GetParameters() const { return parameters; }
+	const std::vector<Texture>& GetTextures() const { return textures; }
+	bool IsTransparent() const { return parameters.Opacity < 1.0f; }
+
+private:
+	static unsigned int nextID;
+
+	unsigned int id;
+	std::vector<Texture> textures;
+	std::vector<SamplerBinding> samplers;
+	MaterialParameters parameters;
+	GLuint uniformBuffer = 0;
+	ShaderHandle shader;
+
+	uint32_t buildSamplers();
+	static GLuint samplerUnit(const std::string& type, unsigned int number);
+	// 1x1 white, bound to texture_diffuse1 by materials without a diffuse map; created on first use
+	static GLuint defaultDiffuse();
+};
@@ -1,71 +1,208 @@
 #include <glad/glad.h>
 #include "Mesh.h"
 #include "Shader.h"
+#include "GLState.h"
+#include "Lightmap.h"
+#include "VertexLayout.h"
 
-Mesh::Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures, Shader& shader)
-	: shaderptr(shader)
+#include <cstring>
+
+Mesh::Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::shared_ptr<Material> material, Shader& shader, const std::vector<glm::vec2>& lightmapCoords, std::shared_ptr<LightmapTexture> lightmap, std::vector<SkinVertex> skin)
+	: shaderptr(shader), skin(std::move(skin)), lightmap(std::move(lightmap))
 {
 	this->vertices = vertices;
 	this->indices = indices;
-	this->textures = textures;
-	setupMesh();
+	this->material = material;
+
+	glm::vec3 minBounds(0.0f), maxBounds(0.0f);
+	if (!this->vertices.empty())
+		minBounds = maxBounds = this->vertices[0].Position;
+	for (const Vertex& vertex : this->vertices)
+	{
+		minBounds = glm::min(minBounds, vertex.Position);
+		maxBounds = glm::max(maxBounds, vertex.Position);
+	}
+	center = (minBounds + maxBounds) * 0.5f;
+	extents = (maxBounds - minBounds) * 0.5f;
+
+	setupMesh(lightmapCoords);
 }
 	
-void Mesh::Draw(Shader& shader)
+void Mesh::Draw() const
+{
+	BindMaterial();
+
+	// draw mesh; bindings stay in place, the next draw only changes what differs
+	GLState::BindVertexArray(VAO);
+	glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0);
+}
+
+void Mesh::DrawInstanced(GLsizei instanceCount) const
 {
-	shaderptr = shader;
-	unsigned int diffuseNr = 1;
-	for (unsigned int i = 0; i < textures.size(); i++)
+	BindMaterial();
+
+	GLState::BindVertexArray(VAO);
+	glDrawElementsInstanced(GL_TRIANGLES, static_cast<GLsizei>(indices.size()), GL_UNSIGNED_INT, 0, instanceCount);
+}
+
+void Mesh::SetInstanceBuffer(GLuint buffer, GLuint location)
+{
+	if (GLAD_GL_VERSION_4_5)
 	{
-		glActiveTexture(GL_TEXTURE0 + i);
-		std::string number;
-		std::string name = textures[i].type;
-		if (name == "texture_diffuse")
-			number = std::to_string(diffuseNr++);
-
-		// now set the sampler to the correct texture unit
-		glUniform1i(glGetUniformLocation(shaderptr.getProgram(), (name + number).c_str()), i);
-		// and finally bind the texture
-		glBindTexture(GL_TEXTURE_2D, textures[i].id);
+		glVertexArrayVertexBuffer(VAO, InstanceBinding, buffer, 0, sizeof(glm::mat4));
+		glVertexArrayBindingDivisor(VAO, InstanceBinding, 1);
+
+		// a mat4 attribute occupies four consecutive vec4 locations
+		for (GLuint column = 0; column < 4; column++)
+		{
+			glEnableVertexArrayAttrib(VAO, location + column);
+			glVertexArrayAttribFormat(VAO, location + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4) * column);
+			glVertexArrayAttribBinding(VAO, location + column, InstanceBinding);
+		}
+		return;
 	}
 
-	// draw mesh
-	glBindVertexArray(VAO);
-	glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0);
-	glBindVertexArray(0);
+	GLState::BindVertexArray(VAO);
+	GLState::BindBuffer(GL_ARRAY_BUFFER, buffer);
 
-	// always good practice to set everything back to defaults once configured.
-	glActiveTexture(GL_TEXTURE0);
+	for (GLuint column = 0; column < 4; column++)
+	{
+		glEnableVertexAttribArray(location + column);
+		glVertexAttribPointer(location + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(sizeof(glm::vec4) * column));
+		glVertexAttribDivisor(location + column, 1);
+	}
+
+	GLState::BindVertexArray(0);
 }
 
+void Mesh::SetTransformIndexBuffer(GLuint buffer)
+{
+	for (GLuint vao : { VAO, depthVAO })
+	{
+		if (GLAD_GL_VERSION_4_5)
+		{
+			glVertexArrayVertexBuffer(vao, TransformIndexBinding, buffer, 0, sizeof(GLuint));
+			glVertexArrayBindingDivisor(vao, TransformIndexBinding, 1);
+			glEnableVertexArrayAttrib(vao, VertexAttribute::DrawID);
+			glVertexArrayAttribIFormat(vao, VertexAttribute::DrawID, 1, GL_UNSIGNED_INT, 0);
+			glVertexArrayAttribBinding(vao, VertexAttribute::DrawID, TransformIndexBinding);
+			continue;
+		}
 
-void Mesh::setupMesh()
+		GLState::BindVertexArray(vao);
+		GLState::BindBuffer(GL_ARRAY_BUFFER, buffer);
+		glEnableVertexAttribArray(VertexAttribute::DrawID);
+		glVertexAttribIPointer(VertexAttribute::DrawID, 1, GL_UNSIGNED_INT, sizeof(GLuint), (void*)0);
+		glVertexAttribDivisor(VertexAttribute::DrawID, 1);
+		GLState::BindVertexArray(0);
+	}
+}
+
+void Mesh::SetVertexStreams(GLuint buffer, GLintptr positionOffset, GLintptr surfaceOffset)
 {
+	if (GLAD_GL_VERSION_4_5)
+	{
+		glVertexArrayVertexBuffer(VAO, VertexBinding, buffer, positionOffset, sizeof(PositionVertex));
+		glVertexArrayVertexBuffer(VAO, SurfaceBinding, buffer, surfaceOffset, sizeof(SurfaceVertex));
+		return;
+	}
+
+	// without separate formats the pointers are set again against the new buffer
+	GLState::BindVertexArray(VAO);
+	GLState::BindBuffer(GL_ARRAY_BUFFER, buffer);
+	SetVertexAttribPointers<PositionVertex>(positionOffset);
+	SetVertexAttribPointers<SurfaceVertex>(surfaceOffset);
+	GLState::BindVertexArray(0);
+}
+
+void Mesh::BindMaterial() const
+{
+	if (material)
+		material->Bind();
+	if (lightmap)
+		lightmap->Bind();
+}
+
+void Mesh::setupMesh(const std::vector<glm::vec2>& lightmapCoords)
+{
+	// positions and surface attributes as two streams of one buffer; the depth VAO only
+	// sees the first
+	std::vector<unsigned char> streams;
+	const size_t surfaceOffset = WriteVertexStreams(vertices, streams);
+
+	// a baked mesh appends its lightmap coordinates as a third stream
+	const bool lightmapped = lightmap && lightmapCoords.size() == vertices.size();
+	const size_t lightmapOffset = streams.size();
+	if (lightmapped)
+	{
+		streams.resize(lightmapOffset + lightmapCoords.size() * sizeof(LightmapVertex));
+		std::memcpy(streams.data() + lightmapOffset, lightmapCoords.data(), lightmapCoords.size() * sizeof(LightmapVertex));
+	}
+	// and a rigged one its joints and weights
+	const bool skinned = !skin.empty() && skin.size() == vertices.size();
+	const size_t skinOffset = streams.size();
+	if (skinned)
+	{
+		streams.resize(skinOffset + skin.size() * sizeof(SkinVertex));
+		std::memcpy(streams.data() + skinOffset, skin.data(), skin.size() * sizeof(SkinVertex));
+	}
+	const GLsizeiptr indexBytes = indices.size() * sizeof(unsigned int);
+
+	if (GLAD_GL_VERSION_4_5)
+	{
+		// immutable storage, filled once and never bound to be edited
+		glCreateBuffers(1, &VBO);
+		glNamedBufferStorage(VBO, streams.size(), streams.data(), 0);
+		glCreateBuffers(1, &EBO);
+		glNamedBufferStorage(EBO, indexBytes, indices.data(), 0);
+
+		glCreateVertexArrays(1, &VAO);
+		glVertexArrayVertexBuffer(VAO, VertexBinding, VBO, 0, sizeof(PositionVertex));
+		glVertexArrayVertexBuffer(VAO, SurfaceBinding, VBO, surfaceOffset, sizeof(SurfaceVertex));
+		glVertexArrayElementBuffer(VAO, EBO);
+		SetVertexArrayFormat<PositionVertex>(VAO, VertexBinding);
+		SetVertexArrayFormat<SurfaceVertex>(VAO, SurfaceBinding);
+		if (lightmapped)
+		{
+			glVertexArrayVertexBuffer(VAO, LightmapBinding, VBO, lightmapOffset, sizeof(LightmapVertex));
+			SetVertexArrayFormat<LightmapVertex>(VAO, LightmapBinding);
+		}
+		if (skinned)
+		{
+			glVertexArrayVertexBuffer(VAO, SkinBinding, VBO, skinOffset, sizeof(SkinVertex));
+			SetVertexArrayFormat<SkinVertex>(VAO, SkinBinding);
+		}
+
+		glCreateVertexArrays(1, &depthVAO);
+		glVertexArrayVertexBuffer(depthVAO, VertexBinding, VBO, 0, sizeof(PositionVertex));
+		glVertexArrayElementBuffer(depthVAO, EBO);
+		SetVertexArrayFormat<PositionVertex>(depthVAO, VertexBinding);
+		return;
+	}
+
 	glGenVertexArrays(1, &VAO);
+	glGenVertexArrays(1, &depthVAO);
 	glGenBuffers(1, &VBO);
 	glGenBuffers(1, &EBO);
 
-	glBindVertexArray(VAO);
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-
-	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+	GLState::BindVertexArray(VAO);
+	GLState::BindBuffer(GL_ARRAY_BUFFER, VBO);
 
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+	glBufferData(GL_ARRAY_BUFFER, streams.size(), streams.data(), GL_STATIC_DRAW);
 
-	// vertex positions
-	GLint posAttrib = shaderptr.GetAttribLocation("position");
-	glEnableVertexAttribArray(posAttrib);
-	glVertexAttribPointer(posAttrib, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+	GLState::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBytes, indices.data(), GL_STATIC_DRAW);
 
-	// vertex normals
-	GLint texCoordAttrib = shaderptr.GetAttribLocation("texCoord");
-	glEnableVertexAttribArray(texCoordAttrib);
-	glVertexAttribPointer(texCoordAttrib, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+	SetVertexAttribPointers<PositionVertex>();
+	SetVertexAttribPointers<SurfaceVertex>(surfaceOffset);
+	if (lightmapped)
+		SetVertexAttribPointers<LightmapVertex>(lightmapOffset);
+	if (skinned)
+		SetVertexAttribPointers<SkinVertex>(skinOffset);
 
-	GLint normalsAttrib = shaderptr.GetAttribLocation("normal");
-	glEnableVertexAttribArray(normalsAttrib);
-	glVertexAttribPointer(normalsAttrib, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+	GLState::BindVertexArray(depthVAO);
+	GLState::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+	SetVertexAttribPointers<PositionVertex>();
 
-	glBindVertexArray(0);
+	GLState::BindVertexArray(0);
 }
@@ -4,18 +4,18 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <vector>
 #include <string>
+#include <memory>
 #include "Shader.h"
+#include "Material.h"
+#include "Vertex.h"
 
-struct Vertex {
-	glm::vec3 Position;
-	glm::vec3 Normal;
-	glm::vec2 TexCoords;
-};
+class LightmapTexture;
 
-struct Texture {
-	unsigned int id;
-	std::string path;
-	std::string type;
+// location of a mesh inside a GeometryPool
+struct MeshRange {
+	unsigned int firstIndex = 0;
+	unsigned int indexCount = 0;
+	int baseVertex = 0;
 };
 
 class Mesh
@@ -26,15 +26,59 @@ public:
 	// mesh data
 	std::vector<Vertex>       vertices;
 	std::vector<unsigned int> indices;
-	std::vector<Texture>      textures;
+	std::shared_ptr<Material> material;
+	// joints and weights per vertex of a rigged mesh, empty otherwise
+	std::vector<SkinVertex>   skin;
+
+
+	// a baked mesh also takes one lightmap coordinate per vertex and the atlas they map into,
+	// a rigged one its skin
+	Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::shared_ptr<Material> material, Shader& shader, const std::vector<glm::vec2>& lightmapCoords = {}, std::shared_ptr<LightmapTexture> lightmap = nullptr, std::vector<SkinVertex> skin = {});
+	void Draw() const;
+	void DrawInstanced(GLsizei instanceCount) const;
+	void BindMaterial() const;
+	// sources a per-instance mat4 attribute from buffer, one matrix per instance
+	void SetInstanceBuffer(GLuint buffer, GLuint location = VertexAttribute::InstanceModel);
+	// sources positions and surface attributes from buffer instead, e.g. vertices skinned on
+	// the CPU; the skin and lightmap streams stay where they are
+	void SetVertexStreams(GLuint buffer, GLintptr positionOffset, GLintptr surfaceOffset);
+	// sources the per-instance DrawID attribute of both VAOs from buffer, a TransformBuffer's
+	// index buffer, so TRANSFORM_BUFFER variants find their slot in the draw's baseInstance
+	void SetTransformIndexBuffer(GLuint buffer);
+
+	unsigned int GetVAO() const { return VAO; }
+	// the same geometry with the position stream alone, for depth-only passes
+	unsigned int GetDepthVAO() const { return depthVAO; }
+	unsigned int GetIndexCount() const { return static_cast<unsigned int>(indices.size()); }
+	// identifies the material for render queue sorting
+	unsigned int GetMaterialKey() const { return material ? material->GetID() : 0; }
+	const glm::vec3& GetCenter() const { return center; }
+	// half the size of the object-space bounding box around GetCenter
+	const glm::vec3& GetExtents() const { return extents; }
 
+	bool HasLightmap() const { return lightmap != nullptr; }
+	bool HasSkin() const { return !skin.empty(); }
 
-	Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures, Shader& shader);
-	void Draw(Shader& shader);
+	void SetPoolRange(const MeshRange& range) { poolRange = range; pooled = true; }
+	bool IsPooled() const { return pooled; }
+	const MeshRange& GetPoolRange() const { return poolRange; }
 private:
 	//  render data
-	unsigned int VAO, VBO, EBO;
+	unsigned int VAO, depthVAO, VBO, EBO;
+	// vertex buffer binding points of the VAO: positions, instance matrices, surface
+	// attributes, lightmap coordinates, joints and weights, transform slots
+	static constexpr GLuint VertexBinding = 0;
+	static constexpr GLuint InstanceBinding = 1;
+	static constexpr GLuint SurfaceBinding = 2;
+	static constexpr GLuint LightmapBinding = 3;
+	static constexpr GLuint SkinBinding = 4;
+	static constexpr GLuint TransformIndexBinding = 5;
+	std::shared_ptr<LightmapTexture> lightmap;
+	glm::vec3 center;
+	glm::vec3 extents;
+	MeshRange poolRange;
+	bool pooled = false;
 
-	void setupMesh();
+	void setupMesh(const std::vector<glm::vec2>& lightmapCoords);
 };
 
@@ -0,0 +1,397 @@
+#include "ModelLoader.h"
+#include "JobSystem.h"
+#include "VertexConversion.h"
+#include "stb_image.h"
+
+#include <Assimp/postprocess.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+	// Assimp matrices are row-major, glm ones column-major
+	glm::mat4 toMat4(const aiMatrix4x4& matrix)
+	{
+		glm::mat4 result;
+		for (int row = 0; row < 4; row++)
+		{
+			for (int column = 0; column < 4; column++)
+				result[column][row] = matrix[row][column];
+		}
+		return result;
+	}
+
+	glm::vec4 toVec4(const aiVector3D& vector)
+	{
+		return glm::vec4(vector.x, vector.y, vector.z, 0.0f);
+	}
+
+	glm::vec4 toVec4(const aiQuaternion& quaternion)
+	{
+		return glm::vec4(quaternion.x, quaternion.y, quaternion.z, quaternion.w);
+	}
+
+	// keys are in ticks, the clip keeps seconds
+	template <typename Key>
+	void addTrack(AnimationClip& clip, size_t track, const Key* keys, unsigned int count, double ticksPerSecond)
+	{
+		clip.tracks[track] = { static_cast<uint32_t>(clip.times.size()), count };
+		for (unsigned int i = 0; i < count; i++)
+		{
+			clip.times.push_back(static_cast<float>(keys[i].mTime / ticksPerSecond));
+			clip.values.push_back(toVec4(keys[i].mValue));
+		}
+	}
+}
+
+void ImageDeleter::operator()(unsigned char* pixels) const
+{
+	stbi_image_free(pixels);
+}
+
+ModelLoader::ModelLoader(bool flipTextures)
+	: flipTextures(flipTextures)
+{
+}
+
+bool ModelLoader::Import(const std::string& path)
+{
+	error.clear();
+	materialIndex.clear();
+	imageIndex.clear();
+	jointIndex.clear();
+	paletteIndex.clear();
+
+	// at most four weights per vertex, the most a SkinVertex holds
+	scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace | aiProcess_LimitBoneWeights);
+	if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
+	{
+		error = importer.GetErrorString();
+		scene = nullptr;
+		return false;
+	}
+
+	directory = path.substr(0, path.find_last_of('/'));
+	return true;
+}
+
+void ModelLoader::ConvertMeshes(ModelData& model)
+{
+	if (!scene)
+		return;
+
+	// the walk and the materials share lookup tables and stay serial; the vertex and index
+	// arrays are independent per mesh
+	std::vector<const aiMesh*> aimeshes;
+	std::vector<const aiNode*> ainodes;
+	processNode(scene->mRootNode, aimeshes, ainodes, model);
+
+	// the skeleton is serial too, the meshes only look their bones up in it
+	std::vector<unsigned int> rigidEntries(aimeshes.size(), 0);
+	bool rigged = std::any_of(aimeshes.begin(), aimeshes.end(), [](const aiMesh* aimesh) { return aimesh->HasBones(); });
+	if (rigged)
+	{
+		buildSkeleton(aimeshes, ainodes, rigidEntries, model.animations.skeleton);
+		convertClips(model.animations);
+	}
+
+	size_t first = model.meshes.size();
+	model.meshes.resize(first + aimeshes.size());
+	JobSystem::ParallelFor(aimeshes.size(), 1, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++)
+			processMesh(aimeshes[i], rigidEntries[i], model.meshes[first + i]);
+	});
+}
+
+void ModelLoader::DecodeTextures(ModelData& model)
+{
+	JobSystem::ParallelFor(model.images.size(), 1, [&](size_t begin, size_t end) {
+		// the flag is per thread, the jobs may run anywhere
+		stbi_set_flip_vertically_on_load_thread(flipTextures);
+		for (size_t i = begin; i < end; i++)
+		{
+			ImageData& image = model.images[i];
+			std::string filename = directory + '/' + image.path;
+			image.pixels.reset(stbi_load(filename.c_str(), &image.width, &image.height, &image.components, 0));
+			if (!image.pixels)
+				image.width = image.height = image.components = 0;
+		}
+	});
+}
+
+void ModelLoader::ReleaseScene()
+{
+	importer.FreeScene();
+	scene = nullptr;
+}
+
+bool ModelLoader::Load(const std::string& path, ModelData& model)
+{
+	if (!Import(path))
+		return false;
+	ConvertMeshes(model);
+	ReleaseScene();
+	DecodeTextures(model);
+	return true;
+}
+
+void ModelLoader::processNode(const aiNode* ainode, std::vector<const aiMesh*>& aimeshes, std::vector<const aiNode*>& ainodes, ModelData& model)
+{
+	for (unsigned int i = 0; i < ainode->mNumMeshes; i++)
+	{
+		const aiMesh* mesh = scene->mMeshes[ainode->mMeshes[i]];
+		aimeshes.push_back(mesh);
+		ainodes.push_back(ainode);
+		processMaterial(mesh->mMaterialIndex, model);
+	}
+
+	for (unsigned int i = 0; i < ainode->mNumChildren; i++)
+	{
+		processNode(ainode->mChildren[i], aimeshes, ainodes, model);
+	}
+}
+
+void ModelLoader::processMesh(const aiMesh* aimesh, unsigned int rigidEntry, MeshData& mesh) const
+{
+	// sized exactly up front and filled in place
+	mesh.vertices.resize(aimesh->mNumVertices);
+	ConvertVertices(*aimesh, mesh.vertices.data());
+	mesh.indices.resize(CountIndices(*aimesh));
+	ConvertIndices(*aimesh, mesh.indices.data());
+
+	mesh.material = materialIndex.at(aimesh->mMaterialIndex);
+
+	if (jointIndex.empty())
+		return;
+
+	mesh.skin.assign(aimesh->mNumVertices, SkinVertex{ { static_cast<uint16_t>(rigidEntry), 0, 0, 0 }, { 255, 0, 0, 0 } });
+	if (!aimesh->HasBones())
+		return;
+
+	// the four heaviest influences per vertex; LimitBoneWeights already drops the rest
+	// unless the importer skipped it
+	std::vector<float> weights(aimesh->mNumVertices * 4, 0.0f);
+	std::vector<unsigned int> entries(aimesh->mNumVertices * 4, 0);
+	for (unsigned int b = 0; b < aimesh->mNumBones; b++)
+	{
+		const aiBone* bone = aimesh->mBones[b];
+		unsigned int entry = paletteIndex.at(bone->mName.C_Str());
+		for (unsigned int w = 0; w < bone->mNumWeights; w++)
+		{
+			const aiVertexWeight& weight = bone->mWeights[w];
+			float* slots = &weights[weight.mVertexId * 4];
+			size_t lightest = std::min_element(slots, slots + 4) - slots;
+			if (weight.mWeight > slots[lightest])
+			{
+				slots[lightest] = weight.mWeight;
+				entries[weight.mVertexId * 4 + lightest] = entry;
+			}
+		}
+	}
+
+	// quantized so the four always add up to 255; rounding leftovers go to the heaviest
+	unsigned int firstEntry = paletteIndex.at(aimesh->mBones[0]->mName.C_Str());
+	for (unsigned int v = 0; v < aimesh->mNumVertices; v++)
+	{
+		const float* slots = &weights[v * 4];
+		SkinVertex& skin = mesh.skin[v];
+		float total = slots[0] + slots[1] + slots[2] + slots[3];
+		if (total <= 0.0f)
+		{
+			// a vertex no bone weights follows the mesh's first bone
+			skin.Joints[0] = static_cast<uint16_t>(firstEntry);
+			continue;
+		}
+
+		int sum = 0;
+		for (int j = 0; j < 4; j++)
+		{
+			int quantized = static_cast<int>(std::lround(slots[j] / total * 255.0f));
+			skin.Joints[j] = static_cast<uint16_t>(entries[v * 4 + j]);
+			skin.Weights[j] = static_cast<uint8_t>(quantized);
+			sum += quantized;
+		}
+		size_t heaviest = std::max_element(slots, slots + 4) - slots;
+		skin.Weights[heaviest] = static_cast<uint8_t>(skin.Weights[heaviest] + 255 - sum);
+	}
+}
+
+void ModelLoader::buildSkeleton(const std::vector<const aiMesh*>& aimeshes, const std::vector<const aiNode*>& ainodes, std::vector<unsigned int>& rigidEntries, Skeleton& skeleton)
+{
+	// every node a bone, a channel or a mesh names is a joint, and so are its ancestors so
+	// each joint's parent transform comes out of the hierarchy walk
+	std::unordered_set<std::string> names;
+	for (const aiMesh* aimesh : aimeshes)
+	{
+		for (unsigned int b = 0; b < aimesh->mNumBones; b++)
+			names.insert(aimesh->mBones[b]->mName.C_Str());
+	}
+	for (const aiNode* ainode : ainodes)
+		names.insert(ainode->mName.C_Str());
+	for (unsigned int a = 0; a < scene->mNumAnimations; a++)
+	{
+		const aiAnimation* aianimation = scene->mAnimations[a];
+		for (unsigned int c = 0; c < aianimation->mNumChannels; c++)
+			names.insert(aianimation->mChannels[c]->mNodeName.C_Str());
+	}
+
+	std::unordered_set<const aiNode*> joints;
+	markJoints(scene->mRootNode, names, joints);
+
+	std::vector<const aiNode*> order;
+	skeleton.restPose = MakeIdentityPose(joints.size());
+	addJoints(scene->mRootNode, -1, joints, order, skeleton);
+
+	std::unordered_map<const aiNode*, unsigned int> nodeJoint;
+	for (size_t joint = 0; joint < order.size(); joint++)
+		nodeJoint[order[joint]] = static_cast<unsigned int>(joint);
+
+	// a bone shared by several meshes gets one entry; a mesh without bones gets one for
+	// its node, whose transform already puts the mesh in place
+	std::unordered_map<const aiNode*, unsigned int> rigidIndex;
+	for (size_t i = 0; i < aimeshes.size(); i++)
+	{
+		const aiMesh* aimesh = aimeshes[i];
+		if (!aimesh->HasBones())
+		{
+			auto [found, inserted] = rigidIndex.try_emplace(ainodes[i], static_cast<unsigned int>(skeleton.paletteJoints.size()));
+			if (inserted)
+			{
+				skeleton.paletteJoints.push_back(nodeJoint.at(ainodes[i]));
+				skeleton.inverseBindMatrices.push_back(AffineMatrix::FromMat4(glm::mat4(1.0f)));
+			}
+			rigidEntries[i] = found->second;
+			continue;
+		}
+
+		for (unsigned int b = 0; b < aimesh->mNumBones; b++)
+		{
+			const aiBone* bone = aimesh->mBones[b];
+			auto [found, inserted] = paletteIndex.try_emplace(bone->mName.C_Str(), static_cast<unsigned int>(skeleton.paletteJoints.size()));
+			if (!inserted)
+				continue;
+			// a bone without a node of its name follows the root
+			auto joint = jointIndex.find(bone->mName.C_Str());
+			skeleton.paletteJoints.push_back(joint != jointIndex.end() ? joint->second : 0);
+			skeleton.inverseBindMatrices.push_back(AffineMatrix::FromMat4(toMat4(bone->mOffsetMatrix)));
+		}
+	}
+}
+
+bool ModelLoader::markJoints(const aiNode* ainode, const std::unordered_set<std::string>& names, std::unordered_set<const aiNode*>& joints) const
+{
+	bool marked = names.count(ainode->mName.C_Str()) > 0;
+	for (unsigned int i = 0; i < ainode->mNumChildren; i++)
+	{
+		if (markJoints(ainode->mChildren[i], names, joints))
+			marked = true;
+	}
+	if (marked)
+		joints.insert(ainode);
+	return marked;
+}
+
+void ModelLoader::addJoints(const aiNode* ainode, int32_t parent, const std::unordered_set<const aiNode*>& joints, std::vector<const aiNode*>& order, Skeleton& skeleton)
+{
+	// the ancestors of a joint are joints, so nothing below a node that is not one is either
+	if (!joints.count(ainode))
+		return;
+
+	int32_t joint = static_cast<int32_t>(order.size());
+	order.push_back(ainode);
+	skeleton.names.push_back(ainode->mName.C_Str());
+	skeleton.parents.push_back(parent);
+	// with duplicate names the first node wins
+	jointIndex.try_emplace(ainode->mName.C_Str(), static_cast<unsigned int>(joint));
+
+	aiVector3D scaling, position;
+	aiQuaternion rotation;
+	ainode->mTransformation.Decompose(scaling, rotation, position);
+	SetJointTransform(skeleton.restPose, joint, glm::vec3(position.x, position.y, position.z), toVec4(rotation), glm::vec3(scaling.x, scaling.y, scaling.z));
+
+	for (unsigned int i = 0; i < ainode->mNumChildren; i++)
+	{
+		addJoints(ainode->mChildren[i], joint, joints, order, skeleton);
+	}
+}
+
+void ModelLoader::convertClips(AnimationSet& animations) const
+{
+	size_t jointCount = animations.skeleton.GetJointCount();
+	for (unsigned int a = 0; a < scene->mNumAnimations; a++)
+	{
+		const aiAnimation* aianimation = scene->mAnimations[a];
+		// files that leave the rate out mean the common default
+		double ticksPerSecond = aianimation->mTicksPerSecond != 0.0 ? aianimation->mTicksPerSecond : 25.0;
+
+		AnimationClip clip;
+		clip.name = aianimation->mName.C_Str();
+		clip.duration = static_cast<float>(aianimation->mDuration / ticksPerSecond);
+		clip.tracks.resize(jointCount * AnimationClip::ChannelCount);
+		for (unsigned int c = 0; c < aianimation->mNumChannels; c++)
+		{
+			const aiNodeAnim* channel = aianimation->mChannels[c];
+			auto joint = jointIndex.find(channel->mNodeName.C_Str());
+			if (joint == jointIndex.end())
+				continue;
+			size_t track = joint->second * AnimationClip::ChannelCount;
+			addTrack(clip, track + AnimationClip::Translation, channel->mPositionKeys, channel->mNumPositionKeys, ticksPerSecond);
+			addTrack(clip, track + AnimationClip::Rotation, channel->mRotationKeys, channel->mNumRotationKeys, ticksPerSecond);
+			addTrack(clip, track + AnimationClip::Scale, channel->mScalingKeys, channel->mNumScalingKeys, ticksPerSecond);
+		}
+		animations.clips.push_back(std::move(clip));
+	}
+}
+
+unsigned int ModelLoader::processMaterial(unsigned int index, ModelData& model)
+{
+	// only materials a mesh actually uses are converted, each of them once
+	auto found = materialIndex.find(index);
+	if (found != materialIndex.end())
+		return found->second;
+
+	const aiMaterial* aimaterial = scene->mMaterials[index];
+
+	aiColor3D ambient(0.0f, 0.0f, 0.0f);
+	aiColor3D specular(0.0f, 0.0f, 0.0f);
+	float shininess = 0.0f;
+	float opacity = 1.0f;
+	aimaterial->Get(AI_MATKEY_COLOR_AMBIENT, ambient);
+	aimaterial->Get(AI_MATKEY_COLOR_SPECULAR, specular);
+	aimaterial->Get(AI_MATKEY_SHININESS, shininess);
+	aimaterial->Get(AI_MATKEY_OPACITY, opacity);
+
+	MaterialData material;
+	material.parameters.Ambient = glm::vec4(ambient.r, ambient.g, ambient.b, 1.0f);
+	material.parameters.Specular = glm::vec4(specular.r, specular.g, specular.b, 1.0f);
+	material.parameters.Shininess = shininess;
+	material.parameters.Opacity = opacity;
+	material.parameters.padding[0] = material.parameters.padding[1] = 0.0f;
+
+	addTextures(aimaterial, aiTextureType_DIFFUSE, "texture_diffuse", material, model);
+	addTextures(aimaterial, aiTextureType_SPECULAR, "texture_specular", material, model);
+
+	unsigned int converted = static_cast<unsigned int>(model.materials.size());
+	model.materials.push_back(std::move(material));
+	materialIndex[index] = converted;
+	return converted;
+}
+
+void ModelLoader::addTextures(const aiMaterial* aimaterial, aiTextureType type, const std::string& typeName, MaterialData& material, ModelData& model)
+{
+	for (unsigned int i = 0; i < aimaterial->GetTextureCount(type); i++)
+	{
+		aiString str;
+		aimaterial->GetTexture(type, i, &str);
+
+		// a texture with the same filepath is only decoded once
+		auto [found, inserted] = imageIndex.try_emplace(str.C_Str(), static_cast<unsigned int>(model.images.size()));
+		if (inserted)
+		{
+			ImageData image;
+			image.path = str.C_Str();
+			model.images.push_back(std::move(image));
+		}
+		material.textures.push_back({ typeName, found->second });
+	}
+}
@@ -0,0 +1,123 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <Assimp/Importer.hpp>
+#include <Assimp/scene.h>
+
+#include "Animation.h"
+#include "Material.h"
+#include "Vertex.h"
+
+struct ImageDeleter {
+	void operator()(unsigned char* pixels) const;
+};
+
+// one decoded image, exactly as stb_image returned it
+struct ImageData {
+	// as the material references it, relative to the model's directory
+	std::string path;
+	int width = 0;
+	int height = 0;
+	int components = 0;
+	std::unique_ptr<unsigned char, ImageDeleter> pixels;
+
+	size_t GetByteSize() const { return static_cast<size_t>(width) * height * components; }
+};
+
+struct MaterialTexture {
+	// sampler prefix, "texture_diffuse" or "texture_specular"
+	std::string type;
+	unsigned int image;
+};
+
+struct MaterialData {
+	MaterialParameters parameters;
+	std::vector<MaterialTexture> textures;
+};
+
+struct MeshData {
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	// index into ModelData::materials
+	unsigned int material;
+	// one per vertex once a LightmapData has been applied, empty before
+	std::vector<glm::vec2> lightmapCoords;
+	// one per vertex in a rigged model, empty in anything else
+	std::vector<SkinVertex> skin;
+};
+
+// Everything a model needs before it reaches the GPU.
+struct ModelData {
+	std::vector<MeshData> meshes;
+	std::vector<MaterialData> materials;
+	std::vector<ImageData> images;
+	// no joints unless some mesh has bones
+	AnimationSet animations;
+};
+
+// Loads a model file into plain CPU-side data without touching GL, in three stages that
+// can be timed on their own: Import parses the file with Assimp, ConvertMeshes flattens
+// the node hierarchy into vertex/index arrays and the materials that are actually used,
+// and DecodeTextures reads every referenced image once. The last two spread their work
+// over the JobSystem.
+//
+// A model where some mesh has bones also gets a skeleton and its clips. The joints are
+// the nodes that bones, animation channels and meshes refer to, with their ancestors.
+// Every mesh of such a model is skinned: a mesh without bones gets a palette entry for
+// its own node and follows it rigidly.
+class ModelLoader
+{
+public:
+	explicit ModelLoader(bool flipTextures);
+
+	ModelLoader(const ModelLoader&) = delete;
+	ModelLoader& operator=(const ModelLoader&) = delete;
+
+	// false (and GetError) if Assimp could not produce a complete scene
+	bool Import(const std::string& path);
+	void ConvertMeshes(ModelData& model);
+	void DecodeTextures(ModelData& model);
+	// frees the imported scene; ConvertMeshes needs it, DecodeTextures does not
+	void ReleaseScene();
+
+	// all three stages
+	bool Load(const std::string& path, ModelData& model);
+
+	const std::string& GetError() const { return error; }
+	const std::string& GetDirectory() const { return directory; }
+	// the imported scene, between Import and ReleaseScene
+	const aiScene* GetScene() const { return scene; }
+
+private:
+	Assimp::Importer importer;
+	const aiScene* scene = nullptr;
+	bool flipTextures;
+	std::string directory;
+	std::string error;
+
+	// aiScene material index -> ModelData::materials index
+	std::unordered_map<unsigned int, unsigned int> materialIndex;
+	// image path -> ModelData::images index
+	std::unordered_map<std::string, unsigned int> imageIndex;
+	// node name -> Skeleton joint, and bone name -> skin palette entry
+	std::unordered_map<std::string, unsigned int> jointIndex;
+	std::unordered_map<std::string, unsigned int> paletteIndex;
+
+	// collects the meshes in node order, with the node of each, and converts the materials they use
+	void processNode(const aiNode* ainode, std::vector<const aiMesh*>& aimeshes, std::vector<const aiNode*>& ainodes, ModelData& model);
+	// runs on the job system, one mesh per call; rigidEntry is the palette entry of a mesh
+	// without bones in a rigged model
+	void processMesh(const aiMesh* aimesh, unsigned int rigidEntry, MeshData& mesh) const;
+	// the skeleton and palette, and the entry each mesh without bones follows
+	void buildSkeleton(const std::vector<const aiMesh*>& aimeshes, const std::vector<const aiNode*>& ainodes, std::vector<unsigned int>& rigidEntries, Skeleton& skeleton);
+	// true if ainode or anything below it is named in names
+	bool markJoints(const aiNode* ainode, const std::unordered_set<std::string>& names, std::unordered_set<const aiNode*>& joints) const;
+	void addJoints(const aiNode* ainode, int32_t parent, const std::unordered_set<const aiNode*>& joints, std::vector<const aiNode*>& order, Skeleton& skeleton);
+	void convertClips(AnimationSet& animations) const;
+	unsigned int processMaterial(unsigned int index, ModelData& model);
+	void addTextures(const aiMaterial* aimaterial, aiTextureType type, const std::string& typeName, MaterialData& material, ModelData& model);
+};
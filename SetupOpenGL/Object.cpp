@@ -1,4 +1,9 @@
 #include "Object.h"
+#include "GLState.h"
+#include "FrameArena.h"
+#include "Lightmap.h"
+#include "ModelLoader.h"
+#include "Profiler.h"
 #include "stb_image.h"
 
 #include <glm/glm.hpp>
@@ -10,10 +15,56 @@
 #include <fstream>
 #include <sstream>
 #include <format>
+#include <algorithm>
+#include <cmath>
 
-Object::Object(std::string const& path, bool flipTextures, Shader& shader) : shaderptr(shader)
+namespace {
+	// uploads an 8-bit image and builds its full mip chain; GL 4.5 gets immutable storage
+	// sized for every level, older contexts respecify level 0 through the bound texture
+	GLuint createTexture2D(const unsigned char* data, int width, int height, int components, GLint minFilter)
+	{
+		GLenum format = GL_RGBA;
+		GLenum internalFormat = GL_RGBA8;
+		if (components == 1) { format = GL_RED; internalFormat = GL_R8; }
+		else if (components == 2) { format = GL_RG; internalFormat = GL_RG8; }
+		else if (components == 3) { format = GL_RGB; internalFormat = GL_RGB8; }
+
+		// rows of one and three channel images are not padded to four bytes
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+		GLuint texture = 0;
+		if (GLAD_GL_VERSION_4_5)
+		{
+			GLsizei levels = 1 + static_cast<GLsizei>(std::floor(std::log2(std::max(width, height))));
+
+			glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+			glTextureStorage2D(texture, levels, internalFormat, width, height);
+			glTextureSubImage2D(texture, 0, 0, 0, width, height, format, GL_UNSIGNED_BYTE, data);
+			glGenerateTextureMipmap(texture);
+
+			glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_REPEAT);
+			glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_REPEAT);
+			glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, minFilter);
+			glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			return texture;
+		}
+
+		glGenTextures(1, &texture);
+		GLState::BindTexture(0, GL_TEXTURE_2D, texture);
+		glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+		glGenerateMipmap(GL_TEXTURE_2D);
+
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, minFilter);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		return texture;
+	}
+}
+
+Object::Object(std::string const& path, bool flipTextures, ShaderManager& shaders, ShaderHandle shader, uint32_t shaderFeatures)
+	: shaders(shaders), baseShader(shader), shaderFeatures(shaderFeatures), shaderptr(shaders.Get(shader)), flipTextures(flipTextures)
 {
-	stbi_set_flip_vertically_on_load(flipTextures);
 	loadModel(path);
 	Position = glm::vec3(0.0f, 0.0f, 0.0f);
 	Scale = glm::vec3(1.0f, 1.0f, 1.0f);
@@ -21,27 +72,27 @@ Object::Object(std::string const& path, bool flipTextures, Shader& shader) : sha
 	SetScale(Scale);
 }
 
+Object::Object(std::vector<Mesh> meshes, ShaderManager& shaders, ShaderHandle shader)
+	: shaders(shaders), baseShader(shader), shaderFeatures(ShaderFeature::None), shaderptr(shaders.Get(shader)), flipTextures(false), meshes(std::move(meshes))
+{
+	Position = glm::vec3(0.0f, 0.0f, 0.0f);
+	Scale = glm::vec3(1.0f, 1.0f, 1.0f);
+	Translate(Position);
+	SetScale(Scale);
+}
+
 
 void Object::AddTexture(const char* texturePath)
 {
 	texture.push_back(0);
 
-	glGenTextures(1, &texture[texture.size() - 1]);
-	glBindTexture(GL_TEXTURE_2D, texture[texture.size() - 1]);
-
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
 	stbi_set_flip_vertically_on_load(true);
 
 	int width, height, nrChannels;
 	unsigned char* data = stbi_load(texturePath, &width, &height, &nrChannels, 4);
 	if (data)
 	{
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-		glGenerateMipmap(GL_TEXTURE_2D);
+		texture[texture.size() - 1] = createTexture2D(data, width, height, 4, GL_LINEAR);
 		std::cout << "Texture loaded successfully: " << texturePath << std::endl;
 	}
 	else
@@ -52,179 +103,178 @@ void Object::AddTexture(const char* texturePath)
 
 	std::string TextureAttribute = std::format("texture_diffuse{0}", texture.size() - 1);
 
-	textureLocation.push_back(shaderptr.GetUniformLocation(TextureAttribute));
+	textureLocation.push_back(shaderptr.GetUniform(TextureAttribute));
 
-	glUniform1i(textureLocation[texture.size() - 1], texture.size() - 1);
+	shaderptr.SetUniform(textureLocation[texture.size() - 1], static_cast<int>(texture.size() - 1));
 }
 
-void Object::Draw(Shader& shader)
+void Object::Draw()
 {
-	shaderptr.SetUniformMat4f("model", modelMatrix);
+	shaderptr.SetUniform(shaderptr.GetModelUniform(), modelMatrix);
 
 	for (unsigned int i = 0; i < meshes.size(); i++)
-		meshes[i].Draw(shader);
+		meshes[i].Draw();
 
 }
 
-
-void Object::loadModel(std::string path)
+void Object::SetTransformIndexBuffer(GLuint buffer)
 {
+	for (Mesh& mesh : meshes)
+		mesh.SetTransformIndexBuffer(buffer);
+}
 
-	Assimp::Importer importer;
-	const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
-
-	if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
+void Object::AddToPool(GeometryPool& pool)
+{
+	// the pool has no lightmap or skin stream, baked and rigged meshes keep drawing from
+	// their own buffers
+	for (Mesh& mesh : meshes)
 	{
-		std::cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << std::endl;
-		return;
+		if (!mesh.HasLightmap() && !mesh.HasSkin())
+			pool.Add(mesh);
 	}
+}
 
-	directory = path.substr(0, path.find_last_of('/'));
-
-	processNode(scene->mRootNode, scene);
+void Object::Submit(RenderQueue& queue, const glm::mat4& view, RenderPass pass) const
+{
+	Submit(queue, view, modelMatrix, nullptr, pass);
 }
 
-void Object::processNode(aiNode* ainode, const aiScene* aiscene)
+void Object::Submit(RenderQueue& queue, const glm::mat4& view, const glm::mat4& model, const Frustum* frustum, RenderPass pass) const
 {
-	for (unsigned int i = 0; i < ainode->mNumMeshes; i++)
-	{
-		aiMesh* mesh = aiscene->mMeshes[ainode->mMeshes[i]];
-		meshes.push_back(processMesh(mesh, aiscene));
-	}
+	submitRange(queue, this, &model, 1, view, frustum, pass);
+}
 
-	for (unsigned int i = 0; i < ainode->mNumChildren; i++)
-	{
-		processNode(ainode->mChildren[i], aiscene);
-	}
+void Object::SubmitAll(RenderQueue& queue, const std::vector<Object>& objects, const std::vector<glm::mat4>& models, const glm::mat4& view, const Frustum* frustum, RenderPass pass)
+{
+	submitRange(queue, objects.data(), models.data(), std::min(objects.size(), models.size()), view, frustum, pass);
 }
 
-Mesh Object::processMesh(aiMesh* aimesh, const aiScene* aiscene)
+void Object::submitRange(RenderQueue& queue, const Object* objects, const glm::mat4* models, size_t count, const glm::mat4& view, const Frustum* frustum, RenderPass pass)
 {
-	std::vector<Vertex> vertices;
-	std::vector<unsigned int> indices;
-	std::vector<Texture> textures;
+	PROFILE_SCOPE("Packet generation");
 
-	// walk through each of the mesh's vertices
-	for (unsigned int i = 0; i < aimesh->mNumVertices; i++)
-	{
-		Vertex vertex;
-		glm::vec3 vector;
+	// flat index of every object's first mesh, so a chunk can start in the middle of one
+	std::pmr::vector<size_t> firstMesh(count + 1, 0, FrameArena::GetThreadResource());
+	for (size_t i = 0; i < count; i++)
+		firstMesh[i + 1] = firstMesh[i] + objects[i].meshes.size();
 
-		vector.x = aimesh->mVertices[i].x;
-		vector.y = aimesh->mVertices[i].y;
-		vector.z = aimesh->mVertices[i].z;
-		vertex.Position = vector;
+	// small enough to balance objects of very different sizes, large enough that a chunk
+	// is worth a job
+	const size_t meshesPerJob = 256;
+	queue.PushParallel(firstMesh[count], meshesPerJob, [&](size_t begin, size_t end, std::vector<RenderPacket>& bucket) {
+		size_t object = std::upper_bound(firstMesh.begin(), firstMesh.end(), begin) - firstMesh.begin() - 1;
+		glm::mat4 modelView = view * models[object];
 
-		if (aimesh->HasNormals())
+		for (size_t i = begin; i < end; i++)
 		{
-			vector.x = aimesh->mNormals[i].x;
-			vector.y = aimesh->mNormals[i].y;
-			vector.z = aimesh->mNormals[i].z;
-			vertex.Normal = vector;
+			while (i >= firstMesh[object + 1])
+			{
+				object++;
+				modelView = view * models[object];
+			}
+
+			const Object& owner = objects[object];
+			const Mesh& mesh = owner.meshes[i - firstMesh[object]];
+			if (frustum && !frustum->IntersectsBox(mesh.GetCenter(), mesh.GetExtents(), models[object]))
+				continue;
+
+			// view space looks down -z
+			float viewDepth = -(modelView * glm::vec4(mesh.GetCenter(), 1.0f)).z;
+			// the material's own variant once it has compiled, the base shader until then
+			ShaderHandle shader = mesh.material ? owner.shaders.Resolve(mesh.material->GetShader()) : owner.baseShader;
+			// see-through materials are blended after everything opaque, whatever pass was asked for
+			RenderPass meshPass = mesh.material && mesh.material->IsTransparent() ? RenderPass::Transparent : pass;
+			bucket.push_back(queue.MakePacket(meshPass, mesh, owner.shaders.Get(shader), models[object], owner.transformIndex, viewDepth));
 		}
+	});
+}
 
-		if (aimesh->mTextureCoords[0])
+
+void Object::loadModel(std::string path)
+{
+	PROFILE_SCOPE("Object::loadModel");
+
+	// the loader never touches GL; everything it produces is uploaded here
+	ModelLoader loader(flipTextures);
+	ModelData model;
+	{
+		PROFILE_SCOPE("Assimp import");
+		if (!loader.Import(path))
 		{
-			glm::vec2 vec;
-			vec.x = aimesh->mTextureCoords[0][i].x;
-			vec.y = aimesh->mTextureCoords[0][i].y;
-			vertex.TexCoords = vec;
+			std::cout << "ERROR::ASSIMP:: " << loader.GetError() << std::endl;
+			return;
 		}
-		else
-			vertex.TexCoords = glm::vec2(0.0f, 0.0f);
-
-		vertices.push_back(vertex);
 	}
-
-	for (unsigned int i = 0; i < aimesh->mNumFaces; i++)
 	{
-		aiFace face = aimesh->mFaces[i];
-
-		for (unsigned int j = 0; j < face.mNumIndices; j++)
-			indices.push_back(face.mIndices[j]);
+		PROFILE_SCOPE("Build meshes");
+		loader.ConvertMeshes(model);
+		loader.ReleaseScene();
 	}
-
-	aiMaterial* material = aiscene->mMaterials[aimesh->mMaterialIndex];
-
-
-	std::vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
-	textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
-
-
-	return Mesh(vertices, indices, textures, shaderptr);
-}
-
-std::vector<Texture> Object::loadMaterialTextures(aiMaterial* mat, aiTextureType type, std::string typeName)
-
-{
-	std::vector<Texture> textures;
-	for (unsigned int i = 0; i < mat->GetTextureCount(type); i++)
 	{
-		aiString str;
-		mat->GetTexture(type, i, &str);
+		PROFILE_SCOPE("Image decode");
+		loader.DecodeTextures(model);
+	}
 
-		bool skip = false;
-		for (unsigned int j = 0; j < textures_loaded.size(); j++)
+	// a bake made by LightmapBaker from this very file replaces the mesh data and lights it
+	std::shared_ptr<LightmapTexture> lightmap;
+	{
+		PROFILE_SCOPE("Lightmap load");
+		LightmapData lightmapData;
+		std::string lightmapPath = LightmapData::GetPath(path);
+		if (LightmapTexture::IsSupported() && lightmapData.Read(lightmapPath))
 		{
-			if (std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
+			if (lightmapData.Matches(model))
 			{
-				textures.push_back(textures_loaded[j]);
-				skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-				break;
+				lightmapData.Apply(model);
+				lightmap = std::make_shared<LightmapTexture>(lightmapData);
+				shaderFeatures |= ShaderFeature::Lightmap;
+				std::cout << "Lightmap loaded successfully: " << lightmapPath << std::endl;
+			}
+			else
+			{
+				std::cout << "Lightmap was baked from a different model, ignored: " << lightmapPath << std::endl;
 			}
-		}
-		if (!skip)
-		{   // if texture hasn't been loaded already, load it
-			Texture texture;
-			texture.id = TextureFromFile(str.C_Str(), this->directory);
-			texture.type = typeName;
-			texture.path = str.C_Str();
-			textures.push_back(texture);
-			textures_loaded.push_back(texture);
 		}
 	}
-	return textures;
-}
-
-unsigned int Object::TextureFromFile(const char* path, const std::string& directory, bool gamma)
-{
-	std::string filename = std::string(path);
-	filename = directory + '/' + filename;
 
-	unsigned int textureID;
-	glGenTextures(1, &textureID);
-
-	int width, height, nrComponents;
-	unsigned char* data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-	if (data)
+	std::vector<GLuint> images;
+	images.reserve(model.images.size());
 	{
-		GLenum format;
-		if (nrComponents == 1)
-			format = GL_RED;
-		else if (nrComponents == 3)
-			format = GL_RGB;
-		else if (nrComponents == 4)
-			format = GL_RGBA;
-
-		glBindTexture(GL_TEXTURE_2D, textureID);
-		glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-		glGenerateMipmap(GL_TEXTURE_2D);
-
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-		std::cout << "Texture loaded successfully: " << filename << std::endl;
-		stbi_image_free(data);
+		PROFILE_SCOPE("Texture upload");
+		for (const ImageData& image : model.images)
+		{
+			std::string filename = loader.GetDirectory() + '/' + image.path;
+			// 0 if the image cannot be read; it samples as black just like an empty texture
+			GLuint textureID = 0;
+			if (image.pixels)
+			{
+				textureID = createTexture2D(image.pixels.get(), image.width, image.height, image.components, GL_LINEAR_MIPMAP_LINEAR);
+				std::cout << "Texture loaded successfully: " << filename << std::endl;
+			}
+			else
+			{
+				std::cout << "Texture failed to load at path: " << filename << std::endl;
+			}
+			images.push_back(textureID);
+		}
 	}
-	else
+
+	materials.reserve(model.materials.size());
+	for (const MaterialData& data : model.materials)
 	{
-		std::cout << "Texture failed to load at path: " << filename << std::endl;
-		stbi_image_free(data);
+		std::vector<Texture> textures;
+		for (const MaterialTexture& texture : data.textures)
+			textures.push_back({ images[texture.image], model.images[texture.image].path, texture.type });
+
+		materials.push_back(std::make_shared<Material>(data.parameters, textures, shaders, baseShader, shaderFeatures));
 	}
 
-	return textureID;
+	meshes.reserve(model.meshes.size());
+	for (MeshData& data : model.meshes)
+		meshes.emplace_back(std::move(data.vertices), std::move(data.indices), materials[data.material], shaderptr, data.lightmapCoords, lightmap, std::move(data.skin));
+
+	if (model.animations.skeleton.GetJointCount() > 0)
+		animations = std::make_shared<const AnimationSet>(std::move(model.animations));
 }
 
 void Object::Translate(glm::vec3 newPos)
@@ -1,45 +1,73 @@
 #pragma once
 #include "Mesh.h"
 #include "Shader.h"
+#include "ShaderManager.h"
+#include "RenderQueue.h"
+#include "GeometryPool.h"
+#include "TransformBuffer.h"
+#include "Frustum.h"
 
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <memory>
 #include <vector>
-#include <Assimp/Importer.hpp>
-#include <Assimp/scene.h>
-#include <Assimp/postprocess.h>
+
+struct AnimationSet;
 
 class Object
 {
 public:
-	Object(std::string const& path, bool flipTextures, Shader& shader);
+	// materials pick variants of shader's file; shaderFeatures are added to every one of them
+	Object(std::string const& path, bool flipTextures, ShaderManager& shaders, ShaderHandle shader, uint32_t shaderFeatures = ShaderFeature::None);
+	// wraps meshes that were built in code rather than loaded from a file
+	Object(std::vector<Mesh> meshes, ShaderManager& shaders, ShaderHandle shader);
 	void AddTexture(const char* texturePath);
-	void Draw(Shader& shader);
+	void Draw();
+	// meshes with a transparent material always go to RenderPass::Transparent
+	void Submit(RenderQueue& queue, const glm::mat4& view, RenderPass pass = RenderPass::Opaque) const;
+	// submits with model in place of the object's own matrix, e.g. one taken from a frame snapshot;
+	// meshes outside frustum are skipped
+	void Submit(RenderQueue& queue, const glm::mat4& view, const glm::mat4& model, const Frustum* frustum = nullptr, RenderPass pass = RenderPass::Opaque) const;
+	// Submit for every object, models[i] placing objects[i]. The meshes of all objects are
+	// culled and turned into packets as one range split over the job system, each chunk
+	// writing to its own RenderQueue bucket.
+	static void SubmitAll(RenderQueue& queue, const std::vector<Object>& objects, const std::vector<glm::mat4>& models, const glm::mat4& view, const Frustum* frustum = nullptr, RenderPass pass = RenderPass::Opaque);
 	void Translate(glm::vec3 newPos);
 	void AddToPosition(glm::vec3 vectorToAdd);
 	void SetScale(glm::vec3 newScale);
 	void SetRotation(glm::vec3 RotateAxis, float rotationValue);
 
+	std::vector<Mesh>& GetMeshes() { return meshes; }
+	void AddToPool(GeometryPool& pool);
+	const glm::mat4& GetModelMatrix() const { return modelMatrix; }
+	void SetTransformIndex(GLuint index) { transformIndex = index; }
+	// needed before drawing with TRANSFORM_BUFFER variants, see Mesh::SetTransformIndexBuffer
+	void SetTransformIndexBuffer(GLuint buffer);
+	GLuint GetTransformIndex() const { return transformIndex; }
+	// the skeleton and clips of a rigged model, null for anything else
+	const std::shared_ptr<const AnimationSet>& GetAnimations() const { return animations; }
+
 private:
 
+	ShaderManager& shaders;
+	ShaderHandle baseShader;
+	uint32_t shaderFeatures;
 	Shader& shaderptr;
+	bool flipTextures;
 	std::vector<Mesh> meshes;
-	std::string directory;
+	std::shared_ptr<const AnimationSet> animations;
 
 	void loadModel(std::string path);
-	void processNode(aiNode* ainode, const aiScene* aiscene);
-	Mesh processMesh(aiMesh* aimesh, const aiScene* aiscene);
-	std::vector<Texture> loadMaterialTextures(aiMaterial* mat, aiTextureType type,
-		std::string typeName);
-	unsigned int TextureFromFile(const char* path, const std::string& directory, bool gamma = false);
+	static void submitRange(RenderQueue& queue, const Object* objects, const glm::mat4* models, size_t count, const glm::mat4& view, const Frustum* frustum, RenderPass pass);
 
 	void ResetMatrix() { modelMatrix = glm::mat4(1.0f); }
 
 
-	std::vector<Texture> textures_loaded;
+	// one entry per material a mesh of the model uses
+	std::vector<std::shared_ptr<Material>> materials;
 
 	std::string modelName;
 
@@ -48,7 +76,7 @@ private:
 	GLint colorAttribute;
 
 	std::vector<GLuint> texture;
-	std::vector <GLuint> textureLocation;
+	std::vector<UniformHandle> textureLocation;
 
 	glm::vec3 Position;
 	glm::vec3 Scale;
@@ -57,5 +85,6 @@ private:
 
 	GLuint modelAttribute;
 	glm::mat4 modelMatrix = glm::mat4(1.0f);
+	GLuint transformIndex = TransformBuffer::InvalidIndex;
 
 };
\ No newline at end of file
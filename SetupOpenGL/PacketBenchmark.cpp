@@ -0,0 +1,108 @@
+#include "PacketBenchmark.h"
+#include "Object.h"
+#include "Frustum.h"
+#include "JobSystem.h"
+#include "RenderQueue.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <format>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+namespace {
+	const size_t MeshesPerObject = 100;
+	const size_t SceneSizes[] = { 1000, 10000, 100000 };
+
+	// MeshesPerObject unit quads in a 10x10 square; every one is its own mesh
+	std::vector<Mesh> makeQuads(Shader& shader)
+	{
+		std::vector<Mesh> meshes;
+		meshes.reserve(MeshesPerObject);
+		for (size_t i = 0; i < MeshesPerObject; i++)
+		{
+			glm::vec3 corner(float(i % 10), float(i / 10), 0.0f);
+			std::vector<Vertex> vertices(4);
+			for (int v = 0; v < 4; v++)
+			{
+				vertices[v].Position = corner + glm::vec3(float(v & 1), float(v >> 1), 0.0f);
+				vertices[v].Normal = glm::vec3(0.0f, 0.0f, 1.0f);
+				vertices[v].TexCoords = glm::vec2(float(v & 1), float(v >> 1));
+			}
+			meshes.emplace_back(vertices, std::vector<unsigned int>{ 0, 1, 2, 2, 1, 3 }, nullptr, shader);
+		}
+		return meshes;
+	}
+
+	double median(std::vector<double> values)
+	{
+		std::sort(values.begin(), values.end());
+		return values[values.size() / 2];
+	}
+}
+
+int RunPacketBenchmark(ShaderManager& shaders, ShaderHandle shader, int iterations)
+{
+	const float nearPlane = 0.1f;
+	const float farPlane = 100.0f;
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, nearPlane, farPlane);
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	Frustum frustum(projection * view);
+
+	// the largest scene once; the smaller ones are its first objects
+	std::vector<Object> objects;
+	std::vector<glm::mat4> models;
+	size_t objectCount = SceneSizes[std::size(SceneSizes) - 1] / MeshesPerObject;
+	std::vector<Mesh> quads = makeQuads(shaders.Get(shader));
+	for (size_t i = 0; i < objectCount; i++)
+	{
+		// rows of 32 objects filled from the middle out and stepping away from the camera,
+		// wider than the view so the sides are culled, the last rows past the far plane
+		Object object(quads, shaders, shader);
+		int column = static_cast<int>(i % 32);
+		float side = (column % 2 ? -1.0f : 1.0f) * float((column + 1) / 2);
+		object.Translate(glm::vec3(side * 4.0f - 5.0f, -5.0f, -20.0f - float(i / 32) * 2.5f));
+		models.push_back(object.GetModelMatrix());
+		objects.push_back(std::move(object));
+	}
+
+	int poolSize = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+	std::cout << "Packet generation, median of " << iterations << " frames" << std::endl;
+	for (size_t meshes : SceneSizes)
+	{
+		std::vector<Object> scene(objects.begin(), objects.begin() + meshes / MeshesPerObject);
+		std::vector<glm::mat4> sceneModels(models.begin(), models.begin() + scene.size());
+
+		for (int threads : { 1, poolSize })
+		{
+			JobSystem::Shutdown();
+			JobSystem::Initialize(threads - 1);
+
+			RenderQueue queue(nearPlane, farPlane);
+			std::vector<double> generate, flush;
+			for (int i = 0; i < iterations; i++)
+			{
+				auto start = std::chrono::steady_clock::now();
+				Object::SubmitAll(queue, scene, sceneModels, view, &frustum);
+				auto generated = std::chrono::steady_clock::now();
+				queue.Flush();
+				auto flushed = std::chrono::steady_clock::now();
+
+				generate.push_back(std::chrono::duration<double, std::milli>(generated - start).count());
+				flush.push_back(std::chrono::duration<double, std::milli>(flushed - generated).count());
+			}
+
+			std::cout << std::format("{:>7} meshes, {:>2} threads: {:>8.3f} ms generating {} packets, {:>8.3f} ms merging, sorting and submitting",
+				meshes, threads, median(generate), queue.GetStats().packets, median(flush)) << std::endl;
+			if (threads == poolSize)
+				break;
+		}
+	}
+
+	JobSystem::Shutdown();
+	JobSystem::Initialize();
+	return 0;
+}
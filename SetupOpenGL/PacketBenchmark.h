@@ -0,0 +1,8 @@
+#pragma once
+#include "ShaderManager.h"
+
+// --packet-benchmark: times Object::SubmitAll, culling included, as the scene grows from
+// a thousand to a hundred thousand meshes, once with every job on the calling thread and
+// once on the full job system. The scene is a grid of procedural quads, so no model is
+// loaded; run it on the null backend to leave GL out of the numbers. Returns main's exit code.
+int RunPacketBenchmark(ShaderManager& shaders, ShaderHandle shader, int iterations);
@@ -0,0 +1,258 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+std::atomic<bool> Profiler::enabled = false;
+
+namespace {
+	struct ZoneEvent {
+		const char* name;
+		double start;
+		double end;
+		uint32_t depth;
+	};
+
+	// written only by its owning thread and copied out by WriteChromeTrace; the lock is
+	// uncontended except while a capture copies the ring
+	struct ZoneRing {
+		std::mutex mutex;
+		std::vector<ZoneEvent> events;
+		size_t next = 0;
+		size_t count = 0;
+		uint32_t depth = 0;
+		uint32_t threadId = 0;
+		std::string name;
+
+		void Push(const ZoneEvent& event)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (events.empty())
+				events.resize(Profiler::RingCapacity);
+			events[next] = event;
+			next = (next + 1) % events.size();
+			count = std::min(count + 1, events.size());
+		}
+
+		// the zones held right now, oldest first
+		std::vector<ZoneEvent> Snapshot()
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			std::vector<ZoneEvent> snapshot;
+			snapshot.reserve(count);
+			size_t capacity = events.size();
+			size_t oldest = capacity ? (next + capacity - count) % capacity : 0;
+			for (size_t i = 0; i < count; i++)
+				snapshot.push_back(events[(oldest + i) % capacity]);
+			return snapshot;
+		}
+	};
+
+	struct GpuZone {
+		const char* name;
+		GLuint begin;
+		GLuint end;
+		uint32_t depth;
+	};
+
+	// timer queries issued during one frame, reused FrameLatency frames later
+	struct GpuFrame {
+		std::vector<GLuint> queries;
+		std::vector<GpuZone> zones;
+	};
+
+	const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+	std::mutex ringsMutex;
+	std::vector<std::shared_ptr<ZoneRing>> rings;
+	uint32_t nextThreadId = 1;
+
+	// GPU zones live on the GL thread only
+	std::shared_ptr<ZoneRing> gpuRing;
+	GpuFrame gpuFrames[Profiler::FrameLatency];
+	int gpuFrame = 0;
+	uint32_t gpuDepth = 0;
+
+	std::shared_ptr<ZoneRing> registerRing(const char* name)
+	{
+		auto ring = std::make_shared<ZoneRing>();
+		std::lock_guard<std::mutex> lock(ringsMutex);
+		ring->threadId = nextThreadId++;
+		if (name)
+			ring->name = name;
+		rings.push_back(ring);
+		return ring;
+	}
+
+	ZoneRing& localRing()
+	{
+		thread_local std::shared_ptr<ZoneRing> ring;
+		if (!ring)
+			ring = registerRing(nullptr);
+		return *ring;
+	}
+
+	void writeEscaped(std::ostream& stream, const std::string& text)
+	{
+		for (char c : text)
+		{
+			if (c == '"' || c == '\\')
+				stream << '\\';
+			stream << c;
+		}
+	}
+}
+
+void Profiler::SetEnabled(bool enable)
+{
+	enabled.store(enable, std::memory_order_relaxed);
+}
+
+double Profiler::Now()
+{
+	return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+void Profiler::SetThreadName(const char* name)
+{
+	ZoneRing& ring = localRing();
+	std::lock_guard<std::mutex> lock(ringsMutex);
+	ring.name = name;
+}
+
+uint32_t Profiler::PushDepth()
+{
+	return localRing().depth++;
+}
+
+void Profiler::PopDepth()
+{
+	localRing().depth--;
+}
+
+void Profiler::RecordCpuZone(const char* name, double start, double end, uint32_t depth)
+{
+	localRing().Push({ name, start, end, depth });
+}
+
+int Profiler::BeginGpuZone(const char* name)
+{
+	// GL_TIMESTAMP counters are core since 3.3; unlike GL_TIME_ELAPSED they can nest
+	if (!GLAD_GL_VERSION_3_3)
+		return -1;
+
+	GpuFrame& frame = gpuFrames[gpuFrame];
+	size_t zone = frame.zones.size();
+	if (frame.queries.size() < (zone + 1) * 2)
+	{
+		frame.queries.resize((zone + 1) * 2);
+		glGenQueries(2, &frame.queries[zone * 2]);
+	}
+
+	GpuZone entry = { name, frame.queries[zone * 2], frame.queries[zone * 2 + 1], gpuDepth++ };
+	glQueryCounter(entry.begin, GL_TIMESTAMP);
+	frame.zones.push_back(entry);
+	return static_cast<int>(zone);
+}
+
+void Profiler::EndGpuZone(int zone)
+{
+	GpuFrame& frame = gpuFrames[gpuFrame];
+	if (zone < 0 || zone >= static_cast<int>(frame.zones.size()))
+		return;
+
+	glQueryCounter(frame.zones[zone].end, GL_TIMESTAMP);
+	gpuDepth--;
+}
+
+void Profiler::EndFrame()
+{
+	gpuFrame = (gpuFrame + 1) % FrameLatency;
+	GpuFrame& frame = gpuFrames[gpuFrame];
+	if (frame.zones.empty())
+		return;
+
+	if (!gpuRing)
+		gpuRing = registerRing("GPU");
+
+	// maps GPU nanoseconds onto the CPU timeline; both clocks are read back to back
+	GLint64 gpuNow = 0;
+	glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+	double offset = Now() - gpuNow / 1000.0;
+
+	for (const GpuZone& zone : frame.zones)
+	{
+		// a result that is still not there after FrameLatency frames is dropped, never waited on
+		GLuint available = GL_FALSE;
+		glGetQueryObjectuiv(zone.end, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available)
+			continue;
+
+		GLuint64 begin = 0, end = 0;
+		glGetQueryObjectui64v(zone.begin, GL_QUERY_RESULT, &begin);
+		glGetQueryObjectui64v(zone.end, GL_QUERY_RESULT, &end);
+		gpuRing->Push({ zone.name, begin / 1000.0 + offset, end / 1000.0 + offset, zone.depth });
+	}
+	frame.zones.clear();
+}
+
+bool Profiler::WriteChromeTrace(const std::string& path)
+{
+	std::ofstream stream(path, std::ios::trunc);
+	if (!stream)
+	{
+		std::cout << "Failed to write profile '" << path << "'" << std::endl;
+		return false;
+	}
+
+	// the ring list and names under the registry lock, then each ring's zones under its own,
+	// so threads that keep recording meanwhile only ever wait for their own ring's copy
+	std::vector<std::shared_ptr<ZoneRing>> capturedRings;
+	std::vector<std::string> threadNames;
+	{
+		std::lock_guard<std::mutex> lock(ringsMutex);
+		capturedRings = rings;
+		for (const std::shared_ptr<ZoneRing>& ring : rings)
+			threadNames.push_back(ring->name.empty() ? "Thread " + std::to_string(ring->threadId) : ring->name);
+	}
+
+	stream << std::fixed << std::setprecision(3);
+	stream << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+
+	bool first = true;
+	auto separator = [&]() {
+		if (!first)
+			stream << ",\n";
+		first = false;
+	};
+
+	for (size_t r = 0; r < capturedRings.size(); r++)
+	{
+		const std::shared_ptr<ZoneRing>& ring = capturedRings[r];
+		separator();
+		stream << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << ring->threadId << ",\"args\":{\"name\":\"";
+		writeEscaped(stream, threadNames[r]);
+		stream << "\"}}";
+
+		const char* category = ring == gpuRing ? "gpu" : "cpu";
+		for (const ZoneEvent& event : ring->Snapshot())
+		{
+			separator();
+			stream << "{\"name\":\"";
+			writeEscaped(stream, event.name);
+			stream << "\",\"cat\":\"" << category << "\",\"ph\":\"X\",\"ts\":" << event.start
+				<< ",\"dur\":" << (event.end - event.start) << ",\"pid\":1,\"tid\":" << ring->threadId
+				<< ",\"args\":{\"depth\":" << event.depth << "}}";
+		}
+	}
+
+	stream << "\n]}\n";
+	std::cout << "Profile written to '" << path << "'" << std::endl;
+	return static_cast<bool>(stream);
+}
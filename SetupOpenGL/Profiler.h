@@ -0,0 +1,124 @@
+#pragma once
+#include <glad/glad.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Define ENABLE_PROFILER to 0 to compile every zone out entirely.
+#ifndef ENABLE_PROFILER
+#define ENABLE_PROFILER 1
+#endif
+
+// Scoped-zone frame profiler. CPU zones are written to a ring buffer owned by the thread
+// that records them, behind a lock only a capture ever contends for; while the profiler is
+// disabled a zone is a single flag test. GPU zones bracket the GL commands of a scope with
+// GL_TIMESTAMP queries that are read back FrameLatency frames later, so the CPU never
+// waits on them.
+// Captures are written in the Chrome trace-event format (chrome://tracing, Perfetto).
+//
+// Zone names must be string literals or otherwise outlive the capture.
+class Profiler
+{
+public:
+	// frames between issuing a timer query and reading its result
+	static constexpr int FrameLatency = 4;
+	// zones kept per thread; older ones are overwritten
+	static constexpr size_t RingCapacity = 1 << 16;
+
+	static void SetEnabled(bool enabled);
+	static bool IsEnabled() { return enabled.load(std::memory_order_relaxed); }
+
+	// call once per frame after the last GPU zone, before swapping
+	static void EndFrame();
+
+	// writes every zone still held by the rings; other threads may keep recording, each ring
+	// is copied as it stood at one moment
+	static bool WriteChromeTrace(const std::string& path);
+
+	// names the calling thread in captures
+	static void SetThreadName(const char* name);
+
+	// microseconds since the profiler's epoch
+	static double Now();
+
+	static uint32_t PushDepth();
+	static void PopDepth();
+	static void RecordCpuZone(const char* name, double start, double end, uint32_t depth);
+
+	// returns the zone's query slot, or -1 if GPU timing is unavailable
+	static int BeginGpuZone(const char* name);
+	static void EndGpuZone(int zone);
+
+private:
+	// toggled from the input thread while the render thread records
+	static std::atomic<bool> enabled;
+};
+
+class ProfileZone
+{
+public:
+	explicit ProfileZone(const char* name)
+		: name(name)
+	{
+		if (!Profiler::IsEnabled())
+			return;
+		depth = Profiler::PushDepth();
+		start = Profiler::Now();
+		active = true;
+	}
+
+	~ProfileZone()
+	{
+		if (!active)
+			return;
+		Profiler::RecordCpuZone(name, start, Profiler::Now(), depth);
+		Profiler::PopDepth();
+	}
+
+	ProfileZone(const ProfileZone&) = delete;
+	ProfileZone& operator=(const ProfileZone&) = delete;
+
+private:
+	const char* name;
+	double start = 0.0;
+	uint32_t depth = 0;
+	bool active = false;
+};
+
+// a CPU zone that also times the GL commands issued inside it
+class GpuProfileZone
+{
+public:
+	explicit GpuProfileZone(const char* name)
+		: cpu(name)
+	{
+		if (Profiler::IsEnabled())
+			zone = Profiler::BeginGpuZone(name);
+	}
+
+	~GpuProfileZone()
+	{
+		if (zone >= 0)
+			Profiler::EndGpuZone(zone);
+	}
+
+	GpuProfileZone(const GpuProfileZone&) = delete;
+	GpuProfileZone& operator=(const GpuProfileZone&) = delete;
+
+private:
+	ProfileZone cpu;
+	int zone = -1;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#if ENABLE_PROFILER
+#define PROFILE_SCOPE(name) ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define PROFILE_GPU_SCOPE(name) GpuProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#else
+#define PROFILE_SCOPE(name)
+#define PROFILE_GPU_SCOPE(name)
+#endif
@@ -0,0 +1,565 @@
+#include "RenderBackend.h"
+
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <type_traits>
+
+RenderBackendType RenderBackend::backend = RenderBackendType::GL;
+bool RenderBackend::captureCommands = false;
+RenderCounters RenderBackend::current;
+RenderCounters RenderBackend::lastFrame;
+RenderCounters RenderBackend::total;
+std::vector<RecordedCommand> RenderBackend::commands;
+std::vector<RecordedCommand> RenderBackend::lastCommands;
+
+// every GL function the viewer calls, with the kind of work it stands for
+#define RENDER_BACKEND_FUNCTIONS(X) \
+	X(glActiveTexture, Bind) \
+	X(glBindBuffer, Bind) \
+	X(glBindBufferBase, Bind) \
+	X(glBindBufferRange, Bind) \
+	X(glBindFramebuffer, Bind) \
+	X(glBindRenderbuffer, Bind) \
+	X(glBindSampler, Bind) \
+	X(glBindTexture, Bind) \
+	X(glBindVertexArray, Bind) \
+	X(glUseProgram, Bind) \
+	X(glDrawElements, Draw) \
+	X(glDrawElementsInstanced, Draw) \
+	X(glDrawElementsInstancedBaseInstance, Draw) \
+	X(glMultiDrawElementsIndirect, Draw) \
+	X(glBufferData, BufferUpload) \
+	X(glBufferSubData, BufferUpload) \
+	X(glBufferStorage, BufferUpload) \
+	X(glNamedBufferStorage, BufferUpload) \
+	X(glTexImage2D, TextureUpload) \
+	X(glTextureSubImage2D, TextureUpload) \
+	X(glCompressedTexImage2D, TextureUpload) \
+	X(glCompressedTextureSubImage2D, TextureUpload) \
+	X(glUniform1i, Uniform) \
+	X(glUniform1f, Uniform) \
+	X(glUniform3fv, Uniform) \
+	X(glUniform4fv, Uniform) \
+	X(glUniformMatrix4fv, Uniform) \
+	X(glProgramUniform1i, Uniform) \
+	X(glProgramUniform1f, Uniform) \
+	X(glProgramUniform3fv, Uniform) \
+	X(glProgramUniform4fv, Uniform) \
+	X(glProgramUniformMatrix4fv, Uniform) \
+	X(glEnable, State) \
+	X(glDisable, State) \
+	X(glDepthMask, State) \
+	X(glColorMask, State) \
+	X(glDepthFunc, State) \
+	X(glBlendFunc, State) \
+	X(glViewport, State) \
+	X(glPixelStorei, State) \
+	X(glReadBuffer, State) \
+	X(glTexParameteri, State) \
+	X(glTextureParameteri, State) \
+	X(glEnableVertexAttribArray, State) \
+	X(glVertexAttribPointer, State) \
+	X(glVertexAttribIPointer, State) \
+	X(glVertexAttribDivisor, State) \
+	X(glEnableVertexArrayAttrib, State) \
+	X(glVertexArrayVertexBuffer, State) \
+	X(glVertexArrayElementBuffer, State) \
+	X(glVertexArrayAttribBinding, State) \
+	X(glVertexArrayAttribFormat, State) \
+	X(glVertexArrayAttribIFormat, State) \
+	X(glVertexArrayBindingDivisor, State) \
+	X(glUniformBlockBinding, State) \
+	X(glProgramParameteri, State) \
+	X(glFramebufferRenderbuffer, State) \
+	X(glNamedFramebufferRenderbuffer, State) \
+	X(glGenBuffers, Resource) \
+	X(glCreateBuffers, Resource) \
+	X(glDeleteBuffers, Resource) \
+	X(glMapBufferRange, Resource) \
+	X(glUnmapBuffer, Resource) \
+	X(glGenVertexArrays, Resource) \
+	X(glCreateVertexArrays, Resource) \
+	X(glDeleteVertexArrays, Resource) \
+	X(glGenTextures, Resource) \
+	X(glCreateTextures, Resource) \
+	X(glDeleteTextures, Resource) \
+	X(glTextureStorage2D, Resource) \
+	X(glGenerateMipmap, Resource) \
+	X(glGenerateTextureMipmap, Resource) \
+	X(glGenRenderbuffers, Resource) \
+	X(glCreateRenderbuffers, Resource) \
+	X(glDeleteRenderbuffers, Resource) \
+	X(glRenderbufferStorage, Resource) \
+	X(glNamedRenderbufferStorage, Resource) \
+	X(glGenFramebuffers, Resource) \
+	X(glCreateFramebuffers, Resource) \
+	X(glDeleteFramebuffers, Resource) \
+	X(glGenQueries, Resource) \
+	X(glDeleteQueries, Resource) \
+	X(glFenceSync, Resource) \
+	X(glDeleteSync, Resource) \
+	X(glCreateShader, Resource) \
+	X(glDeleteShader, Resource) \
+	X(glShaderSource, Resource) \
+	X(glCompileShader, Resource) \
+	X(glCreateProgram, Resource) \
+	X(glDeleteProgram, Resource) \
+	X(glAttachShader, Resource) \
+	X(glDetachShader, Resource) \
+	X(glLinkProgram, Resource) \
+	X(glValidateProgram, Resource) \
+	X(glProgramBinary, Resource) \
+	X(glGetIntegerv, Query) \
+	X(glGetInteger64v, Query) \
+	X(glGetString, Query) \
+	X(glGetStringi, Query) \
+	X(glGetShaderiv, Query) \
+	X(glGetShaderInfoLog, Query) \
+	X(glGetProgramiv, Query) \
+	X(glGetProgramInfoLog, Query) \
+	X(glGetProgramBinary, Query) \
+	X(glGetUniformLocation, Query) \
+	X(glGetAttribLocation, Query) \
+	X(glGetUniformBlockIndex, Query) \
+	X(glGetActiveUniform, Query) \
+	X(glGetActiveUniformBlockName, Query) \
+	X(glGetUniformfv, Query) \
+	X(glGetUniformiv, Query) \
+	X(glBeginQuery, Query) \
+	X(glEndQuery, Query) \
+	X(glQueryCounter, Query) \
+	X(glGetQueryObjectuiv, Query) \
+	X(glGetQueryObjectui64v, Query) \
+	X(glClientWaitSync, Query) \
+	X(glCheckFramebufferStatus, Query) \
+	X(glCheckNamedFramebufferStatus, Query) \
+	X(glReadPixels, Query) \
+	X(glClear, Other) \
+	X(glFlush, Other)
+
+namespace {
+	// ---- null backend: every call returns zero unless a caller depends on the answer
+
+	template<typename Function>
+	struct NullCall;
+
+	template<typename R, typename... Args>
+	struct NullCall<R(APIENTRYP)(Args...)> {
+		static R APIENTRY Call(Args...)
+		{
+			if constexpr (!std::is_void_v<R>)
+				return R{};
+		}
+	};
+
+	GLuint nextName = 1;
+	// mapped ranges stay valid for the life of the process, like a persistent mapping
+	std::vector<std::unique_ptr<char[]>> mappings;
+
+	void APIENTRY nullGenNames(GLsizei count, GLuint* names)
+	{
+		for (GLsizei i = 0; i < count; i++)
+			names[i] = nextName++;
+	}
+
+	void APIENTRY nullCreateTextures(GLenum, GLsizei count, GLuint* names)
+	{
+		nullGenNames(count, names);
+	}
+
+	GLuint APIENTRY nullCreateShader(GLenum)
+	{
+		return nextName++;
+	}
+
+	GLuint APIENTRY nullCreateProgram()
+	{
+		return nextName++;
+	}
+
+	void APIENTRY nullGetIntegerv(GLenum name, GLint* value)
+	{
+		switch (name)
+		{
+		case GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT:
+		case GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT:
+			*value = 256;
+			break;
+		default:
+			*value = 0;
+			break;
+		}
+	}
+
+	void APIENTRY nullGetInteger64v(GLenum, GLint64* value)
+	{
+		*value = 0;
+	}
+
+	const GLubyte* APIENTRY nullGetString(GLenum name)
+	{
+		switch (name)
+		{
+		case GL_VENDOR: return reinterpret_cast<const GLubyte*>("none");
+		case GL_RENDERER: return reinterpret_cast<const GLubyte*>("Null backend");
+		case GL_VERSION: return reinterpret_cast<const GLubyte*>("4.6 (Core Profile) null backend");
+		case GL_SHADING_LANGUAGE_VERSION: return reinterpret_cast<const GLubyte*>("4.60");
+		default: return nullptr;
+		}
+	}
+
+	void APIENTRY nullGetShaderiv(GLuint, GLenum name, GLint* value)
+	{
+		*value = name == GL_COMPILE_STATUS ? GL_TRUE : 0;
+	}
+
+	void APIENTRY nullGetProgramiv(GLuint, GLenum name, GLint* value)
+	{
+		*value = name == GL_LINK_STATUS || name == GL_VALIDATE_STATUS ? GL_TRUE : 0;
+	}
+
+	GLint APIENTRY nullGetLocation(GLuint, const GLchar*)
+	{
+		return -1;
+	}
+
+	GLuint APIENTRY nullGetUniformBlockIndex(GLuint, const GLchar*)
+	{
+		return GL_INVALID_INDEX;
+	}
+
+	void APIENTRY nullGetQueryObjectuiv(GLuint, GLenum, GLuint* value)
+	{
+		// every result is available at once and is 0
+		*value = GL_TRUE;
+	}
+
+	void* APIENTRY nullMapBufferRange(GLenum, GLintptr offset, GLsizeiptr length, GLbitfield)
+	{
+		mappings.push_back(std::make_unique<char[]>(offset + length));
+		return mappings.back().get() + offset;
+	}
+
+	GLboolean APIENTRY nullUnmapBuffer(GLenum)
+	{
+		return GL_TRUE;
+	}
+
+	GLsync APIENTRY nullFenceSync(GLenum, GLbitfield)
+	{
+		return reinterpret_cast<GLsync>(static_cast<uintptr_t>(nextName++));
+	}
+
+	GLenum APIENTRY nullClientWaitSync(GLsync, GLbitfield, GLuint64)
+	{
+		return GL_ALREADY_SIGNALED;
+	}
+
+	GLenum APIENTRY nullCheckFramebufferStatus(GLenum)
+	{
+		return GL_FRAMEBUFFER_COMPLETE;
+	}
+
+	GLenum APIENTRY nullCheckNamedFramebufferStatus(GLuint, GLenum)
+	{
+		return GL_FRAMEBUFFER_COMPLETE;
+	}
+
+	bool nullInstalled = false;
+
+	void installNull(int version)
+	{
+		nullInstalled = true;
+#define INSTALL_NULL(function, type) function = NullCall<std::remove_reference_t<decltype(function)>>::Call;
+		RENDER_BACKEND_FUNCTIONS(INSTALL_NULL)
+#undef INSTALL_NULL
+
+		glGenBuffers = glCreateBuffers = glGenVertexArrays = glCreateVertexArrays = nullGenNames;
+		glGenTextures = glGenRenderbuffers = glCreateRenderbuffers = nullGenNames;
+		glGenFramebuffers = glCreateFramebuffers = glGenQueries = nullGenNames;
+		glCreateTextures = nullCreateTextures;
+		glCreateShader = nullCreateShader;
+		glCreateProgram = nullCreateProgram;
+		glGetIntegerv = nullGetIntegerv;
+		glGetInteger64v = nullGetInteger64v;
+		glGetString = nullGetString;
+		glGetShaderiv = nullGetShaderiv;
+		glGetProgramiv = nullGetProgramiv;
+		glGetUniformLocation = glGetAttribLocation = nullGetLocation;
+		glGetUniformBlockIndex = nullGetUniformBlockIndex;
+		glGetQueryObjectuiv = nullGetQueryObjectuiv;
+		glMapBufferRange = nullMapBufferRange;
+		glUnmapBuffer = nullUnmapBuffer;
+		glFenceSync = nullFenceSync;
+		glClientWaitSync = nullClientWaitSync;
+		glCheckFramebufferStatus = nullCheckFramebufferStatus;
+		glCheckNamedFramebufferStatus = nullCheckNamedFramebufferStatus;
+
+		int* versions[] = {
+			&GLAD_GL_VERSION_1_0, &GLAD_GL_VERSION_1_1, &GLAD_GL_VERSION_1_2, &GLAD_GL_VERSION_1_3, &GLAD_GL_VERSION_1_4,
+			&GLAD_GL_VERSION_1_5, &GLAD_GL_VERSION_2_0, &GLAD_GL_VERSION_2_1, &GLAD_GL_VERSION_3_0, &GLAD_GL_VERSION_3_1,
+			&GLAD_GL_VERSION_3_2, &GLAD_GL_VERSION_3_3, &GLAD_GL_VERSION_4_0, &GLAD_GL_VERSION_4_1, &GLAD_GL_VERSION_4_2,
+			&GLAD_GL_VERSION_4_3, &GLAD_GL_VERSION_4_4, &GLAD_GL_VERSION_4_5, &GLAD_GL_VERSION_4_6,
+		};
+		const int numbers[] = { 10, 11, 12, 13, 14, 15, 20, 21, 30, 31, 32, 33, 40, 41, 42, 43, 44, 45, 46 };
+		for (size_t i = 0; i < std::size(versions); i++)
+			*versions[i] = numbers[i] <= version ? 1 : 0;
+	}
+
+	// ---- recording backend: counts the call, then forwards it
+
+	uint64_t pixelBytes(GLsizei width, GLsizei height, GLenum format, GLenum type)
+	{
+		uint64_t components = 4;
+		if (format == GL_RED) components = 1;
+		else if (format == GL_RG) components = 2;
+		else if (format == GL_RGB) components = 3;
+		uint64_t size = type == GL_FLOAT || type == GL_UNSIGNED_INT ? 4 : 1;
+		return static_cast<uint64_t>(width) * height * components * size;
+	}
+
+	// fills in the bytes (and draw counts) of calls that move data; the rest keep the defaults
+	template<auto& Function>
+	struct Measure {
+		template<typename... Args>
+		static void Apply(RecordedCommand&, Args...) {}
+	};
+
+	template<> struct Measure<glBufferData> {
+		static void Apply(RecordedCommand& command, GLenum, GLsizeiptr size, const void* data, GLenum)
+		{
+			// without data it orphans the storage, which is still a reallocation every time
+			command.bytes = data ? size : 0;
+		}
+	};
+
+	template<> struct Measure<glBufferSubData> {
+		static void Apply(RecordedCommand& command, GLenum, GLintptr, GLsizeiptr size, const void*) { command.bytes = size; }
+	};
+
+	template<> struct Measure<glBufferStorage> {
+		static void Apply(RecordedCommand& command, GLenum, GLsizeiptr size, const void* data, GLbitfield)
+		{
+			command.bytes = data ? size : 0;
+			if (!data)
+				command.type = RenderCommandType::Resource;
+		}
+	};
+
+	template<> struct Measure<glNamedBufferStorage> {
+		static void Apply(RecordedCommand& command, GLuint, GLsizeiptr size, const void* data, GLbitfield)
+		{
+			command.bytes = data ? size : 0;
+			if (!data)
+				command.type = RenderCommandType::Resource;
+		}
+	};
+
+	template<> struct Measure<glTexImage2D> {
+		static void Apply(RecordedCommand& command, GLenum, GLint, GLint, GLsizei width, GLsizei height, GLint, GLenum format, GLenum type, const void* pixels)
+		{
+			command.bytes = pixels ? pixelBytes(width, height, format, type) : 0;
+		}
+	};
+
+	template<> struct Measure<glTextureSubImage2D> {
+		static void Apply(RecordedCommand& command, GLuint, GLint, GLint, GLint, GLsizei width, GLsizei height, GLenum format, GLenum type, const void*)
+		{
+			command.bytes = pixelBytes(width, height, format, type);
+		}
+	};
+
+	// compressed images carry their byte size
+	template<> struct Measure<glCompressedTexImage2D> {
+		static void Apply(RecordedCommand& command, GLenum, GLint, GLenum, GLsizei, GLsizei, GLint, GLsizei size, const void* data) { command.bytes = data ? size : 0; }
+	};
+
+	template<> struct Measure<glCompressedTextureSubImage2D> {
+		static void Apply(RecordedCommand& command, GLuint, GLint, GLint, GLint, GLsizei, GLsizei, GLenum, GLsizei size, const void*) { command.bytes = size; }
+	};
+
+	template<> struct Measure<glReadPixels> {
+		static void Apply(RecordedCommand& command, GLint, GLint, GLsizei width, GLsizei height, GLenum format, GLenum type, void*)
+		{
+			command.bytes = pixelBytes(width, height, format, type);
+		}
+	};
+
+	template<> struct Measure<glMultiDrawElementsIndirect> {
+		static void Apply(RecordedCommand& command, GLenum, GLenum, const void*, GLsizei drawCount, GLsizei) { command.draws = drawCount; }
+	};
+
+	template<> struct Measure<glUniform1i> {
+		static void Apply(RecordedCommand& command, GLint, GLint) { command.bytes = 4; }
+	};
+	template<> struct Measure<glUniform1f> {
+		static void Apply(RecordedCommand& command, GLint, GLfloat) { command.bytes = 4; }
+	};
+	template<> struct Measure<glUniform3fv> {
+		static void Apply(RecordedCommand& command, GLint, GLsizei count, const GLfloat*) { command.bytes = 12ull * count; }
+	};
+	template<> struct Measure<glUniform4fv> {
+		static void Apply(RecordedCommand& command, GLint, GLsizei count, const GLfloat*) { command.bytes = 16ull * count; }
+	};
+	template<> struct Measure<glUniformMatrix4fv> {
+		static void Apply(RecordedCommand& command, GLint, GLsizei count, GLboolean, const GLfloat*) { command.bytes = 64ull * count; }
+	};
+	template<> struct Measure<glProgramUniform1i> {
+		static void Apply(RecordedCommand& command, GLuint, GLint, GLint) { command.bytes = 4; }
+	};
+	template<> struct Measure<glProgramUniform1f> {
+		static void Apply(RecordedCommand& command, GLuint, GLint, GLfloat) { command.bytes = 4; }
+	};
+	template<> struct Measure<glProgramUniform3fv> {
+		static void Apply(RecordedCommand& command, GLuint, GLint, GLsizei count, const GLfloat*) { command.bytes = 12ull * count; }
+	};
+	template<> struct Measure<glProgramUniform4fv> {
+		static void Apply(RecordedCommand& command, GLuint, GLint, GLsizei count, const GLfloat*) { command.bytes = 16ull * count; }
+	};
+	template<> struct Measure<glProgramUniformMatrix4fv> {
+		static void Apply(RecordedCommand& command, GLuint, GLint, GLsizei count, GLboolean, const GLfloat*) { command.bytes = 64ull * count; }
+	};
+
+	template<auto& Function, typename Pointer = std::remove_reference_t<decltype(Function)>>
+	struct Recorder;
+
+	template<auto& Function, typename R, typename... Args>
+	struct Recorder<Function, R(APIENTRYP)(Args...)> {
+		static inline R(APIENTRYP next)(Args...) = nullptr;
+		static inline const char* name = nullptr;
+		static inline RenderCommandType type = RenderCommandType::Other;
+
+		static R APIENTRY Call(Args... args)
+		{
+			RecordedCommand command = { name, type, 0, type == RenderCommandType::Draw ? 1u : 0u };
+			Measure<Function>::Apply(command, args...);
+			RenderBackend::Record(command);
+			return next(args...);
+		}
+
+		static void Install(const char* functionName, RenderCommandType commandType)
+		{
+			// installing twice would make the recorder forward to itself
+			if (Function == Call)
+				return;
+			name = functionName;
+			type = commandType;
+			next = Function;
+			Function = Call;
+		}
+	};
+
+	void installRecorders()
+	{
+#define INSTALL_RECORDER(function, type) Recorder<function>::Install(#function, RenderCommandType::type);
+		RENDER_BACKEND_FUNCTIONS(INSTALL_RECORDER)
+#undef INSTALL_RECORDER
+	}
+
+	const char* typeName(RenderCommandType type)
+	{
+		switch (type)
+		{
+		case RenderCommandType::Draw: return "draw";
+		case RenderCommandType::Bind: return "bind";
+		case RenderCommandType::BufferUpload: return "buffer_upload";
+		case RenderCommandType::TextureUpload: return "texture_upload";
+		case RenderCommandType::Uniform: return "uniform";
+		case RenderCommandType::State: return "state";
+		case RenderCommandType::Resource: return "resource";
+		case RenderCommandType::Query: return "query";
+		default: return "other";
+		}
+	}
+}
+
+void RenderBackend::Install(RenderBackendType type, int version)
+{
+	backend = type;
+	if (type == RenderBackendType::GL)
+		return;
+
+	// recording on top of a loaded context forwards to the driver, without one to the null
+	// calls; once those are in, a later Install replaces them to apply the new version
+	if (type == RenderBackendType::Null || !glad_glDrawElements || nullInstalled)
+		installNull(version);
+	if (type == RenderBackendType::Recording)
+		installRecorders();
+}
+
+void RenderBackend::Record(const RecordedCommand& command)
+{
+	RenderCounters& counters = current;
+	counters.calls++;
+	switch (command.type)
+	{
+	case RenderCommandType::Draw:
+		counters.drawCalls++;
+		counters.draws += command.draws;
+		break;
+	case RenderCommandType::Bind:
+		counters.binds++;
+		break;
+	case RenderCommandType::BufferUpload:
+		counters.bufferUploads++;
+		counters.bufferBytes += command.bytes;
+		break;
+	case RenderCommandType::TextureUpload:
+		counters.textureUploads++;
+		counters.textureBytes += command.bytes;
+		break;
+	case RenderCommandType::Uniform:
+		counters.uniformUploads++;
+		counters.uniformBytes += command.bytes;
+		break;
+	case RenderCommandType::State:
+		counters.stateChanges++;
+		break;
+	case RenderCommandType::Resource:
+		counters.resources++;
+		break;
+	default:
+		break;
+	}
+
+	if (captureCommands)
+		commands.push_back(command);
+}
+
+void RenderBackend::EndFrame()
+{
+	const RenderCounters& frame = current;
+	total.calls += frame.calls;
+	total.drawCalls += frame.drawCalls;
+	total.draws += frame.draws;
+	total.binds += frame.binds;
+	total.bufferUploads += frame.bufferUploads;
+	total.bufferBytes += frame.bufferBytes;
+	total.textureUploads += frame.textureUploads;
+	total.textureBytes += frame.textureBytes;
+	total.uniformUploads += frame.uniformUploads;
+	total.uniformBytes += frame.uniformBytes;
+	total.stateChanges += frame.stateChanges;
+	total.resources += frame.resources;
+
+	lastFrame = current;
+	current = RenderCounters();
+	lastCommands.swap(commands);
+	commands.clear();
+}
+
+bool RenderBackend::WriteCommands(const std::string& path)
+{
+	std::ofstream stream(path, std::ios::trunc);
+	if (!stream)
+	{
+		std::cout << "Failed to write command stream '" << path << "'" << std::endl;
+		return false;
+	}
+
+	stream << "# call type bytes draws\n";
+	for (const RecordedCommand& command : lastCommands)
+		stream << command.name << " " << typeName(command.type) << " " << command.bytes << " " << command.draws << "\n";
+	return static_cast<bool>(stream);
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+enum class RenderBackendType {
+	// the driver's entry points as glad loaded them
+	GL,
+	// every call does nothing and needs no context; measures pure CPU submission cost
+	Null,
+	// counts and captures every call, then forwards it to GL if a context is loaded or to Null if not
+	Recording,
+};
+
+enum class RenderCommandType {
+	Draw,
+	Bind,
+	BufferUpload,
+	TextureUpload,
+	Uniform,
+	State,
+	// objects created, allocated or deleted
+	Resource,
+	Query,
+	Other,
+};
+
+struct RecordedCommand {
+	const char* name;
+	RenderCommandType type;
+	// bytes sent to (or read back from) the GPU by the call
+	uint64_t bytes;
+	// draws issued by the call; a multi-draw counts one per indirect command
+	uint32_t draws;
+};
+
+struct RenderCounters {
+	uint64_t calls = 0;
+	uint64_t drawCalls = 0;
+	uint64_t draws = 0;
+	uint64_t binds = 0;
+	uint64_t bufferUploads = 0;
+	uint64_t bufferBytes = 0;
+	uint64_t textureUploads = 0;
+	uint64_t textureBytes = 0;
+	uint64_t uniformUploads = 0;
+	uint64_t uniformBytes = 0;
+	uint64_t stateChanges = 0;
+	uint64_t resources = 0;
+};
+
+// Swaps the GL entry points underneath the renderer. Mesh, Object, Shader and the rest
+// call GL through glad's function pointers, so the backend replaces those pointers rather
+// than sitting behind an interface of its own; the calling code is the same for all three.
+// Only the functions the viewer uses are covered, so one that is added to the renderer
+// has to be added to the list in RenderBackend.cpp as well.
+class RenderBackend
+{
+public:
+	// GL needs gladLoadGLLoader to have run; Null and a Recording without a context also set
+	// the GLAD_GL_VERSION flags as if the driver had reported version (major * 10 + minor)
+	static void Install(RenderBackendType type, int version = 46);
+	static RenderBackendType Get() { return backend; }
+
+	// keeps every call of the current frame in GetFrameCommands; counters are always kept
+	static void SetCaptureCommands(bool capture) { captureCommands = capture; }
+
+	// closes the frame; the Get functions return the last closed frame
+	static void EndFrame();
+	static const RenderCounters& GetFrameCounters() { return lastFrame; }
+	static const RenderCounters& GetTotalCounters() { return total; }
+	static const std::vector<RecordedCommand>& GetFrameCommands() { return lastCommands; }
+
+	// the last frame's command stream, one call per line
+	static bool WriteCommands(const std::string& path);
+
+	static void Record(const RecordedCommand& command);
+
+private:
+	static RenderBackendType backend;
+	static bool captureCommands;
+	static RenderCounters current;
+	static RenderCounters lastFrame;
+	static RenderCounters total;
+	static std::vector<RecordedCommand> commands;
+	static std::vector<RecordedCommand> lastCommands;
+};
@@ -0,0 +1,316 @@
+#include "RenderQueue.h"
+#include "Mesh.h"
+#include "Shader.h"
+#include "IndirectRenderer.h"
+#include "GLState.h"
+#include "TransformBuffer.h"
+
+#include <algorithm>
+
+namespace {
+	// a program without a model uniform is a TRANSFORM_BUFFER variant, which finds the
+	// packet's slot in the baseInstance of a single instance
+	void drawPacket(const RenderPacket& packet, UniformHandle modelUniform)
+	{
+		GLsizei count = static_cast<GLsizei>(packet.mesh->GetIndexCount());
+		if (modelUniform == InvalidUniform && packet.transformIndex != TransformBuffer::InvalidIndex)
+			glDrawElementsInstancedBaseInstance(GL_TRIANGLES, count, GL_UNSIGNED_INT, 0, 1, packet.transformIndex);
+		else
+			glDrawElements(GL_TRIANGLES, count, GL_UNSIGNED_INT, 0);
+	}
+}
+
+uint64_t SortKey::Make(RenderPass pass, uint32_t program, uint32_t material, uint32_t vao, uint32_t depth)
+{
+	auto field = [](uint32_t value, int bits, int shift) {
+		return (static_cast<uint64_t>(value) & ((1ull << bits) - 1)) << shift;
+	};
+	if (pass == RenderPass::Transparent)
+	{
+		// the fields below the depth shift down by its width
+		return field(static_cast<uint32_t>(pass), PassBits, PassShift)
+			| field(depth, DepthBits, TransparentDepthShift)
+			| field(program, ProgramBits, ProgramShift - DepthBits)
+			| field(material, MaterialBits, MaterialShift - DepthBits)
+			| field(vao, VAOBits, VAOShift - DepthBits);
+	}
+	return field(static_cast<uint32_t>(pass), PassBits, PassShift)
+		| field(program, ProgramBits, ProgramShift)
+		| field(material, MaterialBits, MaterialShift)
+		| field(vao, VAOBits, VAOShift)
+		| field(depth, DepthBits, DepthShift);
+}
+
+RenderPass SortKey::GetPass(uint64_t key)
+{
+	return static_cast<RenderPass>((key >> PassShift) & ((1ull << PassBits) - 1));
+}
+
+uint32_t SortKey::QuantizeDepth(float viewDepth, float nearPlane, float farPlane, bool backToFront)
+{
+	const uint32_t maxDepth = (1u << DepthBits) - 1;
+	float t = (viewDepth - nearPlane) / (farPlane - nearPlane);
+	t = std::clamp(t, 0.0f, 1.0f);
+	uint32_t depth = static_cast<uint32_t>(t * maxDepth);
+	return backToFront ? maxDepth - depth : depth;
+}
+
+RenderQueue::RenderQueue(float nearPlane, float farPlane)
+	: nearPlane(nearPlane), farPlane(farPlane)
+{
+}
+
+void RenderQueue::SetDepthRange(float _nearPlane, float _farPlane)
+{
+	nearPlane = _nearPlane;
+	farPlane = _farPlane;
+}
+
+void RenderQueue::Push(RenderPass pass, const Mesh& mesh, Shader& shader, const glm::mat4& model, GLuint transformIndex, float viewDepth)
+{
+	packets.push_back(MakePacket(pass, mesh, shader, model, transformIndex, viewDepth));
+}
+
+RenderPacket RenderQueue::MakePacket(RenderPass pass, const Mesh& mesh, Shader& shader, const glm::mat4& model, GLuint transformIndex, float viewDepth) const
+{
+	RenderPacket packet;
+	packet.mesh = &mesh;
+	packet.shader = &shader;
+	packet.model = &model;
+	packet.transformIndex = transformIndex;
+	packet.program = shader.GetRendererID();
+	packet.material = mesh.GetMaterialKey();
+	packet.vao = mesh.GetVAO();
+
+	uint32_t depth = SortKey::QuantizeDepth(viewDepth, nearPlane, farPlane, pass == RenderPass::Transparent);
+	packet.key = SortKey::Make(pass, packet.program, packet.material, packet.vao, depth);
+	return packet;
+}
+
+size_t RenderQueue::beginBuckets(size_t count)
+{
+	size_t first = usedBuckets;
+	usedBuckets += count;
+	if (buckets.size() < usedBuckets)
+		buckets.resize(usedBuckets);
+	return first;
+}
+
+void RenderQueue::mergeBuckets()
+{
+	size_t total = packets.size();
+	for (size_t i = 0; i < usedBuckets; i++)
+		total += buckets[i].size();
+	packets.reserve(total);
+
+	for (size_t i = 0; i < usedBuckets; i++)
+	{
+		packets.insert(packets.end(), buckets[i].begin(), buckets[i].end());
+		buckets[i].clear();
+	}
+	usedBuckets = 0;
+}
+
+void RenderQueue::Flush()
+{
+	mergeBuckets();
+
+	stats.packets = static_cast<unsigned int>(packets.size());
+	stats.stateChangesUnsorted = CountStateChanges(packets);
+
+	RadixSort(packets, scratch);
+
+	stats.stateChangesSorted = CountStateChanges(packets);
+	stats.prepassPackets = depthPrepass ? static_cast<unsigned int>(CountOpaque(packets)) : 0;
+
+	Submit();
+	packets.clear();
+}
+
+void RenderQueue::Submit()
+{
+	if (indirect && indirect->CanSubmit(packets))
+	{
+		indirect->Submit(packets, depthPrepass != nullptr);
+		return;
+	}
+
+	size_t opaqueCount = CountOpaque(packets);
+	bool prepassed = depthPrepass && submitDepthPrepass() > 0;
+
+	GLuint boundProgram = 0;
+	GLuint boundMaterial = 0;
+	GLuint boundVAO = 0;
+	const glm::mat4* boundModel = nullptr;
+	UniformHandle modelUniform = InvalidUniform;
+	bool first = true;
+
+	for (size_t i = 0; i < packets.size(); i++)
+	{
+		const RenderPacket& packet = packets[i];
+		// transparent packets are tested against the scene as usual, and blended over it
+		if (i == opaqueCount)
+		{
+			BeginTransparent();
+			prepassed = false;
+		}
+
+		if (first || packet.program != boundProgram)
+		{
+			GLState::UseProgram(packet.program);
+			boundProgram = packet.program;
+			modelUniform = packet.shader->GetModelUniform();
+			// uniforms are per program; the shader's own shadow drops the resend if it already holds the matrix
+			boundModel = nullptr;
+		}
+		if (first || packet.material != boundMaterial)
+		{
+			packet.mesh->BindMaterial();
+			boundMaterial = packet.material;
+		}
+		if (packet.model != boundModel)
+		{
+			packet.shader->SetUniform(modelUniform, *packet.model);
+			boundModel = packet.model;
+		}
+		if (first || packet.vao != boundVAO)
+		{
+			GLState::BindVertexArray(packet.vao);
+			boundVAO = packet.vao;
+		}
+		first = false;
+
+		drawPacket(packet, modelUniform);
+	}
+	if (prepassed)
+		EndPrepassedShading();
+	if (opaqueCount < packets.size())
+		EndTransparent();
+}
+
+size_t RenderQueue::submitDepthPrepass()
+{
+	size_t opaqueCount = CountOpaque(packets);
+	if (opaqueCount == 0)
+		return 0;
+
+	// the sorted order is kept: nearest first within each VAO, and the model uniform only
+	// changes where the shaded pass changes it as well
+	BeginDepthPrepass();
+	GLState::UseProgram(depthPrepass->GetRendererID());
+	UniformHandle modelUniform = depthPrepass->GetModelUniform();
+	const glm::mat4* boundModel = nullptr;
+	for (size_t i = 0; i < opaqueCount; i++)
+	{
+		const RenderPacket& packet = packets[i];
+		if (packet.model != boundModel)
+		{
+			depthPrepass->SetUniform(modelUniform, *packet.model);
+			boundModel = packet.model;
+		}
+		GLState::BindVertexArray(packet.mesh->GetDepthVAO());
+		drawPacket(packet, modelUniform);
+	}
+	BeginPrepassedShading();
+	return opaqueCount;
+}
+
+size_t RenderQueue::CountOpaque(const std::vector<RenderPacket>& packets)
+{
+	size_t count = 0;
+	while (count < packets.size() && SortKey::GetPass(packets[count].key) == RenderPass::Opaque)
+		count++;
+	return count;
+}
+
+void RenderQueue::BeginDepthPrepass()
+{
+	GLState::SetColorWrite(false);
+	GLState::SetDepthWrite(true);
+	GLState::SetDepthFunc(GL_LESS);
+}
+
+void RenderQueue::BeginPrepassedShading()
+{
+	// the depth is final; anything behind it fails the test before it is shaded
+	GLState::SetColorWrite(true);
+	GLState::SetDepthWrite(false);
+	GLState::SetDepthFunc(GL_LEQUAL);
+}
+
+void RenderQueue::EndPrepassedShading()
+{
+	GLState::SetDepthWrite(true);
+	GLState::SetDepthFunc(GL_LESS);
+}
+
+void RenderQueue::BeginTransparent()
+{
+	GLState::SetDepthWrite(false);
+	GLState::SetDepthFunc(GL_LESS);
+	GLState::SetBlend(true);
+	GLState::SetBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+}
+
+void RenderQueue::EndTransparent()
+{
+	GLState::SetBlend(false);
+	GLState::SetDepthWrite(true);
+}
+
+void RenderQueue::RadixSort(std::vector<RenderPacket>& packets, std::vector<RenderPacket>& scratch)
+{
+	const size_t count = packets.size();
+	if (count < 2)
+		return;
+
+	scratch.resize(count);
+
+	// least significant byte first; a pass where every key shares the same byte is skipped
+	for (int shift = 0; shift < 64; shift += 8)
+	{
+		size_t histogram[256] = {};
+		for (const RenderPacket& packet : packets)
+			histogram[(packet.key >> shift) & 0xFF]++;
+
+		if (histogram[(packets[0].key >> shift) & 0xFF] == count)
+			continue;
+
+		size_t offset = 0;
+		for (size_t& bucket : histogram)
+		{
+			size_t bucketCount = bucket;
+			bucket = offset;
+			offset += bucketCount;
+		}
+
+		for (const RenderPacket& packet : packets)
+			scratch[histogram[(packet.key >> shift) & 0xFF]++] = packet;
+
+		packets.swap(scratch);
+	}
+}
+
+unsigned int RenderQueue::CountStateChanges(const std::vector<RenderPacket>& packets)
+{
+	unsigned int changes = 0;
+	const RenderPacket* previous = nullptr;
+
+	for (const RenderPacket& packet : packets)
+	{
+		if (!previous)
+		{
+			changes += 4;
+		}
+		else
+		{
+			bool programChanged = packet.program != previous->program;
+			changes += programChanged;
+			changes += packet.material != previous->material;
+			changes += packet.vao != previous->vao;
+			changes += programChanged || packet.model != previous->model;
+		}
+		previous = &packet;
+	}
+	return changes;
+}
@@ -0,0 +1,136 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include "JobSystem.h"
+
+class Mesh;
+class Shader;
+class IndirectRenderer;
+
+enum class RenderPass : uint8_t {
+	Opaque = 0,
+	Transparent = 1,
+};
+
+// 64-bit sort key, most significant field first:
+// | pass:2 | program:10 | material:16 | vao:16 | depth:20 |
+// Transparent keys move the depth up, so they are drawn back to front before state matters:
+// | pass:2 | depth:20 | program:10 | material:16 | vao:16 |
+namespace SortKey {
+	constexpr int PassBits = 2;
+	constexpr int ProgramBits = 10;
+	constexpr int MaterialBits = 16;
+	constexpr int VAOBits = 16;
+	constexpr int DepthBits = 20;
+
+	constexpr int DepthShift = 0;
+	constexpr int VAOShift = DepthShift + DepthBits;
+	constexpr int MaterialShift = VAOShift + VAOBits;
+	constexpr int ProgramShift = MaterialShift + MaterialBits;
+	constexpr int PassShift = ProgramShift + ProgramBits;
+	constexpr int TransparentDepthShift = PassShift - DepthBits;
+
+	uint64_t Make(RenderPass pass, uint32_t program, uint32_t material, uint32_t vao, uint32_t depth);
+	RenderPass GetPass(uint64_t key);
+	// maps a view-space distance in [nearPlane, farPlane] onto DepthBits, reversed for back-to-front passes
+	uint32_t QuantizeDepth(float viewDepth, float nearPlane, float farPlane, bool backToFront);
+}
+
+struct RenderPacket {
+	uint64_t key;
+	const Mesh* mesh;
+	Shader* shader;
+	const glm::mat4* model;
+	// slot in the TransformBuffer, or TransformBuffer::InvalidIndex
+	GLuint transformIndex;
+	GLuint program;
+	GLuint material;
+	GLuint vao;
+};
+
+struct RenderQueueStats {
+	unsigned int packets = 0;
+	// program, material, VAO and model changes a submission would issue
+	unsigned int stateChangesUnsorted = 0;
+	unsigned int stateChangesSorted = 0;
+	// opaque packets drawn a second time, position-only, by the depth prepass
+	unsigned int prepassPackets = 0;
+};
+
+class RenderQueue
+{
+public:
+	RenderQueue(float nearPlane, float farPlane);
+
+	void SetDepthRange(float nearPlane, float farPlane);
+	// submit through multi-draw indirect when every packet's mesh is pooled; nullptr disables
+	void SetIndirectRenderer(IndirectRenderer* renderer) { indirect = renderer; }
+	// Lays down the depth of every opaque packet before any of them is shaded, so the
+	// shaded pass runs its fragment shader once per visible pixel. shader is a DEPTH_ONLY
+	// variant, with a model uniform or reading the TransformBuffer like the packets' own
+	// programs, and draws from each mesh's depth VAO; nullptr turns the prepass off. The
+	// indirect path uses its renderer's own depth shader.
+	void SetDepthPrepass(Shader* shader) { depthPrepass = shader; }
+	bool HasDepthPrepass() const { return depthPrepass != nullptr; }
+	void Push(RenderPass pass, const Mesh& mesh, Shader& shader, const glm::mat4& model, GLuint transformIndex, float viewDepth);
+	// the packet Push would add; touches no queue state, so any thread may build one
+	RenderPacket MakePacket(RenderPass pass, const Mesh& mesh, Shader& shader, const glm::mat4& model, GLuint transformIndex, float viewDepth) const;
+
+	// Runs build(begin, end, bucket) over [0, count) on the job system. Every chunk of
+	// grain indices appends to a bucket of its own, so building takes no locks; Flush
+	// merges the buckets in index order, which keeps the result the same as a serial loop.
+	template <typename Function>
+	void PushParallel(size_t count, size_t grain, Function&& build)
+	{
+		grain = grain ? grain : 1;
+		size_t first = beginBuckets((count + grain - 1) / grain);
+		JobSystem::ParallelFor(count, grain, [&](size_t begin, size_t end) {
+			build(begin, end, buckets[first + begin / grain]);
+		});
+	}
+
+	// radix sorts the packets by key and issues them, skipping binds that would not change state;
+	// the transparent packets come last and are blended without writing depth
+	void Flush();
+
+	const RenderQueueStats& GetStats() const { return stats; }
+	const std::vector<RenderPacket>& GetPackets() const { return packets; }
+
+	static void RadixSort(std::vector<RenderPacket>& packets, std::vector<RenderPacket>& scratch);
+	static unsigned int CountStateChanges(const std::vector<RenderPacket>& packets);
+	// sorted packets only: the opaque pass comes first
+	static size_t CountOpaque(const std::vector<RenderPacket>& packets);
+
+	// GL state around a depth prepass: depth only; then shading against the laid depth
+	// without writing it; then the usual depth test again
+	static void BeginDepthPrepass();
+	static void BeginPrepassedShading();
+	static void EndPrepassedShading();
+	// GL state around the transparent packets: alpha blended, depth tested but not written
+	static void BeginTransparent();
+	static void EndTransparent();
+
+private:
+	float nearPlane;
+	float farPlane;
+	IndirectRenderer* indirect = nullptr;
+	Shader* depthPrepass = nullptr;
+
+	std::vector<RenderPacket> packets;
+	std::vector<RenderPacket> scratch;
+	// filled by PushParallel; kept with their capacity between frames
+	std::vector<std::vector<RenderPacket>> buckets;
+	size_t usedBuckets = 0;
+	RenderQueueStats stats;
+
+	// makes count empty buckets available after the used ones, returns the first
+	size_t beginBuckets(size_t count);
+	void mergeBuckets();
+	void Submit();
+	// returns the number of opaque packets it drew
+	size_t submitDepthPrepass();
+};
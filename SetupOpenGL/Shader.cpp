@@ -1,41 +1,133 @@
 #include "Shader.h"
+#include "ShaderPreprocessor.h"
+#include "GLState.h"
 
+#include <cstring>
 
-// Definition of the static member
-unsigned int Shader::program = 0;
+UniformStats Shader::s_UniformStats;
+
+namespace {
+	// size of one element as the shadow stores it; 0 leaves the type untracked
+	uint32_t uniformBytes(GLenum type) {
+		switch (type) {
+		case GL_FLOAT: case GL_INT: case GL_UNSIGNED_INT: case GL_BOOL:
+			return 4;
+		case GL_FLOAT_VEC2: case GL_INT_VEC2:
+			return 8;
+		case GL_FLOAT_VEC3: case GL_INT_VEC3:
+			return 12;
+		case GL_FLOAT_VEC4: case GL_INT_VEC4:
+			return 16;
+		case GL_FLOAT_MAT3:
+			return 36;
+		case GL_FLOAT_MAT4:
+			return 64;
+		case GL_SAMPLER_2D: case GL_SAMPLER_3D: case GL_SAMPLER_CUBE: case GL_SAMPLER_2D_SHADOW: case GL_SAMPLER_2D_ARRAY:
+			return 4;
+		default:
+			return 0;
+		}
+	}
+
+	bool isFloatType(GLenum type) {
+		return type == GL_FLOAT || type == GL_FLOAT_VEC2 || type == GL_FLOAT_VEC3 || type == GL_FLOAT_VEC4
+			|| type == GL_FLOAT_MAT3 || type == GL_FLOAT_MAT4;
+	}
+}
 
 Shader::Shader(const std::string& filepath)
-	: m_FilePath(filepath), m_RendererID(0) {
+	: m_RendererID(0), m_FilePath(filepath) {
 	ShaderProgramSource source = ParseShader(m_FilePath);
 	m_RendererID = CreateShader(source.VertexSource, source.FragmentSource);
+	reflect();
+}
+
+Shader::Shader(const std::string& filepath, unsigned int program)
+	: m_RendererID(program), m_FilePath(filepath) {
+	reflect();
 }
 
 Shader::~Shader() {
-	glDeleteProgram(m_RendererID);
+	GLState::DeleteProgram(m_RendererID);
 }
 
-void Shader::Bind() {
-	glUseProgram(program);
+void Shader::Bind() const {
+	GLState::UseProgram(m_RendererID);
 }
 
 void Shader::Unbind() {
-	glUseProgram(0);
+	GLState::UseProgram(0);
+}
+
+UniformHandle Shader::GetUniform(std::string_view name) const {
+	auto it = m_UniformHandles.find(name);
+	if (it != m_UniformHandles.end())
+		return it->second;
+
+	std::cout << "Warning: uniform '" << name << "' doesn't exist!" << std::endl;
+	m_UniformHandles.emplace(name, InvalidUniform);
+	return InvalidUniform;
+}
+
+void Shader::SetUniform(UniformHandle handle, int value) {
+	if (handle == InvalidUniform || !updateShadow(handle, &value, sizeof(value)))
+		return;
+	if (GLAD_GL_VERSION_4_1)
+		glProgramUniform1i(m_RendererID, m_Uniforms[handle].location, value);
+	else
+		glUniform1i(m_Uniforms[handle].location, value);
+}
+
+void Shader::SetUniform(UniformHandle handle, float value) {
+	if (handle == InvalidUniform || !updateShadow(handle, &value, sizeof(value)))
+		return;
+	if (GLAD_GL_VERSION_4_1)
+		glProgramUniform1f(m_RendererID, m_Uniforms[handle].location, value);
+	else
+		glUniform1f(m_Uniforms[handle].location, value);
+}
+
+void Shader::SetUniform(UniformHandle handle, const glm::vec3& value) {
+	if (handle == InvalidUniform || !updateShadow(handle, glm::value_ptr(value), sizeof(value)))
+		return;
+	if (GLAD_GL_VERSION_4_1)
+		glProgramUniform3fv(m_RendererID, m_Uniforms[handle].location, 1, glm::value_ptr(value));
+	else
+		glUniform3fv(m_Uniforms[handle].location, 1, glm::value_ptr(value));
+}
+
+void Shader::SetUniform(UniformHandle handle, const glm::vec4& value) {
+	if (handle == InvalidUniform || !updateShadow(handle, glm::value_ptr(value), sizeof(value)))
+		return;
+	if (GLAD_GL_VERSION_4_1)
+		glProgramUniform4fv(m_RendererID, m_Uniforms[handle].location, 1, glm::value_ptr(value));
+	else
+		glUniform4fv(m_Uniforms[handle].location, 1, glm::value_ptr(value));
+}
+
+void Shader::SetUniform(UniformHandle handle, const glm::mat4& value) {
+	if (handle == InvalidUniform || !updateShadow(handle, glm::value_ptr(value), sizeof(value)))
+		return;
+	if (GLAD_GL_VERSION_4_1)
+		glProgramUniformMatrix4fv(m_RendererID, m_Uniforms[handle].location, 1, GL_FALSE, glm::value_ptr(value));
+	else
+		glUniformMatrix4fv(m_Uniforms[handle].location, 1, GL_FALSE, glm::value_ptr(value));
 }
 
-void Shader::SetUniform1i(const std::string& name, int value) {
-	glUniform1i(GetUniformLocation(name), value);
+void Shader::SetUniform1i(std::string_view name, int value) {
+	SetUniform(GetUniform(name), value);
 }
 
-void Shader::SetUniform3f(const std::string& name, float v0, float v1, float v2) {
-	glUniform3f(GetUniformLocation(name), v0, v1, v2);
+void Shader::SetUniform3f(std::string_view name, float v0, float v1, float v2) {
+	SetUniform(GetUniform(name), glm::vec3(v0, v1, v2));
 }
 
-void Shader::SetUniform4f(const std::string& name, float v0, float v1, float v2, float v3) {
-	glUniform4f(GetUniformLocation(name), v0, v1, v2, v3);
+void Shader::SetUniform4f(std::string_view name, float v0, float v1, float v2, float v3) {
+	SetUniform(GetUniform(name), glm::vec4(v0, v1, v2, v3));
 }
 
-void Shader::SetUniformMat4f(const std::string& name, const glm::mat4& matrix) {
-	glUniformMatrix4fv(GetUniformLocation(name), 1, GL_FALSE, glm::value_ptr(matrix));
+void Shader::SetUniformMat4f(std::string_view name, const glm::mat4& matrix) {
+	SetUniform(GetUniform(name), matrix);
 }
 
 GLint Shader::GetAttribLocation(const std::string& name) const
@@ -43,39 +135,93 @@ GLint Shader::GetAttribLocation(const std::string& name) const
 	return glGetAttribLocation(m_RendererID, name.c_str());
 }
 
-GLuint Shader::GetUniformLocation(const std::string& name) const {
-	if (m_UniformLocationCache.find(name) != m_UniformLocationCache.end())
-		return m_UniformLocationCache[name];
+void Shader::BindUniformBlock(std::string_view name, GLuint binding) const
+{
+	auto it = m_UniformBlocks.find(name);
+	if (it != m_UniformBlocks.end())
+		glUniformBlockBinding(m_RendererID, it->second, binding);
+}
 
-	GLuint location = glGetUniformLocation(m_RendererID, name.c_str());
-	if (location == -1)
-		std::cout << "Warning: uniform '" << name << "' doesn't exist!" << std::endl;
-	m_UniformLocationCache[name] = location;
-	return location;
+GLint Shader::GetUniformLocation(const std::string& name) const {
+	UniformHandle handle = GetUniform(name);
+	return handle == InvalidUniform ? -1 : m_Uniforms[handle].location;
 }
 
-ShaderProgramSource Shader::ParseShader(const std::string& filepath) {
-	std::ifstream stream(filepath);
-
-	enum class ShaderType {
-		NONE = -1, VERTEX = 0, FRAGMENT = 1
-	};
-
-	std::string line;
-	std::stringstream ss[2];
-	ShaderType type = ShaderType::NONE;
-	while (getline(stream, line)) {
-		if (line.find("#shader") != std::string::npos) {
-			if (line.find("vertex") != std::string::npos)
-				type = ShaderType::VERTEX;
-			else if (line.find("fragment") != std::string::npos)
-				type = ShaderType::FRAGMENT;
+void Shader::reflect() {
+	GLint count = 0;
+	GLint maxLength = 0;
+	glGetProgramiv(m_RendererID, GL_ACTIVE_UNIFORMS, &count);
+	glGetProgramiv(m_RendererID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+	std::vector<char> name(maxLength > 0 ? maxLength : 1);
+	for (GLint i = 0; i < count; i++) {
+		GLsizei length = 0;
+		GLint size = 0;
+		GLenum type = 0;
+		glGetActiveUniform(m_RendererID, i, static_cast<GLsizei>(name.size()), &length, &size, &type, name.data());
+		std::string uniformName(name.data(), length);
+
+		// block members have no location, their values live in buffers
+		GLint location = glGetUniformLocation(m_RendererID, uniformName.c_str());
+		if (location == -1)
+			continue;
+
+		// arrays are reported as "name[0]"; the handle addresses the first element
+		if (uniformName.size() > 3 && uniformName.compare(uniformName.size() - 3, 3, "[0]") == 0)
+			uniformName.resize(uniformName.size() - 3);
+
+		UniformSlot slot = { location, type, static_cast<uint32_t>(m_UniformValues.size()), uniformBytes(type) };
+		m_UniformValues.resize(slot.offset + slot.bytes);
+
+		// start the shadow from what the program holds, e.g. sampler units set before reflection
+		if (slot.bytes > 0) {
+			union { GLfloat f[16]; GLint i[16]; } value = {};
+			if (isFloatType(type))
+				glGetUniformfv(m_RendererID, location, value.f);
+			else
+				glGetUniformiv(m_RendererID, location, value.i);
+			std::memcpy(&m_UniformValues[slot.offset], &value, slot.bytes);
 		}
-		else {
-			ss[(int)type] << line << '\n';
+
+		if (uniformName == "model")
+			m_ModelUniform = static_cast<UniformHandle>(m_Uniforms.size());
+		else if (uniformName == "paletteSize")
+			m_PaletteSizeUniform = static_cast<UniformHandle>(m_Uniforms.size());
+		m_UniformHandles[uniformName] = static_cast<UniformHandle>(m_Uniforms.size());
+		m_Uniforms.push_back(slot);
+	}
+
+	GLint blockCount = 0;
+	GLint maxBlockLength = 0;
+	glGetProgramiv(m_RendererID, GL_ACTIVE_UNIFORM_BLOCKS, &blockCount);
+	glGetProgramiv(m_RendererID, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxBlockLength);
+
+	std::vector<char> blockName(maxBlockLength > 0 ? maxBlockLength : 1);
+	for (GLint i = 0; i < blockCount; i++) {
+		GLsizei length = 0;
+		glGetActiveUniformBlockName(m_RendererID, i, static_cast<GLsizei>(blockName.size()), &length, blockName.data());
+		m_UniformBlocks[std::string(blockName.data(), length)] = static_cast<GLuint>(i);
+	}
+}
+
+bool Shader::updateShadow(UniformHandle handle, const void* value, uint32_t bytes) {
+	const UniformSlot& slot = m_Uniforms[handle];
+	unsigned char* shadow = m_UniformValues.data() + slot.offset;
+
+	// a setter of another size than the declared type (e.g. an int for a bool) is always sent
+	if (slot.bytes == bytes) {
+		if (std::memcmp(shadow, value, bytes) == 0) {
+			s_UniformStats.elided++;
+			return false;
 		}
+		std::memcpy(shadow, value, bytes);
 	}
-	return { ss[0].str(), ss[1].str() };
+	s_UniformStats.uploads++;
+	return true;
+}
+
+ShaderProgramSource Shader::ParseShader(const std::string& filepath) {
+	return ShaderPreprocessor::Process(filepath);
 }
 
 unsigned int Shader::CompileShader(unsigned int type, const std::string& source) {
@@ -89,8 +235,10 @@ unsigned int Shader::CompileShader(unsigned int type, const std::string& source)
 	if (result == GL_FALSE) {
 		int length;
 		glGetShaderiv(id, GL_INFO_LOG_LENGTH, &length);
-		char* message = (char*)_malloca(length * sizeof(char));
-		glGetShaderInfoLog(id, length, &length, message);
+		// _malloca is MSVC only
+		std::string message(length > 0 ? length : 0, '\0');
+		if (length > 0)
+			glGetShaderInfoLog(id, length, &length, message.data());
 		std::cout << "Failed to compile " << (type == GL_VERTEX_SHADER ? "vertex" : "fragment") << " shader!" << std::endl;
 		std::cout << message << std::endl;
 		glDeleteShader(id);
@@ -100,11 +248,14 @@ unsigned int Shader::CompileShader(unsigned int type, const std::string& source)
 	return id;
 }
 
-unsigned int Shader::CreateShader(const std::string& vertexShader, const std::string& fragmentShader) {
-	program = glCreateProgram();
+unsigned int Shader::CreateShader(const std::string& vertexShader, const std::string& fragmentShader, bool retrievable) {
+	unsigned int program = glCreateProgram();
 	unsigned int vs = CompileShader(GL_VERTEX_SHADER, vertexShader);
 	unsigned int fs = CompileShader(GL_FRAGMENT_SHADER, fragmentShader);
 
+	if (retrievable)
+		glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+
 	glAttachShader(program, vs);
 	glAttachShader(program, fs);
 	glLinkProgram(program);
@@ -4,8 +4,11 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <cstdint>
 #include <string>
+#include <string_view>
 #include <unordered_map>
+#include <vector>
 #include <iostream>
 #include <fstream>
 #include <sstream>
@@ -16,31 +19,94 @@ struct ShaderProgramSource {
 	std::string FragmentSource;
 };
 
+// index into a program's reflected uniforms; look it up once and keep it
+using UniformHandle = int;
+constexpr UniformHandle InvalidUniform = -1;
+
+struct UniformStats {
+	// glUniform calls issued and calls skipped because the value was already current
+	unsigned int uploads = 0;
+	unsigned int elided = 0;
+};
+
 class Shader {
 public:
 	Shader(const std::string& filepath);
+	// takes ownership of an already linked program, e.g. one restored from a binary cache
+	Shader(const std::string& filepath, unsigned int program);
 	~Shader();
 
-	static void Bind();
+	Shader(const Shader&) = delete;
+	Shader& operator=(const Shader&) = delete;
+
+	void Bind() const;
 	static void Unbind();
 
-	void SetUniform1i(const std::string& name, int value);
-	void SetUniform3f(const std::string& name, float v0, float v1, float v2);
-	void SetUniform4f(const std::string& name, float v0, float v1, float v2, float v3);
-	void SetUniformMat4f(const std::string& name, const glm::mat4& matrix);
+	// InvalidUniform (and a single warning) if the program has no such active uniform
+	UniformHandle GetUniform(std::string_view name) const;
+	// the "model" matrix every draw sets, found once by reflection; InvalidUniform (without
+	// a warning) if the program has none
+	UniformHandle GetModelUniform() const { return m_ModelUniform; }
+	// the SKINNED variants' "paletteSize", likewise found once
+	UniformHandle GetPaletteSizeUniform() const { return m_PaletteSizeUniform; }
+	// values are compared against a CPU copy and only sent to GL when they change;
+	// on GL 4.1+ they go straight to this program, otherwise it has to be bound
+	void SetUniform(UniformHandle handle, int value);
+	void SetUniform(UniformHandle handle, float value);
+	void SetUniform(UniformHandle handle, const glm::vec3& value);
+	void SetUniform(UniformHandle handle, const glm::vec4& value);
+	void SetUniform(UniformHandle handle, const glm::mat4& value);
+
+	void SetUniform1i(std::string_view name, int value);
+	void SetUniform3f(std::string_view name, float v0, float v1, float v2);
+	void SetUniform4f(std::string_view name, float v0, float v1, float v2, float v3);
+	void SetUniformMat4f(std::string_view name, const glm::mat4& matrix);
 	GLint GetAttribLocation(const std::string& name) const;
+	// assigns a named uniform block to a binding point, ignored if the block is unused
+	void BindUniformBlock(std::string_view name, GLuint binding) const;
 	inline unsigned int GetRendererID() const { return m_RendererID; }
-	static GLuint getProgram() { return program; }
+	GLuint getProgram() const { return m_RendererID; }
 
-	GLuint GetUniformLocation(const std::string& name) const;
+	GLint GetUniformLocation(const std::string& name) const;
+	const std::string& GetFilePath() const { return m_FilePath; }
 
+	// totals across every program since the last reset
+	static const UniformStats& GetUniformStats() { return s_UniformStats; }
+	static void ResetUniformStats() { s_UniformStats = UniformStats(); }
+
+	static ShaderProgramSource ParseShader(const std::string& filepath);
+	// retrievable asks the driver to keep the linked binary for glGetProgramBinary
+	static unsigned int CreateShader(const std::string& vertexShader, const std::string& fragmentShader, bool retrievable = false);
 
 private:
-	static unsigned int program;
+	struct UniformSlot {
+		GLint location;
+		GLenum type;
+		// first byte of the uniform's current value in m_UniformValues
+		uint32_t offset;
+		uint32_t bytes;
+	};
+
 	unsigned int m_RendererID;
 	std::string m_FilePath;
-	mutable std::unordered_map<std::string, int> m_UniformLocationCache;
-	ShaderProgramSource ParseShader(const std::string& filepath);
-	unsigned int CompileShader(unsigned int type, const std::string& source);
-	unsigned int CreateShader(const std::string& vertexShader, const std::string& fragmentShader);
+	std::vector<UniformSlot> m_Uniforms;
+	UniformHandle m_ModelUniform = InvalidUniform;
+	UniformHandle m_PaletteSizeUniform = InvalidUniform;
+	std::vector<unsigned char> m_UniformValues;
+	// looks names up by string_view, so a literal never has to become a std::string first
+	struct NameHash {
+		using is_transparent = void;
+		size_t operator()(std::string_view name) const { return std::hash<std::string_view>{}(name); }
+	};
+
+	// names of active uniforms; misses are added as InvalidUniform so they only warn once
+	mutable std::unordered_map<std::string, UniformHandle, NameHash, std::equal_to<>> m_UniformHandles;
+	std::unordered_map<std::string, GLuint, NameHash, std::equal_to<>> m_UniformBlocks;
+
+	static UniformStats s_UniformStats;
+
+	void reflect();
+	// copies value into the shadow, false if it already held exactly these bytes
+	bool updateShadow(UniformHandle handle, const void* value, uint32_t bytes);
+	static unsigned int CompileShader(unsigned int type, const std::string& source);
 };
\ No newline at end of file
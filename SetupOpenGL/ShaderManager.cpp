@@ -0,0 +1,403 @@
+#include "ShaderManager.h"
+#include "GLState.h"
+#include "ShaderPreprocessor.h"
+#include "Profiler.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+// GL_KHR_parallel_shader_compile is not part of the generated loader
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+namespace {
+	// header in front of every cached binary
+	struct BinaryHeader {
+		uint32_t magic;
+		uint32_t format;
+		uint32_t length;
+	};
+
+	constexpr uint32_t BinaryMagic = 0x42505247; // "GRPB"
+
+	const char* FeatureDefines[ShaderFeature::Count] = {
+		"HAS_DIFFUSE_MAP",
+		"HAS_SPECULAR_MAP",
+		"INSTANCED",
+		"DEPTH_ONLY",
+		"CLUSTERED_LIGHTING",
+		"LIGHTMAP",
+		"SKINNED",
+		"TRANSFORM_BUFFER",
+	};
+
+	std::string glString(GLenum name)
+	{
+		const GLubyte* value = glGetString(name);
+		return value ? reinterpret_cast<const char*>(value) : "";
+	}
+
+	std::string shaderLog(GLuint shader)
+	{
+		GLint length = 0;
+		glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &length);
+		std::string log(length > 0 ? length : 0, '\0');
+		if (length > 0)
+			glGetShaderInfoLog(shader, length, &length, log.data());
+		return log;
+	}
+
+	std::string programLog(GLuint program)
+	{
+		GLint length = 0;
+		glGetProgramiv(program, GL_INFO_LOG_LENGTH, &length);
+		std::string log(length > 0 ? length : 0, '\0');
+		if (length > 0)
+			glGetProgramInfoLog(program, length, &length, log.data());
+		return log;
+	}
+}
+
+std::vector<std::string> ShaderFeature::Defines(uint32_t features)
+{
+	std::vector<std::string> defines;
+	for (int bit = 0; bit < Count; bit++)
+	{
+		if (features & (1u << bit))
+			defines.push_back(FeatureDefines[bit]);
+	}
+	return defines;
+}
+
+ShaderManager::ShaderManager(const std::string& cacheDirectory)
+	: cacheDirectory(cacheDirectory)
+{
+	driverSignature = glString(GL_VENDOR) + '\n' + glString(GL_RENDERER) + '\n' + glString(GL_VERSION);
+	useBinaryCache = BinaryCacheSupported();
+	parallelCompile = hasExtension("GL_KHR_parallel_shader_compile") || hasExtension("GL_ARB_parallel_shader_compile");
+
+	if (useBinaryCache)
+	{
+		std::error_code error;
+		std::filesystem::create_directories(cacheDirectory, error);
+		if (error)
+		{
+			std::cout << "Warning: shader cache directory '" << cacheDirectory << "' unavailable, " << error.message() << std::endl;
+			useBinaryCache = false;
+		}
+	}
+}
+
+ShaderManager::~ShaderManager()
+{
+	for (ProgramEntry& entry : programs)
+	{
+		if (entry.state != State::Compiling)
+			continue;
+		glDeleteShader(entry.vertexShader);
+		glDeleteShader(entry.fragmentShader);
+		GLState::DeleteProgram(entry.program);
+	}
+}
+
+void ShaderManager::AddUniformBlockBinding(const std::string& block, GLuint binding)
+{
+	blockBindings.emplace_back(block, binding);
+}
+
+void ShaderManager::AddSamplerUnit(const std::string& sampler, GLint unit)
+{
+	samplerUnits.push_back({ sampler, unit });
+}
+
+bool ShaderManager::BinaryCacheSupported()
+{
+	if (!GLAD_GL_VERSION_4_1)
+		return false;
+
+	GLint formats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	return formats > 0;
+}
+
+ShaderHandle ShaderManager::LoadVariant(const std::string& filepath, uint32_t features, ShaderHandle fallback)
+{
+	for (ShaderHandle handle = 0; handle < programs.size(); handle++)
+	{
+		if (programs[handle].filepath == filepath && programs[handle].features == features)
+		{
+			// a variant that failed once fails again; the caller gets its own fallback instead
+			if (programs[handle].state == State::Failed)
+				return fallback;
+			return handle;
+		}
+	}
+
+	// filepath may point into programs (GetFilePath), which emplace_back can reallocate
+	std::string path = filepath;
+	ShaderHandle handle = static_cast<ShaderHandle>(programs.size());
+	programs.emplace_back();
+	ProgramEntry& entry = programs.back();
+	entry.filepath = path;
+	entry.features = features;
+	entry.fallback = fallback;
+	{
+		PROFILE_SCOPE("Shader preprocess");
+		entry.source = ShaderPreprocessor::Process(path, ShaderFeature::Defines(features));
+	}
+
+	if (useBinaryCache)
+	{
+		uint64_t key = hash(entry.source.VertexSource);
+		key = hash(entry.source.FragmentSource, key);
+		key = hash(driverSignature, key);
+		entry.cachePath = cachePath(key);
+
+		unsigned int program = loadBinary(entry.cachePath);
+		if (program)
+		{
+			stats.binaryHits++;
+			makeReady(entry, program);
+			return handle;
+		}
+	}
+
+	if (fallback == InvalidHandle)
+	{
+		beginCompile(entry);
+		finishCompile(entry);
+		if (entry.state == State::Failed)
+			return InvalidHandle;
+	}
+	else if (parallelCompile)
+	{
+		beginCompile(entry);
+	}
+	else
+	{
+		stats.pending++;
+	}
+	return handle;
+}
+
+void ShaderManager::Update()
+{
+	unsigned int budget = compileBudget;
+	for (ProgramEntry& entry : programs)
+	{
+		if (entry.state == State::Compiling && compileFinished(entry))
+		{
+			finishCompile(entry);
+		}
+		else if (entry.state == State::Queued && !parallelCompile && budget > 0)
+		{
+			budget--;
+			stats.pending--;
+			beginCompile(entry);
+			finishCompile(entry);
+		}
+	}
+}
+
+ShaderHandle ShaderManager::Resolve(ShaderHandle handle) const
+{
+	while (handle != InvalidHandle && programs[handle].state != State::Ready)
+		handle = programs[handle].fallback;
+	return handle;
+}
+
+void ShaderManager::beginCompile(ProgramEntry& entry)
+{
+	PROFILE_SCOPE("Shader compile");
+	// nothing here waits on the driver; with parallel compile the work happens on its threads
+	auto compile = [](GLenum type, const std::string& source) {
+		GLuint shader = glCreateShader(type);
+		const char* text = source.c_str();
+		glShaderSource(shader, 1, &text, nullptr);
+		glCompileShader(shader);
+		return shader;
+	};
+
+	entry.vertexShader = compile(GL_VERTEX_SHADER, entry.source.VertexSource);
+	entry.fragmentShader = compile(GL_FRAGMENT_SHADER, entry.source.FragmentSource);
+
+	entry.program = glCreateProgram();
+	if (useBinaryCache)
+		glProgramParameteri(entry.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	glAttachShader(entry.program, entry.vertexShader);
+	glAttachShader(entry.program, entry.fragmentShader);
+	glLinkProgram(entry.program);
+
+	entry.state = State::Compiling;
+	stats.compiled++;
+}
+
+bool ShaderManager::compileFinished(const ProgramEntry& entry) const
+{
+	if (!parallelCompile)
+		return true;
+
+	GLint complete = GL_FALSE;
+	glGetProgramiv(entry.program, GL_COMPLETION_STATUS_KHR, &complete);
+	return complete == GL_TRUE;
+}
+
+void ShaderManager::finishCompile(ProgramEntry& entry)
+{
+	PROFILE_SCOPE("Shader link");
+	GLint linked = GL_FALSE;
+	glGetProgramiv(entry.program, GL_LINK_STATUS, &linked);
+
+	if (linked == GL_FALSE)
+	{
+		std::cout << "Failed to build shader '" << entry.filepath << "'";
+		for (const std::string& define : ShaderFeature::Defines(entry.features))
+			std::cout << " " << define;
+		std::cout << std::endl << shaderLog(entry.vertexShader) << shaderLog(entry.fragmentShader) << programLog(entry.program) << std::endl;
+	}
+
+	glDetachShader(entry.program, entry.vertexShader);
+	glDetachShader(entry.program, entry.fragmentShader);
+	glDeleteShader(entry.vertexShader);
+	glDeleteShader(entry.fragmentShader);
+	entry.vertexShader = entry.fragmentShader = 0;
+
+	if (linked == GL_FALSE)
+	{
+		GLState::DeleteProgram(entry.program);
+		entry.program = 0;
+		entry.state = State::Failed;
+		return;
+	}
+
+	if (useBinaryCache)
+		saveBinary(entry.cachePath, entry.program);
+	makeReady(entry, entry.program);
+}
+
+void ShaderManager::makeReady(ProgramEntry& entry, GLuint program)
+{
+	configureProgram(program);
+
+	entry.program = program;
+	entry.shader = std::make_unique<Shader>(entry.filepath, program);
+	entry.state = State::Ready;
+	// the preprocessed text is only needed until the program exists
+	entry.source = ShaderProgramSource();
+}
+
+void ShaderManager::configureProgram(GLuint program) const
+{
+	for (const auto& [block, binding] : blockBindings)
+	{
+		GLuint index = glGetUniformBlockIndex(program, block.c_str());
+		if (index != GL_INVALID_INDEX)
+			glUniformBlockBinding(program, index, binding);
+	}
+
+	GLState::UseProgram(program);
+	for (const SamplerUnit& sampler : samplerUnits)
+	{
+		GLint location = glGetUniformLocation(program, sampler.name.c_str());
+		if (location != -1)
+			glUniform1i(location, sampler.unit);
+	}
+}
+
+std::string ShaderManager::cachePath(uint64_t key) const
+{
+	std::ostringstream name;
+	name << std::hex << std::setw(16) << std::setfill('0') << key << ".bin";
+	return (std::filesystem::path(cacheDirectory) / name.str()).string();
+}
+
+unsigned int ShaderManager::loadBinary(const std::string& path)
+{
+	PROFILE_SCOPE("Shader binary load");
+	std::ifstream stream(path, std::ios::binary);
+	if (!stream)
+		return 0;
+
+	BinaryHeader header;
+	if (!stream.read(reinterpret_cast<char*>(&header), sizeof(header)) || header.magic != BinaryMagic)
+		return 0;
+
+	std::vector<char> binary(header.length);
+	if (!stream.read(binary.data(), binary.size()))
+		return 0;
+
+	unsigned int program = glCreateProgram();
+	glProgramBinary(program, header.format, binary.data(), static_cast<GLsizei>(binary.size()));
+
+	GLint linked = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &linked);
+	if (linked == GL_FALSE)
+	{
+		// driver update or incompatible binary, the caller recompiles and overwrites it
+		stats.binaryRejected++;
+		GLState::DeleteProgram(program);
+		return 0;
+	}
+	return program;
+}
+
+void ShaderManager::saveBinary(const std::string& path, unsigned int program)
+{
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+		return;
+
+	std::vector<char> binary(length);
+	GLenum format = 0;
+	glGetProgramBinary(program, length, &length, &format, binary.data());
+
+	BinaryHeader header = { BinaryMagic, format, static_cast<uint32_t>(length) };
+
+	// write to a temporary file first so a crash never leaves a truncated binary behind
+	std::string temporaryPath = path + ".tmp";
+	{
+		std::ofstream stream(temporaryPath, std::ios::binary | std::ios::trunc);
+		if (!stream)
+			return;
+		stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		stream.write(binary.data(), length);
+		if (!stream)
+			return;
+	}
+
+	std::error_code error;
+	std::filesystem::rename(temporaryPath, path, error);
+	if (error)
+		std::filesystem::remove(temporaryPath, error);
+}
+
+bool ShaderManager::hasExtension(const char* name)
+{
+	GLint count = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+	for (GLint i = 0; i < count; i++)
+	{
+		const GLubyte* extension = glGetStringi(GL_EXTENSIONS, i);
+		if (extension && std::strcmp(reinterpret_cast<const char*>(extension), name) == 0)
+			return true;
+	}
+	return false;
+}
+
+uint64_t ShaderManager::hash(const std::string& data, uint64_t seed)
+{
+	// FNV-1a
+	uint64_t value = seed;
+	for (unsigned char c : data)
+	{
+		value ^= c;
+		value *= 1099511628211ull;
+	}
+	return value;
+}
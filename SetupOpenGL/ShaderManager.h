@@ -0,0 +1,130 @@
+#pragma once
+#include <glad/glad.h>
+
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Shader.h"
+
+using ShaderHandle = uint32_t;
+
+// Feature bits selecting a shader variant; each one becomes a #define in the source.
+namespace ShaderFeature {
+	constexpr uint32_t None = 0;
+	constexpr uint32_t DiffuseMap = 1u << 0;   // HAS_DIFFUSE_MAP
+	constexpr uint32_t SpecularMap = 1u << 1;  // HAS_SPECULAR_MAP
+	constexpr uint32_t Instanced = 1u << 2;    // INSTANCED
+	constexpr uint32_t DepthOnly = 1u << 3;    // DEPTH_ONLY, position in and depth out, nothing shaded
+	constexpr uint32_t ClusteredLighting = 1u << 4;  // CLUSTERED_LIGHTING, needs the LightBuffer bindings
+	constexpr uint32_t Lightmap = 1u << 5;     // LIGHTMAP, baked light from a LightmapTexture
+	constexpr uint32_t Skinned = 1u << 6;      // SKINNED, vertices moved by the palettes of a SkinnedObject
+	constexpr uint32_t Transforms = 1u << 7;   // TRANSFORM_BUFFER, the world matrix read from the draw's TransformBuffer slot
+	constexpr int Count = 8;
+
+	std::vector<std::string> Defines(uint32_t features);
+}
+
+struct ShaderCacheStats {
+	unsigned int binaryHits = 0;
+	unsigned int binaryRejected = 0;
+	unsigned int compiled = 0;
+	unsigned int pending = 0;
+};
+
+// Owns every shader program by handle. Linked programs are written to an on-disk
+// binary cache keyed by the source hash and the driver's vendor, renderer and version
+// strings, so later runs skip compilation unless the driver rejects the binary.
+//
+// Variants of a file are requested by feature bits and compiled on demand. A variant
+// requested with a fallback compiles in the background (in parallel on drivers with
+// GL_KHR_parallel_shader_compile, otherwise a few per Update) and Resolve returns the
+// fallback until it is ready, so the frame never waits on the compiler.
+class ShaderManager
+{
+public:
+	static constexpr ShaderHandle InvalidHandle = 0xFFFFFFFFu;
+
+	explicit ShaderManager(const std::string& cacheDirectory = "shadercache");
+	~ShaderManager();
+
+	ShaderManager(const ShaderManager&) = delete;
+	ShaderManager& operator=(const ShaderManager&) = delete;
+
+	// applied to every program once it is linked, so variants never need per-draw setup
+	void AddUniformBlockBinding(const std::string& block, GLuint binding);
+	void AddSamplerUnit(const std::string& sampler, GLint unit);
+
+	// compiles synchronously; loading the same file twice returns the same handle. A program
+	// that fails to build prints its log and gives InvalidHandle, which callers have to check.
+	ShaderHandle Load(const std::string& filepath) { return LoadVariant(filepath, ShaderFeature::None); }
+	// without a fallback the variant is compiled synchronously, and InvalidHandle is returned
+	// if it fails; with one a failure leaves the handle resolving to the fallback for good
+	ShaderHandle LoadVariant(const std::string& filepath, uint32_t features, ShaderHandle fallback = InvalidHandle);
+
+	// polls background compiles; call once per frame
+	void Update();
+
+	bool IsReady(ShaderHandle handle) const { return programs[handle].state == State::Ready; }
+	// the handle itself once it is ready, otherwise its fallback chain
+	ShaderHandle Resolve(ShaderHandle handle) const;
+	// only for handles that are ready; Resolve first if the handle has a fallback
+	Shader& Get(ShaderHandle handle) { assert(handle < programs.size() && programs[handle].shader); return *programs[handle].shader; }
+	const Shader& Get(ShaderHandle handle) const { assert(handle < programs.size() && programs[handle].shader); return *programs[handle].shader; }
+	const std::string& GetFilePath(ShaderHandle handle) const { return programs[handle].filepath; }
+	uint32_t GetFeatures(ShaderHandle handle) const { return programs[handle].features; }
+	size_t GetCount() const { return programs.size(); }
+
+	const ShaderCacheStats& GetStats() const { return stats; }
+
+	// program binaries need GL 4.1 and at least one binary format from the driver
+	static bool BinaryCacheSupported();
+
+private:
+	enum class State { Queued, Compiling, Ready, Failed };
+
+	struct ProgramEntry {
+		std::string filepath;
+		uint32_t features = 0;
+		ShaderHandle fallback = InvalidHandle;
+		State state = State::Queued;
+		ShaderProgramSource source;
+		std::string cachePath;
+		GLuint program = 0;
+		GLuint vertexShader = 0;
+		GLuint fragmentShader = 0;
+		std::unique_ptr<Shader> shader;
+	};
+
+	struct SamplerUnit {
+		std::string name;
+		GLint unit;
+	};
+
+	std::string cacheDirectory;
+	std::string driverSignature;
+	bool useBinaryCache;
+	bool parallelCompile;
+	// variants compiled per Update when the driver cannot compile in the background
+	unsigned int compileBudget = 1;
+
+	std::vector<ProgramEntry> programs;
+	std::vector<std::pair<std::string, GLuint>> blockBindings;
+	std::vector<SamplerUnit> samplerUnits;
+	ShaderCacheStats stats;
+
+	void beginCompile(ProgramEntry& entry);
+	bool compileFinished(const ProgramEntry& entry) const;
+	void finishCompile(ProgramEntry& entry);
+	void makeReady(ProgramEntry& entry, GLuint program);
+	void configureProgram(GLuint program) const;
+
+	std::string cachePath(uint64_t key) const;
+	unsigned int loadBinary(const std::string& path);
+	void saveBinary(const std::string& path, unsigned int program);
+
+	static bool hasExtension(const char* name);
+	static uint64_t hash(const std::string& data, uint64_t seed = 14695981039346656037ull);
+};
@@ -0,0 +1,107 @@
+#include "ShaderPreprocessor.h"
+#include "VertexLayout.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+namespace {
+	enum Stage {
+		NoStage = -1, VertexStage = 0, FragmentStage = 1
+	};
+
+	// returns the quoted file name of an #include line, or an empty string
+	std::string includeTarget(const std::string& line)
+	{
+		size_t directive = line.find_first_not_of(" \t");
+		if (directive == std::string::npos || line.compare(directive, 8, "#include") != 0)
+			return "";
+
+		size_t open = line.find('"', directive + 8);
+		size_t close = open == std::string::npos ? open : line.find('"', open + 1);
+		if (close == std::string::npos)
+			return "";
+		return line.substr(open + 1, close - open - 1);
+	}
+}
+
+ShaderProgramSource ShaderPreprocessor::Process(const std::string& filepath, const std::vector<std::string>& defines)
+{
+	std::string stages[2];
+	int stage = NoStage;
+	std::vector<std::string> includeStack;
+
+	if (!expand(filepath, includeStack, stages, stage))
+		std::cout << "Failed to preprocess shader '" << filepath << "'" << std::endl;
+
+	std::string block;
+	for (const std::string& define : defines)
+		block += "#define " + define + " 1\n";
+
+	// the vertex inputs are located by name, from the same table the VAOs are set up with
+	std::string vertexBlock = block;
+	for (const VertexInputDefine& input : VertexInputDefines)
+		vertexBlock += "#define " + std::string(input.name) + " " + std::to_string(input.location) + "\n";
+
+	return { injectDefines(stages[VertexStage], vertexBlock), injectDefines(stages[FragmentStage], block) };
+}
+
+bool ShaderPreprocessor::expand(const std::string& filepath, std::vector<std::string>& includeStack, std::string stages[2], int& stage)
+{
+	if (std::find(includeStack.begin(), includeStack.end(), filepath) != includeStack.end())
+	{
+		std::cout << "Shader include cycle at '" << filepath << "'" << std::endl;
+		return false;
+	}
+
+	std::ifstream stream(filepath);
+	if (!stream)
+	{
+		std::cout << "Shader file '" << filepath << "' not found" << std::endl;
+		return false;
+	}
+
+	includeStack.push_back(filepath);
+	std::filesystem::path directory = std::filesystem::path(filepath).parent_path();
+
+	bool ok = true;
+	std::string line;
+	while (getline(stream, line)) {
+		if (line.find("#shader") != std::string::npos) {
+			if (line.find("vertex") != std::string::npos)
+				stage = VertexStage;
+			else if (line.find("fragment") != std::string::npos)
+				stage = FragmentStage;
+			continue;
+		}
+
+		std::string include = includeTarget(line);
+		if (!include.empty()) {
+			ok = expand((directory / include).string(), includeStack, stages, stage) && ok;
+			continue;
+		}
+
+		if (stage != NoStage)
+			stages[stage] += line + '\n';
+	}
+
+	includeStack.pop_back();
+	return ok;
+}
+
+std::string ShaderPreprocessor::injectDefines(const std::string& source, const std::string& block)
+{
+	if (block.empty())
+		return source;
+
+	// #version has to stay the first statement, so the defines go on the line after it
+	size_t version = source.find("#version");
+	size_t insertAt = version == std::string::npos ? 0 : source.find('\n', version);
+	if (insertAt == std::string::npos)
+		return source + '\n' + block;
+	if (version != std::string::npos)
+		insertAt++;
+
+	return source.substr(0, insertAt) + block + source.substr(insertAt);
+}
@@ -0,0 +1,19 @@
+#pragma once
+#include <string>
+#include <vector>
+
+#include "Shader.h"
+
+// Expands #include "file" directives (relative to the including file) and splits the
+// result at the "#shader vertex" / "#shader fragment" markers. Each define is injected
+// as "#define NAME 1" right after the #version line of every stage, and the vertex stage
+// also gets the attribute locations of VertexInputDefines.
+class ShaderPreprocessor
+{
+public:
+	static ShaderProgramSource Process(const std::string& filepath, const std::vector<std::string>& defines = {});
+
+private:
+	static bool expand(const std::string& filepath, std::vector<std::string>& includeStack, std::string stages[2], int& stage);
+	static std::string injectDefines(const std::string& source, const std::string& block);
+};
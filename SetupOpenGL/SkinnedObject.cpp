@@ -0,0 +1,171 @@
+#include "SkinnedObject.h"
+#include "GLState.h"
+#include "JobSystem.h"
+#include "Skinning.h"
+
+#include <algorithm>
+
+SkinnedObject::SkinnedObject(std::string const& path, bool flipTextures, ShaderManager& shaders, ShaderHandle shader, uint32_t shaderFeatures, bool allowGPUSkinning)
+	: shaders(shaders), gpuSkinning(allowGPUSkinning && IsGPUSkinningSupported()),
+	model(path, flipTextures, shaders, shader, shaderFeatures | (gpuSkinning ? ShaderFeature::Skinned : ShaderFeature::None)),
+	animations(model.GetAnimations())
+{
+	// bone-less parts have no joints or weights to read, so they get the plain variant; it
+	// falls back to the plain base shader while it compiles
+	ShaderHandle rigidBase = shaders.LoadVariant(shaders.GetFilePath(shader), shaders.GetFeatures(shader) & ~ShaderFeature::Skinned);
+
+	// a character's skinned vertices are its meshes' position and surface streams back to back
+	for (const Mesh& mesh : model.GetMeshes())
+	{
+		meshOffsets.push_back(characterBytes);
+		ShaderHandle rigid = ShaderManager::InvalidHandle;
+		if (mesh.HasSkin())
+		{
+			characterBytes += mesh.vertices.size() * (sizeof(PositionVertex) + sizeof(SurfaceVertex));
+		}
+		else
+		{
+			ShaderHandle variant = mesh.material->GetShader();
+			rigid = shaders.LoadVariant(shaders.GetFilePath(variant), shaders.GetFeatures(variant) & ~ShaderFeature::Skinned, rigidBase);
+		}
+		rigidShaders.push_back(rigid);
+	}
+}
+
+void SkinnedObject::Draw(const std::vector<glm::mat4>& transforms, const std::vector<AnimationPlayback>& playback)
+{
+	size_t characterCount = std::min(transforms.size(), playback.size());
+	if (!animations || characterCount == 0)
+		return;
+
+	while (evaluators.size() < characterCount)
+		evaluators.emplace_back(*animations);
+
+	if (gpuSkinning)
+		drawGPU(characterCount, transforms, playback);
+	else
+		drawCPU(characterCount, transforms, playback);
+	drawRigid(characterCount, transforms);
+}
+
+void SkinnedObject::reserveStream(GLsizeiptr size)
+{
+	if (stream && stream->GetFrameSize() >= size)
+		return;
+
+	// at least doubled, so a crowd that keeps growing does not replace it every frame; the
+	// old buffer lives on in GL until the frames reading it are done
+	GLsizeiptr frameSize = stream ? std::max(size, stream->GetFrameSize() * 2) : size;
+	stream = std::make_unique<StreamBuffer>(frameSize);
+}
+
+void SkinnedObject::drawGPU(size_t characterCount, const std::vector<glm::mat4>& transforms, const std::vector<AnimationPlayback>& playback)
+{
+	size_t paletteSize = animations->skeleton.GetPaletteSize();
+	GLsizeiptr bytes = characterCount * paletteSize * sizeof(AffineMatrix);
+	reserveStream(bytes);
+
+	stream->BeginFrame();
+	StreamAllocation range = stream->Allocate(bytes, stream->GetStorageAlignment());
+	if (range.IsValid())
+	{
+		// the palettes are written straight into the mapped range
+		AffineMatrix* palettes = static_cast<AffineMatrix*>(range.data);
+		JobSystem::ParallelFor(characterCount, 16, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++)
+				evaluators[i].Evaluate(playback[i], transforms[i], palettes + i * paletteSize);
+		});
+		stream->Commit(range);
+		GLState::BindBufferRange(GL_SHADER_STORAGE_BUFFER, PaletteBinding, stream->GetBuffer(), range.offset, range.size);
+
+		GLsizei instanceCount = static_cast<GLsizei>(characterCount);
+		for (const Mesh& mesh : model.GetMeshes())
+		{
+			if (!mesh.HasSkin())
+				continue;
+			Shader& program = shaders.Get(shaders.Resolve(mesh.material->GetShader()));
+			program.Bind();
+			program.SetUniform(program.GetPaletteSizeUniform(), static_cast<int>(paletteSize));
+			program.SetUniform(program.GetModelUniform(), glm::mat4(1.0f));
+			mesh.DrawInstanced(instanceCount);
+		}
+	}
+	stream->EndFrame();
+}
+
+void SkinnedObject::drawCPU(size_t characterCount, const std::vector<glm::mat4>& transforms, const std::vector<AnimationPlayback>& playback)
+{
+	size_t paletteSize = animations->skeleton.GetPaletteSize();
+	if (palettes.size() < characterCount * paletteSize)
+		palettes.resize(characterCount * paletteSize);
+	GLsizeiptr bytes = characterCount * characterBytes;
+	reserveStream(bytes);
+
+	std::vector<Mesh>& meshes = model.GetMeshes();
+	stream->BeginFrame();
+	StreamAllocation range = stream->Allocate(bytes);
+	if (range.IsValid())
+	{
+		// skinning costs far more than the pose, so a couple of characters already make a job
+		char* vertices = static_cast<char*>(range.data);
+		JobSystem::ParallelFor(characterCount, 2, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++)
+			{
+				AffineMatrix* palette = &palettes[i * paletteSize];
+				evaluators[i].Evaluate(playback[i], transforms[i], palette);
+
+				char* character = vertices + i * characterBytes;
+				for (size_t m = 0; m < meshes.size(); m++)
+				{
+					const Mesh& mesh = meshes[m];
+					if (!mesh.HasSkin())
+						continue;
+					size_t count = mesh.vertices.size();
+					PositionVertex* positions = reinterpret_cast<PositionVertex*>(character + meshOffsets[m]);
+					SurfaceVertex* surfaces = reinterpret_cast<SurfaceVertex*>(character + meshOffsets[m] + count * sizeof(PositionVertex));
+					SkinVertices(mesh.vertices.data(), mesh.skin.data(), count, palette, positions, surfaces);
+				}
+			}
+		});
+		stream->Commit(range);
+
+		// one draw per character and mesh, the mesh's streams moved to that character's vertices
+		for (size_t m = 0; m < meshes.size(); m++)
+		{
+			Mesh& mesh = meshes[m];
+			if (!mesh.HasSkin())
+				continue;
+			Shader& program = shaders.Get(shaders.Resolve(mesh.material->GetShader()));
+			program.Bind();
+			program.SetUniform(program.GetModelUniform(), glm::mat4(1.0f));
+
+			GLintptr surfaceOffset = mesh.vertices.size() * sizeof(PositionVertex);
+			for (size_t i = 0; i < characterCount; i++)
+			{
+				GLintptr offset = range.offset + i * characterBytes + meshOffsets[m];
+				mesh.SetVertexStreams(stream->GetBuffer(), offset, offset + surfaceOffset);
+				mesh.Draw();
+			}
+		}
+	}
+	stream->EndFrame();
+}
+
+void SkinnedObject::drawRigid(size_t characterCount, const std::vector<glm::mat4>& transforms)
+{
+	const std::vector<Mesh>& meshes = model.GetMeshes();
+	for (size_t m = 0; m < meshes.size(); m++)
+	{
+		ShaderHandle handle = shaders.Resolve(rigidShaders[m]);
+		if (handle == ShaderManager::InvalidHandle)
+			continue;
+		Shader& program = shaders.Get(handle);
+		program.Bind();
+		UniformHandle modelUniform = program.GetModelUniform();
+		for (size_t i = 0; i < characterCount; i++)
+		{
+			program.SetUniform(modelUniform, transforms[i]);
+			meshes[m].Draw();
+		}
+	}
+}
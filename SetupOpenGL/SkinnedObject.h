@@ -0,0 +1,71 @@
+#pragma once
+#include "Animation.h"
+#include "Object.h"
+#include "Shader.h"
+#include "ShaderManager.h"
+#include "StreamBuffer.h"
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <memory>
+#include <vector>
+
+// A rigged model drawn as a crowd of characters, each with its own world matrix and
+// AnimationPlayback. Every frame the characters' poses are evaluated as parallel jobs into
+// palettes that already carry the world matrix, so the skinned vertices come out in world
+// space and the shader's model matrix stays the identity.
+//
+// With storage buffers (GL 4.3) the palettes are uploaded as they are and every mesh is
+// one glDrawElementsInstanced, instance i reading palette i in the SKINNED shader variant.
+// Older contexts, and runs that ask for it, skin the vertices on the job system into a
+// stream of their own and draw each character with its meshes pointed at its part of it.
+// On both paths meshes without a skin are drawn once per character, unskinned, with the
+// character's world matrix as the model matrix.
+class SkinnedObject
+{
+public:
+	static constexpr GLuint PaletteBinding = 6;
+
+	// shader should be a variant built with shaderFeatures, plus ShaderFeature::Skinned
+	// if UsesGPUSkinning; allowGPUSkinning false keeps to the CPU path regardless
+	SkinnedObject(std::string const& path, bool flipTextures, ShaderManager& shaders, ShaderHandle shader, uint32_t shaderFeatures = ShaderFeature::None, bool allowGPUSkinning = true);
+
+	SkinnedObject(const SkinnedObject&) = delete;
+	SkinnedObject& operator=(const SkinnedObject&) = delete;
+
+	static bool IsGPUSkinningSupported() { return GLAD_GL_VERSION_4_3 != 0; }
+	bool UsesGPUSkinning() const { return gpuSkinning; }
+
+	// false if the model has no skeleton; Draw does nothing then
+	bool IsAnimated() const { return animations != nullptr; }
+	const std::shared_ptr<const AnimationSet>& GetAnimations() const { return animations; }
+
+	// one character per transform, posed by the playback of the same index
+	void Draw(const std::vector<glm::mat4>& transforms, const std::vector<AnimationPlayback>& playback);
+
+private:
+	ShaderManager& shaders;
+	bool gpuSkinning;
+	Object model;
+	std::shared_ptr<const AnimationSet> animations;
+
+	// one per character, created the first time a character is drawn
+	std::vector<PoseEvaluator> evaluators;
+	// palettes of the CPU path, which only the skinning reads
+	std::vector<AffineMatrix> palettes;
+	// palettes or skinned vertices; replaced by a larger one when a frame no longer fits
+	std::unique_ptr<StreamBuffer> stream;
+	// where each mesh's skinned vertices start inside one character's block of the stream,
+	// and the size of that block
+	std::vector<GLsizeiptr> meshOffsets;
+	GLsizeiptr characterBytes = 0;
+	// the material's variant without SKINNED for every mesh without a skin, InvalidHandle
+	// for the skinned ones
+	std::vector<ShaderHandle> rigidShaders;
+
+	void reserveStream(GLsizeiptr size);
+	void drawGPU(size_t characterCount, const std::vector<glm::mat4>& transforms, const std::vector<AnimationPlayback>& playback);
+	void drawCPU(size_t characterCount, const std::vector<glm::mat4>& transforms, const std::vector<AnimationPlayback>& playback);
+	void drawRigid(size_t characterCount, const std::vector<glm::mat4>& transforms);
+};
@@ -0,0 +1,80 @@
+#include "Skinning.h"
+
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SKINNING_SSE 1
+#include <emmintrin.h>
+#else
+#define SKINNING_SSE 0
+#endif
+
+namespace {
+	const float WeightScale = 1.0f / 255.0f;
+
+#if SKINNING_SSE
+	// the three row dot products of (x, y, z, w) as one vector, w lane zero
+	inline __m128 transform(__m128 row0, __m128 row1, __m128 row2, __m128 vector)
+	{
+		__m128 x = _mm_mul_ps(row0, vector);
+		__m128 y = _mm_mul_ps(row1, vector);
+		__m128 z = _mm_mul_ps(row2, vector);
+		__m128 w = _mm_setzero_ps();
+		_MM_TRANSPOSE4_PS(x, y, z, w);
+		return _mm_add_ps(_mm_add_ps(x, y), _mm_add_ps(z, w));
+	}
+#endif
+}
+
+void SkinVertices(const Vertex* vertices, const SkinVertex* skin, size_t count, const AffineMatrix* palette, PositionVertex* positions, SurfaceVertex* surfaces)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		const Vertex& vertex = vertices[i];
+		const SkinVertex& influence = skin[i];
+#if SKINNING_SSE
+		__m128 row0 = _mm_setzero_ps(), row1 = _mm_setzero_ps(), row2 = _mm_setzero_ps();
+		for (int j = 0; j < 4; j++)
+		{
+			const AffineMatrix& matrix = palette[influence.Joints[j]];
+			__m128 weight = _mm_set1_ps(influence.Weights[j] * WeightScale);
+			row0 = _mm_add_ps(row0, _mm_mul_ps(_mm_loadu_ps(&matrix.rows[0].x), weight));
+			row1 = _mm_add_ps(row1, _mm_mul_ps(_mm_loadu_ps(&matrix.rows[1].x), weight));
+			row2 = _mm_add_ps(row2, _mm_mul_ps(_mm_loadu_ps(&matrix.rows[2].x), weight));
+		}
+
+		__m128 position = transform(row0, row1, row2, _mm_setr_ps(vertex.Position.x, vertex.Position.y, vertex.Position.z, 1.0f));
+		__m128 normal = transform(row0, row1, row2, _mm_setr_ps(vertex.Normal.x, vertex.Normal.y, vertex.Normal.z, 0.0f));
+
+		__m128 squares = _mm_mul_ps(normal, normal);
+		__m128 lengthSquared = _mm_add_ps(squares, _mm_shuffle_ps(squares, squares, _MM_SHUFFLE(2, 3, 0, 1)));
+		lengthSquared = _mm_add_ps(lengthSquared, _mm_shuffle_ps(lengthSquared, lengthSquared, _MM_SHUFFLE(1, 0, 3, 2)));
+		// a zero normal stays zero instead of turning into NaN
+		__m128 nonZero = _mm_cmpgt_ps(lengthSquared, _mm_setzero_ps());
+		normal = _mm_and_ps(_mm_div_ps(normal, _mm_sqrt_ps(lengthSquared)), nonZero);
+
+		float result[2][4];
+		_mm_storeu_ps(result[0], position);
+		_mm_storeu_ps(result[1], normal);
+		positions[i].Position = glm::vec3(result[0][0], result[0][1], result[0][2]);
+		surfaces[i].Normal = glm::vec3(result[1][0], result[1][1], result[1][2]);
+#else
+		glm::vec4 rows[3] = { glm::vec4(0.0f), glm::vec4(0.0f), glm::vec4(0.0f) };
+		for (int j = 0; j < 4; j++)
+		{
+			const AffineMatrix& matrix = palette[influence.Joints[j]];
+			float weight = influence.Weights[j] * WeightScale;
+			for (int row = 0; row < 3; row++)
+				rows[row] += matrix.rows[row] * weight;
+		}
+
+		glm::vec4 position(vertex.Position, 1.0f);
+		glm::vec4 normal(vertex.Normal, 0.0f);
+		positions[i].Position = glm::vec3(glm::dot(rows[0], position), glm::dot(rows[1], position), glm::dot(rows[2], position));
+		glm::vec3 skinnedNormal(glm::dot(rows[0], normal), glm::dot(rows[1], normal), glm::dot(rows[2], normal));
+		float lengthSquared = glm::dot(skinnedNormal, skinnedNormal);
+		surfaces[i].Normal = lengthSquared > 0.0f ? skinnedNormal / std::sqrt(lengthSquared) : glm::vec3(0.0f);
+#endif
+		surfaces[i].TexCoords = vertex.TexCoords;
+	}
+}
@@ -0,0 +1,13 @@
+#pragma once
+#include <cstddef>
+
+#include "Animation.h"
+#include "Vertex.h"
+
+// Linear blend skinning on the CPU, for contexts that cannot read skin palettes from a
+// storage buffer and for runs with no GPU at all. Every vertex is moved by the weighted
+// sum of its joints' palette matrices, the normal by the same matrix and renormalized,
+// so like the shaders it assumes no shear. Writes the two streams Mesh draws from, with
+// the texture coordinates copied through. With SSE2 the matrix blend and the transforms
+// run four components at a time.
+void SkinVertices(const Vertex* vertices, const SkinVertex* skin, size_t count, const AffineMatrix* palette, PositionVertex* positions, SurfaceVertex* surfaces);
@@ -0,0 +1,112 @@
+#include "StreamBuffer.h"
+#include "GLState.h"
+
+#include <algorithm>
+
+StreamBuffer::StreamBuffer(GLsizeiptr size)
+{
+	GLint value = 1;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &value);
+	uniformAlignment = std::max(value, 1);
+	if (GLAD_GL_VERSION_4_3)
+	{
+		value = 1;
+		glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &value);
+		storageAlignment = std::max(value, 1);
+	}
+
+	// every region has to start on an offset any binding target accepts
+	GLsizeiptr alignment = std::max(uniformAlignment, storageAlignment);
+	frameSize = (size + alignment - 1) / alignment * alignment;
+	GLsizeiptr totalSize = frameSize * FrameCount;
+
+	persistent = GLAD_GL_VERSION_4_4 != 0;
+
+	// the copy target leaves every binding the renderer relies on untouched
+	glGenBuffers(1, &buffer);
+	GLState::BindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	if (persistent)
+	{
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_COPY_WRITE_BUFFER, totalSize, nullptr, flags);
+		mapped = static_cast<char*>(glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, totalSize, flags));
+	}
+	else
+	{
+		glBufferData(GL_COPY_WRITE_BUFFER, totalSize, nullptr, GL_STREAM_DRAW);
+		staging.resize(frameSize);
+	}
+	GLState::BindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+StreamBuffer::~StreamBuffer()
+{
+	for (GLsync& fence : fences)
+	{
+		if (fence)
+			glDeleteSync(fence);
+	}
+	if (mapped)
+	{
+		GLState::BindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+		GLState::BindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	}
+	GLState::DeleteBuffer(buffer);
+}
+
+void StreamBuffer::BeginFrame()
+{
+	head = 0;
+
+	GLsync& fence = fences[frame];
+	if (!fence)
+		return;
+
+	GLenum result = glClientWaitSync(fence, 0, 0);
+	if (result == GL_TIMEOUT_EXPIRED)
+	{
+		stallCount++;
+		const GLuint64 oneSecond = 1000000000;
+		glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, oneSecond);
+	}
+	glDeleteSync(fence);
+	fence = nullptr;
+}
+
+StreamAllocation StreamBuffer::Allocate(GLsizeiptr size, GLsizeiptr alignment)
+{
+	GLintptr regionStart = frameSize * frame;
+	GLintptr offset = (regionStart + head + alignment - 1) / alignment * alignment;
+	if (size <= 0 || offset + size > regionStart + frameSize)
+	{
+		overflowCount++;
+		return StreamAllocation();
+	}
+
+	head = offset + size - regionStart;
+	peakUsage = std::max(peakUsage, head);
+
+	StreamAllocation allocation;
+	allocation.offset = offset;
+	allocation.size = size;
+	allocation.data = persistent ? mapped + offset : staging.data() + (offset - regionStart);
+	return allocation;
+}
+
+void StreamBuffer::Commit(const StreamAllocation& allocation)
+{
+	if (persistent || !allocation.IsValid())
+		return;
+
+	// the fence guarantees the GPU is done with this range, so the upload never has to wait
+	GLState::BindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, allocation.offset, allocation.size, allocation.data);
+	GLState::BindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void StreamBuffer::EndFrame()
+{
+	fences[frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	frame = (frame + 1) % FrameCount;
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <glad/glad.h>
+
+#include <vector>
+
+// One sub-allocation from the current frame's region of a StreamBuffer.
+struct StreamAllocation {
+	void* data = nullptr;
+	// byte offset inside the StreamBuffer's GL buffer, for glBindBufferRange or indirect offsets
+	GLintptr offset = 0;
+	GLsizeiptr size = 0;
+
+	bool IsValid() const { return data != nullptr; }
+};
+
+// Ring of FrameCount equally sized regions in one buffer for data rewritten every frame.
+// Each frame bump-allocates aligned ranges out of its own region; a fence placed at
+// EndFrame keeps the region from being reused while the GPU can still read it, so
+// writing never waits on the driver and the buffer is never reallocated.
+//
+// On 4.4+ contexts the buffer is immutable storage mapped once with
+// GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT and allocations point straight into it.
+// Older contexts write into a CPU copy of the region that Commit uploads.
+class StreamBuffer
+{
+public:
+	static constexpr int FrameCount = 3;
+
+	explicit StreamBuffer(GLsizeiptr frameSize);
+	~StreamBuffer();
+
+	StreamBuffer(const StreamBuffer&) = delete;
+	StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+	// waits for the GPU to release this frame's region, normally without blocking
+	void BeginFrame();
+	// invalid once the frame's region is full; the caller has to skip or fall back
+	StreamAllocation Allocate(GLsizeiptr size, GLsizeiptr alignment = 16);
+	// makes a filled allocation visible to GL; does nothing on the persistent path
+	void Commit(const StreamAllocation& allocation);
+	// fences the region once every draw reading this frame's data has been submitted
+	void EndFrame();
+
+	GLuint GetBuffer() const { return buffer; }
+	GLsizeiptr GetFrameSize() const { return frameSize; }
+	bool IsPersistent() const { return persistent; }
+
+	// frames where the GPU still held the region and BeginFrame had to wait
+	unsigned int GetStallCount() const { return stallCount; }
+	// allocations refused because the region was full
+	unsigned int GetOverflowCount() const { return overflowCount; }
+	// most bytes handed out in a single frame
+	GLsizeiptr GetPeakUsage() const { return peakUsage; }
+
+	// offset alignments glBindBufferRange requires for each target
+	GLsizeiptr GetUniformAlignment() const { return uniformAlignment; }
+	GLsizeiptr GetStorageAlignment() const { return storageAlignment; }
+
+private:
+	GLuint buffer = 0;
+	GLsizeiptr frameSize;
+	GLsizeiptr uniformAlignment = 1;
+	GLsizeiptr storageAlignment = 1;
+	bool persistent = false;
+
+	int frame = 0;
+	GLsizeiptr head = 0;
+	char* mapped = nullptr;
+	std::vector<char> staging;
+	GLsync fences[FrameCount] = {};
+
+	unsigned int stallCount = 0;
+	unsigned int overflowCount = 0;
+	GLsizeiptr peakUsage = 0;
+};
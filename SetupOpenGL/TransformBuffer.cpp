@@ -0,0 +1,58 @@
+#include "TransformBuffer.h"
+#include "GLState.h"
+
+#include <numeric>
+#include <vector>
+
+TransformBuffer::TransformBuffer(StreamBuffer& stream, GLuint capacity)
+	: stream(stream), capacity(capacity)
+{
+	std::vector<GLuint> indices(capacity);
+	std::iota(indices.begin(), indices.end(), 0);
+	if (GLAD_GL_VERSION_4_5)
+	{
+		glCreateBuffers(1, &indexBuffer);
+		glNamedBufferStorage(indexBuffer, indices.size() * sizeof(GLuint), indices.data(), 0);
+	}
+	else
+	{
+		glGenBuffers(1, &indexBuffer);
+		GLState::BindBuffer(GL_ARRAY_BUFFER, indexBuffer);
+		glBufferData(GL_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+		GLState::BindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+}
+
+TransformBuffer::~TransformBuffer()
+{
+	GLState::DeleteBuffer(indexBuffer);
+}
+
+GLuint TransformBuffer::Allocate()
+{
+	if (allocated == capacity)
+		return InvalidIndex;
+	return allocated++;
+}
+
+void TransformBuffer::BeginFrame()
+{
+	frameRange = StreamAllocation();
+	if (allocated > 0)
+		frameRange = stream.Allocate(allocated * sizeof(glm::mat4), stream.GetStorageAlignment());
+}
+
+void TransformBuffer::Write(GLuint index, const glm::mat4& transform)
+{
+	if (frameRange.IsValid() && index < allocated)
+		static_cast<glm::mat4*>(frameRange.data)[index] = transform;
+}
+
+void TransformBuffer::Publish()
+{
+	if (!frameRange.IsValid())
+		return;
+
+	stream.Commit(frameRange);
+	GLState::BindBufferRange(GL_SHADER_STORAGE_BUFFER, Binding, stream.GetBuffer(), frameRange.offset, frameRange.size);
+}
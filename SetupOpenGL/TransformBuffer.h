@@ -0,0 +1,47 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "StreamBuffer.h"
+
+// World matrices of every object in one shader storage range. Slots are handed out once;
+// every frame the matrices are written into a fresh range of the StreamBuffer, which
+// keeps the GPU's copy of the previous frames intact until their fences signal.
+//
+// Draws that are not indirect pass their slot as the baseInstance of an instanced draw of
+// one instance; GetIndexBuffer holds 0..capacity-1 for the per-instance attribute that
+// turns it back into an index (see Mesh::SetTransformIndexBuffer).
+class TransformBuffer
+{
+public:
+	static constexpr GLuint Binding = 0;
+	static constexpr GLuint InvalidIndex = 0xFFFFFFFFu;
+
+	TransformBuffer(StreamBuffer& stream, GLuint capacity);
+	~TransformBuffer();
+
+	TransformBuffer(const TransformBuffer&) = delete;
+	TransformBuffer& operator=(const TransformBuffer&) = delete;
+
+	static bool IsSupported() { return GLAD_GL_VERSION_4_3 != 0; }
+
+	// returns InvalidIndex once the buffer is full
+	GLuint Allocate();
+
+	// takes this frame's range from the stream, call after StreamBuffer::BeginFrame
+	void BeginFrame();
+	// plain stores into the mapped range, so jobs may write distinct indices concurrently
+	void Write(GLuint index, const glm::mat4& transform);
+	// makes the frame's range visible at the storage binding, call before drawing
+	void Publish();
+
+	GLuint GetCapacity() const { return capacity; }
+	GLuint GetIndexBuffer() const { return indexBuffer; }
+
+private:
+	StreamBuffer& stream;
+	GLuint capacity;
+	GLuint allocated = 0;
+	GLuint indexBuffer = 0;
+	StreamAllocation frameRange;
+};
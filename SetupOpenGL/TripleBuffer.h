@@ -0,0 +1,55 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+// Lock-free hand-off of the latest value from one writer thread to one reader thread.
+// Each side owns a slot of its own; the third slot sits in between. Publish swaps the
+// writer's slot into the middle and Update swaps the middle into the reader's, each with
+// a single atomic exchange, so neither side ever waits for the other. A value the reader
+// has not picked up yet is replaced by the next one rather than queued.
+template <typename T>
+class TripleBuffer
+{
+public:
+	// the writer's slot; fill it completely, then Publish
+	T& GetWriteBuffer() { return slots[writeIndex]; }
+
+	void Publish()
+	{
+		uint32_t previous = middle.exchange(writeIndex | FreshBit, std::memory_order_acq_rel);
+		writeIndex = previous & IndexMask;
+		published.fetch_add(1, std::memory_order_release);
+		published.notify_one();
+	}
+
+	// true while the last published value has not been taken by the reader
+	bool HasUnread() const { return (middle.load(std::memory_order_acquire) & FreshBit) != 0; }
+
+	// takes the newest published value if there is one; returns false if the read slot is unchanged
+	bool Update()
+	{
+		if (!HasUnread())
+			return false;
+		uint32_t previous = middle.exchange(readIndex, std::memory_order_acq_rel);
+		readIndex = previous & IndexMask;
+		return true;
+	}
+
+	// the reader's slot; stays valid and unchanged until the next Update
+	const T& GetReadBuffer() const { return slots[readIndex]; }
+
+	// number of Publish calls so far; WaitForPublish(count) sleeps until it moves past count
+	uint64_t GetPublishCount() const { return published.load(std::memory_order_acquire); }
+	void WaitForPublish(uint64_t count) const { published.wait(count, std::memory_order_acquire); }
+
+private:
+	// the middle slot's index lives in the low bits, FreshBit marks it as not yet read
+	static constexpr uint32_t IndexMask = 3;
+	static constexpr uint32_t FreshBit = 4;
+
+	T slots[3];
+	uint32_t writeIndex = 0;
+	uint32_t readIndex = 1;
+	std::atomic<uint32_t> middle = 2;
+	std::atomic<uint64_t> published = 0;
+};
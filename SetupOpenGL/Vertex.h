@@ -0,0 +1,56 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+
+struct Vertex {
+	glm::vec3 Position;
+	glm::vec3 Normal;
+	glm::vec2 TexCoords;
+};
+
+// The two streams a Vertex is uploaded as: every position tightly packed, then the
+// attributes only shading needs. Passes that write depth alone read 12 bytes a vertex.
+struct PositionVertex {
+	glm::vec3 Position;
+};
+
+struct SurfaceVertex {
+	glm::vec3 Normal;
+	glm::vec2 TexCoords;
+};
+
+// 20 bytes instead of 32: the normal as signed 10-bit components and the texture
+// coordinate as two half floats. Described in VertexLayout.h and filled by PackVertices;
+// the shaders read it through the same inputs as Vertex.
+struct CompactVertex {
+	glm::vec3 Position;
+	uint32_t Normal;
+	uint16_t TexCoords[2];
+};
+
+// the lightmap UV set of a baked mesh, a stream of its own next to the other two
+struct LightmapVertex {
+	glm::vec2 Coords;
+};
+
+// the joints that move a skinned vertex, as indices into its skeleton's skin palette,
+// and how much each of them pulls; the four weights add up to 255
+struct SkinVertex {
+	uint16_t Joints[4];
+	uint8_t Weights[4];
+};
+
+// attribute locations fixed by the layout qualifiers in every shader
+namespace VertexAttribute {
+	constexpr GLuint Position = 0;
+	constexpr GLuint Normal = 1;
+	constexpr GLuint TexCoord = 2;
+	constexpr GLuint DrawID = 3;
+	// a mat4 takes four locations, InstanceModel to InstanceModel + 3
+	constexpr GLuint InstanceModel = 4;
+	constexpr GLuint LightmapCoord = 8;
+	constexpr GLuint Joints = 9;
+	constexpr GLuint Weights = 10;
+}
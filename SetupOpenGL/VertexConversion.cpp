@@ -0,0 +1,159 @@
+#include "VertexConversion.h"
+
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VERTEX_CONVERSION_SSE 1
+#include <emmintrin.h>
+#else
+#define VERTEX_CONVERSION_SSE 0
+#endif
+
+namespace {
+	constexpr bool isFloatAttribute(const VertexAttributeFormat& attribute, VertexSemantic semantic, GLint count, GLuint offset)
+	{
+		return attribute.semantic == semantic && attribute.type == GL_FLOAT && attribute.count == count && attribute.offset == offset;
+	}
+}
+
+// the kernels write a vertex as two four-float halves: position and normal.x, then the
+// rest of the normal and the texture coordinate
+static_assert(sizeof(Vertex) == 8 * sizeof(float) && std::size(VertexLayout<Vertex>::Attributes) == 3
+	&& isFloatAttribute(VertexLayout<Vertex>::Attributes[0], VertexSemantic::Position, 3, 0)
+	&& isFloatAttribute(VertexLayout<Vertex>::Attributes[1], VertexSemantic::Normal, 3, 3 * sizeof(float))
+	&& isFloatAttribute(VertexLayout<Vertex>::Attributes[2], VertexSemantic::TexCoord, 2, 6 * sizeof(float)),
+	"ConvertVertices is written for the float layout of Vertex");
+static_assert(sizeof(aiVector3D) == 3 * sizeof(float), "aiVector3D is expected to be three packed floats");
+
+namespace {
+	template<bool HasNormals, bool HasTexCoords>
+	void convertScalar(const aiMesh& aimesh, Vertex* destination, unsigned int begin, unsigned int end)
+	{
+		for (unsigned int i = begin; i < end; i++)
+		{
+			Vertex& vertex = destination[i];
+			vertex.Position = glm::vec3(aimesh.mVertices[i].x, aimesh.mVertices[i].y, aimesh.mVertices[i].z);
+			vertex.Normal = HasNormals ? glm::vec3(aimesh.mNormals[i].x, aimesh.mNormals[i].y, aimesh.mNormals[i].z) : glm::vec3(0.0f);
+			vertex.TexCoords = HasTexCoords ? glm::vec2(aimesh.mTextureCoords[0][i].x, aimesh.mTextureCoords[0][i].y) : glm::vec2(0.0f);
+		}
+	}
+
+#if VERTEX_CONVERSION_SSE
+	// lane selection for _mm_shuffle_ps: a0 and a1 from the first operand, b0 and b1 from the second
+	template<int a0, int a1, int b0, int b1>
+	__m128 shuffle(__m128 a, __m128 b)
+	{
+		return _mm_shuffle_ps(a, b, _MM_SHUFFLE(b1, b0, a1, a0));
+	}
+
+	// four packed vec3s, twelve floats, read as three unaligned vec4s without reading past them
+	struct Packed3 {
+		__m128 v0, v1, v2;
+	};
+
+	template<bool Present>
+	Packed3 load3(const aiVector3D* source)
+	{
+		if constexpr (Present)
+		{
+			const float* floats = &source->x;
+			return { _mm_loadu_ps(floats), _mm_loadu_ps(floats + 4), _mm_loadu_ps(floats + 8) };
+		}
+		else
+		{
+			return { _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps() };
+		}
+	}
+
+	template<bool HasNormals, bool HasTexCoords>
+	unsigned int convertSSE(const aiMesh& aimesh, Vertex* destination)
+	{
+		unsigned int count = aimesh.mNumVertices & ~3u;
+		for (unsigned int i = 0; i < count; i += 4)
+		{
+			// p0 = (x0 y0 z0 x1), p1 = (y1 z1 x2 y2), p2 = (z2 x3 y3 z3), the same for n and t
+			Packed3 p = load3<true>(aimesh.mVertices + i);
+			Packed3 n = load3<HasNormals>(HasNormals ? aimesh.mNormals + i : nullptr);
+			Packed3 t = load3<HasTexCoords>(HasTexCoords ? aimesh.mTextureCoords[0] + i : nullptr);
+
+			__m128 a0 = shuffle<0, 1, 0, 2>(p.v0, shuffle<2, 2, 0, 0>(p.v0, n.v0));
+			__m128 b0 = shuffle<1, 2, 0, 1>(n.v0, t.v0);
+			__m128 a1 = shuffle<0, 2, 0, 2>(shuffle<3, 3, 0, 0>(p.v0, p.v1), shuffle<1, 1, 3, 3>(p.v1, n.v0));
+			__m128 b1 = shuffle<0, 1, 0, 2>(n.v1, shuffle<3, 3, 0, 0>(t.v0, t.v1));
+			__m128 a2 = shuffle<2, 3, 0, 2>(p.v1, shuffle<0, 0, 2, 2>(p.v2, n.v1));
+			__m128 b2 = shuffle<0, 2, 2, 3>(shuffle<3, 3, 0, 0>(n.v1, n.v2), t.v1);
+			__m128 a3 = shuffle<1, 2, 0, 2>(p.v2, shuffle<3, 3, 1, 1>(p.v2, n.v2));
+			__m128 b3 = shuffle<2, 3, 1, 2>(n.v2, t.v2);
+
+			float* out = reinterpret_cast<float*>(destination + i);
+			_mm_storeu_ps(out, a0);
+			_mm_storeu_ps(out + 4, b0);
+			_mm_storeu_ps(out + 8, a1);
+			_mm_storeu_ps(out + 12, b1);
+			_mm_storeu_ps(out + 16, a2);
+			_mm_storeu_ps(out + 20, b2);
+			_mm_storeu_ps(out + 24, a3);
+			_mm_storeu_ps(out + 28, b3);
+		}
+		return count;
+	}
+#endif
+
+	template<bool HasNormals, bool HasTexCoords>
+	void convert(const aiMesh& aimesh, Vertex* destination)
+	{
+		unsigned int done = 0;
+#if VERTEX_CONVERSION_SSE
+		done = convertSSE<HasNormals, HasTexCoords>(aimesh, destination);
+#endif
+		convertScalar<HasNormals, HasTexCoords>(aimesh, destination, done, aimesh.mNumVertices);
+	}
+}
+
+void ConvertVertices(const aiMesh& aimesh, Vertex* destination)
+{
+	bool normals = aimesh.HasNormals();
+	bool texCoords = aimesh.mTextureCoords[0] != nullptr;
+	if (normals && texCoords)
+		convert<true, true>(aimesh, destination);
+	else if (normals)
+		convert<true, false>(aimesh, destination);
+	else if (texCoords)
+		convert<false, true>(aimesh, destination);
+	else
+		convert<false, false>(aimesh, destination);
+}
+
+size_t CountIndices(const aiMesh& aimesh)
+{
+	// after aiProcess_Triangulate a mesh of nothing but triangles says so in mPrimitiveTypes
+	if (aimesh.mPrimitiveTypes == aiPrimitiveType_TRIANGLE)
+		return static_cast<size_t>(aimesh.mNumFaces) * 3;
+
+	size_t count = 0;
+	for (unsigned int i = 0; i < aimesh.mNumFaces; i++)
+		count += aimesh.mFaces[i].mNumIndices;
+	return count;
+}
+
+void ConvertIndices(const aiMesh& aimesh, unsigned int* destination)
+{
+	if (aimesh.mPrimitiveTypes == aiPrimitiveType_TRIANGLE)
+	{
+		for (unsigned int i = 0; i < aimesh.mNumFaces; i++, destination += 3)
+		{
+			const unsigned int* indices = aimesh.mFaces[i].mIndices;
+			destination[0] = indices[0];
+			destination[1] = indices[1];
+			destination[2] = indices[2];
+		}
+		return;
+	}
+
+	for (unsigned int i = 0; i < aimesh.mNumFaces; i++)
+	{
+		const aiFace& face = aimesh.mFaces[i];
+		std::memcpy(destination, face.mIndices, face.mNumIndices * sizeof(unsigned int));
+		destination += face.mNumIndices;
+	}
+}
@@ -0,0 +1,127 @@
+#pragma once
+#include <Assimp/mesh.h>
+#include <glm/gtc/packing.hpp>
+
+#include <cstddef>
+#include <cstring>
+#include <utility>
+
+#include "Vertex.h"
+#include "VertexLayout.h"
+
+// Interleaves an aiMesh's separate position, normal and first texture coordinate arrays
+// into Vertex records, four vertices per step with SSE shuffles where the target has
+// SSE2. The kernel is instantiated for each combination of attributes the mesh has, so a
+// missing attribute costs nothing per vertex and is written as zero. destination must
+// hold mNumVertices vertices.
+void ConvertVertices(const aiMesh& aimesh, Vertex* destination);
+
+// every face's indices back to back; CountIndices is exact, not an estimate
+size_t CountIndices(const aiMesh& aimesh);
+void ConvertIndices(const aiMesh& aimesh, unsigned int* destination);
+
+namespace VertexPacking {
+	template<GLenum Type>
+	constexpr bool alwaysFalse = false;
+
+	// one attribute value in the storage of a VertexAttributeFormat
+	template<GLenum Type, GLint Count, bool Normalized>
+	void encode(const glm::vec4& value, unsigned char* destination)
+	{
+		if constexpr (Type == GL_FLOAT)
+		{
+			std::memcpy(destination, &value[0], Count * sizeof(float));
+		}
+		else if constexpr (Type == GL_HALF_FLOAT)
+		{
+			for (GLint i = 0; i < Count; i++)
+			{
+				glm::uint16 half = glm::packHalf1x16(value[i]);
+				std::memcpy(destination + i * sizeof(half), &half, sizeof(half));
+			}
+		}
+		else if constexpr (Type == GL_INT_2_10_10_10_REV)
+		{
+			static_assert(Normalized, "packed 10-bit attributes are only stored normalized");
+			glm::uint32 packed = glm::packSnorm3x10_1x2(value);
+			std::memcpy(destination, &packed, sizeof(packed));
+		}
+		else if constexpr (Type == GL_SHORT || Type == GL_UNSIGNED_SHORT)
+		{
+			static_assert(Normalized, "integer attributes are only stored normalized");
+			for (GLint i = 0; i < Count; i++)
+			{
+				glm::uint16 component = Type == GL_SHORT ? glm::packSnorm1x16(value[i]) : glm::packUnorm1x16(value[i]);
+				std::memcpy(destination + i * sizeof(component), &component, sizeof(component));
+			}
+		}
+		else if constexpr (Type == GL_BYTE || Type == GL_UNSIGNED_BYTE)
+		{
+			static_assert(Normalized, "integer attributes are only stored normalized");
+			for (GLint i = 0; i < Count; i++)
+				destination[i] = Type == GL_BYTE ? glm::packSnorm1x8(value[i]) : glm::packUnorm1x8(value[i]);
+		}
+		else
+		{
+			static_assert(alwaysFalse<Type>, "no encoder for this attribute type");
+		}
+	}
+
+	template<VertexSemantic Semantic, bool HasNormals, bool HasTexCoords>
+	glm::vec4 read(const aiMesh& aimesh, unsigned int i)
+	{
+		if constexpr (Semantic == VertexSemantic::Position)
+			return glm::vec4(aimesh.mVertices[i].x, aimesh.mVertices[i].y, aimesh.mVertices[i].z, 0.0f);
+		else if constexpr (Semantic == VertexSemantic::Normal && HasNormals)
+			return glm::vec4(aimesh.mNormals[i].x, aimesh.mNormals[i].y, aimesh.mNormals[i].z, 0.0f);
+		else if constexpr (Semantic == VertexSemantic::TexCoord && HasTexCoords)
+			return glm::vec4(aimesh.mTextureCoords[0][i].x, aimesh.mTextureCoords[0][i].y, 0.0f, 0.0f);
+		else
+			return glm::vec4(0.0f);
+	}
+
+	// the attribute loop is unrolled at compile time: each vertex runs straight-line code
+	// with every type, offset and attribute presence a constant
+	template<typename V, bool HasNormals, bool HasTexCoords, size_t... Attribute>
+	void pack(const aiMesh& aimesh, V* destination, std::index_sequence<Attribute...>)
+	{
+		constexpr const auto& attributes = VertexLayout<V>::Attributes;
+		for (unsigned int i = 0; i < aimesh.mNumVertices; i++)
+		{
+			unsigned char* vertex = reinterpret_cast<unsigned char*>(destination + i);
+			(encode<attributes[Attribute].type, attributes[Attribute].count, attributes[Attribute].normalized != GL_FALSE>(
+				read<attributes[Attribute].semantic, HasNormals, HasTexCoords>(aimesh, i), vertex + attributes[Attribute].offset), ...);
+		}
+	}
+
+	template<typename V, bool HasNormals, bool HasTexCoords>
+	void pack(const aiMesh& aimesh, V* destination)
+	{
+		pack<V, HasNormals, HasTexCoords>(aimesh, destination, std::make_index_sequence<std::size(VertexLayout<V>::Attributes)>());
+	}
+}
+
+// Fills any vertex struct with a VertexLayout from an aiMesh, encoding each attribute as
+// its layout stores it. Attributes the mesh lacks are written as zero; bytes of V no
+// attribute covers are left alone. Vertex itself goes to ConvertVertices.
+template<typename V>
+void PackVertices(const aiMesh& aimesh, V* destination)
+{
+	static_assert(IsValidLayout<V>());
+	bool normals = aimesh.HasNormals();
+	bool texCoords = aimesh.mTextureCoords[0] != nullptr;
+	if (normals && texCoords)
+		VertexPacking::pack<V, true, true>(aimesh, destination);
+	else if (normals)
+		VertexPacking::pack<V, true, false>(aimesh, destination);
+	else if (texCoords)
+		VertexPacking::pack<V, false, true>(aimesh, destination);
+	else
+		VertexPacking::pack<V, false, false>(aimesh, destination);
+}
+
+template<>
+inline void PackVertices<Vertex>(const aiMesh& aimesh, Vertex* destination)
+{
+	ConvertVertices(aimesh, destination);
+}
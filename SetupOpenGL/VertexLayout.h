@@ -0,0 +1,191 @@
+#pragma once
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <vector>
+
+#include "Vertex.h"
+
+// What an attribute means, independent of how it is stored. Each semantic has one
+// location in every shader.
+enum class VertexSemantic : uint8_t {
+	Position,
+	Normal,
+	TexCoord,
+	LightmapCoord,
+	Joints,
+	Weights,
+};
+
+constexpr GLuint GetSemanticLocation(VertexSemantic semantic)
+{
+	constexpr GLuint locations[] = { VertexAttribute::Position, VertexAttribute::Normal, VertexAttribute::TexCoord, VertexAttribute::LightmapCoord, VertexAttribute::Joints, VertexAttribute::Weights };
+	return locations[static_cast<size_t>(semantic)];
+}
+
+// every vertex input location ShaderPreprocessor defines for the vertex stage, so the
+// shaders write layout(location = NORMAL_LOCATION) instead of a number
+struct VertexInputDefine {
+	const char* name;
+	GLuint location;
+};
+
+constexpr VertexInputDefine VertexInputDefines[] = {
+	{ "POSITION_LOCATION", GetSemanticLocation(VertexSemantic::Position) },
+	{ "NORMAL_LOCATION", GetSemanticLocation(VertexSemantic::Normal) },
+	{ "TEXCOORD_LOCATION", GetSemanticLocation(VertexSemantic::TexCoord) },
+	{ "DRAW_ID_LOCATION", VertexAttribute::DrawID },
+	{ "INSTANCE_MODEL_LOCATION", VertexAttribute::InstanceModel },
+	{ "LIGHTMAP_LOCATION", GetSemanticLocation(VertexSemantic::LightmapCoord) },
+	{ "JOINTS_LOCATION", GetSemanticLocation(VertexSemantic::Joints) },
+	{ "WEIGHTS_LOCATION", GetSemanticLocation(VertexSemantic::Weights) },
+};
+
+// One attribute of a vertex struct, as glVertexAttribFormat takes it. Only attributes
+// that reach the shader as floats are described: float, half float, or integers, which
+// are normalized or converted as they are.
+struct VertexAttributeFormat {
+	VertexSemantic semantic;
+	GLenum type;
+	GLint count;
+	GLboolean normalized;
+	GLuint offset;
+};
+
+constexpr size_t GetAttributeSize(const VertexAttributeFormat& attribute)
+{
+	switch (attribute.type)
+	{
+	case GL_FLOAT: return 4 * attribute.count;
+	case GL_HALF_FLOAT: case GL_SHORT: case GL_UNSIGNED_SHORT: return 2 * attribute.count;
+	case GL_BYTE: case GL_UNSIGNED_BYTE: return attribute.count;
+	case GL_INT_2_10_10_10_REV: return 4;
+	default: return 0;
+	}
+}
+
+// Specialised once per vertex struct with a constexpr Attributes array; that array is the
+// only place a layout is written down. VAO setup, the shader locations and PackVertices
+// are all generated from it.
+template<typename V>
+struct VertexLayout;
+
+template<>
+struct VertexLayout<Vertex> {
+	static constexpr VertexAttributeFormat Attributes[] = {
+		{ VertexSemantic::Position, GL_FLOAT, 3, GL_FALSE, offsetof(Vertex, Position) },
+		{ VertexSemantic::Normal, GL_FLOAT, 3, GL_FALSE, offsetof(Vertex, Normal) },
+		{ VertexSemantic::TexCoord, GL_FLOAT, 2, GL_FALSE, offsetof(Vertex, TexCoords) },
+	};
+};
+
+template<>
+struct VertexLayout<CompactVertex> {
+	static constexpr VertexAttributeFormat Attributes[] = {
+		{ VertexSemantic::Position, GL_FLOAT, 3, GL_FALSE, offsetof(CompactVertex, Position) },
+		{ VertexSemantic::Normal, GL_INT_2_10_10_10_REV, 4, GL_TRUE, offsetof(CompactVertex, Normal) },
+		{ VertexSemantic::TexCoord, GL_HALF_FLOAT, 2, GL_FALSE, offsetof(CompactVertex, TexCoords) },
+	};
+};
+
+template<>
+struct VertexLayout<PositionVertex> {
+	static constexpr VertexAttributeFormat Attributes[] = {
+		{ VertexSemantic::Position, GL_FLOAT, 3, GL_FALSE, offsetof(PositionVertex, Position) },
+	};
+};
+
+template<>
+struct VertexLayout<SurfaceVertex> {
+	static constexpr VertexAttributeFormat Attributes[] = {
+		{ VertexSemantic::Normal, GL_FLOAT, 3, GL_FALSE, offsetof(SurfaceVertex, Normal) },
+		{ VertexSemantic::TexCoord, GL_FLOAT, 2, GL_FALSE, offsetof(SurfaceVertex, TexCoords) },
+	};
+};
+
+template<>
+struct VertexLayout<LightmapVertex> {
+	static constexpr VertexAttributeFormat Attributes[] = {
+		{ VertexSemantic::LightmapCoord, GL_FLOAT, 2, GL_FALSE, offsetof(LightmapVertex, Coords) },
+	};
+};
+
+template<>
+struct VertexLayout<SkinVertex> {
+	static constexpr VertexAttributeFormat Attributes[] = {
+		// exact small integers once converted, the shader rounds them back to indices
+		{ VertexSemantic::Joints, GL_UNSIGNED_SHORT, 4, GL_FALSE, offsetof(SkinVertex, Joints) },
+		{ VertexSemantic::Weights, GL_UNSIGNED_BYTE, 4, GL_TRUE, offsetof(SkinVertex, Weights) },
+	};
+};
+
+// true if every attribute has a size, fits inside V and overlaps no other
+template<typename V>
+constexpr bool IsValidLayout()
+{
+	const auto& attributes = VertexLayout<V>::Attributes;
+	for (size_t i = 0; i < std::size(attributes); i++)
+	{
+		size_t size = GetAttributeSize(attributes[i]);
+		if (size == 0 || attributes[i].offset + size > sizeof(V))
+			return false;
+		for (size_t j = 0; j < i; j++)
+		{
+			if (attributes[i].semantic == attributes[j].semantic)
+				return false;
+			if (attributes[i].offset < attributes[j].offset + GetAttributeSize(attributes[j]) && attributes[j].offset < attributes[i].offset + size)
+				return false;
+		}
+	}
+	return true;
+}
+
+static_assert(IsValidLayout<Vertex>() && IsValidLayout<CompactVertex>());
+static_assert(IsValidLayout<PositionVertex>() && IsValidLayout<SurfaceVertex>());
+static_assert(IsValidLayout<LightmapVertex>() && IsValidLayout<SkinVertex>());
+
+// Vertices as the two streams, back to back in one buffer: all positions, then all
+// surface attributes. Returns the byte offset of the surface stream.
+inline size_t WriteVertexStreams(const std::vector<Vertex>& vertices, std::vector<unsigned char>& buffer)
+{
+	size_t surfaceOffset = vertices.size() * sizeof(PositionVertex);
+	buffer.resize(surfaceOffset + vertices.size() * sizeof(SurfaceVertex));
+	PositionVertex* positions = reinterpret_cast<PositionVertex*>(buffer.data());
+	SurfaceVertex* surfaces = reinterpret_cast<SurfaceVertex*>(buffer.data() + surfaceOffset);
+	for (size_t i = 0; i < vertices.size(); i++)
+	{
+		positions[i].Position = vertices[i].Position;
+		surfaces[i].Normal = vertices[i].Normal;
+		surfaces[i].TexCoords = vertices[i].TexCoords;
+	}
+	return surfaceOffset;
+}
+
+// formats and enables every attribute of V on one buffer binding of vao, GL 4.5
+template<typename V>
+void SetVertexArrayFormat(GLuint vao, GLuint binding)
+{
+	static_assert(IsValidLayout<V>());
+	for (const VertexAttributeFormat& attribute : VertexLayout<V>::Attributes)
+	{
+		GLuint location = GetSemanticLocation(attribute.semantic);
+		glEnableVertexArrayAttrib(vao, location);
+		glVertexArrayAttribFormat(vao, location, attribute.count, attribute.type, attribute.normalized, attribute.offset);
+		glVertexArrayAttribBinding(vao, location, binding);
+	}
+}
+
+// the same for the bound VAO, sourcing V from offset into the buffer bound to GL_ARRAY_BUFFER
+template<typename V>
+void SetVertexAttribPointers(size_t offset = 0)
+{
+	static_assert(IsValidLayout<V>());
+	for (const VertexAttributeFormat& attribute : VertexLayout<V>::Attributes)
+	{
+		GLuint location = GetSemanticLocation(attribute.semantic);
+		glEnableVertexAttribArray(location);
+		glVertexAttribPointer(location, attribute.count, attribute.type, attribute.normalized, sizeof(V), reinterpret_cast<const void*>(static_cast<uintptr_t>(offset + attribute.offset)));
+	}
+}
@@ -0,0 +1,7 @@
+layout(std140) uniform Camera
+{
+    mat4 projection;
+    mat4 view;
+    mat4 viewProjection;
+    vec4 cameraPosition;
+};
\ No newline at end of file
@@ -0,0 +1,109 @@
+#shader vertex
+#version 430 core
+
+layout(location = POSITION_LOCATION) in vec3 position;
+#ifndef DEPTH_ONLY
+layout(location = NORMAL_LOCATION) in vec3 normal;
+layout(location = TEXCOORD_LOCATION) in vec2 texCoord;
+#endif
+layout(location = DRAW_ID_LOCATION) in uint drawID;
+
+struct DrawData
+{
+    uint transformIndex;
+    uint materialIndex;
+};
+
+layout(std430, binding = 0) readonly buffer Transforms
+{
+    mat4 transforms[];
+};
+
+layout(std430, binding = 1) readonly buffer Draws
+{
+    DrawData draws[];
+};
+
+#include "camera.glsl"
+
+#ifndef DEPTH_ONLY
+out vec2 TexCoord;
+flat out uint MaterialIndex;
+#endif
+#ifdef CLUSTERED_LIGHTING
+out vec3 WorldPosition;
+out vec3 WorldNormal;
+out float ViewDepth;
+#endif
+// the depth prepass and the shaded pass have to arrive at bit-identical depths
+invariant gl_Position;
+
+void main()
+{
+    // drawID is an instanced attribute, so it reads the command's baseInstance
+    DrawData draw = draws[drawID];
+    gl_Position = viewProjection * transforms[draw.transformIndex] * vec4(position, 1.0);
+#ifndef DEPTH_ONLY
+    TexCoord = texCoord;
+    MaterialIndex = draw.materialIndex;
+#endif
+#ifdef CLUSTERED_LIGHTING
+    mat4 world = transforms[draw.transformIndex];
+    WorldPosition = vec3(world * vec4(position, 1.0));
+    // uniform scale is assumed; the models are not sheared or squashed
+    WorldNormal = mat3(world) * normal;
+    ViewDepth = -(view * vec4(WorldPosition, 1.0)).z;
+#endif
+}
+
+#shader fragment
+#version 430 core
+
+#ifdef DEPTH_ONLY
+void main()
+{
+}
+#else
+struct MaterialParameters
+{
+    vec4 ambient;
+    vec4 specular;
+    float shininess;
+    float opacity;
+    vec2 padding;
+};
+
+layout(std430, binding = 2) readonly buffer Materials
+{
+    MaterialParameters materials[];
+};
+
+in vec2 TexCoord;
+flat in uint MaterialIndex;
+#ifdef CLUSTERED_LIGHTING
+in vec3 WorldPosition;
+in vec3 WorldNormal;
+in float ViewDepth;
+
+#include "camera.glsl"
+#include "lights.glsl"
+#endif
+
+out vec4 outColor;
+
+uniform sampler2D texture_diffuse1;
+
+void main()
+{
+    vec4 diffuse = texture(texture_diffuse1, TexCoord);
+    MaterialParameters material = materials[MaterialIndex];
+#ifdef CLUSTERED_LIGHTING
+    vec3 lightDiffuse = ambientLight.rgb;
+    vec3 lightSpecular = vec3(0.0);
+    accumulateLights(WorldPosition, normalize(WorldNormal), ViewDepth, max(material.shininess, 1.0), lightDiffuse, lightSpecular);
+    outColor = vec4(diffuse.rgb * lightDiffuse + material.specular.rgb * lightSpecular, diffuse.a * material.opacity);
+#else
+    outColor = vec4(diffuse.rgb, diffuse.a * material.opacity);
+#endif
+}
+#endif
\ No newline at end of file
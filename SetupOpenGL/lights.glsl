@@ -0,0 +1,56 @@
+// Clustered lights, filled by LightBuffer. The fragment's cluster comes from its
+// screen tile and its view depth; only the lights listed for it are evaluated.
+
+struct LightData
+{
+    vec4 positionRange;
+    vec4 colorSpotScale;
+    vec4 directionSpotOffset;
+};
+
+layout(std430, binding = 3) readonly buffer Lights
+{
+    uvec4 clusterCount;
+    vec4 clusterScale;
+    vec4 ambientLight;
+    LightData lights[];
+};
+
+layout(std430, binding = 4) readonly buffer LightClusters
+{
+    uvec2 clusters[];
+};
+
+layout(std430, binding = 5) readonly buffer LightIndices
+{
+    uint lightIndices[];
+};
+
+// adds the diffuse and specular light of the dynamic lights at a world-space point; the
+// caller starts diffuseLight at the ambient or baked light
+void accumulateLights(vec3 position, vec3 normal, float viewDepth, float shininess, inout vec3 diffuseLight, inout vec3 specularLight)
+{
+    if (clusterCount.w == 0u)
+        return;
+
+    float slice = max(log(viewDepth) * clusterScale.z + clusterScale.w, 0.0);
+    uvec3 cluster = min(uvec3(uvec2(gl_FragCoord.xy * clusterScale.xy), uint(slice)), clusterCount.xyz - 1u);
+    uvec2 range = clusters[cluster.x + clusterCount.x * (cluster.y + clusterCount.y * cluster.z)];
+
+    vec3 toEye = normalize(cameraPosition.xyz - position);
+    for (uint i = 0u; i < range.y; i++)
+    {
+        LightData light = lights[lightIndices[range.x + i]];
+        vec3 toLight = light.positionRange.xyz - position;
+        float lightDistance = length(toLight);
+        toLight /= max(lightDistance, 0.0001);
+
+        // reaches zero at the range the light was culled with
+        float falloff = clamp(1.0 - lightDistance / light.positionRange.w, 0.0, 1.0);
+        float cone = clamp(dot(-toLight, light.directionSpotOffset.xyz) * light.colorSpotScale.w + light.directionSpotOffset.w, 0.0, 1.0);
+        vec3 radiance = light.colorSpotScale.rgb * (falloff * falloff * cone);
+
+        diffuseLight += radiance * max(dot(normal, toLight), 0.0);
+        specularLight += radiance * pow(max(dot(normal, normalize(toLight + toEye)), 0.0), shininess);
+    }
+}
\ No newline at end of file
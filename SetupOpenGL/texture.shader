@@ -1,40 +1,183 @@
 #shader vertex
 #version 330 core
+#if defined(SKINNED) || defined(TRANSFORM_BUFFER)
+#extension GL_ARB_shader_storage_buffer_object : require
+#extension GL_ARB_shading_language_420pack : require
+#endif
 
-in vec3 position;
-in vec3 normal;
-in vec3 color;
-in vec2 texCoord;
+layout(location = POSITION_LOCATION) in vec3 position;
+#ifndef DEPTH_ONLY
+layout(location = NORMAL_LOCATION) in vec3 normal;
+layout(location = TEXCOORD_LOCATION) in vec2 texCoord;
+#endif
+#ifdef LIGHTMAP
+layout(location = LIGHTMAP_LOCATION) in vec2 lightmapCoord;
+#endif
+#ifdef INSTANCED
+layout(location = INSTANCE_MODEL_LOCATION) in mat4 instanceModel;
+#endif
+#ifdef TRANSFORM_BUFFER
+// the draw's slot: an instanced attribute over 0, 1, 2..., so it reads the draw's baseInstance
+layout(location = DRAW_ID_LOCATION) in uint transformIndex;
+#endif
+#ifdef SKINNED
+layout(location = JOINTS_LOCATION) in vec4 joints;
+layout(location = WEIGHTS_LOCATION) in vec4 weights;
+#endif
 
-out vec3 Color;
+#ifndef DEPTH_ONLY
 out vec2 TexCoord;
+#endif
+#ifdef LIGHTMAP
+out vec2 LightmapCoord;
+#endif
+#ifdef CLUSTERED_LIGHTING
+out vec3 WorldPosition;
+out vec3 WorldNormal;
+out float ViewDepth;
+#endif
+// the depth prepass and the shaded pass have to arrive at bit-identical depths
+invariant gl_Position;
 
+#include "camera.glsl"
+
+#if defined(TRANSFORM_BUFFER)
+layout(std430, binding = 0) readonly buffer Transforms
+{
+    mat4 transforms[];
+};
+#elif !defined(INSTANCED)
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+#endif
+
+#ifdef SKINNED
+// filled by SkinnedObject: three rows of an affine matrix per palette entry, one palette
+// of paletteSize entries per instance
+layout(std430, binding = 6) readonly buffer SkinPalettes
+{
+    vec4 paletteRows[];
+};
+uniform int paletteSize;
+#endif
 
 void main()
 {
-    gl_Position = projection * view * model * vec4(position, 1.0);
-    Color = color;
+#if defined(INSTANCED)
+    mat4 world = instanceModel;
+#elif defined(TRANSFORM_BUFFER)
+    mat4 world = transforms[transformIndex];
+#else
+    mat4 world = model;
+#endif
+    vec4 localPosition = vec4(position, 1.0);
+#ifndef DEPTH_ONLY
+    vec3 localNormal = normal;
+#endif
+#ifdef SKINNED
+    // the weighted sum of the joints' matrices moves the vertex and its normal alike
+    vec4 rows[3] = vec4[3](vec4(0.0), vec4(0.0), vec4(0.0));
+    for (int i = 0; i < 4; i++)
+    {
+        int entry = (gl_InstanceID * paletteSize + int(joints[i])) * 3;
+        for (int row = 0; row < 3; row++)
+            rows[row] += paletteRows[entry + row] * weights[i];
+    }
+    localPosition = vec4(dot(rows[0], localPosition), dot(rows[1], localPosition), dot(rows[2], localPosition), 1.0);
+#ifndef DEPTH_ONLY
+    localNormal = vec3(dot(rows[0].xyz, localNormal), dot(rows[1].xyz, localNormal), dot(rows[2].xyz, localNormal));
+#endif
+#endif
+    gl_Position = viewProjection * world * localPosition;
+#ifndef DEPTH_ONLY
     TexCoord = texCoord;
+#endif
+#ifdef LIGHTMAP
+    LightmapCoord = lightmapCoord;
+#endif
+#ifdef CLUSTERED_LIGHTING
+    WorldPosition = vec3(world * localPosition);
+    // uniform scale is assumed; the models are not sheared or squashed
+    WorldNormal = mat3(world) * localNormal;
+    ViewDepth = -(view * vec4(WorldPosition, 1.0)).z;
+#endif
 }
 
 #shader fragment
 #version 330 core
+#ifdef CLUSTERED_LIGHTING
+#extension GL_ARB_shader_storage_buffer_object : require
+#extension GL_ARB_shading_language_420pack : require
+#endif
 
-in vec3 Color;
+#ifdef DEPTH_ONLY
+void main()
+{
+}
+#else
 in vec2 TexCoord;
+#ifdef LIGHTMAP
+in vec2 LightmapCoord;
+#endif
+#ifdef CLUSTERED_LIGHTING
+in vec3 WorldPosition;
+in vec3 WorldNormal;
+in float ViewDepth;
+#endif
 
 out vec4 outColor;
 
+#ifdef HAS_DIFFUSE_MAP
 uniform sampler2D texture_diffuse1;
-uniform sampler2D texture_diffuse2;
-uniform sampler2D texture_diffuse3;
+#endif
+#ifdef HAS_SPECULAR_MAP
 uniform sampler2D texture_specular1;
-uniform sampler2D texture_specular2;
+#endif
+#ifdef LIGHTMAP
+// sqrt(light / LightmapData::Range)
+uniform sampler2D lightmap;
+const float lightmapRange = 4.0;
+#endif
+
+layout(std140) uniform Material
+{
+    vec4 ambient;
+    vec4 specular;
+    float shininess;
+    float opacity;
+};
+
+#ifdef CLUSTERED_LIGHTING
+#include "camera.glsl"
+#include "lights.glsl"
+#endif
 
 void main()
 {
-    outColor = texture(texture_diffuse1, TexCoord);
-}
\ No newline at end of file
+#ifdef HAS_DIFFUSE_MAP
+    vec4 diffuse = texture(texture_diffuse1, TexCoord);
+#else
+    vec4 diffuse = vec4(ambient.rgb, 1.0);
+#endif
+#if defined(LIGHTMAP)
+    // everything static, bounces included, in one fetch
+    vec3 baked = texture(lightmap, LightmapCoord).rgb;
+    vec3 lightDiffuse = baked * baked * lightmapRange;
+#elif defined(CLUSTERED_LIGHTING)
+    vec3 lightDiffuse = ambientLight.rgb;
+#else
+    vec3 lightDiffuse = vec3(1.0);
+#endif
+#ifdef CLUSTERED_LIGHTING
+    vec3 lightSpecular = vec3(0.0);
+    accumulateLights(WorldPosition, normalize(WorldNormal), ViewDepth, max(shininess, 1.0), lightDiffuse, lightSpecular);
+#ifdef HAS_SPECULAR_MAP
+    vec3 specularColor = specular.rgb * texture(texture_specular1, TexCoord).rgb;
+#else
+    vec3 specularColor = specular.rgb;
+#endif
+    outColor = vec4(diffuse.rgb * lightDiffuse + specularColor * lightSpecular, diffuse.a * opacity);
+#else
+    outColor = vec4(diffuse.rgb * lightDiffuse, diffuse.a * opacity);
+#endif
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,29 @@
+#pragma once
+#include <iostream>
+
+// Minimal assertion for the test executables: a failed check is printed and counted,
+// and main returns CheckFailures() so ctest sees a non-zero exit code.
+inline int& CheckFailures()
+{
+	static int failures = 0;
+	return failures;
+}
+
+#define CHECK(condition) \
+	do { \
+		if (!(condition)) { \
+			std::cout << __FILE__ << ":" << __LINE__ << ": CHECK(" #condition ") failed" << std::endl; \
+			CheckFailures()++; \
+		} \
+	} while (false)
+
+#define CHECK_EQ(actual, expected) \
+	do { \
+		auto checkActual = (actual); \
+		auto checkExpected = (expected); \
+		if (!(checkActual == checkExpected)) { \
+			std::cout << __FILE__ << ":" << __LINE__ << ": CHECK_EQ(" #actual ", " #expected ") failed: " \
+				<< checkActual << " != " << checkExpected << std::endl; \
+			CheckFailures()++; \
+		} \
+	} while (false)
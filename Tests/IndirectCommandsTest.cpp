@@ -0,0 +1,75 @@
+#include "Check.h"
+#include "IndirectCommands.h"
+
+// BuildIndirectCommands on a sorted list of draws: one command per draw carrying the
+// mesh's pool range, drawData indexed by baseInstance, and a batch per run of draws
+// that share program and material.
+int main()
+{
+	// stand-ins; the builder only compares the pointers
+	const Material* brick = reinterpret_cast<const Material*>(0x10);
+	const Material* glass = reinterpret_cast<const Material*>(0x20);
+
+	std::vector<IndirectDraw> draws = {
+		{ { 0, 36, 0 }, 4, 1, 7, brick },
+		{ { 36, 6, 24 }, 5, 1, 7, brick },
+		{ { 42, 12, 28 }, 6, 2, 7, glass },
+		{ { 54, 3, 36 }, 9, 1, 8, brick },
+		{ { 57, 3, 39 }, 2, 1, 8, brick },
+	};
+
+	IndirectCommandList list;
+	BuildIndirectCommands(draws, list);
+
+	CHECK_EQ(list.commands.size(), draws.size());
+	CHECK_EQ(list.drawData.size(), draws.size());
+	for (size_t i = 0; i < draws.size() && i < list.commands.size() && i < list.drawData.size(); i++)
+	{
+		const DrawElementsIndirectCommand& command = list.commands[i];
+		CHECK_EQ(command.count, draws[i].range.indexCount);
+		CHECK_EQ(command.instanceCount, 1u);
+		CHECK_EQ(command.firstIndex, draws[i].range.firstIndex);
+		CHECK_EQ(command.baseVertex, draws[i].range.baseVertex);
+		CHECK_EQ(command.baseInstance, static_cast<GLuint>(i));
+
+		// the shader finds a draw's record through the command's baseInstance
+		const DrawData& data = list.drawData[command.baseInstance];
+		CHECK_EQ(data.transformIndex, draws[i].transformIndex);
+		CHECK_EQ(data.materialIndex, draws[i].materialIndex);
+	}
+
+	// brick, glass, then brick again under the second program
+	CHECK_EQ(list.batches.size(), 3u);
+	if (list.batches.size() == 3)
+	{
+		CHECK_EQ(list.batches[0].program, 7u);
+		CHECK(list.batches[0].material == brick);
+		CHECK_EQ(list.batches[0].firstCommand, 0u);
+		CHECK_EQ(list.batches[0].commandCount, 2u);
+
+		CHECK_EQ(list.batches[1].program, 7u);
+		CHECK(list.batches[1].material == glass);
+		CHECK_EQ(list.batches[1].firstCommand, 2u);
+		CHECK_EQ(list.batches[1].commandCount, 1u);
+
+		CHECK_EQ(list.batches[2].program, 8u);
+		CHECK(list.batches[2].material == brick);
+		CHECK_EQ(list.batches[2].firstCommand, 3u);
+		CHECK_EQ(list.batches[2].commandCount, 2u);
+	}
+
+	// a rebuild starts from scratch
+	BuildIndirectCommands({ draws[2] }, list);
+	CHECK_EQ(list.commands.size(), 1u);
+	CHECK_EQ(list.batches.size(), 1u);
+	if (!list.commands.empty())
+	{
+		CHECK_EQ(list.commands[0].baseVertex, 28);
+		CHECK_EQ(list.commands[0].baseInstance, 0u);
+	}
+
+	BuildIndirectCommands({}, list);
+	CHECK(list.commands.empty() && list.drawData.empty() && list.batches.empty());
+
+	return CheckFailures();
+}
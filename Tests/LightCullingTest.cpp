@@ -0,0 +1,148 @@
+#include "Check.h"
+#include "JobSystem.h"
+#include "LightCulling.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+// LightCuller::Cull against testing every light against every cluster on its own with
+// IntersectsCluster, inline and on the job system, plus a few lights whose clusters are
+// known: one straddling the screen centre, one behind the camera, one past the far plane
+// and a narrow spot light.
+namespace {
+	const float NearPlane = 0.1f;
+	const float FarPlane = 100.0f;
+
+	// lights scattered through a box around the view, every fourth a spot pointing down
+	std::vector<Light> makeLights(size_t count)
+	{
+		std::mt19937 random(1234);
+		std::uniform_real_distribution<float> across(-60.0f, 60.0f);
+		std::uniform_real_distribution<float> depth(-110.0f, 10.0f);
+		std::uniform_real_distribution<float> range(1.0f, 8.0f);
+		std::vector<Light> lights(count);
+		for (size_t i = 0; i < count; i++)
+		{
+			Light& light = lights[i];
+			light.Position = glm::vec3(across(random), across(random) * 0.25f, depth(random));
+			light.Range = range(random);
+			if (i % 4 == 3)
+			{
+				light.Type = LightType::Spot;
+				light.Direction = glm::vec3(0.0f, -1.0f, 0.2f);
+				light.InnerCone = 0.95f;
+				light.OuterCone = i % 8 == 3 ? 0.85f : 0.5f;
+			}
+		}
+		return lights;
+	}
+
+	// clusters whose list differs from the brute-force one
+	size_t countMismatches(const LightCuller& culler, const std::vector<Light>& lights, const glm::mat4& view)
+	{
+		std::vector<glm::vec4> spheres;
+		for (const Light& light : lights)
+			spheres.push_back(LightCuller::GetBoundingSphere(light, view));
+
+		size_t mismatches = 0;
+		std::vector<uint32_t> expected;
+		for (uint32_t cluster = 0; cluster < culler.GetClusterCount(); cluster++)
+		{
+			expected.clear();
+			for (uint32_t i = 0; i < spheres.size(); i++)
+			{
+				if (LightCuller::IntersectsCluster(spheres[i], culler.GetClusterBounds()[cluster]))
+					expected.push_back(i);
+			}
+			const LightCluster& range = culler.GetClusters()[cluster];
+			const uint32_t* indices = culler.GetLightIndices().data() + range.offset;
+			if (range.count != expected.size() || !std::equal(expected.begin(), expected.end(), indices))
+				mismatches++;
+		}
+		return mismatches;
+	}
+
+	bool clusterHas(const LightCuller& culler, uint32_t cluster, uint32_t light)
+	{
+		const LightCluster& range = culler.GetClusters()[cluster];
+		const uint32_t* indices = culler.GetLightIndices().data() + range.offset;
+		return std::find(indices, indices + range.count, light) != indices + range.count;
+	}
+
+	uint32_t sliceOf(const LightCuller& culler, float depth)
+	{
+		return static_cast<uint32_t>(std::log(depth) * culler.GetSliceScale() + culler.GetSliceBias());
+	}
+}
+
+int main()
+{
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, NearPlane, FarPlane);
+
+	// brute force, with the slices culled inline and then as jobs
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 2.0f, 0.0f), glm::vec3(0.0f, 1.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	for (size_t count : { 1, 100, 1000 })
+	{
+		std::vector<Light> lights = makeLights(count);
+		for (int workers : { 0, 3 })
+		{
+			JobSystem::Initialize(workers);
+			LightCuller culler;
+			culler.Cull(lights, view, projection, NearPlane, FarPlane);
+			CHECK_EQ(countMismatches(culler, lights, view), 0u);
+			CHECK_EQ(culler.GetStats().lights, static_cast<unsigned int>(count));
+			CHECK_EQ(culler.GetStats().references, static_cast<unsigned int>(culler.GetLightIndices().size()));
+			JobSystem::Shutdown();
+		}
+	}
+
+	// fixed lights, seen from the origin down -z
+	std::vector<Light> lights(4);
+	// on the line between the two middle columns of tiles, ten units away
+	lights[0].Position = glm::vec3(0.0f, 0.0f, -10.0f);
+	lights[0].Range = 0.5f;
+	lights[1].Position = glm::vec3(0.0f, 0.0f, 10.0f);
+	lights[1].Range = 2.0f;
+	lights[2].Position = glm::vec3(0.0f, 0.0f, -120.0f);
+	lights[2].Range = 5.0f;
+	// 25 degrees either side of +x, so its sphere is much smaller than its range
+	lights[3].Type = LightType::Spot;
+	lights[3].Position = glm::vec3(0.0f, 0.0f, -20.0f);
+	lights[3].Direction = glm::vec3(1.0f, 0.0f, 0.0f);
+	lights[3].Range = 10.0f;
+	lights[3].OuterCone = 0.9f;
+
+	LightCuller culler;
+	glm::mat4 identity(1.0f);
+	culler.Cull(lights, identity, projection, NearPlane, FarPlane);
+	CHECK_EQ(countMismatches(culler, lights, identity), 0u);
+	CHECK_EQ(culler.GetStats().visibleLights, 2u);
+
+	uint32_t slice = sliceOf(culler, 10.0f);
+	uint32_t middleX = culler.GetTilesX() / 2;
+	uint32_t middleY = culler.GetTilesY() / 2;
+	CHECK(clusterHas(culler, culler.GetClusterIndex(middleX - 1, middleY, slice), 0));
+	CHECK(clusterHas(culler, culler.GetClusterIndex(middleX, middleY, slice), 0));
+	CHECK(!clusterHas(culler, culler.GetClusterIndex(0, 0, slice), 0));
+	CHECK(!clusterHas(culler, culler.GetClusterIndex(middleX, middleY, 0), 0));
+	for (uint32_t cluster = 0; cluster < culler.GetClusterCount(); cluster++)
+	{
+		CHECK(!clusterHas(culler, cluster, 1));
+		CHECK(!clusterHas(culler, cluster, 2));
+	}
+
+	// the sphere holds the apex and the rim of the cone at its range
+	glm::vec4 sphere = LightCuller::GetBoundingSphere(lights[3], identity);
+	CHECK(sphere.w < lights[3].Range);
+	float sine = std::sqrt(1.0f - 0.9f * 0.9f);
+	glm::vec3 rim = lights[3].Position + lights[3].Range * glm::vec3(0.9f, sine, 0.0f);
+	CHECK(glm::length(glm::vec3(sphere) - lights[3].Position) <= sphere.w * 1.001f);
+	CHECK(glm::length(glm::vec3(sphere) - rim) <= sphere.w * 1.001f);
+	CHECK(clusterHas(culler, culler.GetClusterIndex(middleX, middleY, sliceOf(culler, 20.0f)), 3));
+
+	return CheckFailures();
+}
@@ -0,0 +1,201 @@
+#include "Check.h"
+#include "CameraBuffer.h"
+#include "GeometryPool.h"
+#include "GLState.h"
+#include "IndirectRenderer.h"
+#include "Material.h"
+#include "Mesh.h"
+#include "RenderBackend.h"
+#include "RenderQueue.h"
+#include "ShaderManager.h"
+#include "StreamBuffer.h"
+#include "TransformBuffer.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <memory>
+#include <vector>
+
+// Draws a procedural scene through the render queue on the null and recording backends
+// and checks what reaches GL: one draw per mesh (or one multi-draw per material batch on
+// the indirect path) and, once the stream buffer is persistently mapped, no buffer or
+// texture uploads at all in a steady-state frame. Runs from SetupOpenGL/ for the shaders.
+namespace {
+	const size_t MeshCount = 240;
+	const size_t MaterialCount = 4;
+	const int WarmupFrames = 3;
+	const int MeasuredFrames = 4;
+
+	struct Scene {
+		ShaderManager shaders;
+		ShaderHandle shader;
+		std::vector<std::shared_ptr<Material>> materials;
+		std::vector<Mesh> meshes;
+		std::vector<glm::mat4> models;
+		std::vector<GLuint> transformIndices;
+
+		// a row of unit quads, every one its own mesh, cycling through the materials
+		explicit Scene(uint32_t features)
+		{
+			Material::RegisterBindings(shaders);
+			shader = shaders.LoadVariant("texture.shader", features);
+
+			MaterialParameters parameters = { glm::vec4(0.1f), glm::vec4(0.5f), 32.0f, 1.0f, { 0.0f, 0.0f } };
+			for (size_t i = 0; i < MaterialCount; i++)
+				materials.push_back(std::make_shared<Material>(parameters, std::vector<Texture>(), shaders, shader, features));
+
+			std::vector<Vertex> vertices(4);
+			for (int v = 0; v < 4; v++)
+			{
+				vertices[v].Position = glm::vec3(float(v & 1), float(v >> 1), 0.0f);
+				vertices[v].Normal = glm::vec3(0.0f, 0.0f, 1.0f);
+				vertices[v].TexCoords = glm::vec2(float(v & 1), float(v >> 1));
+			}
+			meshes.reserve(MeshCount);
+			for (size_t i = 0; i < MeshCount; i++)
+			{
+				meshes.emplace_back(vertices, std::vector<unsigned int>{ 0, 1, 2, 2, 1, 3 }, materials[i % MaterialCount], shaders.Get(shader));
+				models.push_back(glm::translate(glm::mat4(1.0f), glm::vec3(float(i % 16) * 1.5f, float(i / 16) * 1.5f, -10.0f)));
+			}
+			transformIndices.assign(MeshCount, TransformBuffer::InvalidIndex);
+		}
+	};
+
+	struct FrameCounts {
+		RenderCounters counters;
+		RenderQueueStats queue;
+	};
+
+	// one frame as the viewer draws it: stream, camera, transforms, the queue, then the frame ends
+	FrameCounts drawFrame(Scene& scene, RenderQueue& queue, StreamBuffer& stream, CameraBuffer& camera, TransformBuffer* transforms)
+	{
+		glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+		glm::mat4 view = glm::lookAt(glm::vec3(12.0f, 10.0f, 20.0f), glm::vec3(12.0f, 10.0f, -10.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+		scene.shaders.Update();
+		stream.BeginFrame();
+		camera.Update(projection, view, glm::vec3(12.0f, 10.0f, 20.0f));
+		if (transforms)
+		{
+			transforms->BeginFrame();
+			for (size_t i = 0; i < scene.meshes.size(); i++)
+				transforms->Write(scene.transformIndices[i], scene.models[i]);
+			transforms->Publish();
+		}
+
+		for (size_t i = 0; i < scene.meshes.size(); i++)
+		{
+			const Mesh& mesh = scene.meshes[i];
+			Shader& shader = scene.shaders.Get(scene.shaders.Resolve(mesh.material->GetShader()));
+			queue.Push(RenderPass::Opaque, mesh, shader, scene.models[i], scene.transformIndices[i], 30.0f);
+		}
+		queue.Flush();
+
+		stream.EndFrame();
+		GLState::EndFrame();
+		RenderBackend::EndFrame();
+		return { RenderBackend::GetFrameCounters(), queue.GetStats() };
+	}
+
+	// the recorded counts of every measured frame after the warm-up; with transformBuffer the
+	// meshes read their world matrices from a TransformBuffer, which indirect needs as well
+	std::vector<FrameCounts> run(RenderBackendType backend, int version, bool transformBuffer, bool indirect)
+	{
+		RenderBackend::Install(backend, version);
+		GLState::Invalidate();
+
+		Scene scene(transformBuffer ? ShaderFeature::Transforms : ShaderFeature::None);
+		StreamBuffer stream(1024 * 1024);
+		CameraBuffer camera(stream);
+		RenderQueue queue(0.1f, 100.0f);
+
+		GeometryPool pool;
+		std::unique_ptr<TransformBuffer> transforms;
+		std::unique_ptr<IndirectRenderer> indirectRenderer;
+		ShaderHandle indirectShader = ShaderManager::InvalidHandle;
+		if (transformBuffer)
+		{
+			transforms = std::make_unique<TransformBuffer>(stream, static_cast<GLuint>(MeshCount));
+			for (size_t i = 0; i < scene.meshes.size(); i++)
+			{
+				scene.transformIndices[i] = transforms->Allocate();
+				scene.meshes[i].SetTransformIndexBuffer(transforms->GetIndexBuffer());
+			}
+		}
+		if (indirect)
+		{
+			for (Mesh& mesh : scene.meshes)
+				pool.Add(mesh);
+			pool.Upload();
+			indirectShader = scene.shaders.Load("indirect.shader");
+			CHECK(indirectShader != ShaderManager::InvalidHandle);
+			if (indirectShader != ShaderManager::InvalidHandle)
+			{
+				indirectRenderer = std::make_unique<IndirectRenderer>(scene.shaders.Get(indirectShader), pool, stream);
+				queue.SetIndirectRenderer(indirectRenderer.get());
+			}
+		}
+
+		std::vector<FrameCounts> frames;
+		for (int frame = 0; frame < WarmupFrames + MeasuredFrames; frame++)
+		{
+			FrameCounts counts = drawFrame(scene, queue, stream, camera, transforms.get());
+			if (frame >= WarmupFrames)
+				frames.push_back(counts);
+		}
+		return frames;
+	}
+}
+
+int main()
+{
+	// null backend: nothing is counted, but every packet still goes through the queue
+	for (const FrameCounts& frame : run(RenderBackendType::Null, 46, false, false))
+	{
+		CHECK_EQ(frame.queue.packets, MeshCount);
+		CHECK_EQ(frame.counters.calls, 0u);
+	}
+
+	// GL 3.3: one glDrawElements per mesh, the materials bound once each after sorting
+	for (const FrameCounts& frame : run(RenderBackendType::Recording, 33, false, false))
+	{
+		CHECK_EQ(frame.queue.packets, MeshCount);
+		CHECK_EQ(frame.counters.drawCalls, MeshCount);
+		CHECK_EQ(frame.counters.draws, MeshCount);
+		CHECK(frame.queue.stateChangesSorted <= frame.queue.stateChangesUnsorted);
+		// a VAO per mesh, and the program and material bindings once per material
+		CHECK(frame.counters.binds <= MeshCount + 2 * MaterialCount);
+		// without persistent mapping the camera block is the frame's one upload
+		CHECK_EQ(frame.counters.bufferUploads, 1u);
+		CHECK_EQ(frame.counters.textureUploads, 0u);
+	}
+
+	// GL 4.6: same draws, and the persistently mapped stream leaves nothing to upload
+	for (const FrameCounts& frame : run(RenderBackendType::Recording, 46, false, false))
+	{
+		CHECK_EQ(frame.counters.drawCalls, MeshCount);
+		CHECK_EQ(frame.counters.bufferUploads, 0u);
+		CHECK_EQ(frame.counters.textureUploads, 0u);
+	}
+
+	// GL 4.6 reading the TransformBuffer: still a draw per mesh, each passing its slot as the
+	// base instance instead of a model matrix
+	for (const FrameCounts& frame : run(RenderBackendType::Recording, 46, true, false))
+	{
+		CHECK_EQ(frame.counters.drawCalls, MeshCount);
+		CHECK_EQ(frame.counters.draws, MeshCount);
+		CHECK_EQ(frame.counters.bufferUploads, 0u);
+	}
+
+	// GL 4.6 multi-draw indirect: every mesh in one draw call per material
+	for (const FrameCounts& frame : run(RenderBackendType::Recording, 46, true, true))
+	{
+		CHECK(frame.counters.drawCalls <= MaterialCount);
+		CHECK_EQ(frame.counters.draws, MeshCount);
+		CHECK(frame.counters.binds <= 2 * MaterialCount);
+		CHECK_EQ(frame.counters.bufferUploads, 0u);
+		CHECK_EQ(frame.counters.textureUploads, 0u);
+	}
+
+	return CheckFailures();
+}